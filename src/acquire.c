@@ -77,16 +77,36 @@ typedef struct {
  * Definitions and routines for acquiring data from Data Sources in general
  *********************************************************/
 
+/**
+ * Show how much data has been read so far
+ */
+static void show_progress ( acq_dialog_widgets_t *w, gsize bytes_read )
+{
+  gchar *size = NULL;
+#if GLIB_CHECK_VERSION(2,30,0)
+  size = g_format_size_full ( bytes_read, G_FORMAT_SIZE_DEFAULT );
+#else
+  size = g_format_size_for_display ( bytes_read );
+#endif
+  gchar *msg = g_strdup_printf ( _("Read %s..."), size );
+  gtk_label_set_text ( GTK_LABEL(w->status), msg );
+  g_free ( msg );
+  g_free ( size );
+}
+
 static void progress_func ( BabelProgressCode c, gpointer data, acq_dialog_widgets_t *w )
 {
   if ( w->source_interface->is_thread ) {
     gdk_threads_enter ();
+    // Once cancelled, the source is cleaned up by get_from_anything() when the process returns
     if ( !w->running ) {
-      if ( w->source_interface->cleanup_func )
-        w->source_interface->cleanup_func ( w->user_data );
+      if ( c == BABEL_QUERY_CANCEL )
+        *(gboolean*)data = TRUE;
       gdk_threads_leave ();
-      g_thread_exit ( NULL );
+      return;
     }
+    if ( c == BABEL_PROGRESS )
+      show_progress ( w, *(gsize*)data );
     gdk_threads_leave ();
   }
 
@@ -43,6 +43,10 @@
 #include <unistd.h>
 #endif
 #include <string.h>
+#ifndef WINDOWS
+#include <signal.h>
+#include <pthread.h>
+#endif
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n.h>
@@ -172,6 +176,76 @@ static void babel_watch ( GPid pid,
  *
  * Returns: %TRUE on successful invocation of GPSBabel command
  */
+static void babel_debug_args ( const gchar *function, gchar **args )
+{
+  if ( vik_debug ) {
+    (void)g_printf ( "%s:", function );
+    for ( guint i=0; args[i]; i++ )
+      (void)g_printf ( " %s", args[i] );
+    (void)g_printf ( "\n" );
+  }
+}
+
+/**
+ * Whether the callback wants GPSBabel stopped
+ */
+static gboolean babel_cancelled ( BabelStatusFunc cb, gpointer user_data )
+{
+  gboolean cancel = FALSE;
+  if ( cb )
+    cb ( BABEL_QUERY_CANCEL, &cancel, user_data );
+  return cancel;
+}
+
+/**
+ * Stop GPSBabel early, as nothing more is wanted from it.
+ * It is still reaped as normal once it has gone.
+ */
+static void babel_kill ( GPid pid )
+{
+#ifndef WINDOWS
+  kill ( pid, SIGTERM );
+#endif
+}
+
+/**
+ * Pass each line of GPSBabel's diagnostic output to the callback until it finishes
+ *
+ * Returns: %FALSE if it was stopped early by the callback
+ */
+static gboolean babel_read_diag ( BabelStatusFunc cb, gint babel_diag, GPid pid, gpointer user_data )
+{
+  gchar line[512] = "";
+  gboolean cancelled = FALSE;
+  FILE *diag;
+  diag = fdopen(babel_diag, "r");
+  setvbuf(diag, NULL, _IONBF, 0);
+
+  while (fgets(line, sizeof(line), diag)) {
+    // Once stopped, just wait for the output to end
+    if ( cancelled )
+      continue;
+    if ( babel_cancelled ( cb, user_data ) ) {
+      cancelled = TRUE;
+      babel_kill ( pid );
+      continue;
+    }
+    if ( cb )
+      cb(BABEL_DIAG_OUTPUT, line, user_data);
+  }
+  if ( cb && !cancelled )
+    cb(BABEL_DONE, NULL, user_data);
+  fclose(diag);
+  diag = NULL;
+
+  g_child_watch_add ( pid, (GChildWatchFunc) babel_watch, NULL );
+
+  // Useful to see in case of any errors,
+  //  although they don't always occur on the last line output
+  g_debug ( "%s: last received line is=\"%s\"", __FUNCTION__, line );
+  return !cancelled;
+}
+
 static gboolean babel_general_convert( BabelStatusFunc cb, gchar **args, gpointer user_data )
 {
   gboolean ret = FALSE;
@@ -179,41 +253,207 @@ static gboolean babel_general_convert( BabelStatusFunc cb, gchar **args, gpointe
   GError *error = NULL;
   gint babel_stdout;
 
-  if ( vik_debug ) {
-    (void)g_printf ( "%s:", __FUNCTION__ );
-    for ( guint i=0; args[i]; i++ )
-      (void)g_printf ( " %s", args[i] );
-    (void)g_printf ( "\n" );
-  }
+  babel_debug_args ( __FUNCTION__, args );
 
   if (!g_spawn_async_with_pipes (NULL, args, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL, &babel_stdout, NULL, &error)) {
     g_warning ("Async command failed: %s", error->message);
     g_error_free(error);
     ret = FALSE;
   } else {
+    ret = babel_read_diag ( cb, babel_stdout, pid, user_data );
+  }
+    
+  return ret;
+}
+
+/**
+ * babel_can_stream:
+ *
+ * Whether the GPX data can be passed to or from GPSBabel through pipes, rather than temporary files.
+ *
+ * Not when debug output is asked for (as for the progress of GPS device transfers),
+ *  since that output is only seen through unbuffer, which runs GPSBabel on a terminal
+ *  that mixes everything written together.
+ */
+static gboolean babel_can_stream ( const gchar *babelargs )
+{
+  if ( !babelargs )
+    return TRUE;
+  gboolean can = TRUE;
+  gchar **sub_args = g_strsplit ( babelargs, " ", 0 );
+  for ( guint i = 0; can && sub_args[i]; i++ )
+    can = g_strcmp0 ( sub_args[i], "-D" ) != 0;
+  g_strfreev ( sub_args );
+  return can;
+}
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define babel_thread_new(func,data) g_thread_try_new ( __FUNCTION__, (GThreadFunc)(func), (data), NULL )
+#else
+#define babel_thread_new(func,data) g_thread_create ( (GThreadFunc)(func), (data), TRUE, NULL )
+#endif
+
+/**
+ * Diagnostic output of GPSBabel collected while the main output is being parsed,
+ *  for passing on to the callback from the thread doing the conversion
+ */
+typedef struct {
+  FILE *diag;
+  GAsyncQueue *lines;
+  BabelStatusFunc cb;
+  gpointer user_data;
+  gboolean cancelled;
+} babel_stream_t;
+
+static gpointer babel_diag_thread ( babel_stream_t *bs )
+{
+  gchar line[512];
+  while ( bs->diag && fgets ( line, sizeof(line), bs->diag ) )
+    g_async_queue_push ( bs->lines, g_strdup ( line ) );
+  return NULL;
+}
+
+static void babel_stream_pass_diag ( babel_stream_t *bs )
+{
+  gchar *line;
+  while ( (line = g_async_queue_try_pop ( bs->lines )) ) {
+    if ( bs->cb && !bs->cancelled )
+      bs->cb ( BABEL_DIAG_OUTPUT, line, bs->user_data );
+    g_free ( line );
+  }
+}
+
+static gboolean babel_stream_progress ( gsize bytes_read, babel_stream_t *bs )
+{
+  if ( babel_cancelled ( bs->cb, bs->user_data ) ) {
+    bs->cancelled = TRUE;
+    return FALSE;
+  }
+  babel_stream_pass_diag ( bs );
+  if ( bs->cb )
+    bs->cb ( BABEL_PROGRESS, &bytes_read, bs->user_data );
+  return TRUE;
+}
+
+/**
+ * For threads writing into the standard input of GPSBabel:
+ * Should GPSBabel stop reading early, just let the writes fail rather than be killed by SIGPIPE
+ */
+static void babel_block_sigpipe ( void )
+{
+#ifndef WINDOWS
+  sigset_t set;
+  sigemptyset ( &set );
+  sigaddset ( &set, SIGPIPE );
+  pthread_sigmask ( SIG_BLOCK, &set, NULL );
+#endif
+}
+
+/**
+ * Data copied as it is into the standard input of GPSBabel
+ */
+typedef struct {
+  FILE *from;
+  FILE *to;
+} babel_copy_t;
+
+static gpointer babel_copy_thread ( babel_copy_t *bc )
+{
+  babel_block_sigpipe ();
+  gchar buf[4096];
+  size_t len;
+  while ( (len = fread ( buf, 1, sizeof(buf), bc->from )) > 0 )
+    if ( fwrite ( buf, 1, len, bc->to ) != len )
+      break;
+  fclose ( bc->to );
+  return NULL;
+}
+
+/**
+ * babel_general_convert_stream:
+ * @input: Optional data for the standard input of the command
+ *
+ * Runs args[0] with the arguments, which must write GPX to its standard output,
+ *  and parses the GPX into layer vt while the command is still running.
+ * Diagnostic output is taken from its standard error instead.
+ * When the callback asks to cancel, the command is stopped and this returns once it and its threads are done with.
+ *
+ * Returns: %TRUE on success
+ */
+static gboolean babel_general_convert_stream ( VikTrwLayer *vt, BabelStatusFunc cb, gchar **args, FILE *input, gpointer user_data )
+{
+  gboolean ret = FALSE;
+  GPid pid;
+  GError *error = NULL;
+  gint babel_stdin, babel_stdout, babel_stderr;
 
-    gchar line[512];
-    FILE *diag;
-    diag = fdopen(babel_stdout, "r");
-    setvbuf(diag, NULL, _IONBF, 0);
+  babel_debug_args ( __FUNCTION__, args );
 
-    while (fgets(line, sizeof(line), diag)) {
-      if ( cb )
-        cb(BABEL_DIAG_OUTPUT, line, user_data);
+  if (!g_spawn_async_with_pipes (NULL, args, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, input ? &babel_stdin : NULL, &babel_stdout, &babel_stderr, &error)) {
+    g_warning ("Async command failed: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  babel_copy_t bc = { input, NULL };
+  GThread *copy_thread = NULL;
+  if ( input ) {
+    bc.to = fdopen ( babel_stdin, "w" );
+    if ( bc.to ) {
+      copy_thread = babel_thread_new ( babel_copy_thread, &bc );
+      if ( !copy_thread ) {
+        g_warning ( "%s: could not start passing on the data", __FUNCTION__ );
+        fclose ( bc.to );
+      }
     }
-    if ( cb )
-      cb(BABEL_DONE, NULL, user_data);
-    fclose(diag);
-    diag = NULL;
+    else
+      close ( babel_stdin );
+  }
 
-    g_child_watch_add ( pid, (GChildWatchFunc) babel_watch, NULL );
+  babel_stream_t bs;
+  bs.diag = fdopen ( babel_stderr, "r" );
+  bs.lines = g_async_queue_new ();
+  bs.cb = cb;
+  bs.user_data = user_data;
+  bs.cancelled = FALSE;
+
+  GThread *thread = babel_thread_new ( babel_diag_thread, &bs );
+  if ( !thread )
+    g_warning ( "%s: diagnostic output will only be read at the end", __FUNCTION__ );
+
+  FILE *f = fdopen ( babel_stdout, "r" );
+  if ( f ) {
+    // As if read from a temporary file, for any relative links
+    ret = a_gpx_read_file_progress ( vt, f, g_get_tmp_dir(), (VikReadProgressFunc)babel_stream_progress, &bs );
+    // Should the GPX be malformed, closing the pipe ends the conversion
+    fclose ( f );
+  }
+  else
+    close ( babel_stdout );
 
-    // Useful to see in case of any errors,
-    //  although they don't always occur on the last line output
-    g_debug ( "%s: last received line is=\"%s\"", __FUNCTION__, line );
-    ret = TRUE;
+  // Not left reading its input or a device, so that the threads below finish
+  if ( bs.cancelled ) {
+    ret = FALSE;
+    babel_kill ( pid );
   }
-    
+
+  if ( copy_thread )
+    g_thread_join ( copy_thread );
+  if ( thread )
+    g_thread_join ( thread );
+  else
+    (void)babel_diag_thread ( &bs );
+  babel_stream_pass_diag ( &bs );
+  if ( cb && !bs.cancelled )
+    cb ( BABEL_DONE, NULL, user_data );
+  if ( bs.diag )
+    fclose ( bs.diag );
+  else
+    close ( babel_stderr );
+  g_async_queue_unref ( bs.lines );
+
+  g_child_watch_add ( pid, (GChildWatchFunc) babel_watch, NULL );
+
   return ret;
 }
 
@@ -282,17 +522,21 @@ gboolean a_babel_convert_from_filter( VikTrwLayer *vt, const char *babelargs, co
   gchar *name_dst = NULL;
   gboolean ret = FALSE;
   gchar *args[64];
+  // Parse the output as it is converted, unless it is only wanted to run gpsbabel
+  gboolean stream = vt && babel_can_stream ( babelargs );
 
-  if ((fd_dst = g_file_open_tmp("tmp-viking.XXXXXX", &name_dst, NULL)) >= 0) {
-    g_debug ("%s: temporary file: %s", __FUNCTION__, name_dst);
-    close(fd_dst);
+  if ( stream || (fd_dst = g_file_open_tmp("tmp-viking.XXXXXX", &name_dst, NULL)) >= 0) {
+    if ( !stream ) {
+      g_debug ("%s: temporary file: %s", __FUNCTION__, name_dst);
+      close(fd_dst);
+    }
 
     if (gpsbabel_loc ) {
       gchar **sub_args = g_strsplit(babelargs, " ", 0);
       gchar **sub_filters = NULL;
 
       i = 0;
-      if (unbuffer_loc)
+      if (unbuffer_loc && !stream)
         args[i++] = unbuffer_loc;
       args[i++] = gpsbabel_loc;
       for (j = 0; sub_args[j]; j++) {
@@ -313,23 +557,77 @@ gboolean a_babel_convert_from_filter( VikTrwLayer *vt, const char *babelargs, co
       args[i++] = "-o";
       args[i++] = "gpx";
       args[i++] = "-F";
-      args[i++] = name_dst;
+      args[i++] = stream ? "-" : name_dst;
       args[i] = NULL;
 
-      ret = babel_general_convert_from ( vt, cb, args, name_dst, user_data );
+      if ( stream )
+        ret = babel_general_convert_stream ( vt, cb, args, NULL, user_data );
+      else
+        ret = babel_general_convert_from ( vt, cb, args, name_dst, user_data );
 
       g_strfreev(sub_args);
       if (sub_filters)
           g_strfreev(sub_filters);
     } else
       g_critical("gpsbabel not found in PATH");
-    (void)g_remove(name_dst);
-    g_free(name_dst);
+    if ( name_dst ) {
+      (void)g_remove(name_dst);
+      g_free(name_dst);
+    }
   }
 
   return ret;
 }
 
+/**
+ * a_babel_convert_from_stream:
+ * @vt:        The TRW layer to place data into. Duplicate items will be overwritten.
+ * @babelargs: A string containing gpsbabel command line options. This string
+ *             must include the input file type (-i) option.
+ * @f:         The data to convert, which is passed to gpsbabel on its standard input
+ * @cb:        Optional callback function. Same usage as in a_babel_convert().
+ * @user_data: passed along to cb
+ *
+ * As a_babel_convert_from_filter(), for data that need not be in a file of its own,
+ *  such as that being decompressed.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean a_babel_convert_from_stream ( VikTrwLayer *vt, const char *babelargs, FILE *f, BabelStatusFunc cb, gpointer user_data )
+{
+  gboolean ret = FALSE;
+  gchar *args[64];
+  int i,j;
+
+  g_return_val_if_fail ( vt != NULL, FALSE );
+
+  if ( gpsbabel_loc ) {
+    gchar **sub_args = g_strsplit(babelargs, " ", 0);
+
+    i = 0;
+    args[i++] = gpsbabel_loc;
+    for (j = 0; sub_args[j]; j++) {
+      /* some version of gpsbabel can not take extra blank arg */
+      if (sub_args[j][0] != '\0')
+        args[i++] = sub_args[j];
+    }
+    args[i++] = "-f";
+    args[i++] = "-";
+    args[i++] = "-o";
+    args[i++] = "gpx";
+    args[i++] = "-F";
+    args[i++] = "-";
+    args[i] = NULL;
+
+    ret = babel_general_convert_stream ( vt, cb, args, f, user_data );
+
+    g_strfreev(sub_args);
+  } else
+    g_critical("gpsbabel not found in PATH");
+
+  return ret;
+}
+
 /**
  * a_babel_convert_from_shellcommand:
  * @vt: The #VikTrwLayer where to insert the collected data
@@ -342,8 +640,9 @@ gboolean a_babel_convert_from_filter( VikTrwLayer *vt, const char *babelargs, co
  * Runs the input command in a shell (bash) and optionally uses GPSBabel to convert from input_file_type.
  * If input_file_type is %NULL, doesn't use GPSBabel. Input must be GPX (or Geocaching *.loc)
  *
- * Uses babel_general_convert_from() to actually run the command. This function
- * prepares the command and temporary file, and sets up the arguments for bash.
+ * Uses babel_general_convert_stream() to actually run the command and read its output as it arrives,
+ * or babel_general_convert_from() via a temporary file when there is no layer for the data.
+ * This function prepares the command, and sets up the arguments for bash.
  */
 gboolean a_babel_convert_from_shellcommand ( VikTrwLayer *vt, const char *input_cmd, const char *input_file_type, BabelStatusFunc cb, gpointer user_data, gpointer not_used )
 {
@@ -351,18 +650,28 @@ gboolean a_babel_convert_from_shellcommand ( VikTrwLayer *vt, const char *input_
   gchar *name_dst = NULL;
   gboolean ret = FALSE;
   gchar **args;  
+  // Parse the output as it is produced, unless it is only wanted to run the command
+  gboolean stream = vt != NULL;
 
-  if ((fd_dst = g_file_open_tmp("tmp-viking.XXXXXX", &name_dst, NULL)) >= 0) {
-    g_debug ("%s: temporary file: %s", __FUNCTION__, name_dst);
+  if ( stream || (fd_dst = g_file_open_tmp("tmp-viking.XXXXXX", &name_dst, NULL)) >= 0) {
     gchar *shell_command;
-    if ( input_file_type )
-      shell_command = g_strdup_printf("%s | %s -i %s -f - -o gpx -F %s",
-        input_cmd, gpsbabel_loc, input_file_type, name_dst);
-    else
-      shell_command = g_strdup_printf("%s > %s", input_cmd, name_dst);
+    if ( stream ) {
+      if ( input_file_type )
+        shell_command = g_strdup_printf("%s | %s -i %s -f - -o gpx -F -",
+          input_cmd, gpsbabel_loc, input_file_type);
+      else
+        shell_command = g_strdup(input_cmd);
+    } else {
+      g_debug ("%s: temporary file: %s", __FUNCTION__, name_dst);
+      if ( input_file_type )
+        shell_command = g_strdup_printf("%s | %s -i %s -f - -o gpx -F %s",
+          input_cmd, gpsbabel_loc, input_file_type, name_dst);
+      else
+        shell_command = g_strdup_printf("%s > %s", input_cmd, name_dst);
+      close(fd_dst);
+    }
 
     g_debug("%s: %s", __FUNCTION__, shell_command);
-    close(fd_dst);
 
     args = g_malloc(sizeof(gchar *)*4);
     args[0] = BASH_LOCATION;
@@ -370,11 +679,16 @@ gboolean a_babel_convert_from_shellcommand ( VikTrwLayer *vt, const char *input_
     args[2] = shell_command;
     args[3] = NULL;
 
-    ret = babel_general_convert_from ( vt, cb, args, name_dst, user_data );
+    if ( stream )
+      ret = babel_general_convert_stream ( vt, cb, args, NULL, user_data );
+    else
+      ret = babel_general_convert_from ( vt, cb, args, name_dst, user_data );
     g_free ( args );
     g_free ( shell_command );
-    (void)g_remove(name_dst);
-    g_free(name_dst);
+    if ( name_dst ) {
+      (void)g_remove(name_dst);
+      g_free(name_dst);
+    }
   }
 
   return ret;
@@ -473,6 +787,75 @@ gboolean a_babel_convert_from ( VikTrwLayer *vt, ProcessOptions *process_options
   return FALSE;
 }
 
+/**
+ * GPX written into the standard input of GPSBabel
+ */
+typedef struct {
+  VikTrwLayer *vtl;
+  VikTrack *trk;
+  FILE *f;
+} babel_write_t;
+
+static gpointer babel_write_thread ( babel_write_t *bw )
+{
+  babel_block_sigpipe ();
+  // As a_file_export(), so invisible tracks and waypoints are left out
+  GpxWritingOptions options = { FALSE, FALSE, FALSE, FALSE };
+  if ( bw->trk ) {
+    options.is_route = bw->trk->is_route;
+    a_gpx_write_track_file ( bw->trk, bw->f, &options );
+  }
+  else
+    a_gpx_write_file ( bw->vtl, bw->f, &options, g_get_tmp_dir() );
+  fclose ( bw->f );
+  return NULL;
+}
+
+/**
+ * babel_general_convert_to_stream:
+ *
+ * Runs args[0] with the arguments, which must read GPX from its standard input,
+ *  writing the data of the layer (or just the track) to it while the command runs.
+ * Diagnostic output is taken from its standard error.
+ *
+ * Returns: %TRUE on successful invocation of GPSBabel command
+ */
+static gboolean babel_general_convert_to_stream ( VikTrwLayer *vt, VikTrack *trk, BabelStatusFunc cb, gchar **args, gpointer user_data )
+{
+  GPid pid;
+  GError *error = NULL;
+  gint babel_stdin, babel_stderr;
+
+  babel_debug_args ( __FUNCTION__, args );
+
+  // The output goes to the file or device given to GPSBabel, so only its diagnostics are of interest
+  if (!g_spawn_async_with_pipes (NULL, args, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &pid, &babel_stdin, NULL, &babel_stderr, &error)) {
+    g_warning ("Async command failed: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  babel_write_t bw = { vt, trk, fdopen ( babel_stdin, "w" ) };
+  GThread *thread = NULL;
+  if ( bw.f ) {
+    thread = babel_thread_new ( babel_write_thread, &bw );
+    if ( !thread ) {
+      g_warning ( "%s: could not start writing the data", __FUNCTION__ );
+      fclose ( bw.f );
+    }
+  }
+  else
+    close ( babel_stdin );
+
+  // Even without its input GPSBabel has been started, so see it through
+  gboolean ret = babel_read_diag ( cb, babel_stderr, pid, user_data );
+
+  if ( !thread )
+    return FALSE;
+  g_thread_join ( thread );
+  return ret;
+}
+
 static gboolean babel_general_convert_to( VikTrwLayer *vt, VikTrack *trk, BabelStatusFunc cb, gchar **args, const gchar *name_src, gpointer user_data )
 {
   // Now strips out invisible tracks and waypoints
@@ -507,22 +890,25 @@ gboolean a_babel_convert_to( VikTrwLayer *vt, VikTrack *track, const char *babel
   gchar *name_src = NULL;
   gboolean ret = FALSE;
   gchar *args[64];  
+  gboolean stream = babel_can_stream ( babelargs );
 
-  if ((fd_src = g_file_open_tmp("tmp-viking.XXXXXX", &name_src, NULL)) >= 0) {
-    g_debug ("%s: temporary file: %s", __FUNCTION__, name_src);
-    close(fd_src);
+  if ( stream || (fd_src = g_file_open_tmp("tmp-viking.XXXXXX", &name_src, NULL)) >= 0) {
+    if ( !stream ) {
+      g_debug ("%s: temporary file: %s", __FUNCTION__, name_src);
+      close(fd_src);
+    }
 
     if (gpsbabel_loc ) {
       gchar **sub_args = g_strsplit(babelargs, " ", 0);
 
       i = 0;
-      if (unbuffer_loc)
+      if (unbuffer_loc && !stream)
         args[i++] = unbuffer_loc;
       args[i++] = gpsbabel_loc;
       args[i++] = "-i";
       args[i++] = "gpx";
       args[i++] = "-f";
-      args[i++] = name_src;
+      args[i++] = stream ? "-" : name_src;
       for (j = 0; sub_args[j]; j++)
         /* some version of gpsbabel can not take extra blank arg */
         if (sub_args[j][0] != '\0')
@@ -531,13 +917,18 @@ gboolean a_babel_convert_to( VikTrwLayer *vt, VikTrack *track, const char *babel
       args[i++] = (char *)to;
       args[i] = NULL;
 
-      ret = babel_general_convert_to ( vt, track, cb, args, name_src, user_data );
+      if ( stream )
+        ret = babel_general_convert_to_stream ( vt, track, cb, args, user_data );
+      else
+        ret = babel_general_convert_to ( vt, track, cb, args, name_src, user_data );
 
       g_strfreev(sub_args);
     } else
       g_critical("gpsbabel not found in PATH");
-    (void)g_remove(name_src);
-    g_free(name_src);
+    if ( name_src ) {
+      (void)g_remove(name_src);
+      g_free(name_src);
+    }
   }
 
   return ret;
@@ -611,7 +1002,7 @@ static void load_feature_parse_line (gchar *line)
 
 static void load_feature_cb (BabelProgressCode code, gpointer line, gpointer user_data)
 {
-  if (line != NULL)
+  if (code == BABEL_DIAG_OUTPUT && line != NULL)
     load_feature_parse_line (line);
 }
 
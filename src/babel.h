@@ -25,6 +25,7 @@
 #define _VIKING_BABEL_H
 
 #include <glib.h>
+#include <stdio.h>
 
 #include "viktrwlayer.h"
 #include "download.h"
@@ -36,12 +37,18 @@ G_BEGIN_DECLS
  * @BABEL_DIAG_OUTPUT: a line of diagnostic output is available. The pointer is to a 
  *                     NULL-terminated line of diagnostic output from gpsbabel.
  * @BABEL_DONE: gpsbabel finished, or %NULL if no callback is needed.
+ * @BABEL_PROGRESS: more of the GPX output from gpsbabel has been read.
+ *                  The pointer is to a #gsize of how many bytes so far.
+ * @BABEL_QUERY_CANCEL: asks whether to stop gpsbabel early. The pointer is to a #gboolean,
+ *                      to be set to %TRUE if so. The callback must return normally rather than exit the thread.
  *
  * Used when calling #BabelStatusFunc.
  */
 typedef enum {
   BABEL_DIAG_OUTPUT,
   BABEL_DONE,
+  BABEL_PROGRESS,
+  BABEL_QUERY_CANCEL,
 } BabelProgressCode;
 
 /**
@@ -118,6 +125,8 @@ void a_babel_foreach_file_read_any (GFunc func, gpointer user_data);
 // NB needs to match typedef VikDataSourceProcessFunc in acquire.h
 gboolean a_babel_convert_from ( VikTrwLayer *vt, ProcessOptions *process_options, BabelStatusFunc cb, gpointer user_data, DownloadFileOptions *download_options );
 
+gboolean a_babel_convert_from_stream ( VikTrwLayer *vt, const char *babelargs, FILE *f, BabelStatusFunc cb, gpointer user_data );
+
 gboolean a_babel_convert_to( VikTrwLayer *vt, VikTrack *track, const char *babelargs, const char *file, BabelStatusFunc cb, gpointer user_data );
 
 void a_babel_init ();
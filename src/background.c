@@ -88,6 +88,20 @@ static gboolean idle_progress_update ( gpointer user_data )
   return FALSE;
 }
 
+// Called from other threads
+static void progress_update ( gpointer *args, gdouble fraction )
+{
+  if (args[5] != NULL) {
+    gdouble myfraction = fabs(fraction);
+    if ( myfraction > 1.0 )
+      myfraction = 1.0;
+    progress_t *progress = g_malloc0 ( sizeof(progress_t) );
+    progress->percent = myfraction * 100;
+    progress->iter = (GtkTreeIter*)args[5];
+    gdk_threads_add_idle ( idle_progress_update, progress );
+  }
+}
+
 /**
  * a_background_thread_progress:
  * @callbackdata: Thread data
@@ -101,15 +115,7 @@ int a_background_thread_progress ( gpointer callbackdata, gdouble fraction )
 {
   gpointer *args = (gpointer *) callbackdata;
   int res = a_background_testcancel ( callbackdata );
-  if (args[5] != NULL) {
-    gdouble myfraction = fabs(fraction);
-    if ( myfraction > 1.0 )
-      myfraction = 1.0;
-    progress_t *progress = g_malloc0 ( sizeof(progress_t) );
-    progress->percent = myfraction * 100;
-    progress->iter = (GtkTreeIter*)args[5];
-    gdk_threads_add_idle ( idle_progress_update, progress );
-  }
+  progress_update ( args, fraction );
 
   args[6] = GINT_TO_POINTER(GPOINTER_TO_INT(args[6])-1);
   bgitemcount--;
@@ -117,6 +123,22 @@ int a_background_thread_progress ( gpointer callbackdata, gdouble fraction )
   return res;
 }
 
+/**
+ * a_background_thread_fraction:
+ * @callbackdata: Thread data
+ * @fraction:     How much of the current item is complete, between 0.0 and 1.0
+ *
+ * Called from other threads, for progress within an item
+ *  (unlike a_background_thread_progress() no item is counted as done)
+ *
+ * Returns a non zero number if the thread should be terminated
+ */
+int a_background_thread_fraction ( gpointer callbackdata, gdouble fraction )
+{
+  progress_update ( (gpointer *) callbackdata, fraction );
+  return a_background_testcancel ( callbackdata );
+}
+
 static void thread_die ( gpointer args[VIK_BG_NUM_ARGS] )
 {
   vik_thr_free_func userdata_free_func = args[3];
@@ -337,6 +359,20 @@ void a_background_post_init()
   bgstore = gtk_list_store_new ( N_COLUMNS, G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_POINTER );
 }
 
+/**
+ * a_background_get_local_threads:
+ *
+ * Returns: The number of threads available in the local (CPU bound) pool.
+ *  Allows CPU bound jobs to size any sub tasks they may create.
+ */
+guint a_background_get_local_threads ()
+{
+  gint threads = 1;
+  if ( thread_pool_local )
+    threads = g_thread_pool_get_max_threads ( thread_pool_local );
+  return threads > 0 ? threads : util_get_number_of_cpus ();
+}
+
 /**
  * a_background_show_window:
  *
@@ -43,7 +43,9 @@ typedef enum {
 
 void a_background_thread ( Background_Pool_Type bp, GtkWindow *parent, const gchar *message, vik_thr_func func, gpointer userdata, vik_thr_free_func userdata_free_func, vik_thr_free_func userdata_cancel_cleanup_func, gint number_items );
 int a_background_thread_progress ( gpointer callbackdata, gdouble fraction );
+int a_background_thread_fraction ( gpointer callbackdata, gdouble fraction );
 int a_background_testcancel ( gpointer callbackdata );
+guint a_background_get_local_threads ();
 void a_background_show_window ();
 void a_background_init ();
 void a_background_post_init ();
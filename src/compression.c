@@ -41,9 +41,152 @@
 #include "compression.h"
 #include "util.h"
 #include <string.h>
+#include <errno.h>
 #include <gio/gio.h>
 #include <glib/gstdio.h>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifndef WINDOWS
+// Decompressed data is passed to the file readers through a pipe
+#define UNCOMPRESS_STREAM
+#endif
+
+/* Amount decompressed at once */
+#define UNCOMPRESS_BLOCK_SIZE (256*1024)
+
+/*
+ * Decompress up to @size bytes into @buf
+ * Returns the number of bytes, 0 at the end of the data or negative on an error
+ */
+typedef gssize (*uncompress_read_func) ( gpointer source, gchar *buf, gsize size );
+
+#ifdef UNCOMPRESS_STREAM
+typedef struct {
+	uncompress_read_func read_func;
+	gpointer source;
+	int fd;
+} uncompress_stream_t;
+
+// In its own thread, so decompression overlaps with the parsing of what has already been decompressed
+static gpointer uncompress_stream_thread ( uncompress_stream_t *us )
+{
+	gchar *buf = g_malloc ( UNCOMPRESS_BLOCK_SIZE );
+	gssize len;
+	gboolean ok = TRUE;
+	while ( ok && (len = us->read_func ( us->source, buf, UNCOMPRESS_BLOCK_SIZE )) > 0 ) {
+		gchar *pos = buf;
+		while ( len > 0 ) {
+			gssize written = write ( us->fd, pos, len );
+			if ( written < 0 && errno == EINTR )
+				continue;
+			if ( written <= 0 ) {
+				ok = FALSE;
+				break;
+			}
+			pos += written;
+			len -= written;
+		}
+	}
+	if ( len < 0 )
+		ok = FALSE;
+	close ( us->fd );
+	g_free ( buf );
+	return GINT_TO_POINTER(ok);
+}
+
+/*
+ * Load the data as it is decompressed, without writing it out to a file first
+ * @filename: Of the data once decompressed, for detecting its type
+ */
+static VikLoadType_t uncompress_load_stream ( uncompress_read_func read_func,
+                                              gpointer source,
+                                              const gchar *filename,
+                                              VikAggregateLayer *top,
+                                              VikViewport *vp,
+                                              VikTrwLayer *vtl,
+                                              gboolean new_layer,
+                                              gboolean external,
+                                              const gchar *dirpath,
+                                              const gchar *name )
+{
+	int fds[2];
+	if ( pipe ( fds ) != 0 ) {
+		g_warning ( "%s: Unable to create pipe: %s", __FUNCTION__, g_strerror(errno) );
+		return LOAD_TYPE_READ_FAILURE;
+	}
+
+	uncompress_stream_t us = { read_func, source, fds[1] };
+	GThread *thread;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+	thread = g_thread_try_new ( "uncompress_stream_thread", (GThreadFunc)uncompress_stream_thread, &us, NULL );
+#else
+	thread = g_thread_create ( (GThreadFunc)uncompress_stream_thread, &us, TRUE, NULL );
+#endif
+	if ( !thread ) {
+		close ( fds[0] );
+		close ( fds[1] );
+		return LOAD_TYPE_READ_FAILURE;
+	}
+
+	VikLoadType_t ans = LOAD_TYPE_READ_FAILURE;
+	// Should the reading stop early, let the decompression run to the end rather than block
+	gchar drain[4096];
+	FILE *ff = fdopen ( fds[0], "r" );
+	if ( ff ) {
+		ans = a_file_load_stream ( ff, filename, top, vp, vtl, new_layer, external, dirpath, name );
+		while ( fread ( drain, 1, sizeof(drain), ff ) > 0 );
+		fclose ( ff );
+	}
+	else {
+		while ( read ( fds[0], drain, sizeof(drain) ) > 0 );
+		close ( fds[0] );
+	}
+
+	if ( !GPOINTER_TO_INT(g_thread_join ( thread )) )
+		g_warning ( "%s: Decompression of %s failed", __FUNCTION__, filename );
+	return ans;
+}
+#else
+/*
+ * Without pipes, fallback to extracting the contents to a temporary file and then reread back in
+ * Not so efficient but should be reliable enough
+ */
+static VikLoadType_t uncompress_load_stream ( uncompress_read_func read_func,
+                                              gpointer source,
+                                              const gchar *filename,
+                                              VikAggregateLayer *top,
+                                              VikViewport *vp,
+                                              VikTrwLayer *vtl,
+                                              gboolean new_layer,
+                                              gboolean external,
+                                              const gchar *dirpath,
+                                              const gchar *name )
+{
+	VikLoadType_t ans = LOAD_TYPE_READ_FAILURE;
+	GString *contents = g_string_new ( NULL );
+	gchar *buf = g_malloc ( UNCOMPRESS_BLOCK_SIZE );
+	gssize len;
+	while ( (len = read_func ( source, buf, UNCOMPRESS_BLOCK_SIZE )) > 0 )
+		g_string_append_len ( contents, buf, len );
+	if ( len == 0 ) {
+		gchar *tmp_name = util_write_tmp_file_from_bytes ( contents->str, contents->len );
+		if ( tmp_name ) {
+			ans = a_file_load ( top, vp, vtl, tmp_name, new_layer, external, name );
+			(void)util_remove ( tmp_name );
+			g_free ( tmp_name );
+		}
+	}
+	else
+		g_warning ( "%s: Decompression of %s failed", __FUNCTION__, filename );
+	g_free ( buf );
+	g_string_free ( contents, TRUE );
+	return ans;
+}
+#endif
+
 #ifdef HAVE_ZIP_H
 /**
  * figure_out_answer:
@@ -76,18 +219,30 @@ VikLoadType_t figure_out_answer ( VikLoadType_t current_ans, VikLoadType_t last_
 }
 #endif
 
+#ifdef HAVE_ZIP_H
+static gssize zip_stream_read ( gpointer source, gchar *buf, gsize size )
+{
+	return zip_fread ( (struct zip_file*)source, buf, size );
+}
+#endif
+
 /**
+ * uncompress_load_zip_stream:
+ * @f:        The zip archive, which must be a file as it is not read in order
+ * @filename: Of the archive, for messages
+ *
  * NB is typically called from file.c and circularly calls back into file.c
  * ATM this works OK!
  *
  */
-VikLoadType_t uncompress_load_zip_file ( const gchar *filename,
-                                         VikAggregateLayer *top,
-                                         VikViewport *vp,
-                                         VikTrwLayer *vtl,
-                                         gboolean new_layer,
-                                         gboolean external,
-                                         const gchar *dirpath )
+VikLoadType_t uncompress_load_zip_stream ( FILE *f,
+                                           const gchar *filename,
+                                           VikAggregateLayer *top,
+                                           VikViewport *vp,
+                                           VikTrwLayer *vtl,
+                                           gboolean new_layer,
+                                           gboolean external,
+                                           const gchar *dirpath )
 {
 	VikLoadType_t ans = LOAD_TYPE_READ_FAILURE;
 #ifdef HAVE_ZIP_H
@@ -95,14 +250,18 @@ VikLoadType_t uncompress_load_zip_file ( const gchar *filename,
 #ifndef zip_t
 typedef struct zip zip_t;
 typedef struct zip_file zip_file_t;
-#endif
-#ifndef ZIP_RDONLY
-#define ZIP_RDONLY 0
 #endif
 
+	// Opened through the descriptor of the stream, since it may not be the file of that name
 	int zans = ZIP_ER_OK;
-	zip_t *archive = zip_open ( filename, ZIP_RDONLY, &zans );
+	zip_t *archive = NULL;
+	int fd = dup ( fileno ( f ) );
+	if ( fd >= 0 && lseek ( fd, 0, SEEK_CUR ) >= 0 )
+		archive = zip_fdopen ( fd, 0, &zans );
 	if ( !archive ) {
+		// e.g. a zip within another compressed file can't be seeked through
+		if ( fd >= 0 )
+			close ( fd );
 		g_warning ( "%s: Unable to open archive: '%s' Error code %d", __FUNCTION__, filename, zans );
 		goto cleanup;
 	}
@@ -117,32 +276,9 @@ typedef struct zip_file zip_file_t;
 		if ( zip_stat_index( archive, ii, 0, &zs ) == 0) {
 			zip_file_t *zf = zip_fopen_index ( archive, ii, 0 );
 			if ( zf ) {
-				char *buffer = g_malloc(zs.size);
-				int len = zip_fread ( zf, buffer, zs.size );
-				if ( len == zs.size ) {
-					VikLoadType_t current_ans = LOAD_TYPE_READ_FAILURE;
-#ifdef HAVE_FMEMOPEN
-					FILE *ff = fmemopen ( buffer, zs.size, "r" );
-					if ( ff ) {
-						current_ans = a_file_load_stream ( ff, zs.name, top, vp, vtl, new_layer, external, dirpath, zs.name );
-						(void)fclose ( ff );
-					}
-					else {
-						g_warning ( "%s: Unable to load stream: %d in '%s'", __FUNCTION__, ii, filename );
-					}
-#else
-					// For example, Windows doesn't have fmemopen()
-					// Fallback to extracting contents to temporary files and then reread back in
-					// Not so efficient but should be reliable enough
-					gchar *tmp_name = util_write_tmp_file_from_bytes ( buffer, zs.size );
-					current_ans = a_file_load ( top, vp, vtl, tmp_name, new_layer, external, zs.name );
-					(void)util_remove ( tmp_name );
-#endif
-					ans = figure_out_answer ( current_ans, ans, ii, entries );
-				}
-				else {
-					g_warning ( "%s: Unable to read index: %d in '%s', got %d, wanted %ld", __FUNCTION__, ii, filename, len, zs.size );
-				}
+				VikLoadType_t current_ans = uncompress_load_stream ( zip_stream_read, zf, zs.name, top, vp, vtl, new_layer, external, dirpath, zs.name );
+				ans = figure_out_answer ( current_ans, ans, ii, entries );
+				zip_fclose ( zf );
 			}
 			else {
 				g_warning ( "%s: Unable to open index: %d in '%s'", __FUNCTION__, ii, filename );
@@ -350,15 +486,160 @@ gchar* uncompress_bzip2 ( const gchar *name )
 #endif
 }
 
-VikLoadType_t uncompress_load_bzip_file ( const gchar *filename,
-                                          VikAggregateLayer *top,
-                                          VikViewport *vp,
-                                          VikTrwLayer *vtl,
-                                          gboolean new_layer,
-                                          gboolean external )
+/*
+ * The name of the file once decompressed, i.e. without the compression extension
+ */
+static gchar *uncompressed_name ( const gchar *filename, const gchar *ext )
+{
+	if ( a_file_check_ext ( filename, ext ) )
+		return g_strndup ( filename, strlen(filename) - strlen(ext) );
+	return g_strdup ( filename );
+}
+
+#ifdef HAVE_BZLIB_H
+typedef struct {
+	BZFILE *bf;
+	gboolean end;
+} bzip2_stream_t;
+
+static gssize bzip2_stream_read ( gpointer source, gchar *buf, gsize size )
+{
+	bzip2_stream_t *bs = source;
+	// No more reading is allowed once the end has been reached
+	if ( bs->end )
+		return 0;
+	int bzerror;
+	int len = BZ2_bzRead ( &bzerror, bs->bf, buf, size );
+	if ( bzerror == BZ_STREAM_END )
+		bs->end = TRUE;
+	else if ( bzerror != BZ_OK )
+		return -1;
+	return len;
+}
+#endif
+
+/**
+ * uncompress_load_bzip_stream:
+ * @f:        The bzip2 compressed data
+ * @filename: Of the compressed data, from which the name of its contents is derived
+ *
+ * Load the file held in bzip2 compressed data
+ */
+VikLoadType_t uncompress_load_bzip_stream ( FILE *f,
+                                            const gchar *filename,
+                                            VikAggregateLayer *top,
+                                            VikViewport *vp,
+                                            VikTrwLayer *vtl,
+                                            gboolean new_layer,
+                                            gboolean external,
+                                            const gchar *dirpath )
+{
+	VikLoadType_t ans = LOAD_TYPE_READ_FAILURE;
+#ifdef HAVE_BZLIB_H
+	int bzerror;
+	BZFILE* bf = BZ2_bzReadOpen ( &bzerror, f, 0, 0, NULL, 0 );
+	if ( bzerror != BZ_OK ) {
+		BZ2_bzReadClose ( &bzerror, bf );
+		g_warning ( "%s: BZ ReadOpen error on %s", __FUNCTION__, filename );
+		return ans;
+	}
+
+	bzip2_stream_t bs = { bf, FALSE };
+	gchar *name = uncompressed_name ( filename, ".bz2" );
+	ans = uncompress_load_stream ( bzip2_stream_read, &bs, name, top, vp, vtl, new_layer, external, dirpath, filename );
+	g_free ( name );
+
+	BZ2_bzReadClose ( &bzerror, bf );
+#endif
+	return ans;
+}
+
+#ifdef HAVE_LIBZ
+/* Amount of compressed data read at once */
+#define GZIP_INPUT_SIZE 4096
+
+typedef struct {
+	FILE *f;
+	z_stream zs;
+	guint members;
+	gboolean member_end;
+	gboolean end;
+	Bytef in[GZIP_INPUT_SIZE];
+} gzip_stream_t;
+
+/*
+ * Read through stdio rather than gzdopen() on the descriptor,
+ *  since the start of the data has already been buffered by the stream
+ */
+static gssize gzip_stream_read ( gpointer source, gchar *buf, gsize size )
 {
-	gchar *tmp_name = uncompress_bzip2 ( filename );
-	VikLoadType_t ans = a_file_load ( top, vp, vtl, tmp_name, new_layer, external, filename );
-	(void)util_remove ( tmp_name );
+	gzip_stream_t *gs = source;
+	gs->zs.next_out = (Bytef*)buf;
+	gs->zs.avail_out = size;
+	while ( !gs->end && gs->zs.avail_out > 0 ) {
+		if ( gs->zs.avail_in == 0 ) {
+			gs->zs.next_in = gs->in;
+			gs->zs.avail_in = fread ( gs->in, 1, sizeof(gs->in), gs->f );
+			if ( gs->zs.avail_in == 0 ) {
+				// Truncated data is an error
+				if ( !gs->member_end )
+					return -1;
+				gs->end = TRUE;
+				break;
+			}
+		}
+		// As gzread(), further gzip members are read on as the same data
+		if ( gs->member_end ) {
+			if ( inflateReset ( &gs->zs ) != Z_OK )
+				return -1;
+			gs->member_end = FALSE;
+		}
+		int err = inflate ( &gs->zs, Z_NO_FLUSH );
+		if ( err == Z_STREAM_END ) {
+			gs->member_end = TRUE;
+			gs->members++;
+		}
+		else if ( err == Z_DATA_ERROR && gs->members > 0 && gs->zs.total_out == 0 )
+			// Also as gzread(), anything other than gzip data after the first member is ignored
+			gs->end = TRUE;
+		else if ( err != Z_OK )
+			return -1;
+	}
+	return size - gs->zs.avail_out;
+}
+#endif
+
+/**
+ * uncompress_load_gzip_stream:
+ * @f:        The gzip compressed data
+ * @filename: Of the compressed data, from which the name of its contents is derived
+ *
+ * Load the file held in gzip compressed data
+ */
+VikLoadType_t uncompress_load_gzip_stream ( FILE *f,
+                                            const gchar *filename,
+                                            VikAggregateLayer *top,
+                                            VikViewport *vp,
+                                            VikTrwLayer *vtl,
+                                            gboolean new_layer,
+                                            gboolean external,
+                                            const gchar *dirpath )
+{
+	VikLoadType_t ans = LOAD_TYPE_READ_FAILURE;
+#ifdef HAVE_LIBZ
+	gzip_stream_t *gs = g_malloc0 ( sizeof(gzip_stream_t) );
+	gs->f = f;
+	// Only gzip headers are accepted
+	if ( inflateInit2 ( &gs->zs, MAX_WBITS + 16 ) != Z_OK ) {
+		g_warning ( "%s: Unable to decompress %s", __FUNCTION__, filename );
+		g_free ( gs );
+		return ans;
+	}
+	gchar *name = uncompressed_name ( filename, ".gz" );
+	ans = uncompress_load_stream ( gzip_stream_read, gs, name, top, vp, vtl, new_layer, external, dirpath, filename );
+	g_free ( name );
+	inflateEnd ( &gs->zs );
+	g_free ( gs );
+#endif
 	return ans;
 }
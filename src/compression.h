@@ -35,20 +35,32 @@ void *unzip_file(gchar *zip_file, gulong *unzip_size);
 
 gchar* uncompress_bzip2 ( const gchar *name );
 
-VikLoadType_t uncompress_load_zip_file ( const gchar *filename,
-                                         VikAggregateLayer *top,
-                                         VikViewport *vp,
-                                         VikTrwLayer *vtl,
-                                         gboolean new_layer,
-                                         gboolean external,
-                                         const gchar *dirpath );
-
-VikLoadType_t uncompress_load_bzip_file ( const gchar *filename,
-                                          VikAggregateLayer *top,
-                                          VikViewport *vp,
-                                          VikTrwLayer *vtl,
-                                          gboolean new_layer,
-                                          gboolean external );
+VikLoadType_t uncompress_load_zip_stream ( FILE *f,
+                                           const gchar *filename,
+                                           VikAggregateLayer *top,
+                                           VikViewport *vp,
+                                           VikTrwLayer *vtl,
+                                           gboolean new_layer,
+                                           gboolean external,
+                                           const gchar *dirpath );
+
+VikLoadType_t uncompress_load_bzip_stream ( FILE *f,
+                                            const gchar *filename,
+                                            VikAggregateLayer *top,
+                                            VikViewport *vp,
+                                            VikTrwLayer *vtl,
+                                            gboolean new_layer,
+                                            gboolean external,
+                                            const gchar *dirpath );
+
+VikLoadType_t uncompress_load_gzip_stream ( FILE *f,
+                                            const gchar *filename,
+                                            VikAggregateLayer *top,
+                                            VikViewport *vp,
+                                            VikTrwLayer *vtl,
+                                            gboolean new_layer,
+                                            gboolean external,
+                                            const gchar *dirpath );
 G_END_DECLS
 
 #endif
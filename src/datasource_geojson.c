@@ -49,7 +49,7 @@ VikDataSourceInterface vik_datasource_geojson_interface = {
 	VIK_DATASOURCE_INPUTTYPE_NONE,
 	TRUE,
 	FALSE, // We should be able to see the data on the screen so no point in keeping the dialog open
-	FALSE, // Not thread method - open each file in the main loop
+	TRUE,  // Read in a thread, as files can be large
 	(VikDataSourceInitFunc)               datasource_geojson_init,
 	(VikDataSourceCheckExistenceFunc)     NULL,
 	(VikDataSourceAddSetupWidgetsFunc)    datasource_geojson_add_setup_widgets,
@@ -129,7 +129,7 @@ static void datasource_geojson_get_process_options ( datasource_geojson_user_dat
 }
 
 /**
- * Process selected files and try to generate waypoints storing them in the given vtl
+ * Process selected files and read the features from them into the given vtl
  */
 static gboolean datasource_geojson_process ( VikTrwLayer *vtl, ProcessOptions *process_options, BabelStatusFunc status_cb, acq_dialog_widgets_t *adw, DownloadFileOptions *options_unused )
 {
@@ -140,15 +140,13 @@ static gboolean datasource_geojson_process ( VikTrwLayer *vtl, ProcessOptions *p
 	while ( cur_file ) {
 		gchar *filename = cur_file->data;
 
-		gchar *gpx_filename = a_geojson_import_to_gpx ( filename );
-		if ( gpx_filename ) {
-			// Important that this process is run in the main thread
-			vik_window_open_file ( adw->vw, gpx_filename, FALSE, TRUE, TRUE, TRUE, FALSE );
-			// Delete the temporary file
-			(void)g_remove (gpx_filename);
-			g_free (gpx_filename);
+		gboolean ok = FALSE;
+		FILE *f = g_fopen ( filename, "r" );
+		if ( f ) {
+			ok = a_geojson_read_file ( vtl, f );
+			fclose ( f );
 		}
-		else {
+		if ( !ok ) {
 			gchar* msg = g_strdup_printf ( _("Unable to import from: %s"), filename );
 			vik_window_statusbar_update ( adw->vw, msg, VIK_STATUSBAR_INFO );
 			g_free (msg);
@@ -56,6 +56,12 @@
 
 #define DEM_BLOCK_SIZE 1024
 #define GET_COLUMN(dem,n) ((VikDEMColumn *)g_ptr_array_index( (dem)->columns, (n) ))
+#define GET_OVERVIEW(dem,n) ((VikDEMOverview *)g_ptr_array_index( (dem)->overviews, (n) ))
+
+/* Stop making overviews once they get this small */
+#define DEM_OVERVIEW_MIN_SIZE 4
+
+static void dem_build_overviews ( VikDEM *dem );
 
 static gboolean get_double_and_continue ( gchar **buffer, gdouble *tmp, gboolean warn )
 {
@@ -284,6 +290,7 @@ static VikDEM *vik_dem_read_srtm_hgt(const gchar *file_name, const gchar *basena
 
   dem->columns = g_ptr_array_new();
   dem->n_columns = 0;
+  dem->overviews = NULL;
 
   if ((mf = g_mapped_file_new(file_name, FALSE, &error)) == NULL) {
     g_critical(_("Couldn't map file %s: %s"), file_name, error->message);
@@ -371,6 +378,8 @@ VikDEM *vik_dem_new_from_file(const gchar *file)
        (basename[0] == 'N' || basename[0] == 'S') && (basename[3] == 'E' || basename[3] =='W')) {
     gboolean is_zip_file = (strlen(basename) == 15);
     rv = vik_dem_read_srtm_hgt(file, basename, is_zip_file);
+    if ( rv )
+      dem_build_overviews ( rv );
     return(rv);
   }
 
@@ -393,6 +402,7 @@ VikDEM *vik_dem_new_from_file(const gchar *file)
 
   rv->columns = g_ptr_array_new();
   rv->n_columns = 0;
+  rv->overviews = NULL;
 
       /* Column -- Data */
   while (! feof(f) ) {
@@ -427,13 +437,87 @@ VikDEM *vik_dem_new_from_file(const gchar *file)
     rv->min_north += 200;
   }
 
+  dem_build_overviews ( rv );
 
   return rv;
 }
 
+static void dem_overview_free ( VikDEMOverview *ov )
+{
+  g_free ( ov->min );
+  g_free ( ov->max );
+  g_free ( ov );
+}
+
+/* Combine two values of a level, ignoring any invalid ones */
+static inline gint16 dem_overview_min ( gint16 a, gint16 b )
+{
+  if ( a == VIK_DEM_INVALID_ELEVATION ) return b;
+  if ( b == VIK_DEM_INVALID_ELEVATION ) return a;
+  return MIN(a, b);
+}
+
+static inline gint16 dem_overview_max ( gint16 a, gint16 b )
+{
+  if ( a == VIK_DEM_INVALID_ELEVATION ) return b;
+  if ( b == VIK_DEM_INVALID_ELEVATION ) return a;
+  return MAX(a, b);
+}
+
+/**
+ * dem_build_overviews:
+ *
+ * Create a pyramid of min/max values, each level halving the resolution of the one below,
+ *  so drawing when zoomed out only has to look at a small number of samples.
+ * Done once whilst loading, thus (usually) in a background thread.
+ */
+static void dem_build_overviews ( VikDEM *dem )
+{
+  guint level = 0;
+  guint n_columns = dem->n_columns;
+  guint n_rows = 0;
+  guint col, row;
+
+  for ( col = 0; col < dem->n_columns; col++ )
+    n_rows = MAX(n_rows, GET_COLUMN(dem, col)->n_points);
+
+  dem->overviews = g_ptr_array_new_with_free_func ( (GDestroyNotify)dem_overview_free );
+
+  while ( n_columns / 2 >= DEM_OVERVIEW_MIN_SIZE && n_rows / 2 >= DEM_OVERVIEW_MIN_SIZE ) {
+    VikDEMOverview *ov = g_malloc ( sizeof(VikDEMOverview) );
+    ov->factor = 2 << level;
+    ov->n_columns = (n_columns + 1) / 2;
+    ov->n_rows = (n_rows + 1) / 2;
+    ov->min = g_malloc ( sizeof(gint16) * ov->n_columns * ov->n_rows );
+    ov->max = g_malloc ( sizeof(gint16) * ov->n_columns * ov->n_rows );
+
+    for ( col = 0; col < ov->n_columns; col++ ) {
+      for ( row = 0; row < ov->n_rows; row++ ) {
+        gint16 lo = VIK_DEM_INVALID_ELEVATION;
+        gint16 hi = VIK_DEM_INVALID_ELEVATION;
+        guint cc, rr;
+        for ( cc = col*2; cc < col*2+2; cc++ )
+          for ( rr = row*2; rr < row*2+2; rr++ ) {
+            lo = dem_overview_min ( lo, vik_dem_get_level_xy ( dem, level, cc, rr, FALSE ) );
+            hi = dem_overview_max ( hi, vik_dem_get_level_xy ( dem, level, cc, rr, TRUE ) );
+          }
+        ov->min[col * ov->n_rows + row] = lo;
+        ov->max[col * ov->n_rows + row] = hi;
+      }
+    }
+
+    g_ptr_array_add ( dem->overviews, ov );
+    n_columns = ov->n_columns;
+    n_rows = ov->n_rows;
+    level++;
+  }
+}
+
 void vik_dem_free ( VikDEM *dem )
 {
   guint i;
+  if ( dem->overviews )
+    g_ptr_array_free ( dem->overviews, TRUE );
   for ( i = 0; i < dem->n_columns; i++)
     g_free ( GET_COLUMN(dem, i)->points );
   g_ptr_array_foreach ( dem->columns, (GFunc)g_free, NULL );
@@ -449,6 +533,46 @@ gint16 vik_dem_get_xy ( VikDEM *dem, guint col, guint row )
   return VIK_DEM_INVALID_ELEVATION;
 }
 
+/**
+ * vik_dem_get_n_levels:
+ *
+ * Returns: The number of resolution levels available, including the original data (level 0)
+ */
+guint vik_dem_get_n_levels ( VikDEM *dem )
+{
+  return 1 + (dem->overviews ? dem->overviews->len : 0);
+}
+
+/**
+ * vik_dem_get_level_factor:
+ *
+ * Returns: How many original samples (in each direction) a sample of the level covers
+ */
+guint vik_dem_get_level_factor ( VikDEM *dem, guint level )
+{
+  if ( level == 0 || level >= vik_dem_get_n_levels(dem) )
+    return 1;
+  return GET_OVERVIEW(dem, level-1)->factor;
+}
+
+/**
+ * vik_dem_get_level_xy:
+ * @maximum: Whether to get the highest or the lowest value of the samples covered
+ *
+ * Level 0 is the original data, for which min and max are the same.
+ */
+gint16 vik_dem_get_level_xy ( VikDEM *dem, guint level, guint col, guint row, gboolean maximum )
+{
+  if ( level == 0 )
+    return vik_dem_get_xy ( dem, col, row );
+  if ( level >= vik_dem_get_n_levels(dem) )
+    return VIK_DEM_INVALID_ELEVATION;
+  VikDEMOverview *ov = GET_OVERVIEW(dem, level-1);
+  if ( col < ov->n_columns && row < ov->n_rows )
+    return maximum ? ov->max[col * ov->n_rows + row] : ov->min[col * ov->n_rows + row];
+  return VIK_DEM_INVALID_ELEVATION;
+}
+
 gint16 vik_dem_get_east_north ( VikDEM *dem, gdouble east, gdouble north )
 {
   gint col, row;
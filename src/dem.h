@@ -41,6 +41,7 @@ G_BEGIN_DECLS
 typedef struct {
   guint n_columns;
   GPtrArray *columns;
+  GPtrArray *overviews; /* VikDEMOverview - coarser levels of the data, may be NULL */
 
   guint8 horiz_units;
   guint8 orig_vert_units; /* original, always converted to meters when loading. */
@@ -65,6 +66,18 @@ typedef struct {
   gint16 *points;
 } VikDEMColumn;
 
+/* A reduced resolution copy of the DEM,
+ *  where each sample covers 'factor' x 'factor' samples of the original.
+ * Values are stored column by column, as per the original.
+ */
+typedef struct {
+  guint factor;
+  guint n_columns;
+  guint n_rows;
+  gint16 *min;
+  gint16 *max;
+} VikDEMOverview;
+
 
 VikDEM *vik_dem_new_from_file(const gchar *file);
 void vik_dem_free ( VikDEM *dem );
@@ -75,6 +88,10 @@ gint16 vik_dem_get_simple_interpol ( VikDEM *dem, gdouble east, gdouble north );
 gint16 vik_dem_get_shepard_interpol ( VikDEM *dem, gdouble east, gdouble north );
 gint16 vik_dem_get_best_interpol ( VikDEM *dem, gdouble east, gdouble north );
 
+guint vik_dem_get_n_levels ( VikDEM *dem );
+guint vik_dem_get_level_factor ( VikDEM *dem, guint level );
+gint16 vik_dem_get_level_xy ( VikDEM *dem, guint level, guint col, guint row, gboolean maximum );
+
 void vik_dem_east_north_to_xy ( VikDEM *dem, gdouble east, gdouble north, guint *col, guint *row );
 
 LatLonBBox vik_dem_get_bbox ( const VikDEM *dem );
@@ -32,6 +32,10 @@ typedef struct {
 GHashTable *loaded_dems = NULL;
 /* filename -> DEM */
 
+/* DEMs may be loaded by several threads at once,
+ * so all access to the hash table is serialized */
+G_LOCK_DEFINE_STATIC(loaded_dems);
+
 static void loaded_dem_free ( LoadedDEM *ldem )
 {
   vik_dem_free ( ldem->dem );
@@ -40,47 +44,79 @@ static void loaded_dem_free ( LoadedDEM *ldem )
 
 void a_dems_uninit ()
 {
+  G_LOCK(loaded_dems);
   if ( loaded_dems )
     g_hash_table_destroy ( loaded_dems );
+  loaded_dems = NULL;
+  G_UNLOCK(loaded_dems);
 }
 
-/* To load a dem. if it was already loaded, will simply
- * reference the one already loaded and return it.
- */
-VikDEM *a_dems_load(const gchar *filename)
+/* NB Must be called with the loaded_dems lock held */
+static VikDEM *dems_ref_loaded ( const gchar *filename )
 {
-  LoadedDEM *ldem;
-
   /* dems init hash table */
   if ( ! loaded_dems )
     loaded_dems = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, (GDestroyNotify) loaded_dem_free );
 
-  ldem = (LoadedDEM *) g_hash_table_lookup ( loaded_dems, filename );
+  LoadedDEM *ldem = (LoadedDEM *) g_hash_table_lookup ( loaded_dems, filename );
   if ( ldem ) {
     ldem->ref_count++;
     return ldem->dem;
-  } else {
-    VikDEM *dem = vik_dem_new_from_file ( filename );
-    if ( ! dem )
-      return NULL;
-    ldem = g_malloc ( sizeof(LoadedDEM) );
-    ldem->ref_count = 1;
-    ldem->dem = dem;
-    g_hash_table_insert ( loaded_dems, g_strdup(filename), ldem );
-    return dem;
   }
+  return NULL;
+}
+
+/* Merge a freshly read DEM into the registry.
+ * If another thread got there first, the copy already registered is used instead.
+ * NB Must be called with the loaded_dems lock held
+ */
+static VikDEM *dems_insert_loaded ( const gchar *filename, VikDEM *dem )
+{
+  VikDEM *existing = dems_ref_loaded ( filename );
+  if ( existing ) {
+    vik_dem_free ( dem );
+    return existing;
+  }
+  LoadedDEM *ldem = g_malloc ( sizeof(LoadedDEM) );
+  ldem->ref_count = 1;
+  ldem->dem = dem;
+  g_hash_table_insert ( loaded_dems, g_strdup(filename), ldem );
+  return dem;
+}
+
+/* To load a dem. if it was already loaded, will simply
+ * reference the one already loaded and return it.
+ */
+VikDEM *a_dems_load(const gchar *filename)
+{
+  G_LOCK(loaded_dems);
+  VikDEM *dem = dems_ref_loaded ( filename );
+  G_UNLOCK(loaded_dems);
+  if ( dem )
+    return dem;
+
+  /* Reading the file can take a while, so don't hold the lock whilst doing so */
+  dem = vik_dem_new_from_file ( filename );
+  if ( ! dem )
+    return NULL;
+
+  G_LOCK(loaded_dems);
+  dem = dems_insert_loaded ( filename, dem );
+  G_UNLOCK(loaded_dems);
+  return dem;
 }
 
 void a_dems_unref(const gchar *filename)
 {
-  LoadedDEM *ldem = (LoadedDEM *) g_hash_table_lookup ( loaded_dems, filename );
-  if ( !ldem ) {
-    /* This is fine - probably means the loaded list was aborted / not completed for some reason */
-    return;
+  G_LOCK(loaded_dems);
+  LoadedDEM *ldem = loaded_dems ? (LoadedDEM *) g_hash_table_lookup ( loaded_dems, filename ) : NULL;
+  if ( ldem ) {
+    ldem->ref_count--;
+    if ( ldem->ref_count == 0 )
+      g_hash_table_remove ( loaded_dems, filename );
   }
-  ldem->ref_count--;
-  if ( ldem->ref_count == 0 )
-    g_hash_table_remove ( loaded_dems, filename );
+  /* else this is fine - probably means the loaded list was aborted / not completed for some reason */
+  G_UNLOCK(loaded_dems);
 }
 
 /* to get a DEM that was already loaded.
@@ -89,17 +125,43 @@ void a_dems_unref(const gchar *filename)
  */
 VikDEM *a_dems_get(const gchar *filename)
 {
-  LoadedDEM *ldem = g_hash_table_lookup ( loaded_dems, filename );
-  if ( ldem )
-    return ldem->dem;
-  return NULL;
+  VikDEM *dem = NULL;
+  G_LOCK(loaded_dems);
+  if ( loaded_dems ) {
+    LoadedDEM *ldem = g_hash_table_lookup ( loaded_dems, filename );
+    if ( ldem )
+      dem = ldem->dem;
+  }
+  G_UNLOCK(loaded_dems);
+  return dem;
 }
 
+/* A single file of a list being read by a worker thread */
+typedef struct {
+  GList *link;       /* Position in the callers list */
+  VikDEM *dem;       /* Result - NULL if failed or skipped */
+  gboolean loaded;   /* Whether the result is already referenced in the loaded DEMs */
+  GAsyncQueue *done; /* Where to report back to */
+  gint *cancel;
+} DEMLoadJob;
+
+static void dems_load_worker ( DEMLoadJob *job, gpointer user_data )
+{
+  // Skip reading anything more once cancelled, but still report back
+  if ( ! g_atomic_int_get ( job->cancel ) )
+    job->dem = vik_dem_new_from_file ( (const gchar *) job->link->data );
+  g_async_queue_push ( job->done, job );
+}
 
 /* Load a string list (GList of strings) of dems. You have to use get to at them later.
  * When updating a list as a parameter, this should be bfore freeing the list so
  * the same DEMs won't be loaded & unloaded.
  * Modifies the list to remove DEMs which did not load.
+ *
+ * Files not already loaded are read (and unzipped) concurrently,
+ *  using as many threads as the local background pool.
+ * The results are merged into the loaded DEMs from the calling thread,
+ *  in whatever order they complete.
  */
 
 /* TODO: don't delete them when they don't exist.
@@ -109,28 +171,67 @@ VikDEM *a_dems_get(const gchar *filename)
  */
 int a_dems_load_list ( GList **dems, gpointer threaddata )
 {
-  GList *iter = *dems;
+  int result = 0;
   guint dem_count = 0;
   const guint dem_total = g_list_length ( *dems );
+  if ( dem_total == 0 )
+    return 0;
+
+  gint cancel = 0;
+  DEMLoadJob *jobs = g_new0 ( DEMLoadJob, dem_total );
+  GAsyncQueue *done = g_async_queue_new ();
+  GThreadPool *pool = g_thread_pool_new ( (GFunc) dems_load_worker, NULL,
+                                          MIN(a_background_get_local_threads(), dem_total),
+                                          FALSE, NULL );
+  guint queued = 0;
+  GList *iter = *dems;
   while ( iter ) {
-    if ( ! a_dems_load((const gchar *) (iter->data)) ) {
-      GList *iter_temp = iter->next;
-      g_free ( iter->data );
-      (*dems) = g_list_remove_link ( (*dems), iter );
-      iter = iter_temp;
-    } else {
-      iter = iter->next;
+    jobs[queued].link = iter;
+    jobs[queued].done = done;
+    jobs[queued].cancel = &cancel;
+    // Already loaded ones just need a reference - no need to bother a worker
+    G_LOCK(loaded_dems);
+    jobs[queued].dem = dems_ref_loaded ( (const gchar *) iter->data );
+    G_UNLOCK(loaded_dems);
+    jobs[queued].loaded = ( jobs[queued].dem != NULL );
+    if ( jobs[queued].loaded )
+      g_async_queue_push ( done, &jobs[queued] );
+    else
+      g_thread_pool_push ( pool, &jobs[queued], NULL );
+    queued++;
+    iter = iter->next;
+  }
+
+  while ( dem_count < queued ) {
+    DEMLoadJob *job = g_async_queue_pop ( done );
+    dem_count++;
+
+    if ( job->dem ) {
+      // Newly read ones still need registering
+      if ( ! job->loaded ) {
+        G_LOCK(loaded_dems);
+        job->dem = dems_insert_loaded ( (const gchar *) job->link->data, job->dem );
+        G_UNLOCK(loaded_dems);
+      }
+    } else if ( ! cancel ) {
+      g_free ( job->link->data );
+      (*dems) = g_list_delete_link ( (*dems), job->link );
     }
+
     /* When running a thread - inform of progress */
-    if ( threaddata ) {
-      dem_count++;
+    if ( threaddata && ! cancel ) {
       /* NB Progress also detects abort request via the returned value */
-      int result = a_background_thread_progress ( threaddata, ((gdouble)dem_count) / dem_total );
-      if ( result != 0 )
-	return -1; /* Abort thread */
+      if ( a_background_thread_progress ( threaddata, ((gdouble)dem_count) / dem_total ) != 0 ) {
+        g_atomic_int_set ( &cancel, 1 );
+        result = -1; /* Abort thread */
+      }
     }
   }
-  return 0;
+
+  g_thread_pool_free ( pool, FALSE, TRUE );
+  g_async_queue_unref ( done );
+  g_free ( jobs );
+  return result;
 }
 
 /* Takes a string list (GList of strings) of dems (filenames).
@@ -248,7 +349,10 @@ gint16 a_dems_get_elev_by_coord ( const VikCoord *coord, VikDemInterpol method )
   ce.method = method;
   ce.elev = VIK_DEM_INVALID_ELEVATION;
 
-  if(!g_hash_table_find(loaded_dems, (GHRFunc)get_elev_by_coord, &ce))
+  G_LOCK(loaded_dems);
+  gboolean found = loaded_dems && g_hash_table_find(loaded_dems, (GHRFunc)get_elev_by_coord, &ce);
+  G_UNLOCK(loaded_dems);
+  if(!found)
     return VIK_DEM_INVALID_ELEVATION;
   return ce.elev;
 }
@@ -269,13 +373,17 @@ gboolean a_dems_overlaps_bbox ( LatLonBBox bbox )
 
   gpointer key, value;
   GHashTableIter ght_iter;
-  g_hash_table_iter_init ( &ght_iter, loaded_dems );
-  while ( g_hash_table_iter_next (&ght_iter, &key, &value) ) {
-    dem_bbox = vik_dem_get_bbox ( ((LoadedDEM*)value)->dem );
-    if ( BBOX_INTERSECT(dem_bbox, bbox) ) {
-      ans = TRUE;
-      break;
+  G_LOCK(loaded_dems);
+  if ( loaded_dems ) {
+    g_hash_table_iter_init ( &ght_iter, loaded_dems );
+    while ( g_hash_table_iter_next (&ght_iter, &key, &value) ) {
+      dem_bbox = vik_dem_get_bbox ( ((LoadedDEM*)value)->dem );
+      if ( BBOX_INTERSECT(dem_bbox, bbox) ) {
+        ans = TRUE;
+        break;
+      }
     }
   }
+  G_UNLOCK(loaded_dems);
   return ans;
 }
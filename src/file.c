@@ -32,7 +32,8 @@
 #include "babel.h"
 #include "gpsmapper.h"
 #include "compression.h"
-#include "file_magic.h"
+#include "file_binary.h"
+#include "background.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -51,6 +52,14 @@
 #define GPX_MAGIC "<?xm"
 #define VIK_MAGIC_LEN 4
 #define GPX_MAGIC_LEN 4
+#define GZIP_MAGIC "\037\213"
+#define GZIP_MAGIC_LEN 2
+#define BZIP2_MAGIC "BZh"
+#define BZIP2_MAGIC_LEN 3
+#define ZIP_MAGIC "PK\003\004"
+#define ZIP_MAGIC_LEN 4
+#define JPG_MAGIC "\377\330\377"
+#define JPG_MAGIC_LEN 3
 
 #define VIKING_FILE_VERSION 1
 
@@ -87,6 +96,19 @@ static gboolean check_magic ( FILE *f, const gchar *magic_number, guint magic_le
   return rv;
 }
 
+/*
+ * Whether the stream reads the file of that name,
+ *  rather than say data decompressed from it
+ */
+static gboolean stream_is_file ( FILE *f, const gchar *filename )
+{
+  GStatBuf fst, st;
+  int fd = fileno ( f );
+  if ( fd < 0 || fstat ( fd, &fst ) != 0 || g_stat ( filename, &st ) != 0 )
+    return FALSE;
+  return fst.st_dev == st.st_dev && fst.st_ino == st.st_ino;
+}
+
 
 static gboolean str_starts_with ( const gchar *haystack, const gchar *needle, guint16 len_needle, gboolean must_be_longer )
 {
@@ -616,7 +638,8 @@ gboolean check_file_magic_vik ( const gchar *filename )
   gboolean result = FALSE;
   FILE *ff = xfopen ( filename );
   if ( ff ) {
-    result = check_magic ( ff, VIK_MAGIC, VIK_MAGIC_LEN );
+    result = check_magic ( ff, VIK_MAGIC, VIK_MAGIC_LEN ) ||
+             check_magic ( ff, VIK_BINARY_MAGIC, VIK_BINARY_MAGIC_LEN );
     xfclose ( ff );
   }
   return result;
@@ -687,14 +710,26 @@ VikLoadType_t a_file_load_stream ( FILE *f,
     else
       load_answer = LOAD_TYPE_VIK_FAILURE_NON_FATAL;
   }
-  else if ( file_magic_check ( filename, "application/zip", ".zip" ) ) {
-    load_answer = uncompress_load_zip_file ( filename, top, vp, vtl, new_layer, external, dirpath );
+  else if ( check_magic ( f, VIK_BINARY_MAGIC, VIK_BINARY_MAGIC_LEN ) )
+  {
+    if ( a_file_binary_read ( top, filename, f, dirpath, vp ) )
+      load_answer = LOAD_TYPE_VIK_SUCCESS;
+    else
+      load_answer = LOAD_TYPE_VIK_FAILURE_NON_FATAL;
+  }
+  // NB The type is detected from the data itself, as the filename may be that of data decompressed from another file
+  else if ( check_magic ( f, ZIP_MAGIC, ZIP_MAGIC_LEN ) ) {
+    load_answer = uncompress_load_zip_stream ( f, filename, top, vp, vtl, new_layer, external, dirpath );
+  }
+  else if ( check_magic ( f, BZIP2_MAGIC, BZIP2_MAGIC_LEN ) ) {
+    load_answer = uncompress_load_bzip_stream ( f, filename, top, vp, vtl, new_layer, external, dirpath );
   }
-  else if ( file_magic_check ( filename, "application/x-bzip2", ".bz2" ) ) {
-    load_answer = uncompress_load_bzip_file ( filename, top, vp, vtl, new_layer, external );
+  else if ( check_magic ( f, GZIP_MAGIC, GZIP_MAGIC_LEN ) ) {
+    load_answer = uncompress_load_gzip_stream ( f, filename, top, vp, vtl, new_layer, external, dirpath );
   }
-  else if ( a_jpg_magic_check ( filename ) ) {
-    if ( ! a_jpg_load_file ( top, filename, vp ) )
+  else if ( check_magic ( f, JPG_MAGIC, JPG_MAGIC_LEN ) ) {
+    // The waypoint refers to the image file, so there has to be one
+    if ( ! stream_is_file ( f, filename ) || ! a_jpg_load_file ( top, filename, vp ) )
       load_answer = LOAD_TYPE_UNSUPPORTED_FAILURE;
   }
   else
@@ -728,8 +763,7 @@ VikLoadType_t a_file_load_stream ( FILE *f,
     // In fact both kml & gpx files start the same as they are in xml
     if ( a_file_check_ext ( filename, ".kml" ) && check_magic ( f, GPX_MAGIC, GPX_MAGIC_LEN ) ) {
       // Implicit Conversion
-      ProcessOptions po = { "-i kml", (gchar*)filename, NULL, NULL, NULL, NULL };
-      if ( ! ( success = a_babel_convert_from ( vtl, &po, NULL, NULL, NULL ) ) ) {
+      if ( ! ( success = a_babel_convert_from_stream ( vtl, "-i kml", f, NULL, NULL ) ) ) {
         load_answer = LOAD_TYPE_GPSBABEL_FAILURE;
       }
     }
@@ -740,7 +774,8 @@ VikLoadType_t a_file_load_stream ( FILE *f,
         load_answer = LOAD_TYPE_GPX_FAILURE;
       }
       if ( load_answer == LOAD_TYPE_OTHER_SUCCESS ) {
-	if ( external )
+	// Only a file that can be read again
+	if ( external && stream_is_file ( f, filename ) )
 	  // TODO may have to make absolute??
 	  trw_layer_replace_external ( vtl, filename );
       }
@@ -813,14 +848,184 @@ VikLoadType_t a_file_load ( VikAggregateLayer *top,
   return load_answer;
 }
 
-gboolean a_file_save ( VikAggregateLayer *top, gpointer vp, const gchar *filename )
+/**
+ * a_file_load_in_background_possible:
+ *
+ * Returns: Whether the file only holds tracks, routes and waypoints that a_file_load_in_background() can read.
+ *  i.e. GPX and GPS Point files, but not Viking, KML, compressed or image files
+ */
+gboolean a_file_load_in_background_possible ( const gchar *filename_or_uri )
+{
+  const gchar *filename = filename_or_uri;
+  if ( strncmp ( filename, "file://", 7 ) == 0 )
+    filename = filename + 7;
+  // Not stdin
+  if ( strcmp ( filename, "-" ) == 0 )
+    return FALSE;
+  if ( a_file_check_ext ( filename, ".kml" ) )
+    return FALSE;
+
+  FILE *f = g_fopen ( filename, "r" );
+  if ( !f )
+    return FALSE;
+  gboolean possible = ! check_magic ( f, VIK_MAGIC, VIK_MAGIC_LEN ) &&
+                      ! check_magic ( f, VIK_BINARY_MAGIC, VIK_BINARY_MAGIC_LEN ) &&
+                      ! check_magic ( f, GZIP_MAGIC, GZIP_MAGIC_LEN ) &&
+                      ! check_magic ( f, BZIP2_MAGIC, BZIP2_MAGIC_LEN ) &&
+                      ! check_magic ( f, ZIP_MAGIC, ZIP_MAGIC_LEN ) &&
+                      ! check_magic ( f, JPG_MAGIC, JPG_MAGIC_LEN );
+  fclose ( f );
+
+  return possible;
+}
+
+typedef struct {
+  VikTrwLayer *vtl;
+  gchar *filename;
+  FILE *f;
+  glong size;
+  gint percent;
+  gpointer threaddata;
+  gboolean external;
+  gchar *dirpath; // Of the resolved filename, for any relative links in the file
+  VikLoadType_t load_answer;
+  gboolean cancelled;
+  VikFileLoadedFunc loaded_func;
+  gpointer user_data;
+} load_thread_data;
+
+// In main thread
+static gboolean load_thread_finished ( load_thread_data *ltd )
+{
+  VikTrwLayer *vtl = ltd->vtl;
+  if ( ltd->load_answer == LOAD_TYPE_OTHER_SUCCESS && !ltd->cancelled ) {
+    if ( ltd->external )
+      trw_layer_replace_external ( vtl, ltd->filename );
+  }
+  else {
+    g_object_unref ( vtl );
+    vtl = NULL;
+  }
+
+  ltd->loaded_func ( vtl, ltd->filename, ltd->load_answer, ltd->user_data );
+
+  g_free ( ltd->filename );
+  g_free ( ltd->dirpath );
+  g_free ( ltd );
+  return FALSE;
+}
+
+// In the background thread
+static gboolean load_thread_progress ( gsize bytes_read, load_thread_data *ltd )
+{
+  if ( ltd->size > 0 ) {
+    gint percent = (gint)(100.0 * bytes_read / ltd->size);
+    if ( percent != ltd->percent ) {
+      ltd->percent = percent;
+      return a_background_thread_fraction ( ltd->threaddata, (gdouble)bytes_read / ltd->size ) == 0;
+    }
+  }
+  return a_background_testcancel ( ltd->threaddata ) == 0;
+}
+
+// Only the layer is changed, which is not yet shown anywhere
+static int load_thread ( load_thread_data *ltd, gpointer threaddata )
+{
+  FILE *f = ltd->f;
+  ltd->threaddata = threaddata;
+  if ( f ) {
+    // NB use a extension check first, as a GPX file header may have a Byte Order Mark (BOM) in it
+    if ( a_file_check_ext ( ltd->filename, ".gpx" ) || check_magic ( f, GPX_MAGIC, GPX_MAGIC_LEN ) ) {
+      if ( ! a_gpx_read_file_progress ( ltd->vtl, f, ltd->dirpath, (VikReadProgressFunc)load_thread_progress, ltd ) )
+        ltd->load_answer = LOAD_TYPE_GPX_FAILURE;
+    }
+    else if ( ! a_gpspoint_read_file_progress ( ltd->vtl, f, ltd->dirpath, (VikReadProgressFunc)load_thread_progress, ltd ) )
+      ltd->load_answer = LOAD_TYPE_UNSUPPORTED_FAILURE;
+
+    fclose ( f );
+  }
+  else
+    ltd->load_answer = LOAD_TYPE_READ_FAILURE;
+
+  ltd->cancelled = a_background_testcancel ( threaddata ) != 0;
+  // A read stopped part way through is not a problem with the file
+  if ( ltd->cancelled )
+    ltd->load_answer = LOAD_TYPE_OTHER_SUCCESS;
+
+  // Everything else has to be done by the main thread, which then owns the data
+  gdk_threads_add_idle ( (GSourceFunc)load_thread_finished, ltd );
+  return 0;
+}
+
+/**
+ * a_file_load_in_background:
+ * @loaded_func: Called in the main thread once the file has been read
+ *
+ * Read a GPX or GPS Point file (see a_file_load_in_background_possible()) into a new TrackWaypoint layer in
+ *  the local background thread pool, so that many files are read at the same time and without blocking the UI.
+ * The progress is how much of the file has been read, and the reading stops part way through when cancelled.
+ */
+void a_file_load_in_background ( VikViewport *vp,
+                                 const gchar *filename_or_uri,
+                                 gboolean external,
+                                 VikFileLoadedFunc loaded_func,
+                                 gpointer user_data )
+{
+  const gchar *filename = filename_or_uri;
+  if ( strncmp ( filename, "file://", 7 ) == 0 )
+    filename = filename + 7;
+
+  load_thread_data *ltd = g_malloc0 ( sizeof(load_thread_data) );
+  ltd->filename = g_strdup ( filename );
+  ltd->external = external;
+  ltd->load_answer = LOAD_TYPE_OTHER_SUCCESS;
+  ltd->loaded_func = loaded_func;
+  ltd->user_data = user_data;
+
+  // Opened now, so the file can be removed (e.g. a temporary file) once this returns
+  ltd->f = g_fopen ( filename, "r" );
+  if ( ltd->f ) {
+    // For the progress
+    if ( fseek ( ltd->f, 0, SEEK_END ) == 0 )
+      ltd->size = ftell ( ltd->f );
+    rewind ( ltd->f );
+
+    // Resolved now, as the current directory may change before the thread runs
+    gchar *absolute = file_realpath_dup ( filename );
+    if ( absolute )
+      ltd->dirpath = g_path_get_dirname ( absolute );
+    g_free ( absolute );
+  }
+
+  // The layer is made here as it creates drawing resources for the viewport
+  ltd->vtl = VIK_TRW_LAYER ( vik_layer_create ( VIK_LAYER_TRW, vp, FALSE ) );
+  vik_layer_rename ( VIK_LAYER(ltd->vtl), a_file_basename ( filename ) );
+
+  gchar *msg = g_strdup_printf ( _("Loading %s"), a_file_basename ( filename ) );
+  a_background_thread ( BACKGROUND_POOL_LOCAL,
+                        VIK_GTK_WINDOW_FROM_WIDGET(vp),
+                        msg,
+                        (vik_thr_func) load_thread,
+                        ltd,
+                        NULL,
+                        NULL,
+                        1 );
+  g_free ( msg );
+}
+
+/**
+ * a_file_save:
+ * @binary: Save in the binary form, which is quicker to load, rather than as text
+ *
+ */
+gboolean a_file_save ( VikAggregateLayer *top, gpointer vp, const gchar *filename, gboolean binary )
 {
   FILE *f;
 
   if (strncmp(filename, "file://", 7) == 0)
     filename = filename + 7;
 
-  f = g_fopen(filename, "w");
+  f = g_fopen(filename, binary ? "wb" : "w");
 
   if ( ! f )
     return FALSE;
@@ -834,7 +1039,10 @@ gboolean a_file_save ( VikAggregateLayer *top, gpointer vp, const gchar *filenam
     }
   }
 
-  file_write ( top, f, vp, dir );
+  if ( binary )
+    a_file_binary_write ( top, f, vp, dir );
+  else
+    file_write ( top, f, vp, dir );
   g_free (dir);
 
   // Restore previous working directory
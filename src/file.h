@@ -77,7 +77,22 @@ VikLoadType_t a_file_load ( VikAggregateLayer *top,
                             gboolean external,
                             const gchar *name );
 
-gboolean a_file_save ( VikAggregateLayer *top, gpointer vp, const gchar *filename );
+/**
+ * VikFileLoadedFunc:
+ * @vtl: The new layer, which the function takes ownership of.
+ *       NULL if the file could not be read (see @load_type) or the load was cancelled
+ */
+typedef void (*VikFileLoadedFunc) ( VikTrwLayer *vtl, const gchar *filename, VikLoadType_t load_type, gpointer user_data );
+
+gboolean a_file_load_in_background_possible ( const gchar *filename_or_uri );
+
+void a_file_load_in_background ( VikViewport *vp,
+                                 const gchar *filename_or_uri,
+                                 gboolean external,
+                                 VikFileLoadedFunc loaded_func,
+                                 gpointer user_data );
+
+gboolean a_file_save ( VikAggregateLayer *top, gpointer vp, const gchar *filename, gboolean binary );
 /* Only need to define VikTrack if the file type is FILE_TYPE_GPX_TRACK */
 gboolean a_file_export ( VikTrwLayer *vtl, const gchar *filename, VikFileType_t file_type, VikTrack *trk, gboolean write_hidden );
 gboolean a_file_export_babel ( VikTrwLayer *vtl, const gchar *filename, const gchar *format,
@@ -0,0 +1,1426 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <glib/gstdio.h>
+
+#include "viking.h"
+#include "file_binary.h"
+
+/*
+ * Layout of the file, all values are little endian:
+ *
+ *  Header:  magic[8], guint32 version, guint32 reserved
+ *  Sections, each starting on an 8 byte boundary
+ *  Table:   per section - guint32 kind, guint32 layer, guint64 offset, guint64 size
+ *  Trailer: guint64 offset of the table, guint32 number of sections, guint32 reserved
+ *
+ * The sections are in the order of the text form:
+ *  the viewport, then each layer (depth first) followed by its data.
+ *  The layer of a data section is the index of its layer section amongst all the layer sections.
+ *
+ * Viewport:    a parameter block, with the same names as the text form
+ * Layer:       guint32 parent layer (or NO_LAYER for the top), guint32 visible,
+ *              string type (the fixed layer name), string name, then a parameter block
+ * Layer Data:  the text form of the layer data, for layers without a binary form
+ * Waypoints, Trackpoints and Tracks:
+ *              guint32 rows, guint32 columns,
+ *              per column - guint32 id, guint32 width, guint64 offset (from the start of the section), guint64 size
+ *              then the columns themselves, each starting on an 8 byte boundary.
+ *              String columns hold offsets into the STRINGS column, or NO_STRING for none.
+ *              Each track takes the next N_POINTS rows of the trackpoints section before it.
+ *
+ * Parameter block: guint32 count, then per parameter -
+ *              guint32 type (VikLayerParamType), string name, value
+ * Strings in parameter blocks are guint32 length then the characters.
+ *
+ * Unknown sections and columns are ignored, so more can be added without changing the version.
+ */
+
+#define BINARY_VERSION 1
+#define HEADER_SIZE 16
+#define TABLE_ENTRY_SIZE 24
+#define TRAILER_SIZE 16
+#define COLUMN_ENTRY_SIZE 24
+
+#define NO_LAYER G_MAXUINT32
+#define NO_STRING G_MAXUINT32
+
+typedef enum {
+  SECTION_VIEWPORT = 1,
+  SECTION_LAYER,
+  SECTION_LAYER_DATA,
+  SECTION_WAYPOINTS,
+  SECTION_TRACKPOINTS,
+  SECTION_TRACKS,
+} SectionKind;
+
+typedef enum {
+  COLUMN_STRINGS = 1,
+  COLUMN_FLAGS,
+  COLUMN_NAME,
+  COLUMN_LATITUDE,
+  COLUMN_LONGITUDE,
+  COLUMN_ALTITUDE,
+  COLUMN_TIMESTAMP,
+  COLUMN_COMMENT,
+  COLUMN_DESCRIPTION,
+  COLUMN_SOURCE,
+  COLUMN_TYPE,
+  COLUMN_IMAGE,
+  COLUMN_IMAGE_DIRECTION,
+  COLUMN_IMAGE_DIRECTION_REF,
+  COLUMN_SYMBOL,
+  COLUMN_SPEED,
+  COLUMN_COURSE,
+  COLUMN_NSATS,
+  COLUMN_FIX,
+  COLUMN_HDOP,
+  COLUMN_VDOP,
+  COLUMN_PDOP,
+  COLUMN_COLOR,
+  COLUMN_DRAW_NAME_MODE,
+  COLUMN_DIST_LABELS,
+  COLUMN_N_POINTS,
+} ColumnId;
+
+#define FLAG_VISIBLE    (1<<0)
+#define FLAG_IS_ROUTE   (1<<1)
+#define FLAG_HAS_COLOR  (1<<2)
+#define FLAG_NEWSEGMENT (1<<3)
+
+typedef struct {
+  guint32 id;
+  guint32 width; /* Bytes per row, 0 for the strings */
+} Column;
+
+static const Column waypoint_columns[] = {
+  { COLUMN_FLAGS, 4 },
+  { COLUMN_LATITUDE, 8 },
+  { COLUMN_LONGITUDE, 8 },
+  { COLUMN_ALTITUDE, 8 },
+  { COLUMN_TIMESTAMP, 8 },
+  { COLUMN_IMAGE_DIRECTION, 8 },
+  { COLUMN_IMAGE_DIRECTION_REF, 4 },
+  { COLUMN_NAME, 4 },
+  { COLUMN_COMMENT, 4 },
+  { COLUMN_DESCRIPTION, 4 },
+  { COLUMN_SOURCE, 4 },
+  { COLUMN_TYPE, 4 },
+  { COLUMN_IMAGE, 4 },
+  { COLUMN_SYMBOL, 4 },
+  { COLUMN_STRINGS, 0 },
+};
+
+static const Column trackpoint_columns[] = {
+  { COLUMN_FLAGS, 4 },
+  { COLUMN_LATITUDE, 8 },
+  { COLUMN_LONGITUDE, 8 },
+  { COLUMN_ALTITUDE, 8 },
+  { COLUMN_TIMESTAMP, 8 },
+  { COLUMN_SPEED, 8 },
+  { COLUMN_COURSE, 8 },
+  { COLUMN_HDOP, 8 },
+  { COLUMN_VDOP, 8 },
+  { COLUMN_PDOP, 8 },
+  { COLUMN_NSATS, 4 },
+  { COLUMN_FIX, 4 },
+  { COLUMN_NAME, 4 },
+  { COLUMN_STRINGS, 0 },
+};
+
+static const Column track_columns[] = {
+  { COLUMN_FLAGS, 4 },
+  { COLUMN_N_POINTS, 4 },
+  { COLUMN_COLOR, 8 },
+  { COLUMN_DRAW_NAME_MODE, 4 },
+  { COLUMN_DIST_LABELS, 4 },
+  { COLUMN_NAME, 4 },
+  { COLUMN_COMMENT, 4 },
+  { COLUMN_DESCRIPTION, 4 },
+  { COLUMN_SOURCE, 4 },
+  { COLUMN_TYPE, 4 },
+  { COLUMN_STRINGS, 0 },
+};
+
+/* ---------------------------------------------------- */
+/* Writing */
+
+typedef struct {
+  guint32 kind;
+  guint32 layer;
+  guint64 offset;
+  guint64 size;
+} SectionEntry;
+
+typedef struct {
+  FILE *f;
+  guint64 pos;
+  GArray *sections;
+  guint32 n_layers;
+  const gchar *dirpath;
+} BinaryWriter;
+
+static void write_bytes ( BinaryWriter *bw, gconstpointer data, gsize len )
+{
+  fwrite ( data, 1, len, bw->f );
+  bw->pos += len;
+}
+
+static void write_u32 ( BinaryWriter *bw, guint32 value )
+{
+  value = GUINT32_TO_LE ( value );
+  write_bytes ( bw, &value, 4 );
+}
+
+static void write_u64 ( BinaryWriter *bw, guint64 value )
+{
+  value = GUINT64_TO_LE ( value );
+  write_bytes ( bw, &value, 8 );
+}
+
+static void write_f64 ( BinaryWriter *bw, gdouble value )
+{
+  guint64 bits;
+  memcpy ( &bits, &value, 8 );
+  write_u64 ( bw, bits );
+}
+
+static void write_align ( BinaryWriter *bw )
+{
+  static const guint8 zeroes[8] = { 0 };
+  if ( bw->pos % 8 )
+    write_bytes ( bw, zeroes, 8 - bw->pos % 8 );
+}
+
+static void section_begin ( BinaryWriter *bw, SectionKind kind, guint32 layer )
+{
+  write_align ( bw );
+  SectionEntry entry = { kind, layer, bw->pos, 0 };
+  g_array_append_val ( bw->sections, entry );
+}
+
+static void section_end ( BinaryWriter *bw )
+{
+  SectionEntry *entry = &g_array_index ( bw->sections, SectionEntry, bw->sections->len-1 );
+  entry->size = bw->pos - entry->offset;
+}
+
+/* Small parts are put together in memory */
+
+static void append_u32 ( GByteArray *ba, guint32 value )
+{
+  value = GUINT32_TO_LE ( value );
+  g_byte_array_append ( ba, (guint8*)&value, 4 );
+}
+
+static void append_f64 ( GByteArray *ba, gdouble value )
+{
+  guint64 bits;
+  memcpy ( &bits, &value, 8 );
+  bits = GUINT64_TO_LE ( bits );
+  g_byte_array_append ( ba, (guint8*)&bits, 8 );
+}
+
+static void append_string ( GByteArray *ba, const gchar *str )
+{
+  guint32 len = str ? strlen ( str ) : 0;
+  append_u32 ( ba, len );
+  if ( len )
+    g_byte_array_append ( ba, (const guint8*)str, len );
+}
+
+static void append_param ( GByteArray *ba, guint *count, const gchar *name, VikLayerParamType type, VikLayerParamData data )
+{
+  switch ( type ) {
+    case VIK_LAYER_PARAM_DOUBLE:
+    case VIK_LAYER_PARAM_UINT:
+    case VIK_LAYER_PARAM_INT:
+    case VIK_LAYER_PARAM_BOOLEAN:
+    case VIK_LAYER_PARAM_STRING:
+    case VIK_LAYER_PARAM_COLOR:
+    case VIK_LAYER_PARAM_STRING_LIST:
+      break;
+    default:
+      // Nothing else is in the text form either
+      return;
+  }
+  append_u32 ( ba, type );
+  append_string ( ba, name );
+  switch ( type ) {
+    case VIK_LAYER_PARAM_DOUBLE: append_f64 ( ba, data.d ); break;
+    case VIK_LAYER_PARAM_UINT: append_u32 ( ba, data.u ); break;
+    case VIK_LAYER_PARAM_INT: append_u32 ( ba, (guint32)data.i ); break;
+    case VIK_LAYER_PARAM_BOOLEAN: append_u32 ( ba, data.b ? 1 : 0 ); break;
+    case VIK_LAYER_PARAM_STRING: append_string ( ba, data.s ); break;
+    case VIK_LAYER_PARAM_COLOR:
+      append_u32 ( ba, data.c.red );
+      append_u32 ( ba, data.c.green );
+      append_u32 ( ba, data.c.blue );
+      break;
+    default: {
+      append_u32 ( ba, g_list_length ( data.sl ) );
+      for ( GList *iter = data.sl; iter; iter = iter->next )
+        append_string ( ba, (const gchar*)iter->data );
+      break;
+    }
+  }
+  (*count)++;
+}
+
+static void write_param_block ( BinaryWriter *bw, GByteArray *params, guint count )
+{
+  write_u32 ( bw, count );
+  write_bytes ( bw, params->data, params->len );
+}
+
+static void write_viewport ( BinaryWriter *bw, VikAggregateLayer *top, VikViewport *vp )
+{
+  struct LatLon ll;
+  vik_coord_to_latlon ( vik_viewport_get_center ( vp ), &ll );
+
+  const gchar *modestring = NULL;
+  switch ( vik_viewport_get_drawmode ( vp ) ) {
+    case VIK_VIEWPORT_DRAWMODE_UTM: modestring = "utm"; break;
+    case VIK_VIEWPORT_DRAWMODE_EXPEDIA: modestring = "expedia"; break;
+    case VIK_VIEWPORT_DRAWMODE_MERCATOR: modestring = "mercator"; break;
+    case VIK_VIEWPORT_DRAWMODE_LATLON: modestring = "latlon"; break;
+    default: break;
+  }
+
+  GByteArray *ba = g_byte_array_new ();
+  guint count = 0;
+  VikLayerParamData data;
+  data.d = vik_viewport_get_xmpp ( vp );
+  append_param ( ba, &count, "xmpp", VIK_LAYER_PARAM_DOUBLE, data );
+  data.d = vik_viewport_get_ympp ( vp );
+  append_param ( ba, &count, "ympp", VIK_LAYER_PARAM_DOUBLE, data );
+  data.d = ll.lat;
+  append_param ( ba, &count, "lat", VIK_LAYER_PARAM_DOUBLE, data );
+  data.d = ll.lon;
+  append_param ( ba, &count, "lon", VIK_LAYER_PARAM_DOUBLE, data );
+  if ( modestring ) {
+    data.s = modestring;
+    append_param ( ba, &count, "mode", VIK_LAYER_PARAM_STRING, data );
+  }
+  data.s = vik_viewport_get_background_color ( vp );
+  append_param ( ba, &count, "color", VIK_LAYER_PARAM_STRING, data );
+  data.s = vik_viewport_get_highlight_color ( vp );
+  append_param ( ba, &count, "highlightcolor", VIK_LAYER_PARAM_STRING, data );
+  data.b = vik_viewport_get_draw_scale ( vp );
+  append_param ( ba, &count, "drawscale", VIK_LAYER_PARAM_BOOLEAN, data );
+  data.b = vik_viewport_get_draw_centermark ( vp );
+  append_param ( ba, &count, "drawcentermark", VIK_LAYER_PARAM_BOOLEAN, data );
+  data.b = vik_viewport_get_draw_highlight ( vp );
+  append_param ( ba, &count, "drawhighlight", VIK_LAYER_PARAM_BOOLEAN, data );
+  data.b = VIK_LAYER(top)->visible;
+  append_param ( ba, &count, "visible", VIK_LAYER_PARAM_BOOLEAN, data );
+
+  section_begin ( bw, SECTION_VIEWPORT, NO_LAYER );
+  write_param_block ( bw, ba, count );
+  section_end ( bw );
+  g_byte_array_free ( ba, TRUE );
+}
+
+/*
+ * Start a columnar section, with the columns following in the order given
+ */
+static void write_columns_header ( BinaryWriter *bw, guint32 n_rows, const Column *columns, guint n_columns, guint32 strings_size )
+{
+  guint64 start = bw->sections->len ? g_array_index ( bw->sections, SectionEntry, bw->sections->len-1 ).offset : bw->pos;
+  guint64 offset = bw->pos - start + 8 + n_columns * COLUMN_ENTRY_SIZE;
+  write_u32 ( bw, n_rows );
+  write_u32 ( bw, n_columns );
+  for ( guint cc = 0; cc < n_columns; cc++ ) {
+    guint64 size = columns[cc].width ? (guint64)columns[cc].width * n_rows : strings_size;
+    offset = (offset + 7) & ~G_GUINT64_CONSTANT(7);
+    write_u32 ( bw, columns[cc].id );
+    write_u32 ( bw, columns[cc].width );
+    write_u64 ( bw, offset );
+    write_u64 ( bw, size );
+    offset += size;
+  }
+}
+
+/*
+ * Add the offset of a string, as they will be placed in the STRINGS column
+ */
+static void write_string_ref ( BinaryWriter *bw, const gchar *str, guint32 *strings_pos )
+{
+  if ( str ) {
+    write_u32 ( bw, *strings_pos );
+    *strings_pos += strlen ( str ) + 1;
+  }
+  else
+    write_u32 ( bw, NO_STRING );
+}
+
+static void write_string ( BinaryWriter *bw, const gchar *str, guint32 *strings_size )
+{
+  if ( str ) {
+    guint32 len = strlen ( str ) + 1;
+    if ( strings_size )
+      *strings_size += len;
+    else
+      write_bytes ( bw, str, len );
+  }
+}
+
+/*
+ * Waypoints
+ */
+
+static const gchar *waypoint_string ( VikWaypoint *wp, const gchar *image, guint32 id )
+{
+  switch ( id ) {
+    case COLUMN_NAME: return wp->name;
+    case COLUMN_COMMENT: return wp->comment;
+    case COLUMN_DESCRIPTION: return wp->description;
+    case COLUMN_SOURCE: return wp->source;
+    case COLUMN_TYPE: return wp->type;
+    case COLUMN_IMAGE: return image;
+    case COLUMN_SYMBOL: return wp->symbol;
+    default: return NULL;
+  }
+}
+
+static void write_waypoints ( BinaryWriter *bw, VikTrwLayer *vtl )
+{
+  GPtrArray *wps = g_ptr_array_new ();
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init ( &iter, vik_trw_layer_get_waypoints ( vtl ) );
+  while ( g_hash_table_iter_next ( &iter, NULL, &value ) )
+    // As in the text form
+    if ( VIK_WAYPOINT(value)->name )
+      g_ptr_array_add ( wps, value );
+  guint n_wps = wps->len;
+
+  // Image filenames as written in the text form
+  gchar **images = g_new0 ( gchar*, n_wps );
+  for ( guint ii = 0; ii < n_wps; ii++ ) {
+    VikWaypoint *wp = g_ptr_array_index ( wps, ii );
+    if ( !wp->image )
+      continue;
+    if ( a_vik_get_file_ref_format() == VIK_FILE_REF_FORMAT_RELATIVE && bw->dirpath )
+      images[ii] = g_strdup ( file_GetRelativeFilename ( (gchar*)bw->dirpath, wp->image ) );
+    if ( !images[ii] )
+      images[ii] = g_strdup ( wp->image );
+  }
+
+  guint n_columns = G_N_ELEMENTS(waypoint_columns);
+  guint32 strings_size = 0;
+  for ( guint cc = 0; cc < n_columns; cc++ )
+    for ( guint ii = 0; ii < n_wps; ii++ )
+      write_string ( bw, waypoint_string ( g_ptr_array_index ( wps, ii ), images[ii], waypoint_columns[cc].id ), &strings_size );
+
+  section_begin ( bw, SECTION_WAYPOINTS, bw->n_layers-1 );
+  write_columns_header ( bw, n_wps, waypoint_columns, n_columns, strings_size );
+  guint32 strings_pos = 0;
+  for ( guint cc = 0; cc < n_columns; cc++ ) {
+    guint32 id = waypoint_columns[cc].id;
+    write_align ( bw );
+    if ( id == COLUMN_STRINGS ) {
+      for ( guint ss = 0; ss < n_columns; ss++ )
+        for ( guint ii = 0; ii < n_wps; ii++ )
+          write_string ( bw, waypoint_string ( g_ptr_array_index ( wps, ii ), images[ii], waypoint_columns[ss].id ), NULL );
+      continue;
+    }
+    for ( guint ii = 0; ii < n_wps; ii++ ) {
+      VikWaypoint *wp = g_ptr_array_index ( wps, ii );
+      struct LatLon ll;
+      switch ( id ) {
+        case COLUMN_FLAGS: write_u32 ( bw, wp->visible ? FLAG_VISIBLE : 0 ); break;
+        case COLUMN_LATITUDE:
+          vik_coord_to_latlon ( &wp->coord, &ll );
+          write_f64 ( bw, ll.lat );
+          break;
+        case COLUMN_LONGITUDE:
+          vik_coord_to_latlon ( &wp->coord, &ll );
+          write_f64 ( bw, ll.lon );
+          break;
+        case COLUMN_ALTITUDE: write_f64 ( bw, wp->altitude ); break;
+        case COLUMN_TIMESTAMP: write_f64 ( bw, wp->timestamp ); break;
+        case COLUMN_IMAGE_DIRECTION: write_f64 ( bw, wp->image_direction ); break;
+        case COLUMN_IMAGE_DIRECTION_REF: write_u32 ( bw, wp->image_direction_ref ); break;
+        default:
+          write_string_ref ( bw, waypoint_string ( wp, images[ii], id ), &strings_pos );
+          break;
+      }
+    }
+  }
+  section_end ( bw );
+
+  for ( guint ii = 0; ii < n_wps; ii++ )
+    g_free ( images[ii] );
+  g_free ( images );
+  g_ptr_array_free ( wps, TRUE );
+}
+
+/*
+ * Tracks and routes
+ */
+
+static const gchar *track_string ( VikTrack *trk, guint32 id )
+{
+  switch ( id ) {
+    case COLUMN_NAME: return trk->name;
+    case COLUMN_COMMENT: return trk->comment;
+    case COLUMN_DESCRIPTION: return trk->description;
+    case COLUMN_SOURCE: return trk->source;
+    case COLUMN_TYPE: return trk->type;
+    default: return NULL;
+  }
+}
+
+static void add_named_track ( gpointer key, VikTrack *trk, GPtrArray *trks )
+{
+  // As in the text form
+  if ( trk->name )
+    g_ptr_array_add ( trks, trk );
+}
+
+static void write_trackpoints ( BinaryWriter *bw, GPtrArray *trks )
+{
+  guint n_columns = G_N_ELEMENTS(trackpoint_columns);
+  guint32 n_tps = 0;
+  guint32 strings_size = 0;
+  for ( guint tt = 0; tt < trks->len; tt++ )
+    for ( GList *iter = VIK_TRACK(g_ptr_array_index ( trks, tt ))->trackpoints; iter; iter = iter->next ) {
+      n_tps++;
+      write_string ( bw, VIK_TRACKPOINT(iter->data)->name, &strings_size );
+    }
+
+  section_begin ( bw, SECTION_TRACKPOINTS, bw->n_layers-1 );
+  write_columns_header ( bw, n_tps, trackpoint_columns, n_columns, strings_size );
+  guint32 strings_pos = 0;
+  for ( guint cc = 0; cc < n_columns; cc++ ) {
+    guint32 id = trackpoint_columns[cc].id;
+    write_align ( bw );
+    for ( guint tt = 0; tt < trks->len; tt++ ) {
+      for ( GList *iter = VIK_TRACK(g_ptr_array_index ( trks, tt ))->trackpoints; iter; iter = iter->next ) {
+        VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
+        struct LatLon ll;
+        switch ( id ) {
+          case COLUMN_FLAGS: write_u32 ( bw, tp->newsegment ? FLAG_NEWSEGMENT : 0 ); break;
+          case COLUMN_LATITUDE:
+            vik_coord_to_latlon ( &tp->coord, &ll );
+            write_f64 ( bw, ll.lat );
+            break;
+          case COLUMN_LONGITUDE:
+            vik_coord_to_latlon ( &tp->coord, &ll );
+            write_f64 ( bw, ll.lon );
+            break;
+          case COLUMN_ALTITUDE: write_f64 ( bw, tp->altitude ); break;
+          case COLUMN_TIMESTAMP: write_f64 ( bw, tp->timestamp ); break;
+          case COLUMN_SPEED: write_f64 ( bw, tp->speed ); break;
+          case COLUMN_COURSE: write_f64 ( bw, tp->course ); break;
+          case COLUMN_HDOP: write_f64 ( bw, tp->hdop ); break;
+          case COLUMN_VDOP: write_f64 ( bw, tp->vdop ); break;
+          case COLUMN_PDOP: write_f64 ( bw, tp->pdop ); break;
+          case COLUMN_NSATS: write_u32 ( bw, tp->nsats ); break;
+          case COLUMN_FIX: write_u32 ( bw, tp->fix_mode ); break;
+          case COLUMN_NAME: write_string_ref ( bw, tp->name, &strings_pos ); break;
+          case COLUMN_STRINGS: write_string ( bw, tp->name, NULL ); break;
+          default: break;
+        }
+      }
+    }
+  }
+  section_end ( bw );
+}
+
+static void write_tracks ( BinaryWriter *bw, VikTrwLayer *vtl )
+{
+  // Tracks then routes, as in the text form
+  GPtrArray *trks = g_ptr_array_new ();
+  g_hash_table_foreach ( vik_trw_layer_get_tracks ( vtl ), (GHFunc)add_named_track, trks );
+  g_hash_table_foreach ( vik_trw_layer_get_routes ( vtl ), (GHFunc)add_named_track, trks );
+
+  write_trackpoints ( bw, trks );
+
+  guint n_columns = G_N_ELEMENTS(track_columns);
+  guint32 strings_size = 0;
+  for ( guint cc = 0; cc < n_columns; cc++ )
+    for ( guint tt = 0; tt < trks->len; tt++ )
+      write_string ( bw, track_string ( g_ptr_array_index ( trks, tt ), track_columns[cc].id ), &strings_size );
+
+  section_begin ( bw, SECTION_TRACKS, bw->n_layers-1 );
+  write_columns_header ( bw, trks->len, track_columns, n_columns, strings_size );
+  guint32 strings_pos = 0;
+  for ( guint cc = 0; cc < n_columns; cc++ ) {
+    guint32 id = track_columns[cc].id;
+    write_align ( bw );
+    if ( id == COLUMN_STRINGS ) {
+      for ( guint ss = 0; ss < n_columns; ss++ )
+        for ( guint tt = 0; tt < trks->len; tt++ )
+          write_string ( bw, track_string ( g_ptr_array_index ( trks, tt ), track_columns[ss].id ), NULL );
+      continue;
+    }
+    for ( guint tt = 0; tt < trks->len; tt++ ) {
+      VikTrack *trk = g_ptr_array_index ( trks, tt );
+      switch ( id ) {
+        case COLUMN_FLAGS:
+          write_u32 ( bw, (trk->visible ? FLAG_VISIBLE : 0) | (trk->is_route ? FLAG_IS_ROUTE : 0) | (trk->has_color ? FLAG_HAS_COLOR : 0) );
+          break;
+        case COLUMN_N_POINTS: write_u32 ( bw, g_list_length ( trk->trackpoints ) ); break;
+        case COLUMN_COLOR:
+          write_u64 ( bw, trk->color.red | ((guint64)trk->color.green << 16) | ((guint64)trk->color.blue << 32) );
+          break;
+        case COLUMN_DRAW_NAME_MODE: write_u32 ( bw, trk->draw_name_mode ); break;
+        case COLUMN_DIST_LABELS: write_u32 ( bw, trk->max_number_dist_labels ); break;
+        default:
+          write_string_ref ( bw, track_string ( trk, id ), &strings_pos );
+          break;
+      }
+    }
+  }
+  section_end ( bw );
+
+  g_ptr_array_free ( trks, TRUE );
+}
+
+/*
+ * Layer data that only has a text form is kept as that text
+ */
+static void write_layer_data_text ( BinaryWriter *bw, VikLayer *vl )
+{
+  gchar *tmpname = NULL;
+  gint fd = g_file_open_tmp ( "vik-binary-tmp.XXXXXX", &tmpname, NULL );
+  if ( fd < 0 ) {
+    g_warning ( "%s: Could not create a temporary file", __FUNCTION__ );
+    return;
+  }
+  FILE *tmp = fdopen ( fd, "w+b" );
+  if ( tmp ) {
+    vik_layer_get_interface(vl->type)->write_file_data ( vl, tmp, bw->dirpath );
+    rewind ( tmp );
+    section_begin ( bw, SECTION_LAYER_DATA, bw->n_layers-1 );
+    gchar buffer[4096];
+    gsize len;
+    while ( (len = fread ( buffer, 1, sizeof(buffer), tmp )) > 0 )
+      write_bytes ( bw, buffer, len );
+    section_end ( bw );
+    fclose ( tmp );
+  }
+  else
+    close ( fd );
+  util_remove ( tmpname );
+  g_free ( tmpname );
+}
+
+static void write_layer ( BinaryWriter *bw, VikLayer *vl, guint32 parent )
+{
+  VikLayerInterface *vli = vik_layer_get_interface ( vl->type );
+
+  GByteArray *ba = g_byte_array_new ();
+  guint count = 0;
+  if ( vli->params && vli->get_param )
+    for ( guint16 ii = 0; ii < vli->params_count; ii++ )
+      append_param ( ba, &count, vli->params[ii].name, vli->params[ii].type, vli->get_param ( vl, ii, TRUE ) );
+
+  section_begin ( bw, SECTION_LAYER, NO_LAYER );
+  write_u32 ( bw, parent );
+  write_u32 ( bw, vl->visible );
+  GByteArray *names = g_byte_array_new ();
+  append_string ( names, vli->fixed_layer_name );
+  append_string ( names, vl->name );
+  write_bytes ( bw, names->data, names->len );
+  write_param_block ( bw, ba, count );
+  section_end ( bw );
+  g_byte_array_free ( names, TRUE );
+  g_byte_array_free ( ba, TRUE );
+
+  guint32 index = bw->n_layers++;
+
+  if ( vl->type == VIK_LAYER_TRW && !vik_trw_layer_is_external ( VIK_TRW_LAYER(vl) ) ) {
+    write_waypoints ( bw, VIK_TRW_LAYER(vl) );
+    write_tracks ( bw, VIK_TRW_LAYER(vl) );
+  }
+  else if ( vli->write_file_data )
+    write_layer_data_text ( bw, vl );
+
+  const GList *children = NULL;
+  if ( vl->type == VIK_LAYER_AGGREGATE )
+    children = vik_aggregate_layer_get_children ( VIK_AGGREGATE_LAYER(vl) );
+  else if ( vl->type == VIK_LAYER_GPS )
+    children = vik_gps_layer_get_children ( VIK_GPS_LAYER(vl) );
+  for ( const GList *iter = children; iter; iter = iter->next )
+    write_layer ( bw, VIK_LAYER(iter->data), index );
+}
+
+/**
+ * a_file_binary_write:
+ *
+ * Write the layers and the viewport settings in the binary form
+ */
+void a_file_binary_write ( VikAggregateLayer *top, FILE *f, VikViewport *vp, const gchar *dirpath )
+{
+  BinaryWriter bw;
+  bw.f = f;
+  bw.pos = 0;
+  bw.sections = g_array_new ( FALSE, FALSE, sizeof(SectionEntry) );
+  bw.n_layers = 0;
+  bw.dirpath = dirpath;
+
+  write_bytes ( &bw, VIK_BINARY_MAGIC, VIK_BINARY_MAGIC_LEN );
+  write_u32 ( &bw, BINARY_VERSION );
+  write_u32 ( &bw, 0 );
+
+  write_viewport ( &bw, top, vp );
+  for ( const GList *iter = vik_aggregate_layer_get_children ( top ); iter; iter = iter->next )
+    write_layer ( &bw, VIK_LAYER(iter->data), NO_LAYER );
+
+  write_align ( &bw );
+  guint64 table = bw.pos;
+  for ( guint ii = 0; ii < bw.sections->len; ii++ ) {
+    SectionEntry *entry = &g_array_index ( bw.sections, SectionEntry, ii );
+    write_u32 ( &bw, entry->kind );
+    write_u32 ( &bw, entry->layer );
+    write_u64 ( &bw, entry->offset );
+    write_u64 ( &bw, entry->size );
+  }
+  write_u64 ( &bw, table );
+  write_u32 ( &bw, bw.sections->len );
+  write_u32 ( &bw, 0 );
+
+  g_array_free ( bw.sections, TRUE );
+}
+
+/* ---------------------------------------------------- */
+/* Reading */
+
+static inline guint32 get_u32 ( const guint8 *p )
+{
+  guint32 value;
+  memcpy ( &value, p, 4 );
+  return GUINT32_FROM_LE ( value );
+}
+
+static inline guint64 get_u64 ( const guint8 *p )
+{
+  guint64 value;
+  memcpy ( &value, p, 8 );
+  return GUINT64_FROM_LE ( value );
+}
+
+static inline gdouble get_f64 ( const guint8 *p )
+{
+  guint64 bits = get_u64 ( p );
+  gdouble value;
+  memcpy ( &value, &bits, 8 );
+  return value;
+}
+
+/*
+ * For reading through the small parts, where the size is checked once at the end
+ */
+typedef struct {
+  const guint8 *pos;
+  const guint8 *end;
+  gboolean overrun;
+} Cursor;
+
+static gboolean cursor_has ( Cursor *cur, guint64 len )
+{
+  if ( cur->overrun || (guint64)(cur->end - cur->pos) < len ) {
+    cur->overrun = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static guint32 cursor_u32 ( Cursor *cur )
+{
+  if ( !cursor_has ( cur, 4 ) )
+    return 0;
+  guint32 value = get_u32 ( cur->pos );
+  cur->pos += 4;
+  return value;
+}
+
+static gdouble cursor_f64 ( Cursor *cur )
+{
+  if ( !cursor_has ( cur, 8 ) )
+    return NAN;
+  gdouble value = get_f64 ( cur->pos );
+  cur->pos += 8;
+  return value;
+}
+
+/*
+ * Returns: A newly allocated string
+ */
+static gchar *cursor_string ( Cursor *cur )
+{
+  guint32 len = cursor_u32 ( cur );
+  if ( !cursor_has ( cur, len ) )
+    return g_strdup ( "" );
+  gchar *str = g_strndup ( (const gchar*)cur->pos, len );
+  cur->pos += len;
+  return str;
+}
+
+typedef struct {
+  const guint8 *data;
+  guint64 size;
+} Section;
+
+typedef struct {
+  const Section *section;
+  guint32 n_rows;
+  guint32 n_columns;
+  const gchar *strings;
+  guint64 strings_size;
+} Columns;
+
+static gboolean columns_init ( Columns *cols, const Section *section )
+{
+  cols->section = section;
+  cols->strings = NULL;
+  cols->strings_size = 0;
+  if ( section->size < 8 )
+    return FALSE;
+  cols->n_rows = get_u32 ( section->data );
+  cols->n_columns = get_u32 ( section->data + 4 );
+  if ( (section->size - 8) / COLUMN_ENTRY_SIZE < cols->n_columns )
+    return FALSE;
+  return TRUE;
+}
+
+/*
+ * Returns: The start of the column, or NULL if there is no such column of the expected width
+ */
+static const guint8 *columns_get ( const Columns *cols, guint32 id, guint32 width, guint64 *size )
+{
+  const guint8 *entry = cols->section->data + 8;
+  for ( guint cc = 0; cc < cols->n_columns; cc++, entry += COLUMN_ENTRY_SIZE ) {
+    if ( get_u32 ( entry ) != id )
+      continue;
+    guint64 offset = get_u64 ( entry + 8 );
+    guint64 len = get_u64 ( entry + 16 );
+    if ( get_u32 ( entry + 4 ) != width ||
+         offset > cols->section->size || len > cols->section->size - offset ||
+         (width && len < (guint64)width * cols->n_rows) ) {
+      g_warning ( "%s: Invalid column %d", __FUNCTION__, id );
+      return NULL;
+    }
+    if ( size )
+      *size = len;
+    return cols->section->data + offset;
+  }
+  return NULL;
+}
+
+static void columns_init_strings ( Columns *cols )
+{
+  guint64 size = 0;
+  const guint8 *strings = columns_get ( cols, COLUMN_STRINGS, 0, &size );
+  // Every string must end within the column
+  if ( strings && size && strings[size-1] == '\0' ) {
+    cols->strings = (const gchar*)strings;
+    cols->strings_size = size;
+  }
+}
+
+static inline const gchar *columns_string ( const Columns *cols, const guint8 *column, guint32 row )
+{
+  if ( !column )
+    return NULL;
+  guint32 offset = get_u32 ( column + 4 * (gsize)row );
+  if ( offset >= cols->strings_size )
+    return NULL;
+  return cols->strings + offset;
+}
+
+static inline gdouble columns_f64 ( const guint8 *column, guint32 row, gdouble missing )
+{
+  return column ? get_f64 ( column + 8 * (gsize)row ) : missing;
+}
+
+static inline guint32 columns_u32 ( const guint8 *column, guint32 row, guint32 missing )
+{
+  return column ? get_u32 ( column + 4 * (gsize)row ) : missing;
+}
+
+static gboolean read_waypoints ( VikTrwLayer *vtl, const Section *section, const gchar *dirpath )
+{
+  Columns cols;
+  if ( !columns_init ( &cols, section ) )
+    return FALSE;
+  columns_init_strings ( &cols );
+  const guint8 *flags = columns_get ( &cols, COLUMN_FLAGS, 4, NULL );
+  const guint8 *lat = columns_get ( &cols, COLUMN_LATITUDE, 8, NULL );
+  const guint8 *lon = columns_get ( &cols, COLUMN_LONGITUDE, 8, NULL );
+  const guint8 *alt = columns_get ( &cols, COLUMN_ALTITUDE, 8, NULL );
+  const guint8 *timestamp = columns_get ( &cols, COLUMN_TIMESTAMP, 8, NULL );
+  const guint8 *image_direction = columns_get ( &cols, COLUMN_IMAGE_DIRECTION, 8, NULL );
+  const guint8 *image_direction_ref = columns_get ( &cols, COLUMN_IMAGE_DIRECTION_REF, 4, NULL );
+  const guint8 *name = columns_get ( &cols, COLUMN_NAME, 4, NULL );
+  const guint8 *comment = columns_get ( &cols, COLUMN_COMMENT, 4, NULL );
+  const guint8 *description = columns_get ( &cols, COLUMN_DESCRIPTION, 4, NULL );
+  const guint8 *source = columns_get ( &cols, COLUMN_SOURCE, 4, NULL );
+  const guint8 *type = columns_get ( &cols, COLUMN_TYPE, 4, NULL );
+  const guint8 *image = columns_get ( &cols, COLUMN_IMAGE, 4, NULL );
+  const guint8 *symbol = columns_get ( &cols, COLUMN_SYMBOL, 4, NULL );
+
+  VikCoordMode coord_mode = vik_trw_layer_get_coord_mode ( vtl );
+  for ( guint32 ii = 0; ii < cols.n_rows; ii++ ) {
+    const gchar *wp_name = columns_string ( &cols, name, ii );
+    if ( !wp_name )
+      continue;
+    VikWaypoint *wp = vik_waypoint_new ();
+    wp->visible = columns_u32 ( flags, ii, FLAG_VISIBLE ) & FLAG_VISIBLE;
+    wp->altitude = columns_f64 ( alt, ii, NAN );
+    wp->timestamp = columns_f64 ( timestamp, ii, NAN );
+    struct LatLon ll = { columns_f64 ( lat, ii, 0.0 ), columns_f64 ( lon, ii, 0.0 ) };
+    vik_coord_load_from_latlon ( &wp->coord, coord_mode, &ll );
+
+    vik_trw_layer_filein_add_waypoint ( vtl, (gchar*)wp_name, wp );
+
+    const gchar *str;
+    if ( (str = columns_string ( &cols, comment, ii )) )
+      vik_waypoint_set_comment ( wp, str );
+    if ( (str = columns_string ( &cols, description, ii )) )
+      vik_waypoint_set_description ( wp, str );
+    if ( (str = columns_string ( &cols, source, ii )) )
+      vik_waypoint_set_source ( wp, str );
+    if ( (str = columns_string ( &cols, type, ii )) )
+      vik_waypoint_set_type ( wp, str );
+    if ( (str = columns_string ( &cols, image, ii )) ) {
+      gchar *fn = util_make_absolute_filename ( str, dirpath );
+      vik_waypoint_set_image ( wp, fn ? fn : str );
+      g_free ( fn );
+    }
+    gdouble direction = columns_f64 ( image_direction, ii, NAN );
+    if ( !isnan(direction) ) {
+      wp->image_direction = direction;
+      wp->image_direction_ref = columns_u32 ( image_direction_ref, ii, WP_IMAGE_DIRECTION_REF_TRUE );
+    }
+    if ( (str = columns_string ( &cols, symbol, ii )) )
+      vik_waypoint_set_symbol ( wp, str );
+  }
+  return TRUE;
+}
+
+static gboolean read_tracks ( VikTrwLayer *vtl, const Section *section, const Section *points )
+{
+  Columns cols;
+  if ( !columns_init ( &cols, section ) )
+    return FALSE;
+  columns_init_strings ( &cols );
+  const guint8 *flags = columns_get ( &cols, COLUMN_FLAGS, 4, NULL );
+  const guint8 *n_points = columns_get ( &cols, COLUMN_N_POINTS, 4, NULL );
+  const guint8 *color = columns_get ( &cols, COLUMN_COLOR, 8, NULL );
+  const guint8 *draw_name_mode = columns_get ( &cols, COLUMN_DRAW_NAME_MODE, 4, NULL );
+  const guint8 *dist_labels = columns_get ( &cols, COLUMN_DIST_LABELS, 4, NULL );
+  const guint8 *name = columns_get ( &cols, COLUMN_NAME, 4, NULL );
+  const guint8 *comment = columns_get ( &cols, COLUMN_COMMENT, 4, NULL );
+  const guint8 *description = columns_get ( &cols, COLUMN_DESCRIPTION, 4, NULL );
+  const guint8 *source = columns_get ( &cols, COLUMN_SOURCE, 4, NULL );
+  const guint8 *type = columns_get ( &cols, COLUMN_TYPE, 4, NULL );
+
+  Columns tps;
+  gboolean have_points = points && columns_init ( &tps, points );
+  const guint8 *tp_flags = NULL, *tp_lat = NULL, *tp_lon = NULL, *tp_alt = NULL, *tp_timestamp = NULL;
+  const guint8 *tp_speed = NULL, *tp_course = NULL, *tp_hdop = NULL, *tp_vdop = NULL, *tp_pdop = NULL;
+  const guint8 *tp_nsats = NULL, *tp_fix = NULL, *tp_name = NULL;
+  if ( have_points ) {
+    columns_init_strings ( &tps );
+    tp_flags = columns_get ( &tps, COLUMN_FLAGS, 4, NULL );
+    tp_lat = columns_get ( &tps, COLUMN_LATITUDE, 8, NULL );
+    tp_lon = columns_get ( &tps, COLUMN_LONGITUDE, 8, NULL );
+    tp_alt = columns_get ( &tps, COLUMN_ALTITUDE, 8, NULL );
+    tp_timestamp = columns_get ( &tps, COLUMN_TIMESTAMP, 8, NULL );
+    tp_speed = columns_get ( &tps, COLUMN_SPEED, 8, NULL );
+    tp_course = columns_get ( &tps, COLUMN_COURSE, 8, NULL );
+    tp_hdop = columns_get ( &tps, COLUMN_HDOP, 8, NULL );
+    tp_vdop = columns_get ( &tps, COLUMN_VDOP, 8, NULL );
+    tp_pdop = columns_get ( &tps, COLUMN_PDOP, 8, NULL );
+    tp_nsats = columns_get ( &tps, COLUMN_NSATS, 4, NULL );
+    tp_fix = columns_get ( &tps, COLUMN_FIX, 4, NULL );
+    tp_name = columns_get ( &tps, COLUMN_NAME, 4, NULL );
+  }
+
+  VikCoordMode coord_mode = vik_trw_layer_get_coord_mode ( vtl );
+  gboolean success = TRUE;
+  guint32 next_point = 0;
+  for ( guint32 tt = 0; tt < cols.n_rows; tt++ ) {
+    guint32 n_tps = columns_u32 ( n_points, tt, 0 );
+    guint32 first = next_point;
+    if ( n_tps && (!have_points || n_tps > tps.n_rows - first) ) {
+      g_warning ( "%s: More trackpoints than stored", __FUNCTION__ );
+      success = FALSE;
+      n_tps = 0;
+    }
+    next_point += n_tps;
+
+    const gchar *trk_name = columns_string ( &cols, name, tt );
+    if ( !trk_name )
+      continue;
+
+    VikTrack *trk = vik_track_new ();
+    guint32 trk_flags = columns_u32 ( flags, tt, FLAG_VISIBLE );
+    trk->visible = trk_flags & FLAG_VISIBLE;
+    trk->is_route = (trk_flags & FLAG_IS_ROUTE) != 0;
+    if ( trk_flags & FLAG_HAS_COLOR ) {
+      guint64 rgb = color ? get_u64 ( color + 8 * (gsize)tt ) : 0;
+      trk->has_color = TRUE;
+      trk->color.red = rgb & 0xffff;
+      trk->color.green = (rgb >> 16) & 0xffff;
+      trk->color.blue = (rgb >> 32) & 0xffff;
+    }
+    trk->draw_name_mode = columns_u32 ( draw_name_mode, tt, 0 );
+    trk->max_number_dist_labels = columns_u32 ( dist_labels, tt, 0 );
+
+    const gchar *str;
+    if ( (str = columns_string ( &cols, comment, tt )) )
+      vik_track_set_comment ( trk, str );
+    if ( (str = columns_string ( &cols, description, tt )) )
+      vik_track_set_description ( trk, str );
+    if ( (str = columns_string ( &cols, source, tt )) )
+      vik_track_set_source ( trk, str );
+    if ( (str = columns_string ( &cols, type, tt )) )
+      vik_track_set_type ( trk, str );
+
+    GList *tpl = NULL;
+    for ( guint32 pp = first + n_tps; pp > first; ) {
+      pp--;
+      VikTrackpoint *tp = vik_trackpoint_new ();
+      struct LatLon ll = { columns_f64 ( tp_lat, pp, 0.0 ), columns_f64 ( tp_lon, pp, 0.0 ) };
+      vik_coord_load_from_latlon ( &tp->coord, coord_mode, &ll );
+      tp->newsegment = (columns_u32 ( tp_flags, pp, 0 ) & FLAG_NEWSEGMENT) != 0;
+      tp->altitude = columns_f64 ( tp_alt, pp, NAN );
+      tp->timestamp = columns_f64 ( tp_timestamp, pp, NAN );
+      tp->speed = columns_f64 ( tp_speed, pp, NAN );
+      tp->course = columns_f64 ( tp_course, pp, NAN );
+      tp->hdop = columns_f64 ( tp_hdop, pp, NAN );
+      tp->vdop = columns_f64 ( tp_vdop, pp, NAN );
+      tp->pdop = columns_f64 ( tp_pdop, pp, NAN );
+      tp->nsats = columns_u32 ( tp_nsats, pp, 0 );
+      tp->fix_mode = columns_u32 ( tp_fix, pp, VIK_GPS_MODE_NOT_SEEN );
+      if ( (str = columns_string ( &tps, tp_name, pp )) )
+        vik_trackpoint_set_name ( tp, str );
+      tpl = g_list_prepend ( tpl, tp );
+    }
+    trk->trackpoints = tpl;
+
+    vik_trw_layer_filein_add_track ( vtl, (gchar*)trk_name, trk );
+  }
+  return success;
+}
+
+/*
+ * Give the text form of the layer data to the layer to read
+ */
+static gboolean read_layer_data_text ( VikLayer *vl, const Section *section, const gchar *dirpath )
+{
+  static const gchar end[] = "~EndLayerData\n";
+  GByteArray *ba = g_byte_array_sized_new ( section->size + sizeof(end) );
+  g_byte_array_append ( ba, section->data, section->size );
+  g_byte_array_append ( ba, (const guint8*)end, strlen(end) );
+  gchar *tmpname = util_write_tmp_file_from_bytes ( ba->data, ba->len );
+  g_byte_array_free ( ba, TRUE );
+  if ( !tmpname )
+    return FALSE;
+
+  gboolean success = FALSE;
+  FILE *tmp = g_fopen ( tmpname, "rb" );
+  if ( tmp ) {
+    success = vik_layer_get_interface(vl->type)->read_file_data ( vl, tmp, dirpath );
+    fclose ( tmp );
+  }
+  util_remove ( tmpname );
+  g_free ( tmpname );
+  return success;
+}
+
+static VikLayerParamData cursor_param_value ( Cursor *cur, VikLayerParamType type, gchar **str )
+{
+  VikLayerParamData data;
+  memset ( &data, 0, sizeof(data) );
+  switch ( type ) {
+    case VIK_LAYER_PARAM_DOUBLE: data.d = cursor_f64 ( cur ); break;
+    case VIK_LAYER_PARAM_UINT: data.u = cursor_u32 ( cur ); break;
+    case VIK_LAYER_PARAM_INT: data.i = (gint32)cursor_u32 ( cur ); break;
+    case VIK_LAYER_PARAM_BOOLEAN: data.b = cursor_u32 ( cur ) != 0; break;
+    case VIK_LAYER_PARAM_STRING:
+      *str = cursor_string ( cur );
+      data.s = *str;
+      break;
+    case VIK_LAYER_PARAM_COLOR:
+      data.c.red = cursor_u32 ( cur );
+      data.c.green = cursor_u32 ( cur );
+      data.c.blue = cursor_u32 ( cur );
+      break;
+    case VIK_LAYER_PARAM_STRING_LIST: {
+      guint32 n = cursor_u32 ( cur );
+      for ( guint32 ii = 0; ii < n && !cur->overrun; ii++ )
+        data.sl = g_list_prepend ( data.sl, cursor_string ( cur ) );
+      data.sl = g_list_reverse ( data.sl );
+      break;
+    }
+    default:
+      cur->overrun = TRUE;
+      break;
+  }
+  return data;
+}
+
+static void free_string_list ( GList *sl )
+{
+  g_list_free_full ( sl, g_free );
+}
+
+/*
+ * Set the parameters of a layer, as done for the text form
+ */
+static gboolean read_layer_params ( VikLayer *vl, Cursor *cur, VikViewport *vp, const gchar *dirpath )
+{
+  VikLayerInterface *vli = vik_layer_get_interface ( vl->type );
+  guint32 count = cursor_u32 ( cur );
+  for ( guint32 nn = 0; nn < count && !cur->overrun; nn++ ) {
+    VikLayerParamType type = cursor_u32 ( cur );
+    gchar *name = cursor_string ( cur );
+    gchar *str = NULL;
+    VikLayerParamData data = cursor_param_value ( cur, type, &str );
+
+    guint16 ii;
+    for ( ii = 0; ii < vli->params_count; ii++ )
+      if ( g_ascii_strcasecmp ( vli->params[ii].name, name ) == 0 )
+        break;
+    if ( ii < vli->params_count && vli->params[ii].type == type && !cur->overrun ) {
+      VikLayerSetParam vlsp;
+      vlsp.id                  = ii;
+      vlsp.data                = data;
+      vlsp.vp                  = vp;
+      vlsp.is_file_operation   = TRUE;
+      vlsp.dirpath             = dirpath;
+      vik_layer_set_param ( vl, &vlsp );
+      // The layer takes over the list
+      data.sl = NULL;
+    }
+    else
+      g_warning ( "%s: Unknown parameter %s", __FUNCTION__, name );
+
+    if ( type == VIK_LAYER_PARAM_STRING_LIST )
+      free_string_list ( data.sl );
+    g_free ( str );
+    g_free ( name );
+  }
+  return !cur->overrun;
+}
+
+static gboolean read_viewport ( VikAggregateLayer *top, const Section *section, VikViewport *vp, struct LatLon *ll )
+{
+  Cursor cur = { section->data, section->data + section->size, FALSE };
+  guint32 count = cursor_u32 ( &cur );
+  gboolean success = TRUE;
+  for ( guint32 nn = 0; nn < count && !cur.overrun; nn++ ) {
+    VikLayerParamType type = cursor_u32 ( &cur );
+    gchar *name = cursor_string ( &cur );
+    gchar *str = NULL;
+    VikLayerParamData data = cursor_param_value ( &cur, type, &str );
+    if ( cur.overrun )
+      ;
+    else if ( type == VIK_LAYER_PARAM_DOUBLE && g_strcmp0 ( name, "xmpp" ) == 0 )
+      vik_viewport_set_xmpp ( vp, data.d );
+    else if ( type == VIK_LAYER_PARAM_DOUBLE && g_strcmp0 ( name, "ympp" ) == 0 )
+      vik_viewport_set_ympp ( vp, data.d );
+    else if ( type == VIK_LAYER_PARAM_DOUBLE && g_strcmp0 ( name, "lat" ) == 0 )
+      ll->lat = data.d;
+    else if ( type == VIK_LAYER_PARAM_DOUBLE && g_strcmp0 ( name, "lon" ) == 0 )
+      ll->lon = data.d;
+    else if ( type == VIK_LAYER_PARAM_STRING && g_strcmp0 ( name, "mode" ) == 0 ) {
+      if ( g_ascii_strcasecmp ( data.s, "utm" ) == 0 )
+        vik_viewport_set_drawmode ( vp, VIK_VIEWPORT_DRAWMODE_UTM );
+      else if ( g_ascii_strcasecmp ( data.s, "expedia" ) == 0 )
+        vik_viewport_set_drawmode ( vp, VIK_VIEWPORT_DRAWMODE_EXPEDIA );
+      else if ( g_ascii_strcasecmp ( data.s, "mercator" ) == 0 )
+        vik_viewport_set_drawmode ( vp, VIK_VIEWPORT_DRAWMODE_MERCATOR );
+      else if ( g_ascii_strcasecmp ( data.s, "latlon" ) == 0 )
+        vik_viewport_set_drawmode ( vp, VIK_VIEWPORT_DRAWMODE_LATLON );
+      else
+        success = FALSE;
+    }
+    else if ( type == VIK_LAYER_PARAM_STRING && g_strcmp0 ( name, "color" ) == 0 )
+      vik_viewport_set_background_color ( vp, data.s );
+    else if ( type == VIK_LAYER_PARAM_STRING && g_strcmp0 ( name, "highlightcolor" ) == 0 )
+      vik_viewport_set_highlight_color ( vp, data.s );
+    else if ( type == VIK_LAYER_PARAM_BOOLEAN && g_strcmp0 ( name, "drawscale" ) == 0 )
+      vik_viewport_set_draw_scale ( vp, data.b );
+    else if ( type == VIK_LAYER_PARAM_BOOLEAN && g_strcmp0 ( name, "drawcentermark" ) == 0 )
+      vik_viewport_set_draw_centermark ( vp, data.b );
+    else if ( type == VIK_LAYER_PARAM_BOOLEAN && g_strcmp0 ( name, "drawhighlight" ) == 0 )
+      vik_viewport_set_draw_highlight ( vp, data.b );
+    else if ( type == VIK_LAYER_PARAM_BOOLEAN && g_strcmp0 ( name, "visible" ) == 0 )
+      VIK_LAYER(top)->visible = data.b;
+    else
+      g_warning ( "%s: Unknown viewport setting %s", __FUNCTION__, name );
+
+    if ( type == VIK_LAYER_PARAM_STRING_LIST )
+      free_string_list ( data.sl );
+    g_free ( str );
+    g_free ( name );
+  }
+  return success && !cur.overrun;
+}
+
+typedef struct {
+  VikAggregateLayer *top;
+  VikViewport *vp;
+  const gchar *dirpath;
+  GPtrArray *layers;  /* By layer index, NULL for those not read */
+  GArray *parents;    /* By layer index */
+  GArray *open;       /* Indices of the layers not yet added to their parents */
+} BinaryReader;
+
+static VikLayer *reader_get_layer ( BinaryReader *br, guint32 index )
+{
+  if ( index == NO_LAYER )
+    return VIK_LAYER(br->top);
+  if ( index >= br->layers->len )
+    return NULL;
+  return g_ptr_array_index ( br->layers, index );
+}
+
+/*
+ * As at the end of a layer in the text form
+ */
+static gboolean reader_close_layer ( BinaryReader *br )
+{
+  guint32 index = g_array_index ( br->open, guint32, br->open->len-1 );
+  g_array_set_size ( br->open, br->open->len-1 );
+
+  VikLayer *vl = reader_get_layer ( br, index );
+  VikLayer *parent = reader_get_layer ( br, g_array_index ( br->parents, guint32, index ) );
+  if ( !vl || !parent )
+    return TRUE;
+  if ( parent->type == VIK_LAYER_AGGREGATE ) {
+    vik_aggregate_layer_add_layer ( VIK_AGGREGATE_LAYER(parent), vl, FALSE );
+    vik_layer_post_read ( vl, br->vp, TRUE );
+  }
+  else if ( parent->type != VIK_LAYER_GPS ) {
+    g_warning ( "%s: Layer inside non-Aggregate Layer (type %d)", __FUNCTION__, parent->type );
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean reader_open_layer ( BinaryReader *br, const Section *section )
+{
+  gboolean success = TRUE;
+  Cursor cur = { section->data, section->data + section->size, FALSE };
+  guint32 parent_index = cursor_u32 ( &cur );
+  gboolean visible = cursor_u32 ( &cur ) != 0;
+  gchar *type_name = cursor_string ( &cur );
+  gchar *name = cursor_string ( &cur );
+
+  // Layers come straight after their parent or their siblings
+  while ( br->open->len && g_array_index ( br->open, guint32, br->open->len-1 ) != parent_index )
+    if ( !reader_close_layer ( br ) )
+      success = FALSE;
+
+  VikLayer *parent = NULL;
+  if ( parent_index == NO_LAYER || br->open->len )
+    parent = reader_get_layer ( br, parent_index );
+
+  VikLayer *vl = NULL;
+  if ( parent && (parent->type == VIK_LAYER_AGGREGATE || parent->type == VIK_LAYER_GPS) ) {
+    VikLayerTypeEnum type = vik_layer_type_from_string ( type_name );
+    if ( type == VIK_LAYER_NUM_TYPES ) {
+      g_warning ( "%s: Unknown type %s", __FUNCTION__, type_name );
+      success = FALSE;
+    }
+    else if ( parent->type == VIK_LAYER_GPS )
+      vl = VIK_LAYER(vik_gps_layer_get_a_child ( VIK_GPS_LAYER(parent) ));
+    else
+      vl = vik_layer_create ( type, br->vp, FALSE );
+  }
+  else {
+    g_warning ( "%s: Layer inside non-Aggregate Layer", __FUNCTION__ );
+    success = FALSE;
+  }
+
+  if ( vl ) {
+    if ( !read_layer_params ( vl, &cur, br->vp, br->dirpath ) )
+      success = FALSE;
+    vik_layer_rename ( vl, name );
+    vl->visible = visible;
+  }
+
+  g_ptr_array_add ( br->layers, vl );
+  g_array_append_val ( br->parents, parent_index );
+  guint32 index = br->layers->len - 1;
+  g_array_append_val ( br->open, index );
+
+  g_free ( type_name );
+  g_free ( name );
+  return success;
+}
+
+/**
+ * a_file_binary_read:
+ * @f: The file is memory mapped when possible, otherwise it is read through
+ *
+ * Read a file written by a_file_binary_write()
+ *
+ * Returns: Whether everything was read, although as for the text form,
+ *  whatever could be read is still added
+ */
+gboolean a_file_binary_read ( VikAggregateLayer *top, const gchar *filename, FILE *f, const gchar *dirpath, VikViewport *vp )
+{
+  GMappedFile *mf = NULL;
+  gchar *contents = NULL;
+  gsize size = 0;
+#if GLIB_CHECK_VERSION(2,32,0)
+  // Map what is actually being read, as the name may not be that of the data (e.g. once decompressed)
+  GStatBuf st;
+  int fd = fileno ( f );
+  if ( fd >= 0 && fstat ( fd, &st ) == 0 && S_ISREG(st.st_mode) )
+    mf = g_mapped_file_new_from_fd ( fd, FALSE, NULL );
+#else
+  if ( filename && strcmp ( filename, "-" ) )
+    mf = g_mapped_file_new ( filename, FALSE, NULL );
+#endif
+  if ( mf ) {
+    contents = g_mapped_file_get_contents ( mf );
+    size = g_mapped_file_get_length ( mf );
+  }
+  else {
+    GByteArray *ba = g_byte_array_new ();
+    guint8 buffer[65536];
+    gsize len;
+    while ( (len = fread ( buffer, 1, sizeof(buffer), f )) > 0 )
+      g_byte_array_append ( ba, buffer, len );
+    size = ba->len;
+    contents = (gchar*)g_byte_array_free ( ba, FALSE );
+  }
+  const guint8 *data = (const guint8*)contents;
+
+  gboolean success = FALSE;
+  if ( size < HEADER_SIZE + TRAILER_SIZE || memcmp ( data, VIK_BINARY_MAGIC, VIK_BINARY_MAGIC_LEN ) ) {
+    g_warning ( "%s: Not a binary Viking file", __FUNCTION__ );
+    goto done;
+  }
+  guint32 version = get_u32 ( data + 8 );
+  g_debug ( "%s: reading file version %d", __FUNCTION__, version );
+  guint64 table = get_u64 ( data + size - TRAILER_SIZE );
+  guint32 n_sections = get_u32 ( data + size - TRAILER_SIZE + 8 );
+  if ( table > size - TRAILER_SIZE || (size - TRAILER_SIZE - table) / TABLE_ENTRY_SIZE < n_sections ) {
+    g_warning ( "%s: Invalid section table", __FUNCTION__ );
+    goto done;
+  }
+
+  BinaryReader br;
+  br.top = top;
+  br.vp = vp;
+  br.dirpath = dirpath;
+  br.layers = g_ptr_array_new ();
+  br.parents = g_array_new ( FALSE, FALSE, sizeof(guint32) );
+  br.open = g_array_new ( FALSE, FALSE, sizeof(guint32) );
+  struct LatLon ll = { 0.0, 0.0 };
+  // Newer versions may hold things which can not be read, but still read what can be
+  success = version <= BINARY_VERSION;
+
+  Section points = { NULL, 0 };
+  guint32 points_layer = NO_LAYER;
+  for ( guint32 ss = 0; ss < n_sections; ss++ ) {
+    const guint8 *entry = data + table + (gsize)ss * TABLE_ENTRY_SIZE;
+    guint32 kind = get_u32 ( entry );
+    guint32 layer_index = get_u32 ( entry + 4 );
+    Section section;
+    guint64 offset = get_u64 ( entry + 8 );
+    section.size = get_u64 ( entry + 16 );
+    if ( offset > table || section.size > table - offset ) {
+      g_warning ( "%s: Invalid section %d", __FUNCTION__, ss );
+      success = FALSE;
+      continue;
+    }
+    section.data = data + offset;
+
+    VikLayer *vl = NULL;
+    if ( layer_index != NO_LAYER ) {
+      vl = reader_get_layer ( &br, layer_index );
+      // Data is only for the most recent layer
+      if ( layer_index != br.layers->len-1 )
+        vl = NULL;
+    }
+
+    switch ( kind ) {
+      case SECTION_VIEWPORT:
+        if ( !read_viewport ( top, &section, vp, &ll ) )
+          success = FALSE;
+        break;
+      case SECTION_LAYER:
+        if ( !reader_open_layer ( &br, &section ) )
+          success = FALSE;
+        break;
+      case SECTION_LAYER_DATA:
+        if ( vl && vik_layer_get_interface(vl->type)->read_file_data )
+          if ( !read_layer_data_text ( vl, &section, dirpath ) )
+            success = FALSE;
+        break;
+      case SECTION_WAYPOINTS:
+        if ( vl && vl->type == VIK_LAYER_TRW )
+          if ( !read_waypoints ( VIK_TRW_LAYER(vl), &section, dirpath ) )
+            success = FALSE;
+        break;
+      case SECTION_TRACKPOINTS:
+        points = section;
+        points_layer = layer_index;
+        break;
+      case SECTION_TRACKS:
+        if ( vl && vl->type == VIK_LAYER_TRW )
+          if ( !read_tracks ( VIK_TRW_LAYER(vl), &section, points_layer == layer_index ? &points : NULL ) )
+            success = FALSE;
+        break;
+      default:
+        break;
+    }
+  }
+
+  while ( br.open->len )
+    if ( !reader_close_layer ( &br ) )
+      success = FALSE;
+
+  g_ptr_array_free ( br.layers, TRUE );
+  g_array_free ( br.parents, TRUE );
+  g_array_free ( br.open, TRUE );
+
+  if ( ll.lat != 0.0 || ll.lon != 0.0 )
+    vik_viewport_set_center_latlon ( vp, &ll, TRUE );
+
+  if ( ( ! VIK_LAYER(top)->visible ) && VIK_LAYER(top)->realized )
+    vik_treeview_item_set_visible ( VIK_LAYER(top)->vt, &(VIK_LAYER(top)->iter), FALSE );
+
+ done:
+  if ( mf )
+    g_mapped_file_unref ( mf );
+  else
+    g_free ( contents );
+  return success;
+}
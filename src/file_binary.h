@@ -0,0 +1,46 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef _VIKING_FILE_BINARY_H
+#define _VIKING_FILE_BINARY_H
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "vikaggregatelayer.h"
+#include "vikviewport.h"
+
+G_BEGIN_DECLS
+
+/**
+ * The binary form of a Viking file holds the same as the text form,
+ *  but with the tracks and waypoints of each TrackWaypoint layer stored in columns
+ *  so that it can be read straight from a memory mapping of the file.
+ *
+ * Like PNG, the magic detects files damaged by line ending or 7 bit conversions.
+ */
+#define VIK_BINARY_MAGIC "\211VIK\r\n\032\n"
+#define VIK_BINARY_MAGIC_LEN 8
+
+void a_file_binary_write ( VikAggregateLayer *top, FILE *f, VikViewport *vp, const gchar *dirpath );
+
+gboolean a_file_binary_read ( VikAggregateLayer *top, const gchar *filename, FILE *f, const gchar *dirpath, VikViewport *vp );
+
+G_END_DECLS
+
+#endif
@@ -338,6 +338,8 @@ static struct {
 
 static GHashTable *icons = NULL;
 static GHashTable *old_icons = NULL;
+// Waypoint symbols are looked up when files are read in background threads
+G_LOCK_DEFINE_STATIC(icons);
 
 static gboolean str_equal_casefold ( gconstpointer v1, gconstpointer v2 ) {
   gboolean equal;
@@ -412,37 +414,41 @@ static GdkPixbuf *get_wp_sym_from_index ( gint i ) {
 GdkPixbuf *a_get_wp_sym ( const gchar *sym ) {
   gpointer gp;
   gpointer x;
+  GdkPixbuf *icon = NULL;
 
   if (!sym) {
     return NULL;
   }
+  G_LOCK(icons);
   if (!icons) {
     init_icons();
   }
   if (g_hash_table_lookup_extended(icons, sym, &x, &gp))
-    return get_wp_sym_from_index(GPOINTER_TO_INT(gp));
+    icon = get_wp_sym_from_index(GPOINTER_TO_INT(gp));
   else if (g_hash_table_lookup_extended(old_icons, sym, &x, &gp))
-    return get_wp_sym_from_index(GPOINTER_TO_INT(gp));
-  else
-    return NULL;
+    icon = get_wp_sym_from_index(GPOINTER_TO_INT(gp));
+  G_UNLOCK(icons);
+  return icon;
 }
 
 const gchar *a_get_hashed_sym ( const gchar *sym ) {
   gpointer gp;
   gpointer x;
+  const gchar *hashed_sym = NULL;
 
   if (!sym) {
     return NULL;
   }
+  G_LOCK(icons);
   if (!icons) {
     init_icons();
   }
   if (g_hash_table_lookup_extended(icons, sym, &x, &gp))
-    return garmin_syms[GPOINTER_TO_INT(gp)].sym;
+    hashed_sym = garmin_syms[GPOINTER_TO_INT(gp)].sym;
   else if (g_hash_table_lookup_extended(old_icons, sym, &x, &gp))
-    return garmin_syms[GPOINTER_TO_INT(gp)].sym;
-  else
-    return NULL;
+    hashed_sym = garmin_syms[GPOINTER_TO_INT(gp)].sym;
+  G_UNLOCK(icons);
+  return hashed_sym;
 }
 
 void a_populate_sym_list ( GtkListStore *list ) {
@@ -451,8 +457,11 @@ void a_populate_sym_list ( GtkListStore *list ) {
     // Ensure at least one symbol available - the other can be auto generated
     if ( garmin_syms[i].data || garmin_syms[i].data_large ) {
       GtkTreeIter iter;
+      G_LOCK(icons);
+      GdkPixbuf *icon = get_wp_sym_from_index(i);
+      G_UNLOCK(icons);
       gtk_list_store_append(list, &iter);
-      gtk_list_store_set(list, &iter, 0, garmin_syms[i].sym, 1, get_wp_sym_from_index(i), -1);
+      gtk_list_store_set(list, &iter, 0, garmin_syms[i].sym, 1, icon, -1);
     }
   }
 }
@@ -462,10 +471,12 @@ void a_populate_sym_list ( GtkListStore *list ) {
 void clear_garmin_icon_syms () {
   g_debug("garminsymbols: clear_garmin_icon_syms");
   gint i;
+  G_LOCK(icons);
   for (i=0; i<G_N_ELEMENTS(garmin_syms); i++) {
     if (garmin_syms[i].icon) {
       g_object_unref (garmin_syms[i].icon);
       garmin_syms[i].icon = NULL;
     }
   }
+  G_UNLOCK(icons);
 }
@@ -23,166 +23,756 @@
  */
 
 #include "geojson.h"
-#include "gpx.h"
 #include "globals.h"
-#include "vikwindow.h"
+#include "coords.h"
+#include "util.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <glib.h>
-#include <glib/gstdio.h>
-#include <glib/gi18n.h>
 
-/**
- * Perform any cleanup actions once program has completed running
+/*
+ * GeoJSON is read and written here directly, a feature at a time,
+ *  so that memory use depends on the largest feature rather than on the whole file.
+ *
+ * Point and MultiPoint features become waypoints,
+ *  LineString and MultiLineString features become tracks (each line being a segment).
+ * Other geometries are ignored.
+ *
+ * Of the properties, 'name', 'desc', 'cmt' and 'time' are used,
+ *  plus 'coordTimes' for the times of track points as written by togeojson.
  */
-static void my_watch ( GPid pid,
-                       gint status,
-                       gpointer user_data )
+
+/* Amount of the file read in at once */
+#define GEOJSON_READ_SIZE (64*1024)
+
+/* Deepest nesting of values skipped over */
+#define GEOJSON_MAX_DEPTH 512
+
+typedef struct {
+	gdouble lon;
+	gdouble lat;
+	gdouble alt;
+	gboolean new_part; // First position of a line
+} geojson_position_t;
+
+typedef struct {
+	FILE *f;
+	gchar buf[GEOJSON_READ_SIZE];
+	gsize pos;
+	gsize len;
+	gboolean error;
+	GString *key;
+	GString *str;
+	VikTrwLayer *vtl;
+	guint unnamed_waypoints;
+	guint unnamed_tracks;
+	// The feature being read
+	GString *geometry_type;
+	GArray *positions;
+	gboolean new_part;
+	GArray *times;
+	gdouble time;
+	gchar *name;
+	gchar *comment;
+	gchar *description;
+} geojson_reader_t;
+
+static gint gr_getc ( geojson_reader_t *gr )
 {
-	g_spawn_close_pid ( pid );
+	if ( gr->pos == gr->len ) {
+		gr->len = fread ( gr->buf, 1, sizeof(gr->buf), gr->f );
+		gr->pos = 0;
+		if ( !gr->len )
+			return EOF;
+	}
+	return (guchar)gr->buf[gr->pos++];
 }
 
-/**
- * a_geojson_write_file:
- *
- * Returns TRUE if successfully written
+/*
+ * The next character that is not white space, which is left to be read
  */
-gboolean a_geojson_write_file ( VikTrwLayer *vtl, FILE *ff )
+static gint gr_peek ( geojson_reader_t *gr )
 {
-	gboolean result = FALSE;
+	gint c;
+	while ( (c = gr_getc ( gr )) != EOF && g_ascii_isspace ( c ) )
+		;
+	if ( c != EOF )
+		gr->pos--;
+	return c;
+}
 
-	gchar *tmp_filename = a_gpx_write_tmp_file ( vtl, NULL );
-	if ( !tmp_filename )
-		return result;
+static gboolean gr_expect ( geojson_reader_t *gr, gchar expected )
+{
+	if ( gr_peek ( gr ) == expected ) {
+		gr->pos++;
+		return TRUE;
+	}
+	gr->error = TRUE;
+	return FALSE;
+}
 
-	GPid pid;
-	gint mystdout;
+static gint gr_hex4 ( geojson_reader_t *gr )
+{
+	gint value = 0;
+	for ( guint ii = 0; ii < 4; ii++ ) {
+		gint c = gr_getc ( gr );
+		if ( c == EOF || !g_ascii_isxdigit ( c ) )
+			return -1;
+		value = value * 16 + g_ascii_xdigit_value ( c );
+	}
+	return value;
+}
 
-	// geojson program should be on the $PATH
-	gchar **argv;
-	argv = g_new (gchar*, 5);
-	argv[0] = g_strdup (a_geojson_program_export());
-	argv[1] = g_strdup ("-f");
-	argv[2] = g_strdup ("gpx");
-	argv[3] = g_strdup (tmp_filename);
-	argv[4] = NULL;
+static gboolean gr_string ( geojson_reader_t *gr, GString *str )
+{
+	g_string_truncate ( str, 0 );
+	if ( !gr_expect ( gr, '"' ) )
+		return FALSE;
 
-	GError *error = NULL;
-	// TODO: monitor stderr?
-	if (!g_spawn_async_with_pipes (NULL, argv, NULL, (GSpawnFlags) G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL, &mystdout, NULL, &error)) {
+	while ( TRUE ) {
+		// Copy plain runs straight from the buffer
+		gsize start = gr->pos;
+		while ( gr->pos < gr->len && gr->buf[gr->pos] != '"' && gr->buf[gr->pos] != '\\' )
+			gr->pos++;
+		g_string_append_len ( str, gr->buf + start, gr->pos - start );
 
-		if ( IS_VIK_WINDOW ((VikWindow *)VIK_GTK_WINDOW_FROM_LAYER(vtl)) ) {
-			gchar* msg = g_strdup_printf ( _("%s command failed: %s"), argv[0], error->message );
-			vik_window_statusbar_update ( (VikWindow*)VIK_GTK_WINDOW_FROM_LAYER(vtl), msg, VIK_STATUSBAR_INFO );
-			g_free (msg);
+		gint c = gr_getc ( gr );
+		if ( c == '"' )
+			return TRUE;
+		if ( c == EOF )
+			break;
+		if ( c != '\\' ) {
+			g_string_append_c ( str, c );
+			continue;
 		}
-		else
-			g_warning ("Async command failed: %s", error->message);
+		c = gr_getc ( gr );
+		switch ( c ) {
+		case '"':
+		case '\\':
+		case '/': g_string_append_c ( str, c ); break;
+		case 'b': g_string_append_c ( str, '\b' ); break;
+		case 'f': g_string_append_c ( str, '\f' ); break;
+		case 'n': g_string_append_c ( str, '\n' ); break;
+		case 'r': g_string_append_c ( str, '\r' ); break;
+		case 't': g_string_append_c ( str, '\t' ); break;
+		case 'u': {
+			gint value = gr_hex4 ( gr );
+			if ( value < 0 )
+				goto error;
+			if ( value >= 0xD800 && value < 0xDC00 ) {
+				// Characters beyond the BMP come as a pair of surrogates
+				if ( gr_getc ( gr ) != '\\' || gr_getc ( gr ) != 'u' )
+					goto error;
+				gint low = gr_hex4 ( gr );
+				if ( low < 0xDC00 || low >= 0xE000 )
+					goto error;
+				value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+			}
+			else if ( value >= 0xDC00 && value < 0xE000 )
+				value = 0xFFFD;
+			g_string_append_unichar ( str, value );
+			break;
+		}
+		default:
+			goto error;
+		}
+	}
+ error:
+	gr->error = TRUE;
+	return FALSE;
+}
 
-		g_error_free(error);
+static gboolean gr_number ( geojson_reader_t *gr, gdouble *value )
+{
+	gchar num[64];
+	guint nn = 0;
+	gint c;
+	(void)gr_peek ( gr );
+	while ( (c = gr_getc ( gr )) != EOF ) {
+		if ( !g_ascii_isdigit ( c ) && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E' ) {
+			gr->pos--;
+			break;
+		}
+		if ( nn < sizeof(num)-1 )
+			num[nn++] = c;
+	}
+	num[nn] = '\0';
+	gchar *end = NULL;
+	*value = g_ascii_strtod ( num, &end );
+	if ( nn == 0 || end != num + nn ) {
+		gr->error = TRUE;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean gr_literal ( geojson_reader_t *gr, const gchar *word )
+{
+	(void)gr_peek ( gr );
+	for ( const gchar *cp = word; *cp; cp++ )
+		if ( gr_getc ( gr ) != *cp ) {
+			gr->error = TRUE;
+			return FALSE;
+		}
+	return TRUE;
+}
+
+/*
+ * Move on to the next member of an object, with its name read into gr->key
+ * Returns FALSE at the end of the object, or on an error
+ */
+static gboolean gr_object_next ( geojson_reader_t *gr, gboolean *first )
+{
+	if ( *first ) {
+		*first = FALSE;
+		if ( !gr_expect ( gr, '{' ) )
+			return FALSE;
+		if ( gr_peek ( gr ) == '}' ) {
+			gr->pos++;
+			return FALSE;
+		}
 	}
 	else {
-		// Probably should use GIOChannels...
-		gchar line[512];
-		FILE *fout = fdopen(mystdout, "r");
-		setvbuf(fout, NULL, _IONBF, 0);
+		if ( gr_peek ( gr ) == '}' ) {
+			gr->pos++;
+			return FALSE;
+		}
+		if ( !gr_expect ( gr, ',' ) )
+			return FALSE;
+	}
+	return gr_string ( gr, gr->key ) && gr_expect ( gr, ':' );
+}
+
+/*
+ * Move on to the next element of an array
+ * Returns FALSE at the end of the array, or on an error
+ */
+static gboolean gr_array_next ( geojson_reader_t *gr, gboolean *first )
+{
+	if ( *first ) {
+		*first = FALSE;
+		if ( !gr_expect ( gr, '[' ) )
+			return FALSE;
+	}
+	else {
+		if ( gr_peek ( gr ) == ']' ) {
+			gr->pos++;
+			return FALSE;
+		}
+		return gr_expect ( gr, ',' );
+	}
+	if ( gr_peek ( gr ) == ']' ) {
+		gr->pos++;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Read over any value
+ */
+static gboolean gr_skip ( geojson_reader_t *gr, guint depth )
+{
+	gboolean first = TRUE;
+	gdouble value;
+
+	if ( depth > GEOJSON_MAX_DEPTH ) {
+		gr->error = TRUE;
+		return FALSE;
+	}
+	switch ( gr_peek ( gr ) ) {
+	case '{':
+		while ( gr_object_next ( gr, &first ) )
+			if ( !gr_skip ( gr, depth+1 ) )
+				break;
+		break;
+	case '[':
+		while ( gr_array_next ( gr, &first ) )
+			if ( !gr_skip ( gr, depth+1 ) )
+				break;
+		break;
+	case '"': (void)gr_string ( gr, gr->str ); break;
+	case 't': (void)gr_literal ( gr, "true" ); break;
+	case 'f': (void)gr_literal ( gr, "false" ); break;
+	case 'n': (void)gr_literal ( gr, "null" ); break;
+	default: (void)gr_number ( gr, &value ); break;
+	}
+	return !gr->error;
+}
+
+/*
+ * Read a string into *value, replacing any previous one, or skip anything else
+ */
+static gboolean gr_string_value ( geojson_reader_t *gr, gchar **value )
+{
+	if ( gr_peek ( gr ) != '"' )
+		return gr_skip ( gr, 0 );
+	if ( !gr_string ( gr, gr->str ) )
+		return FALSE;
+	g_free ( *value );
+	*value = g_strdup ( gr->str->str );
+	return TRUE;
+}
+
+/*
+ * Collect the positions of any geometry, noting where each line of positions starts
+ */
+static gboolean read_coordinates ( geojson_reader_t *gr, guint depth )
+{
+	if ( depth > 3 || gr_peek ( gr ) != '[' )
+		return gr_skip ( gr, depth );
+	gr->pos++;
+
+	gint c = gr_peek ( gr );
+	if ( c == '-' || g_ascii_isdigit ( c ) ) {
+		// Longitude, latitude and maybe altitude
+		geojson_position_t pos = { NAN, NAN, NAN, gr->new_part };
+		gdouble *values[] = { &pos.lon, &pos.lat, &pos.alt };
+		guint nn = 0;
+		while ( TRUE ) {
+			gdouble value;
+			if ( !gr_number ( gr, &value ) )
+				return FALSE;
+			if ( nn < G_N_ELEMENTS(values) )
+				*values[nn] = value;
+			nn++;
+			if ( gr_peek ( gr ) != ',' )
+				break;
+			gr->pos++;
+		}
+		if ( !gr_expect ( gr, ']' ) )
+			return FALSE;
+		if ( nn >= 2 ) {
+			g_array_append_val ( gr->positions, pos );
+			gr->new_part = FALSE;
+		}
+		return TRUE;
+	}
+
+	// A list of positions, or of lists of them
+	gr->new_part = TRUE;
+	if ( c == ']' ) {
+		gr->pos++;
+		return TRUE;
+	}
+	while ( TRUE ) {
+		if ( !read_coordinates ( gr, depth+1 ) )
+			return FALSE;
+		if ( gr_peek ( gr ) == ']' ) {
+			gr->pos++;
+			return TRUE;
+		}
+		if ( !gr_expect ( gr, ',' ) )
+			return FALSE;
+	}
+}
+
+/*
+ * Collect times in the same order as the positions, in however many lists
+ */
+static gboolean read_times ( geojson_reader_t *gr, guint depth )
+{
+	if ( depth > 3 || gr_peek ( gr ) != '[' )
+		return gr_skip ( gr, depth );
 
-		while (fgets(line, sizeof(line), fout)) {
-			fprintf ( ff, "%s", line );
+	gboolean first = TRUE;
+	while ( gr_array_next ( gr, &first ) ) {
+		gint c = gr_peek ( gr );
+		if ( c == '[' ) {
+			if ( !read_times ( gr, depth+1 ) )
+				return FALSE;
+			continue;
+		}
+		gdouble timestamp = NAN;
+		if ( c == '"' ) {
+			if ( !gr_string ( gr, gr->str ) )
+				return FALSE;
+			if ( !util_iso8601_to_timestamp ( gr->str->str, &timestamp ) )
+				timestamp = NAN;
 		}
+		else if ( !gr_skip ( gr, depth+1 ) )
+			return FALSE;
+		g_array_append_val ( gr->times, timestamp );
+	}
+	return !gr->error;
+}
 
-		fclose(fout);
+static gboolean read_properties ( geojson_reader_t *gr )
+{
+	if ( gr_peek ( gr ) != '{' )
+		return gr_skip ( gr, 0 );
 
-		g_child_watch_add ( pid, (GChildWatchFunc) my_watch, NULL );
-		result = TRUE;
+	gboolean first = TRUE;
+	while ( gr_object_next ( gr, &first ) ) {
+		const gchar *key = gr->key->str;
+		gboolean ok;
+		if ( g_strcmp0 ( key, "name" ) == 0 )
+			ok = gr_string_value ( gr, &gr->name );
+		else if ( g_strcmp0 ( key, "desc" ) == 0 || g_strcmp0 ( key, "description" ) == 0 )
+			ok = gr_string_value ( gr, &gr->description );
+		else if ( g_strcmp0 ( key, "cmt" ) == 0 )
+			ok = gr_string_value ( gr, &gr->comment );
+		else if ( g_strcmp0 ( key, "coordTimes" ) == 0 )
+			ok = read_times ( gr, 0 );
+		else if ( g_strcmp0 ( key, "time" ) == 0 && gr_peek ( gr ) == '"' ) {
+			ok = gr_string ( gr, gr->str );
+			if ( ok && !util_iso8601_to_timestamp ( gr->str->str, &gr->time ) )
+				gr->time = NAN;
+		}
+		else
+			ok = gr_skip ( gr, 0 );
+		if ( !ok )
+			break;
 	}
+	return !gr->error;
+}
+
+static void feature_reset ( geojson_reader_t *gr )
+{
+	g_string_truncate ( gr->geometry_type, 0 );
+	g_array_set_size ( gr->positions, 0 );
+	g_array_set_size ( gr->times, 0 );
+	gr->new_part = TRUE;
+	gr->time = NAN;
+	g_free ( gr->name );
+	gr->name = NULL;
+	g_free ( gr->comment );
+	gr->comment = NULL;
+	g_free ( gr->description );
+	gr->description = NULL;
+}
 
-	g_strfreev (argv);
+/*
+ * Add the feature just read to the layer
+ */
+static void feature_add ( geojson_reader_t *gr )
+{
+	const gchar *type = gr->geometry_type->str;
+	VikCoordMode coord_mode = vik_trw_layer_get_coord_mode ( gr->vtl );
 
-	// Delete the temporary file
-	(void)g_remove (tmp_filename);
-	g_free (tmp_filename);
+	if ( g_strcmp0 ( type, "Point" ) == 0 || g_strcmp0 ( type, "MultiPoint" ) == 0 ) {
+		for ( guint ii = 0; ii < gr->positions->len; ii++ ) {
+			geojson_position_t *pos = &g_array_index ( gr->positions, geojson_position_t, ii );
+			struct LatLon ll = { pos->lat, pos->lon };
+			VikWaypoint *wp = vik_waypoint_new ();
+			vik_coord_load_from_latlon ( &wp->coord, coord_mode, &ll );
+			wp->visible = TRUE;
+			wp->altitude = pos->alt;
+			wp->timestamp = ii < gr->times->len ? g_array_index ( gr->times, gdouble, ii ) : gr->time;
+			if ( gr->comment )
+				vik_waypoint_set_comment ( wp, gr->comment );
+			if ( gr->description )
+				vik_waypoint_set_description ( wp, gr->description );
+			gchar *name = gr->name ? g_strdup ( gr->name ) : g_strdup_printf ( "VIKING_WP%04d", gr->unnamed_waypoints++ );
+			vik_trw_layer_filein_add_waypoint ( gr->vtl, name, wp );
+			g_free ( name );
+		}
+	}
+	else if ( g_strcmp0 ( type, "LineString" ) == 0 || g_strcmp0 ( type, "MultiLineString" ) == 0 ) {
+		VikTrack *trk = vik_track_new ();
+		vik_track_set_defaults ( trk );
+		trk->visible = TRUE;
+		// Only when there is a time for every point
+		gboolean times = gr->times->len == gr->positions->len;
+		GList *tpl = NULL;
+		for ( guint ii = 0; ii < gr->positions->len; ii++ ) {
+			geojson_position_t *pos = &g_array_index ( gr->positions, geojson_position_t, ii );
+			struct LatLon ll = { pos->lat, pos->lon };
+			VikTrackpoint *tp = vik_trackpoint_new ();
+			vik_coord_load_from_latlon ( &tp->coord, coord_mode, &ll );
+			tp->newsegment = pos->new_part;
+			tp->altitude = pos->alt;
+			if ( times )
+				tp->timestamp = g_array_index ( gr->times, gdouble, ii );
+			tpl = g_list_prepend ( tpl, tp );
+		}
+		trk->trackpoints = g_list_reverse ( tpl );
+		if ( gr->comment )
+			vik_track_set_comment ( trk, gr->comment );
+		if ( gr->description )
+			vik_track_set_description ( trk, gr->description );
+		gchar *name = gr->name ? g_strdup ( gr->name ) : g_strdup_printf ( "VIKING_TR%03d", gr->unnamed_tracks++ );
+		vik_trw_layer_filein_add_track ( gr->vtl, name, trk );
+		g_free ( name );
+	}
+	else if ( type[0] )
+		g_debug ( "%s: ignoring %s geometry", __FUNCTION__, type );
 
-	return result;
+	feature_reset ( gr );
 }
 
-//
-// https://github.com/mapbox/togeojson
-//
-// https://www.npmjs.org/package/togeojson
-//
-// Tested with version 0.7.0
-const gchar* a_geojson_program_export ( void )
+static gboolean read_features ( geojson_reader_t *gr );
+
+/*
+ * Read a FeatureCollection (depth 0), a Feature or a geometry on its own
+ */
+static gboolean read_object ( geojson_reader_t *gr, guint depth )
 {
-	return "togeojson";
+	gboolean first = TRUE;
+	while ( gr_object_next ( gr, &first ) ) {
+		const gchar *key = gr->key->str;
+		gboolean ok;
+		if ( g_strcmp0 ( key, "type" ) == 0 && gr_peek ( gr ) == '"' ) {
+			ok = gr_string ( gr, gr->str );
+			if ( ok && g_strcmp0 ( gr->str->str, "Feature" ) != 0 && g_strcmp0 ( gr->str->str, "FeatureCollection" ) != 0 )
+				g_string_assign ( gr->geometry_type, gr->str->str );
+		}
+		else if ( g_strcmp0 ( key, "coordinates" ) == 0 )
+			ok = read_coordinates ( gr, 0 );
+		else if ( g_strcmp0 ( key, "geometry" ) == 0 && depth < 2 && gr_peek ( gr ) == '{' )
+			ok = read_object ( gr, depth+1 );
+		else if ( g_strcmp0 ( key, "properties" ) == 0 )
+			ok = read_properties ( gr );
+		else if ( g_strcmp0 ( key, "features" ) == 0 && depth == 0 )
+			ok = read_features ( gr );
+		else
+			ok = gr_skip ( gr, 0 );
+		if ( !ok )
+			break;
+	}
+	return !gr->error;
 }
 
-//
-// https://github.com/tyrasd/togpx
-//
-// https://www.npmjs.org/package/togpx
-//
-// Tested with version 0.3.1
-const gchar* a_geojson_program_import ( void )
+/*
+ * Each feature is added to the layer as soon as it has been read
+ */
+static gboolean read_features ( geojson_reader_t *gr )
 {
-	return "togpx";
+	if ( gr_peek ( gr ) != '[' )
+		return gr_skip ( gr, 0 );
+
+	gboolean first = TRUE;
+	while ( gr_array_next ( gr, &first ) ) {
+		if ( gr_peek ( gr ) != '{' ) {
+			if ( !gr_skip ( gr, 0 ) )
+				break;
+			continue;
+		}
+		feature_reset ( gr );
+		if ( !read_object ( gr, 1 ) )
+			break;
+		feature_add ( gr );
+	}
+	return !gr->error;
 }
 
 /**
- * a_geojson_import_to_gpx:
+ * a_geojson_read_file:
  *
- * @filename: The source GeoJSON file
+ * Read the features of a GeoJSON file into the layer
  *
- * Returns: The name of newly created temporary GPX file
- *          This file should be removed once used and the string freed.
- *          If NULL then the process failed.
+ * Returns: %FALSE if the file is not valid JSON
+ *          (features before the error remain in the layer)
  */
-gchar* a_geojson_import_to_gpx ( const gchar *filename )
+gboolean a_geojson_read_file ( VikTrwLayer *vtl, FILE *f )
 {
-	gchar *gpx_filename = NULL;
-	GError *error = NULL;
-	// Opening temporary file
-	int fd = g_file_open_tmp("vik_geojson_XXXXXX.gpx", &gpx_filename, &error);
-	if (fd < 0) {
-		g_warning ( _("failed to open temporary file: %s"), error->message );
-		g_clear_error ( &error );
-		return NULL;
+	geojson_reader_t *gr = g_malloc0 ( sizeof(geojson_reader_t) );
+	gr->f = f;
+	gr->key = g_string_new ( NULL );
+	gr->str = g_string_new ( NULL );
+	gr->vtl = vtl;
+	gr->unnamed_waypoints = 1;
+	gr->unnamed_tracks = 1;
+	gr->geometry_type = g_string_new ( NULL );
+	gr->positions = g_array_new ( FALSE, FALSE, sizeof(geojson_position_t) );
+	gr->times = g_array_new ( FALSE, FALSE, sizeof(gdouble) );
+	feature_reset ( gr );
+
+	gboolean ok = gr_peek ( gr ) == '{' && read_object ( gr, 0 );
+	if ( ok ) {
+		// A Feature or geometry on its own
+		feature_add ( gr );
+		ok = gr_peek ( gr ) == EOF;
 	}
-	g_debug ( "%s: temporary file = %s", __FUNCTION__, gpx_filename );
 
-	GPid pid;
-	gint mystdout;
+	feature_reset ( gr );
+	g_array_free ( gr->times, TRUE );
+	g_array_free ( gr->positions, TRUE );
+	g_string_free ( gr->geometry_type, TRUE );
+	g_string_free ( gr->str, TRUE );
+	g_string_free ( gr->key, TRUE );
+	g_free ( gr );
+	return ok;
+}
 
-	// geojson program should be on the $PATH
-	gchar **argv;
-	argv = g_new (gchar*, 3);
-	argv[0] = g_strdup (a_geojson_program_import());
-	argv[1] = g_strdup (filename);
-	argv[2] = NULL;
+static void geojson_write_string ( FILE *ff, const gchar *str )
+{
+	fputc ( '"', ff );
+	for ( const guchar *cp = (const guchar *)str; *cp; cp++ ) {
+		switch ( *cp ) {
+		case '"':  fputs ( "\\\"", ff ); break;
+		case '\\': fputs ( "\\\\", ff ); break;
+		case '\n': fputs ( "\\n", ff ); break;
+		case '\r': fputs ( "\\r", ff ); break;
+		case '\t': fputs ( "\\t", ff ); break;
+		default:
+			if ( *cp < 0x20 )
+				fprintf ( ff, "\\u%04x", *cp );
+			else
+				fputc ( *cp, ff );
+			break;
+		}
+	}
+	fputc ( '"', ff );
+}
 
-	FILE *gpxfile = fdopen (fd, "w");
+static void geojson_write_position ( FILE *ff, const VikCoord *coord, gdouble altitude )
+{
+	struct LatLon ll;
+	gchar lat[COORDS_STR_BUFFER_SIZE];
+	gchar lon[COORDS_STR_BUFFER_SIZE];
+	vik_coord_to_latlon ( coord, &ll );
+	a_coords_dtostr_buffer ( ll.lat, lat );
+	a_coords_dtostr_buffer ( ll.lon, lon );
+	if ( isnan(altitude) )
+		fprintf ( ff, "[%s,%s]", lon, lat );
+	else {
+		gchar alt[COORDS_STR_BUFFER_SIZE];
+		a_coords_dtostr_buffer ( altitude, alt );
+		fprintf ( ff, "[%s,%s,%s]", lon, lat, alt );
+	}
+}
 
-	// TODO: monitor stderr?
-	if (!g_spawn_async_with_pipes (NULL, argv, NULL, (GSpawnFlags) G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL, &mystdout, NULL, &error)) {
-		g_warning ("Async command failed: %s", error->message);
-		g_error_free(error);
+static void geojson_write_time ( FILE *ff, gdouble timestamp )
+{
+	if ( isnan(timestamp) ) {
+		fputs ( "null", ff );
+		return;
 	}
-	else {
-		// Probably should use GIOChannels...
-		gchar line[512];
-		FILE *fout = fdopen(mystdout, "r");
-		setvbuf(fout, NULL, _IONBF, 0);
+	GTimeVal tv;
+	tv.tv_sec = timestamp;
+	tv.tv_usec = ABS((timestamp-(gint64)timestamp)*G_USEC_PER_SEC);
+	gchar *time_iso8601 = g_time_val_to_iso8601 ( &tv );
+	if ( time_iso8601 )
+		fprintf ( ff, "\"%s\"", time_iso8601 );
+	else
+		fputs ( "null", ff );
+	g_free ( time_iso8601 );
+}
 
-		while (fgets(line, sizeof(line), fout)) {
-			fprintf ( gpxfile, "%s", line );
-		}
+/*
+ * Start a feature with the common properties, leaving the properties open for more
+ */
+static void geojson_write_feature_start ( FILE *ff, gboolean *first, const gchar *name, const gchar *comment, const gchar *description )
+{
+	fputs ( *first ? "\n" : ",\n", ff );
+	*first = FALSE;
+	fputs ( "{\"type\":\"Feature\",\"properties\":{\"name\":", ff );
+	geojson_write_string ( ff, name ? name : "" );
+	if ( comment ) {
+		fputs ( ",\"cmt\":", ff );
+		geojson_write_string ( ff, comment );
+	}
+	if ( description ) {
+		fputs ( ",\"desc\":", ff );
+		geojson_write_string ( ff, description );
+	}
+}
+
+static void geojson_write_waypoint ( FILE *ff, VikWaypoint *wp, gboolean *first )
+{
+	geojson_write_feature_start ( ff, first, wp->name, wp->comment, wp->description );
+	if ( !isnan(wp->timestamp) ) {
+		fputs ( ",\"time\":", ff );
+		geojson_write_time ( ff, wp->timestamp );
+	}
+	fputs ( "},\"geometry\":{\"type\":\"Point\",\"coordinates\":", ff );
+	geojson_write_position ( ff, &wp->coord, wp->altitude );
+	fputs ( "}}", ff );
+}
+
+/*
+ * The points of a track in lists for each segment when it has several,
+ *  or the times of those points
+ */
+static void geojson_write_track_points ( FILE *ff, VikTrack *trk, gboolean multi, gboolean times )
+{
+	fputs ( multi ? "[[" : "[", ff );
+	for ( GList *iter = trk->trackpoints; iter; iter = iter->next ) {
+		VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
+		if ( iter != trk->trackpoints )
+			fputs ( multi && tp->newsegment ? "],[" : ",", ff );
+		if ( times )
+			geojson_write_time ( ff, tp->timestamp );
+		else
+			geojson_write_position ( ff, &tp->coord, tp->altitude );
+	}
+	fputs ( multi ? "]]" : "]", ff );
+}
+
+static void geojson_write_track ( FILE *ff, VikTrack *trk, gboolean *first )
+{
+	gboolean multi = FALSE;
+	gboolean times = FALSE;
+	for ( GList *iter = trk->trackpoints; iter; iter = iter->next ) {
+		VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
+		if ( tp->newsegment && iter != trk->trackpoints )
+			multi = TRUE;
+		if ( !isnan(tp->timestamp) )
+			times = TRUE;
+	}
+
+	geojson_write_feature_start ( ff, first, trk->name, trk->comment, trk->description );
+	if ( times ) {
+		fputs ( ",\"coordTimes\":", ff );
+		geojson_write_track_points ( ff, trk, multi, TRUE );
+	}
+	fputs ( multi ? "},\"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":" :
+	                "},\"geometry\":{\"type\":\"LineString\",\"coordinates\":", ff );
+	geojson_write_track_points ( ff, trk, multi, FALSE );
+	fputs ( "}}", ff );
+}
+
+static gint geojson_waypoint_compare ( gconstpointer a, gconstpointer b )
+{
+	return g_strcmp0 ( VIK_WAYPOINT(a)->name, VIK_WAYPOINT(b)->name );
+}
 
-		fclose(fout);
-		g_child_watch_add ( pid, (GChildWatchFunc) my_watch, NULL );
+static gint geojson_track_compare ( gconstpointer a, gconstpointer b )
+{
+	return g_strcmp0 ( VIK_TRACK(a)->name, VIK_TRACK(b)->name );
+}
+
+/**
+ * a_geojson_write_file:
+ *
+ * Write the visible kinds of items of the layer as a FeatureCollection,
+ *  waypoints as Points and tracks and routes as LineStrings
+ *  (or MultiLineStrings when there are several segments)
+ *
+ * Returns TRUE if successfully written
+ */
+gboolean a_geojson_write_file ( VikTrwLayer *vtl, FILE *ff )
+{
+	gboolean first = TRUE;
+	GList *gl;
+
+	fputs ( "{\"type\":\"FeatureCollection\",\"features\":[", ff );
+
+	if ( vik_trw_layer_get_waypoints_visibility ( vtl ) ) {
+		gl = g_list_sort ( g_hash_table_get_values ( vik_trw_layer_get_waypoints ( vtl ) ), geojson_waypoint_compare );
+		for ( GList *iter = gl; iter; iter = iter->next )
+			geojson_write_waypoint ( ff, VIK_WAYPOINT(iter->data), &first );
+		g_list_free ( gl );
 	}
 
-	fclose (gpxfile);
+	if ( vik_trw_layer_get_tracks_visibility ( vtl ) ) {
+		gl = g_list_sort ( g_hash_table_get_values ( vik_trw_layer_get_tracks ( vtl ) ), geojson_track_compare );
+		for ( GList *iter = gl; iter; iter = iter->next )
+			geojson_write_track ( ff, VIK_TRACK(iter->data), &first );
+		g_list_free ( gl );
+	}
+
+	if ( vik_trw_layer_get_routes_visibility ( vtl ) ) {
+		gl = g_list_sort ( g_hash_table_get_values ( vik_trw_layer_get_routes ( vtl ) ), geojson_track_compare );
+		for ( GList *iter = gl; iter; iter = iter->next )
+			geojson_write_track ( ff, VIK_TRACK(iter->data), &first );
+		g_list_free ( gl );
+	}
 
-	g_strfreev (argv);
+	fputs ( "\n]}\n", ff );
 
-	return gpx_filename;
+	return !ferror ( ff );
 }
@@ -26,12 +26,9 @@
 
 G_BEGIN_DECLS
 
-gboolean a_geojson_write_file ( VikTrwLayer *vtl, FILE *ff );
-
-const gchar* a_geojson_program_export ( void );
-const gchar* a_geojson_program_import ( void );
+gboolean a_geojson_read_file ( VikTrwLayer *vtl, FILE *f );
 
-gchar* a_geojson_import_to_gpx ( const gchar *filename );
+gboolean a_geojson_write_file ( VikTrwLayer *vtl, FILE *ff );
 
 G_END_DECLS
 
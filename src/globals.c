@@ -111,6 +111,7 @@ static VikLayerParam io_prefs_external_gpx[] = {
 };
 
 static gchar * params_vik_fileref[] = {N_("Absolute"), N_("Relative"), NULL};
+static gchar * params_vik_file_save_format[] = {N_("Text"), N_("Binary"), NULL};
 static VikLayerParamScale params_recent_files[] = { {-1, 25, 1, 0} };
 static gchar * params_pos_type[] = {N_("None"), N_("Bottom"), N_("Middle"), N_("Top"), NULL};
 
@@ -129,6 +130,8 @@ static VikLayerParam prefs_advanced[] = {
     N_("Whether scroll events zoom or move the viewport"), NULL, NULL, NULL },
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_ADVANCED_NAMESPACE "invert_scroll_direction", VIK_LAYER_PARAM_BOOLEAN, VIK_LAYER_GROUP_NONE, N_("Invert Scroll Direction:"), VIK_LAYER_WIDGET_CHECKBUTTON, NULL, NULL,
     N_("Invert direction of scrolling, particularly for touchpad use"), NULL, NULL, NULL },
+  { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_ADVANCED_NAMESPACE "save_file_format", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Save File Format:"), VIK_LAYER_WIDGET_COMBOBOX, params_vik_file_save_format, NULL,
+    N_("When saving a Viking .vik file, whether to write it as text or in the binary form which is quicker to load but can only be read by newer versions of Viking."), NULL, NULL, NULL },
 };
 
 static gchar * params_startup_methods[] = {N_("Home Location"), N_("Last Location"), N_("Specified File"), N_("Auto Location"), NULL};
@@ -280,6 +283,9 @@ void a_vik_preferences_init ()
 
   tmp.b = FALSE;
   a_preferences_register(&prefs_advanced[8], tmp, VIKING_PREFERENCES_ADVANCED_GROUP_KEY);
+
+  tmp.u = VIK_FILE_SAVE_FORMAT_TEXT;
+  a_preferences_register(&prefs_advanced[9], tmp, VIKING_PREFERENCES_ADVANCED_GROUP_KEY);
 }
 
 vik_degree_format_t a_vik_get_degree_format ( )
@@ -389,6 +395,13 @@ vik_file_ref_format_t a_vik_get_file_ref_format ( )
   return format;
 }
 
+vik_file_save_format_t a_vik_get_file_save_format ( )
+{
+  vik_file_save_format_t format;
+  format = a_preferences_get(VIKING_PREFERENCES_ADVANCED_NAMESPACE "save_file_format")->u;
+  return format;
+}
+
 gboolean a_vik_get_ask_for_create_track_name ( )
 {
   return a_preferences_get(VIKING_PREFERENCES_ADVANCED_NAMESPACE "ask_for_create_track_name")->b;
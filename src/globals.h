@@ -217,6 +217,13 @@ typedef enum {
 
 vik_file_ref_format_t a_vik_get_file_ref_format ( );
 
+typedef enum {
+  VIK_FILE_SAVE_FORMAT_TEXT,
+  VIK_FILE_SAVE_FORMAT_BINARY,
+} vik_file_save_format_t;
+
+vik_file_save_format_t a_vik_get_file_save_format ( );
+
 gboolean a_vik_get_ask_for_create_track_name ( );
 
 gboolean a_vik_get_create_track_tooltip ( );
@@ -30,7 +30,6 @@
 #include "viking.h"
 #include "vikutils.h"
 
-#include <ctype.h>
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
@@ -60,7 +59,6 @@ if trackpoint, make trackpoint, store to current track (error / skip if none)
 
 /* Thanks to etrex-cache's gpsbabel's gpspoint.c for starting me off! */
 #define VIKING_LINE_SIZE 4096
-static char line_buffer[VIKING_LINE_SIZE];
 
 #define GPSPOINT_TYPE_NONE 0
 #define GPSPOINT_TYPE_WAYPOINT 1
@@ -71,40 +69,60 @@ static char line_buffer[VIKING_LINE_SIZE];
 #define GPSPOINT_TYPE_ROUTE 6
 #define GPSPOINT_TYPE_ROUTE_END 7
 
-static VikTrack *current_track; /* pointer to pointer to first GList */
-
-static gint line_type = GPSPOINT_TYPE_NONE;
-static struct LatLon line_latlon;
-static gchar *line_name;
-static gchar *line_comment;
-static gchar *line_description;
-static gchar *line_source;
-static gchar *line_xtype;
-static gchar *line_color;
-static gint line_name_label = 0;
-static gint line_dist_label = 0;
-static gchar *line_image;
-static gchar *line_symbol;
-static gdouble line_image_direction = NAN;
-static VikWaypointImageDirectionRef line_image_direction_ref = WP_IMAGE_DIRECTION_REF_TRUE;
-static gboolean line_newsegment = FALSE;
-static gdouble line_timestamp = NAN;
-static gdouble line_altitude = NAN;
-static gboolean line_visible = TRUE;
-
-static gboolean line_extended = FALSE;
-static gdouble line_speed = NAN;
-static gdouble line_course = NAN;
-static gint line_sat = 0;
-static gint line_fix = 0;
-static gdouble line_hdop = NAN;
-static gdouble line_vdop = NAN;
-static gdouble line_pdop = NAN;
-/* other possible properties go here */
-
-
-static void gpspoint_process_tag ( const gchar *tag, guint len );
-static void gpspoint_process_key_and_value ( const gchar *key, guint key_len, const gchar *value, guint value_len );
+/*
+ * Everything about the file being read, so any number of files can be read at once
+ */
+typedef struct {
+  VikTrack *current_track; /* pointer to pointer to first GList */
+
+  gint line_type;
+  struct LatLon line_latlon;
+  gchar *line_name;
+  gchar *line_comment;
+  gchar *line_description;
+  gchar *line_source;
+  gchar *line_xtype;
+  gchar *line_color;
+  gint line_name_label;
+  gint line_dist_label;
+  gchar *line_image;
+  gchar *line_symbol;
+  gdouble line_image_direction;
+  VikWaypointImageDirectionRef line_image_direction_ref;
+  gboolean line_newsegment;
+  gdouble line_timestamp;
+  gdouble line_altitude;
+  gboolean line_visible;
+
+  gboolean line_extended;
+  gdouble line_speed;
+  gdouble line_course;
+  gint line_sat;
+  gint line_fix;
+  gdouble line_hdop;
+  gdouble line_vdop;
+  gdouble line_pdop;
+  /* other possible properties go here */
+} TP_read_info_type;
+
+static void read_info_init ( TP_read_info_type *ri )
+{
+  memset ( ri, 0, sizeof(TP_read_info_type) );
+  ri->line_type = GPSPOINT_TYPE_NONE;
+  ri->line_image_direction = NAN;
+  ri->line_image_direction_ref = WP_IMAGE_DIRECTION_REF_TRUE;
+  ri->line_timestamp = NAN;
+  ri->line_altitude = NAN;
+  ri->line_visible = TRUE;
+  ri->line_speed = NAN;
+  ri->line_course = NAN;
+  ri->line_hdop = NAN;
+  ri->line_vdop = NAN;
+  ri->line_pdop = NAN;
+}
+
+static void gpspoint_process_tag ( TP_read_info_type *ri, const gchar *tag, guint len );
+static void gpspoint_process_key_and_value ( TP_read_info_type *ri, const gchar *key, guint key_len, const gchar *value, guint value_len );
 
 static gchar *slashdup(const gchar *str)
 {
@@ -164,13 +182,75 @@ static gchar *deslashndup ( const gchar *str, guint16 len )
 }
 
 
-static void trackpoints_end ()
+static void trackpoints_end ( TP_read_info_type *ri )
+{
+  if ( ri->current_track )
+    if ( ri->current_track->trackpoints ) {
+      ri->current_track->trackpoints = g_list_reverse ( ri->current_track->trackpoints );
+      ri->current_track = NULL;
+    }
+}
+
+/*
+ * Lines are read either from a file or from text already in memory
+ */
+typedef struct {
+  FILE *f;
+  GString *line; /* the current line of the file */
+  const gchar *pos;
+  const gchar *end;
+  gsize bytes_read;
+  gsize next_progress;
+  VikReadProgressFunc progress;
+  gpointer progress_data;
+  gboolean stopped; /* by the progress function */
+} TP_read_source_type;
+
+/* How often reading progress is told, in bytes */
+#define GPSPOINT_PROGRESS_SIZE (1024*1024)
+
+/*
+ * Account for a line having been read
+ * Returns FALSE if the reading should stop
+ */
+static gboolean read_source_progress ( TP_read_source_type *src, gsize len )
+{
+  src->bytes_read += len;
+  if ( !src->progress || src->bytes_read < src->next_progress )
+    return TRUE;
+  src->next_progress = src->bytes_read + GPSPOINT_PROGRESS_SIZE;
+  src->stopped = !src->progress ( src->bytes_read, src->progress_data );
+  return !src->stopped;
+}
+
+/*
+ * Get the next whole line, including any newline
+ * Text in memory is not copied, the line points straight into it
+ * From a file, only the line itself is read as the rest of the file may be for something else
+ */
+static gboolean read_source_next_line ( TP_read_source_type *src, const gchar **line, gsize *len )
 {
-  if ( current_track )
-    if ( current_track->trackpoints ) {
-      current_track->trackpoints = g_list_reverse ( current_track->trackpoints );
-      current_track = NULL;
+  if ( src->f ) {
+    gchar line_buffer[VIKING_LINE_SIZE];
+    g_string_truncate ( src->line, 0 );
+    while ( fgets ( line_buffer, VIKING_LINE_SIZE, src->f ) ) {
+      g_string_append ( src->line, line_buffer );
+      if ( src->line->str[src->line->len-1] == '\n' )
+        break;
     }
+    *line = src->line->str;
+    *len = src->line->len;
+    return src->line->len > 0 && read_source_progress ( src, *len );
+  }
+
+  if ( src->pos >= src->end )
+    return FALSE;
+  const gchar *nl = memchr ( src->pos, '\n', src->end - src->pos );
+  const gchar *line_end = nl ? nl + 1 : src->end;
+  *line = src->pos;
+  *len = line_end - src->pos;
+  src->pos = line_end;
+  return read_source_progress ( src, *len );
 }
 
 /*
@@ -178,40 +258,41 @@ static void trackpoints_end ()
  * No obvious way to test for a 'gpspoint' file,
  *  thus set a flag if any actual tag found during processing of the file
  */
-gboolean a_gpspoint_read_file(VikTrwLayer *trw, FILE *f, const gchar *dirpath ) {
+static gboolean gpspoint_read ( VikTrwLayer *trw, TP_read_source_type *src, const gchar *dirpath ) {
   VikCoordMode coord_mode = vik_trw_layer_get_coord_mode ( trw );
-  gchar *tag_start, *tag_end;
-  g_assert ( f != NULL && trw != NULL );
-  line_type = GPSPOINT_TYPE_NONE;
-  line_timestamp = NAN;
-  line_newsegment = FALSE;
-  line_image = NULL;
-  line_symbol = NULL;
-  current_track = NULL;
+  const gchar *line, *line_end, *tag_start, *tag_end;
+  gsize line_len;
+  TP_read_info_type read_info;
+  TP_read_info_type *ri = &read_info;
+  g_assert ( trw != NULL );
+  read_info_init ( ri );
   gboolean have_read_something = FALSE;
 
-  while (fgets(line_buffer, VIKING_LINE_SIZE, f))
+  while (read_source_next_line(src, &line, &line_len))
   {
     gboolean inside_quote = 0;
     gboolean backslash = 0;
 
-    line_buffer[strlen(line_buffer)-1] = '\0'; /* chop off newline */
+    /* chop off newline - NB the line is not nul terminated, so everything stops at line_end */
+    line_end = line + line_len;
+    if ( line_end[-1] == '\n' )
+      line_end--;
 
     /* for gpspoint files wrapped inside */
-    if ( strlen(line_buffer) >= 13 && strncmp ( line_buffer, "~EndLayerData", 13 ) == 0 ) {
+    if ( line_end - line >= 13 && strncmp ( line, "~EndLayerData", 13 ) == 0 ) {
       // Even just a blank TRW is ok when in a .vik file
       have_read_something = TRUE;
       break;
     }
 
     /* each line: nullify stuff, make thing if nes, free name if ness */
-    tag_start = line_buffer;
+    tag_start = line;
     for (;;)
     {
-      /* my addition: find first non-whitespace character. if the null, skip line. */
-      while (*tag_start != '\0' && isspace(*tag_start))
+      /* my addition: find first non-whitespace character. if the end, skip line. */
+      while (tag_start < line_end && g_ascii_isspace(*tag_start))
         tag_start++;
-      if (*tag_start == '\0')
+      if (tag_start == line_end)
         break;
 
       if (*tag_start == '#')
@@ -220,8 +301,9 @@ gboolean a_gpspoint_read_file(VikTrwLayer *trw, FILE *f, const gchar *dirpath )
       tag_end = tag_start;
         if (*tag_end == '"')
           inside_quote = !inside_quote;
-      while (*tag_end != '\0' && (!isspace(*tag_end) || inside_quote)) {
-        tag_end++;
+      while (tag_end < line_end && (!g_ascii_isspace(*tag_end) || inside_quote)) {
+        if (++tag_end == line_end)
+          break;
         if (*tag_end == '\\' && !backslash)
           backslash = TRUE;
         else if (backslash)
@@ -232,175 +314,317 @@ gboolean a_gpspoint_read_file(VikTrwLayer *trw, FILE *f, const gchar *dirpath )
 
       // Won't have super massively long strings, so potential truncation in cast is acceptable.
       guint len = (guint)(tag_end - tag_start);
-      gpspoint_process_tag ( tag_start, len );
+      gpspoint_process_tag ( ri, tag_start, len );
 
-      if (*tag_end == '\0' )
+      if (tag_end == line_end )
         break;
       else
         tag_start = tag_end+1;
     }
-    if (line_type == GPSPOINT_TYPE_TRACK_END || line_type == GPSPOINT_TYPE_ROUTE_END) {
-      trackpoints_end ();
+    if (ri->line_type == GPSPOINT_TYPE_TRACK_END || ri->line_type == GPSPOINT_TYPE_ROUTE_END) {
+      trackpoints_end ( ri );
     }
-    if (line_type == GPSPOINT_TYPE_WAYPOINT && line_name)
+    if (ri->line_type == GPSPOINT_TYPE_WAYPOINT && ri->line_name)
     {
       // Handle a badly formatted file in case of missing explicit track/route end (this shouldn't happen)
-      trackpoints_end ();
+      trackpoints_end ( ri );
       have_read_something = TRUE;
       VikWaypoint *wp = vik_waypoint_new();
-      wp->visible = line_visible;
-      wp->altitude = line_altitude;
-      wp->timestamp = line_timestamp;
+      wp->visible = ri->line_visible;
+      wp->altitude = ri->line_altitude;
+      wp->timestamp = ri->line_timestamp;
 
-      vik_coord_load_from_latlon ( &(wp->coord), coord_mode, &line_latlon );
+      vik_coord_load_from_latlon ( &(wp->coord), coord_mode, &ri->line_latlon );
 
-      vik_trw_layer_filein_add_waypoint ( trw, line_name, wp );
-      g_free ( line_name );
-      line_name = NULL;
+      vik_trw_layer_filein_add_waypoint ( trw, ri->line_name, wp );
+      g_free ( ri->line_name );
+      ri->line_name = NULL;
 
-      if ( line_comment )
-        vik_waypoint_set_comment ( wp, line_comment );
+      if ( ri->line_comment )
+        vik_waypoint_set_comment ( wp, ri->line_comment );
 
-      if ( line_description )
-        vik_waypoint_set_description ( wp, line_description );
+      if ( ri->line_description )
+        vik_waypoint_set_description ( wp, ri->line_description );
 
-      if ( line_source )
-        vik_waypoint_set_source ( wp, line_source );
+      if ( ri->line_source )
+        vik_waypoint_set_source ( wp, ri->line_source );
 
-      if ( line_xtype )
-        vik_waypoint_set_type ( wp, line_xtype );
+      if ( ri->line_xtype )
+        vik_waypoint_set_type ( wp, ri->line_xtype );
 
-      if ( line_image ) {
-        gchar *fn = util_make_absolute_filename ( line_image, dirpath );
-        vik_waypoint_set_image ( wp, fn ? fn : line_image );
+      if ( ri->line_image ) {
+        gchar *fn = util_make_absolute_filename ( ri->line_image, dirpath );
+        vik_waypoint_set_image ( wp, fn ? fn : ri->line_image );
         g_free ( fn );
       }
 
-      if ( !isnan(line_image_direction) ) {
-        wp->image_direction = line_image_direction;
-        wp->image_direction_ref = line_image_direction_ref;
+      if ( !isnan(ri->line_image_direction) ) {
+        wp->image_direction = ri->line_image_direction;
+        wp->image_direction_ref = ri->line_image_direction_ref;
       }
 
-      if ( line_symbol )
-        vik_waypoint_set_symbol ( wp, line_symbol );
+      if ( ri->line_symbol )
+        vik_waypoint_set_symbol ( wp, ri->line_symbol );
     }
-    else if ((line_type == GPSPOINT_TYPE_TRACK || line_type == GPSPOINT_TYPE_ROUTE) && line_name)
+    else if ((ri->line_type == GPSPOINT_TYPE_TRACK || ri->line_type == GPSPOINT_TYPE_ROUTE) && ri->line_name)
     {
       // Handle a badly formatted file in case of missing explicit track/route end (this shouldn't happen)
-      trackpoints_end ();
+      trackpoints_end ( ri );
       have_read_something = TRUE;
       VikTrack *pl = vik_track_new();
       // NB don't set defaults here as all properties are stored in the GPS_POINT format
       //vik_track_set_defaults ( pl );
 
       /* Thanks to Peter Jones for this Fix */
-      if (!line_name) line_name = g_strdup("UNK");
+      if (!ri->line_name) ri->line_name = g_strdup("UNK");
 
-      pl->visible = line_visible;
-      pl->is_route = (line_type == GPSPOINT_TYPE_ROUTE);
+      pl->visible = ri->line_visible;
+      pl->is_route = (ri->line_type == GPSPOINT_TYPE_ROUTE);
 
-      if ( line_comment )
-        vik_track_set_comment ( pl, line_comment );
+      if ( ri->line_comment )
+        vik_track_set_comment ( pl, ri->line_comment );
 
-      if ( line_description )
-        vik_track_set_description ( pl, line_description );
+      if ( ri->line_description )
+        vik_track_set_description ( pl, ri->line_description );
 
-      if ( line_source )
-        vik_track_set_source ( pl, line_source );
+      if ( ri->line_source )
+        vik_track_set_source ( pl, ri->line_source );
 
-      if ( line_xtype )
-        vik_track_set_type ( pl, line_xtype );
+      if ( ri->line_xtype )
+        vik_track_set_type ( pl, ri->line_xtype );
 
-      if ( line_color )
+      if ( ri->line_color )
       {
-        if ( gdk_color_parse ( line_color, &(pl->color) ) )
+        if ( gdk_color_parse ( ri->line_color, &(pl->color) ) )
         pl->has_color = TRUE;
       }
 
-      pl->draw_name_mode = line_name_label;
-      pl->max_number_dist_labels = line_dist_label;
+      pl->draw_name_mode = ri->line_name_label;
+      pl->max_number_dist_labels = ri->line_dist_label;
 
       pl->trackpoints = NULL;
-      vik_trw_layer_filein_add_track ( trw, line_name, pl );
-      g_free ( line_name );
-      line_name = NULL;
+      vik_trw_layer_filein_add_track ( trw, ri->line_name, pl );
+      g_free ( ri->line_name );
+      ri->line_name = NULL;
 
-      current_track = pl;
+      ri->current_track = pl;
     }
-    else if ((line_type == GPSPOINT_TYPE_TRACKPOINT || line_type == GPSPOINT_TYPE_ROUTEPOINT) && current_track)
+    else if ((ri->line_type == GPSPOINT_TYPE_TRACKPOINT || ri->line_type == GPSPOINT_TYPE_ROUTEPOINT) && ri->current_track)
     {
       have_read_something = TRUE;
       VikTrackpoint *tp = vik_trackpoint_new();
-      vik_coord_load_from_latlon ( &(tp->coord), coord_mode, &line_latlon );
-      tp->newsegment = line_newsegment;
-      tp->timestamp = line_timestamp;
-      tp->altitude = line_altitude;
-      vik_trackpoint_set_name ( tp, line_name );
-      if (line_extended) {
-        tp->speed = line_speed;
-        tp->course = line_course;
-        tp->nsats = line_sat;
-        tp->fix_mode = line_fix;
-        tp->hdop = line_hdop;
-        tp->vdop = line_vdop;
-        tp->pdop = line_pdop;
+      vik_coord_load_from_latlon ( &(tp->coord), coord_mode, &ri->line_latlon );
+      tp->newsegment = ri->line_newsegment;
+      tp->timestamp = ri->line_timestamp;
+      tp->altitude = ri->line_altitude;
+      vik_trackpoint_set_name ( tp, ri->line_name );
+      if (ri->line_extended) {
+        tp->speed = ri->line_speed;
+        tp->course = ri->line_course;
+        tp->nsats = ri->line_sat;
+        tp->fix_mode = ri->line_fix;
+        tp->hdop = ri->line_hdop;
+        tp->vdop = ri->line_vdop;
+        tp->pdop = ri->line_pdop;
       }
       // Much faster to prepend and then reverse list once all points read in
       // Especially if hunderds of thousands or more trackpoints in a file
-      current_track->trackpoints = g_list_prepend ( current_track->trackpoints, tp );
+      ri->current_track->trackpoints = g_list_prepend ( ri->current_track->trackpoints, tp );
     }
 
-    if (line_name) 
-      g_free ( line_name );
-    line_name = NULL;
-    if (line_comment)
-      g_free ( line_comment );
-    if (line_description)
-      g_free ( line_description );
-    if (line_source)
-      g_free ( line_source );
-    if (line_xtype)
-      g_free ( line_xtype );
-    if (line_color)
-      g_free ( line_color );
-    if (line_image)
-      g_free ( line_image );
-    if (line_symbol)
-      g_free ( line_symbol );
-    line_comment = NULL;
-    line_description = NULL;
-    line_source = NULL;
-    line_xtype = NULL;
-    line_color = NULL;
-    line_image = NULL;
-    line_image_direction = NAN;
-    line_image_direction_ref = WP_IMAGE_DIRECTION_REF_TRUE;
-    line_symbol = NULL;
-    line_type = GPSPOINT_TYPE_NONE;
-    line_newsegment = FALSE;
-    line_timestamp = NAN;
-    line_altitude = NAN;
-    line_visible = TRUE;
-    line_symbol = NULL;
-
-    line_extended = FALSE;
-    line_speed = NAN;
-    line_course = NAN;
-    line_sat = 0;
-    line_fix = 0;
-    line_hdop = NAN;
-    line_vdop = NAN;
-    line_pdop = NAN;
-    line_name_label = 0;
-    line_dist_label = 0;
+    if (ri->line_name) 
+      g_free ( ri->line_name );
+    ri->line_name = NULL;
+    if (ri->line_comment)
+      g_free ( ri->line_comment );
+    if (ri->line_description)
+      g_free ( ri->line_description );
+    if (ri->line_source)
+      g_free ( ri->line_source );
+    if (ri->line_xtype)
+      g_free ( ri->line_xtype );
+    if (ri->line_color)
+      g_free ( ri->line_color );
+    if (ri->line_image)
+      g_free ( ri->line_image );
+    if (ri->line_symbol)
+      g_free ( ri->line_symbol );
+    ri->line_comment = NULL;
+    ri->line_description = NULL;
+    ri->line_source = NULL;
+    ri->line_xtype = NULL;
+    ri->line_color = NULL;
+    ri->line_image = NULL;
+    ri->line_image_direction = NAN;
+    ri->line_image_direction_ref = WP_IMAGE_DIRECTION_REF_TRUE;
+    ri->line_symbol = NULL;
+    ri->line_type = GPSPOINT_TYPE_NONE;
+    ri->line_newsegment = FALSE;
+    ri->line_timestamp = NAN;
+    ri->line_altitude = NAN;
+    ri->line_visible = TRUE;
+    ri->line_symbol = NULL;
+
+    ri->line_extended = FALSE;
+    ri->line_speed = NAN;
+    ri->line_course = NAN;
+    ri->line_sat = 0;
+    ri->line_fix = 0;
+    ri->line_hdop = NAN;
+    ri->line_vdop = NAN;
+    ri->line_pdop = NAN;
+    ri->line_name_label = 0;
+    ri->line_dist_label = 0;
   }
 
   // Handle a badly formatted file in case of missing explicit track/route end (this shouldn't happen)
-  trackpoints_end ();
+  trackpoints_end ( ri );
 
   return have_read_something;
 }
 
+gboolean a_gpspoint_read_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath )
+{
+  return a_gpspoint_read_file_progress ( trw, f, dirpath, NULL, NULL );
+}
+
+/**
+ * a_gpspoint_read_file_progress:
+ * @progress: Optional function told how much of the file has been read,
+ *            which can stop the reading (then FALSE is returned)
+ *
+ * As a_gpspoint_read_file()
+ */
+gboolean a_gpspoint_read_file_progress ( VikTrwLayer *trw, FILE *f, const gchar *dirpath, VikReadProgressFunc progress, gpointer user_data )
+{
+  g_assert ( f != NULL );
+  TP_read_source_type src = { f, g_string_sized_new ( VIKING_LINE_SIZE ), NULL, NULL };
+  src.progress = progress;
+  src.progress_data = user_data;
+  src.next_progress = GPSPOINT_PROGRESS_SIZE;
+  gboolean ok = gpspoint_read ( trw, &src, dirpath );
+  g_string_free ( src.line, TRUE );
+  return ok && !src.stopped;
+}
+
+/**
+ * a_gpspoint_read_text:
+ * @text: Data as returned by a_gpspoint_read_unparsed()
+ *
+ * Read the data from memory, in the same way as a_gpspoint_read_file()
+ */
+gboolean a_gpspoint_read_text ( VikTrwLayer *trw, const gchar *text, gsize len, const gchar *dirpath )
+{
+  TP_read_source_type src = { NULL, NULL, text, text + len };
+  return gpspoint_read ( trw, &src, dirpath );
+}
+
+/*
+ * Look for the latitude and longitude tags on a line
+ */
+static void expand_bbox_from_line ( const gchar *line, LatLonBBox *bbox )
+{
+  const gchar *lat = strstr ( line, "latitude=" );
+  const gchar *lon = strstr ( line, "longitude=" );
+  if ( !lat || !lon )
+    return;
+  lat += 9;
+  lon += 10;
+  if ( *lat == '"' ) lat++;
+  if ( *lon == '"' ) lon++;
+  gchar *end_lat, *end_lon;
+  gdouble latitude = g_ascii_strtod ( lat, &end_lat );
+  gdouble longitude = g_ascii_strtod ( lon, &end_lon );
+  if ( end_lat == lat || end_lon == lon ) {
+    // Can't tell where it is, so it could be anywhere
+    bbox->south = -90.0;
+    bbox->north = 90.0;
+    bbox->west = -180.0;
+    bbox->east = 180.0;
+    return;
+  }
+  bbox->south = MIN ( bbox->south, latitude );
+  bbox->north = MAX ( bbox->north, latitude );
+  bbox->west = MIN ( bbox->west, longitude );
+  bbox->east = MAX ( bbox->east, longitude );
+}
+
+/*
+ * Count the items that the line starts, and note the time of the first point of each track
+ */
+static void summarize_line ( const gchar *line, GpspointSummary *summary, gboolean *track_started )
+{
+  if ( strncmp ( line, "type=\"trackpoint\"", 17 ) == 0 ) {
+    if ( *track_started ) {
+      *track_started = FALSE;
+      const gchar *unixtime = strstr ( line, "unixtime=" );
+      if ( unixtime ) {
+        unixtime += 9;
+        if ( *unixtime == '"' ) unixtime++;
+        gchar *end;
+        gdouble timestamp = g_ascii_strtod ( unixtime, &end );
+        if ( end != unixtime )
+          g_array_append_val ( summary->track_times, timestamp );
+      }
+    }
+  }
+  else if ( strncmp ( line, "type=\"track\"", 12 ) == 0 ) {
+    summary->n_tracks++;
+    *track_started = TRUE;
+  }
+  else if ( strncmp ( line, "type=\"route\"", 12 ) == 0 )
+    summary->n_routes++;
+  else if ( strncmp ( line, "type=\"waypoint\"", 15 ) == 0 )
+    summary->n_waypoints++;
+}
+
+/**
+ * a_gpspoint_read_unparsed:
+ * @summary: Set to what can be quickly found out about the data,
+ *           the track_times array of which should be freed by the caller (if the data is returned)
+ *
+ * Read the data of a layer inside a .vik file, up to the ~EndLayerData line,
+ *  without making anything from it.
+ * This is much quicker than a_gpspoint_read_file(),
+ *  so reading the data properly can be left until it is wanted.
+ *
+ * Returns: The text of the data (without the ~EndLayerData line),
+ *          or NULL if the end of the data was not found
+ */
+GString *a_gpspoint_read_unparsed ( FILE *f, GpspointSummary *summary )
+{
+  TP_read_source_type src = { f, g_string_sized_new ( VIKING_LINE_SIZE ), NULL, NULL };
+  const gchar *line;
+  gsize len;
+  GString *text = g_string_new ( NULL );
+  gboolean track_started = FALSE;
+
+  summary->bbox.south = 90.0;
+  summary->bbox.north = -90.0;
+  summary->bbox.west = 180.0;
+  summary->bbox.east = -180.0;
+  summary->n_tracks = 0;
+  summary->n_routes = 0;
+  summary->n_waypoints = 0;
+  summary->track_times = g_array_new ( FALSE, FALSE, sizeof(gdouble) );
+
+  while ( read_source_next_line ( &src, &line, &len ) ) {
+    if ( strncmp ( line, "~EndLayerData", 13 ) == 0 ) {
+      g_string_free ( src.line, TRUE );
+      return text;
+    }
+    expand_bbox_from_line ( line, &(summary->bbox) );
+    summarize_line ( line, summary, &track_started );
+    g_string_append_len ( text, line, len );
+  }
+
+  g_string_free ( src.line, TRUE );
+  g_string_free ( text, TRUE );
+  g_array_free ( summary->track_times, TRUE );
+  summary->track_times = NULL;
+  return NULL;
+}
+
 /* Tag will be of a few defined forms:
    ^[:alpha:]*=".*"$
    ^[:alpha:]*=.*$
@@ -409,7 +633,7 @@ gboolean a_gpspoint_read_file(VikTrwLayer *trw, FILE *f, const gchar *dirpath )
 
 So we must determine end of tag name, start of value, end of value.
 */
-static void gpspoint_process_tag ( const gchar *tag, guint len )
+static void gpspoint_process_tag ( TP_read_info_type *ri, const gchar *tag, guint len )
 {
   const gchar *key_end, *value_start, *value_end;
 
@@ -449,150 +673,229 @@ static void gpspoint_process_tag ( const gchar *tag, guint len )
     if ( (value_end - value_start) < 0 )
       return;
 
-    gpspoint_process_key_and_value(tag, key_end - tag, value_start, value_end - value_start);
+    gpspoint_process_key_and_value(ri, tag, key_end - tag, value_start, value_end - value_start);
   }
 }
 
+typedef enum {
+  GPSPOINT_KEY_UNKNOWN = 0,
+  GPSPOINT_KEY_TYPE,
+  GPSPOINT_KEY_NAME,
+  GPSPOINT_KEY_COMMENT,
+  GPSPOINT_KEY_DESCRIPTION,
+  GPSPOINT_KEY_SOURCE,
+  GPSPOINT_KEY_XTYPE,
+  GPSPOINT_KEY_COLOR,
+  GPSPOINT_KEY_DRAW_NAME_MODE,
+  GPSPOINT_KEY_NUMBER_DIST_LABELS,
+  GPSPOINT_KEY_IMAGE,
+  GPSPOINT_KEY_IMAGE_DIRECTION,
+  GPSPOINT_KEY_IMAGE_DIRECTION_REF,
+  GPSPOINT_KEY_LATITUDE,
+  GPSPOINT_KEY_LONGITUDE,
+  GPSPOINT_KEY_ALTITUDE,
+  GPSPOINT_KEY_VISIBLE,
+  GPSPOINT_KEY_SYMBOL,
+  GPSPOINT_KEY_UNIXTIME,
+  GPSPOINT_KEY_NEWSEGMENT,
+  GPSPOINT_KEY_EXTENDED,
+  GPSPOINT_KEY_SPEED,
+  GPSPOINT_KEY_COURSE,
+  GPSPOINT_KEY_SAT,
+  GPSPOINT_KEY_FIX,
+  GPSPOINT_KEY_HDOP,
+  GPSPOINT_KEY_VDOP,
+  GPSPOINT_KEY_PDOP,
+} gpspoint_key_t;
+
+typedef struct {
+  const gchar *name;
+  guint len;
+  gpspoint_key_t key;
+} gpspoint_key_entry_t;
+
+/*
+ * A perfect hash of the known keys, from their lengths and their first and last letters
+ * NB Any new key will need the hash to be changed so that no two keys share a slot
+ */
+#define GPSPOINT_KEY_HASH(first,last,len) ((g_ascii_tolower(first)*15 + g_ascii_tolower(last)*26 + (len)) & 63)
+
+static const gpspoint_key_entry_t gpspoint_keys[64] = {
+  [4]  = { "newsegment", 10, GPSPOINT_KEY_NEWSEGMENT },
+  [5]  = { "source", 6, GPSPOINT_KEY_SOURCE },
+  [8]  = { "sat", 3, GPSPOINT_KEY_SAT },
+  [14] = { "vdop", 4, GPSPOINT_KEY_VDOP },
+  [15] = { "xtype", 5, GPSPOINT_KEY_XTYPE },
+  [18] = { "type", 4, GPSPOINT_KEY_TYPE },
+  [19] = { "description", 11, GPSPOINT_KEY_DESCRIPTION },
+  [21] = { "course", 6, GPSPOINT_KEY_COURSE },
+  [22] = { "image_direction_ref", 19, GPSPOINT_KEY_IMAGE_DIRECTION_REF },
+  [27] = { "extended", 8, GPSPOINT_KEY_EXTENDED },
+  [28] = { "comment", 7, GPSPOINT_KEY_COMMENT },
+  [30] = { "latitude", 8, GPSPOINT_KEY_LATITUDE },
+  [31] = { "longitude", 9, GPSPOINT_KEY_LONGITUDE },
+  [34] = { "image_direction", 15, GPSPOINT_KEY_IMAGE_DIRECTION },
+  [37] = { "unixtime", 8, GPSPOINT_KEY_UNIXTIME },
+  [38] = { "color", 5, GPSPOINT_KEY_COLOR },
+  [42] = { "speed", 5, GPSPOINT_KEY_SPEED },
+  [44] = { "draw_name_mode", 14, GPSPOINT_KEY_DRAW_NAME_MODE },
+  [45] = { "fix", 3, GPSPOINT_KEY_FIX },
+  [46] = { "image", 5, GPSPOINT_KEY_IMAGE },
+  [50] = { "number_dist_labels", 18, GPSPOINT_KEY_NUMBER_DIST_LABELS },
+  [51] = { "visible", 7, GPSPOINT_KEY_VISIBLE },
+  [52] = { "pdop", 4, GPSPOINT_KEY_PDOP },
+  [56] = { "name", 4, GPSPOINT_KEY_NAME },
+  [57] = { "altitude", 8, GPSPOINT_KEY_ALTITUDE },
+  [59] = { "symbol", 6, GPSPOINT_KEY_SYMBOL },
+  [60] = { "hdop", 4, GPSPOINT_KEY_HDOP },
+};
+
+static gpspoint_key_t gpspoint_lookup_key ( const gchar *key, guint key_len )
+{
+  const gpspoint_key_entry_t *entry = &gpspoint_keys[GPSPOINT_KEY_HASH(key[0], key[key_len-1], key_len)];
+  // Keys are not case sensitive
+  if ( entry->len == key_len && g_ascii_strncasecmp ( key, entry->name, key_len ) == 0 )
+    return entry->key;
+  return GPSPOINT_KEY_UNKNOWN;
+}
+
+/*
+ * Convert a number from the value, which is not nul terminated
+ * Plain decimal numbers (as written by Viking) use the quick conversion
+ */
+static gdouble gpspoint_strtod ( const gchar *value, guint value_len )
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+  if ( value_len >= G_ASCII_DTOSTR_BUF_SIZE )
+    return g_ascii_strtod ( value, NULL );
+  memcpy ( buffer, value, value_len );
+  buffer[value_len] = '\0';
+  return util_ascii_strtod ( buffer );
+}
+
 /*
 value = NULL for none
 */
-static void gpspoint_process_key_and_value ( const gchar *key, guint key_len, const gchar *value, guint value_len )
+static void gpspoint_process_key_and_value ( TP_read_info_type *ri, const gchar *key, guint key_len, const gchar *value, guint value_len )
 {
-  if (key_len == 4 && strncasecmp( key, "type", key_len ) == 0 )
-  {
+  gpspoint_key_t gkey = gpspoint_lookup_key ( key, key_len );
+
+  // Only the type has a meaning without a value
+  if ( value == NULL && gkey != GPSPOINT_KEY_TYPE )
+    return;
+
+  switch ( gkey ) {
+  case GPSPOINT_KEY_TYPE:
     if (value == NULL)
-      line_type = GPSPOINT_TYPE_NONE;
-    else if (value_len == 5 && strncasecmp( value, "track", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_TRACK;
-    else if (value_len == 8 && strncasecmp( value, "trackend", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_TRACK_END;
-    else if (value_len == 10 && strncasecmp( value, "trackpoint", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_TRACKPOINT;
-    else if (value_len == 8 && strncasecmp( value, "waypoint", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_WAYPOINT;
-    else if (value_len == 5 && strncasecmp( value, "route", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_ROUTE;
-    else if (value_len == 8 && strncasecmp( value, "routeend", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_ROUTE_END;
-    else if (value_len == 10 && strncasecmp( value, "routepoint", value_len ) == 0 )
-      line_type = GPSPOINT_TYPE_ROUTEPOINT;
+      ri->line_type = GPSPOINT_TYPE_NONE;
+    // By far the most common, so try it first
+    else if (value_len == 10 && g_ascii_strncasecmp( value, "trackpoint", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_TRACKPOINT;
+    else if (value_len == 5 && g_ascii_strncasecmp( value, "track", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_TRACK;
+    else if (value_len == 8 && g_ascii_strncasecmp( value, "trackend", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_TRACK_END;
+    else if (value_len == 8 && g_ascii_strncasecmp( value, "waypoint", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_WAYPOINT;
+    else if (value_len == 5 && g_ascii_strncasecmp( value, "route", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_ROUTE;
+    else if (value_len == 8 && g_ascii_strncasecmp( value, "routeend", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_ROUTE_END;
+    else if (value_len == 10 && g_ascii_strncasecmp( value, "routepoint", value_len ) == 0 )
+      ri->line_type = GPSPOINT_TYPE_ROUTEPOINT;
     else
       /* all others are ignored */
-      line_type = GPSPOINT_TYPE_NONE;
-  }
-  else if (key_len == 4 && strncasecmp( key, "name", key_len ) == 0 && value != NULL)
-  {
-    if (line_name == NULL)
-    {
-      line_name = deslashndup ( value, value_len );
-    }
-  }
-  else if (key_len == 7 && strncasecmp( key, "comment", key_len ) == 0 && value != NULL)
-  {
-    if (line_comment == NULL)
-      line_comment = deslashndup ( value, value_len );
-  }
-  else if (key_len == 11 && strncasecmp( key, "description", key_len ) == 0 && value != NULL)
-  {
-    if (line_description == NULL)
-      line_description = deslashndup ( value, value_len );
-  }
-  else if (key_len == 6 && strncasecmp( key, "source", key_len ) == 0 && value != NULL)
-  {
-    if (line_source == NULL)
-      line_source = deslashndup ( value, value_len );
-  }
+      ri->line_type = GPSPOINT_TYPE_NONE;
+    break;
+  case GPSPOINT_KEY_NAME:
+    if (ri->line_name == NULL)
+      ri->line_name = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_COMMENT:
+    if (ri->line_comment == NULL)
+      ri->line_comment = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_DESCRIPTION:
+    if (ri->line_description == NULL)
+      ri->line_description = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_SOURCE:
+    if (ri->line_source == NULL)
+      ri->line_source = deslashndup ( value, value_len );
+    break;
   // NB using 'xtype' to differentiate from our own 'type' key
-  else if (key_len == 5 && strncasecmp( key, "xtype", key_len ) == 0 && value != NULL)
-  {
-    if (line_xtype == NULL)
-      line_xtype = deslashndup ( value, value_len );
-  }
-  else if (key_len == 5 && strncasecmp( key, "color", key_len ) == 0 && value != NULL)
-  {
-    if (line_color == NULL)
-      line_color = deslashndup ( value, value_len );
-  }
-  else if (key_len == 14 && strncasecmp( key, "draw_name_mode", key_len ) == 0 && value != NULL)
-  {
-    line_name_label = atoi(value);
-  }
-  else if (key_len == 18 && strncasecmp( key, "number_dist_labels", key_len ) == 0 && value != NULL)
-  {
-    line_dist_label = atoi(value);
-  }
-  else if (key_len == 5 && strncasecmp( key, "image", key_len ) == 0 && value != NULL)
-  {
-    if (line_image == NULL)
-      line_image = deslashndup ( value, value_len );
-  }
-  else if (key_len == 15 && strncasecmp( key, "image_direction", key_len ) == 0 && value != NULL)
-  {
-    line_image_direction = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 19 && strncasecmp( key, "image_direction_ref", key_len ) == 0 && value != NULL)
-  {
-    line_image_direction_ref = atoi(value);
-  }
-  else if (key_len == 8 && strncasecmp( key, "latitude", key_len ) == 0 && value != NULL)
-  {
-    line_latlon.lat = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 9 && strncasecmp( key, "longitude", key_len ) == 0 && value != NULL)
-  {
-    line_latlon.lon = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 8 && strncasecmp( key, "altitude", key_len ) == 0 && value != NULL)
-  {
-    line_altitude = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 7 && strncasecmp( key, "visible", key_len ) == 0 && value != NULL && value[0] != 'y' && value[0] != 'Y' && value[0] != 't' && value[0] != 'T')
-  {
-    line_visible = FALSE;
-  }
-  else if (key_len == 6 && strncasecmp( key, "symbol", key_len ) == 0 && value != NULL)
-  {
-    line_symbol = g_strndup ( value, value_len );
-  }
-  else if (key_len == 8 && strncasecmp( key, "unixtime", key_len ) == 0 && value != NULL)
-  {
-    line_timestamp = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 10 && strncasecmp( key, "newsegment", key_len ) == 0 && value != NULL)
-  {
-    line_newsegment = TRUE;
-  }
-  else if (key_len == 8 && strncasecmp( key, "extended", key_len ) == 0 && value != NULL)
-  {
-    line_extended = TRUE;
-  }
-  else if (key_len == 5 && strncasecmp( key, "speed", key_len ) == 0 && value != NULL)
-  {
-    line_speed = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 6 && strncasecmp( key, "course", key_len ) == 0 && value != NULL)
-  {
-    line_course = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 3 && strncasecmp( key, "sat", key_len ) == 0 && value != NULL)
-  {
-    line_sat = atoi(value);
-  }
-  else if (key_len == 3 && strncasecmp( key, "fix", key_len ) == 0 && value != NULL)
-  {
-    line_fix = atoi(value);
-  }
-  else if (key_len == 4 && strncasecmp( key, "hdop", key_len ) == 0 && value != NULL)
-  {
-    line_hdop = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 4 && strncasecmp( key, "vdop", key_len ) == 0 && value != NULL)
-  {
-    line_vdop = g_ascii_strtod(value, NULL);
-  }
-  else if (key_len == 4 && strncasecmp( key, "pdop", key_len ) == 0 && value != NULL)
-  {
-    line_pdop = g_ascii_strtod(value, NULL);
+  case GPSPOINT_KEY_XTYPE:
+    if (ri->line_xtype == NULL)
+      ri->line_xtype = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_COLOR:
+    if (ri->line_color == NULL)
+      ri->line_color = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_DRAW_NAME_MODE:
+    ri->line_name_label = atoi(value);
+    break;
+  case GPSPOINT_KEY_NUMBER_DIST_LABELS:
+    ri->line_dist_label = atoi(value);
+    break;
+  case GPSPOINT_KEY_IMAGE:
+    if (ri->line_image == NULL)
+      ri->line_image = deslashndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_IMAGE_DIRECTION:
+    ri->line_image_direction = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_IMAGE_DIRECTION_REF:
+    ri->line_image_direction_ref = atoi(value);
+    break;
+  case GPSPOINT_KEY_LATITUDE:
+    ri->line_latlon.lat = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_LONGITUDE:
+    ri->line_latlon.lon = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_ALTITUDE:
+    ri->line_altitude = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_VISIBLE:
+    if (value[0] != 'y' && value[0] != 'Y' && value[0] != 't' && value[0] != 'T')
+      ri->line_visible = FALSE;
+    break;
+  case GPSPOINT_KEY_SYMBOL:
+    ri->line_symbol = g_strndup ( value, value_len );
+    break;
+  case GPSPOINT_KEY_UNIXTIME:
+    ri->line_timestamp = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_NEWSEGMENT:
+    ri->line_newsegment = TRUE;
+    break;
+  case GPSPOINT_KEY_EXTENDED:
+    ri->line_extended = TRUE;
+    break;
+  case GPSPOINT_KEY_SPEED:
+    ri->line_speed = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_COURSE:
+    ri->line_course = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_SAT:
+    ri->line_sat = atoi(value);
+    break;
+  case GPSPOINT_KEY_FIX:
+    ri->line_fix = atoi(value);
+    break;
+  case GPSPOINT_KEY_HDOP:
+    ri->line_hdop = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_VDOP:
+    ri->line_vdop = gpspoint_strtod(value, value_len);
+    break;
+  case GPSPOINT_KEY_PDOP:
+    ri->line_pdop = gpspoint_strtod(value, value_len);
+    break;
+  default:
+    break;
   }
 }
 
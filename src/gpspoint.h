@@ -26,7 +26,23 @@
 
 G_BEGIN_DECLS
 
+/**
+ * GpspointSummary:
+ *
+ * What a_gpspoint_read_unparsed() finds out about the data of a layer, without making anything from it
+ */
+typedef struct {
+  LatLonBBox bbox;     /* Bounds of all the positions, or with north < south if there are none */
+  guint n_tracks;
+  guint n_routes;
+  guint n_waypoints;
+  GArray *track_times; /* Of gdouble: the time of the first trackpoint of each track that has one */
+} GpspointSummary;
+
 gboolean a_gpspoint_read_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath );
+gboolean a_gpspoint_read_file_progress ( VikTrwLayer *trw, FILE *f, const gchar *dirpath, VikReadProgressFunc progress, gpointer user_data );
+gboolean a_gpspoint_read_text ( VikTrwLayer *trw, const gchar *text, gsize len, const gchar *dirpath );
+GString *a_gpspoint_read_unparsed ( FILE *f, GpspointSummary *summary );
 void a_gpspoint_write_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath );
 
 G_END_DECLS
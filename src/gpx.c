@@ -37,6 +37,7 @@
 #include "vikutils.h"
 #include <expat.h>
 #include "misc/gtkhtml-private.h"
+#include "misc/fpconv.h"
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
@@ -103,9 +104,11 @@ typedef struct tag_mapping {
         const char *tag_name;           /* xpath-ish tag name */
 } tag_mapping;
 
+typedef struct _GpxWriter GpxWriter;
+
 typedef struct {
 	GpxWritingOptions *options;
-	FILE *file;
+	GpxWriter *writer;
 	const gchar *dirpath;
 } GpxWritingContext;
 
@@ -183,44 +186,80 @@ tag_mapping tag_path_map[] = {
         {0}
 };
 
-static tag_type get_tag(const char *t)
+/*
+ * The paths above made into a tree, with a node for each element that leads to a tag we handle.
+ * Parsing keeps a stack of the nodes of the elements it is in (NULL for any other element),
+ *  so each new element only needs a lookup amongst the children of the current one.
+ */
+typedef struct tag_node {
+        tag_type tag_type;
+        GHashTable *children;           /* of tag_node by element name */
+} tag_node;
+
+static tag_node *tag_node_child ( tag_node *node, const char *el, gboolean create )
+{
+  tag_node *child;
+  if ( !node )
+    return NULL;
+  if ( !node->children ) {
+    if ( !create )
+      return NULL;
+    node->children = g_hash_table_new ( g_str_hash, g_str_equal );
+  }
+  child = g_hash_table_lookup ( node->children, el );
+  if ( !child && create ) {
+    child = g_new0 ( tag_node, 1 );
+    g_hash_table_insert ( node->children, g_strdup ( el ), child );
+  }
+  return child;
+}
+
+static gpointer tag_tree_build ( gpointer data )
 {
-        tag_mapping *tm;
-        for (tm = tag_path_map; tm->tag_type != 0; tm++)
-                if (0 == strcmp(tm->tag_name, t))
-                        return tm->tag_type;
-        return tt_unknown;
+  tag_mapping *tm;
+  tag_node *root = g_new0 ( tag_node, 1 );
+  for (tm = tag_path_map; tm->tag_type != 0; tm++) {
+    gchar **names = g_strsplit ( tm->tag_name + 1, "/", -1 );
+    tag_node *node = root;
+    for ( gchar **name = names; *name; name++ )
+      node = tag_node_child ( node, *name, TRUE );
+    node->tag_type = tm->tag_type;
+    g_strfreev ( names );
+  }
+  return root;
 }
 
 /******************************************/
 
-tag_type current_tag = tt_unknown;
-GString *xpath = NULL;
-GString *c_cdata = NULL;
+/*
+ * The state of reading a GPX file, all kept here so separate files can be read in separate threads
+ */
+typedef struct {
+	VikTrwLayer *vtl;
+	const gchar *dirpath;
 
-/* current ("c_") objects */
-VikTrackpoint *c_tp = NULL;
-VikWaypoint *c_wp = NULL;
-VikTrack *c_tr = NULL;
-VikTRWMetadata *c_md = NULL;
+	tag_type current_tag;
+	GPtrArray *tag_stack;
+	GString *c_cdata;
 
-gchar *c_wp_name = NULL;
-gchar *c_tr_name = NULL;
+	/* current ("c_") objects */
+	VikTrackpoint *c_tp;
+	VikWaypoint *c_wp;
+	VikTrack *c_tr;
+	VikTRWMetadata *c_md;
 
-/* temporary things so we don't have to create them lots of times */
-const gchar *c_slat, *c_slon;
-struct LatLon c_ll;
+	gchar *c_wp_name;
+	gchar *c_tr_name;
 
-/* specialty flags / etc */
-gboolean f_tr_newseg;
-const gchar *c_link = NULL;
-guint unnamed_waypoints = 0;
-guint unnamed_tracks = 0;
-guint unnamed_routes = 0;
+	/* temporary things so we don't have to create them lots of times */
+	struct LatLon c_ll;
 
-typedef struct {
-	VikTrwLayer *vtl;
-	const gchar *dirpath;
+	/* specialty flags / etc */
+	gboolean f_tr_newseg;
+	const gchar *c_link;
+	guint unnamed_waypoints;
+	guint unnamed_tracks;
+	guint unnamed_routes;
 } UserDataT;
 
 static const char *get_attr ( const char **attr, const char *key )
@@ -233,11 +272,12 @@ static const char *get_attr ( const char **attr, const char *key )
   return NULL;
 }
 
-static gboolean set_c_ll ( const char **attr )
+static gboolean set_c_ll ( UserDataT *ud, const char **attr )
 {
+  const gchar *c_slat, *c_slon;
   if ( (c_slat = get_attr ( attr, "lat" )) && (c_slon = get_attr ( attr, "lon" )) ) {
-    c_ll.lat = g_ascii_strtod(c_slat, NULL);
-    c_ll.lon = g_ascii_strtod(c_slon, NULL);
+    ud->c_ll.lat = util_ascii_strtod ( c_slat );
+    ud->c_ll.lon = util_ascii_strtod ( c_slon );
     return TRUE;
   }
   return FALSE;
@@ -245,64 +285,64 @@ static gboolean set_c_ll ( const char **attr )
 
 static void gpx_start(UserDataT *ud, const char *el, const char **attr)
 {
-  static const gchar *tmp;
+  const gchar *tmp;
   VikTrwLayer *vtl = ud->vtl;
 
-  g_string_append_c ( xpath, '/' );
-  g_string_append ( xpath, el );
-  current_tag = get_tag ( xpath->str );
+  tag_node *node = tag_node_child ( g_ptr_array_index ( ud->tag_stack, ud->tag_stack->len-1 ), el, FALSE );
+  g_ptr_array_add ( ud->tag_stack, node );
+  ud->current_tag = node ? node->tag_type : tt_unknown;
 
-  switch ( current_tag ) {
+  switch ( ud->current_tag ) {
 
      case tt_gpx:
-       c_md = vik_trw_metadata_new();
+       ud->c_md = vik_trw_metadata_new();
        // Store creator information if possible
        const gchar *crt = get_attr ( attr, "creator" );
        if ( crt ) {
          // If there is an actual description field it will overwrite this value
-         c_md->description = g_strdup_printf ( _("Created by: %s"), crt );
+         ud->c_md->description = g_strdup_printf ( _("Created by: %s"), crt );
        }
        break;
 
      case tt_wpt:
-       if ( set_c_ll( attr ) ) {
-         c_wp = vik_waypoint_new ();
-         c_wp->visible = TRUE;
+       if ( set_c_ll( ud, attr ) ) {
+         ud->c_wp = vik_waypoint_new ();
+         ud->c_wp->visible = TRUE;
          if ( get_attr ( attr, "hidden" ) )
-           c_wp->visible = FALSE;
+           ud->c_wp->visible = FALSE;
 
-         vik_coord_load_from_latlon ( &(c_wp->coord), vik_trw_layer_get_coord_mode ( vtl ), &c_ll );
+         vik_coord_load_from_latlon ( &(ud->c_wp->coord), vik_trw_layer_get_coord_mode ( vtl ), &ud->c_ll );
        }
        break;
 
      case tt_trk:
      case tt_rte:
-       c_tr = vik_track_new ();
-       vik_track_set_defaults ( c_tr );
-       c_tr->is_route = (current_tag == tt_rte) ? TRUE : FALSE;
-       c_tr->visible = TRUE;
+       ud->c_tr = vik_track_new ();
+       vik_track_set_defaults ( ud->c_tr );
+       ud->c_tr->is_route = (ud->current_tag == tt_rte) ? TRUE : FALSE;
+       ud->c_tr->visible = TRUE;
        if ( get_attr ( attr, "hidden" ) )
-         c_tr->visible = FALSE;
+         ud->c_tr->visible = FALSE;
        break;
 
      case tt_trk_trkseg:
-       f_tr_newseg = TRUE;
+       ud->f_tr_newseg = TRUE;
        break;
 
      case tt_trk_trkseg_trkpt:
-       if ( set_c_ll( attr ) ) {
-         c_tp = vik_trackpoint_new ();
-         vik_coord_load_from_latlon ( &(c_tp->coord), vik_trw_layer_get_coord_mode ( vtl ), &c_ll );
-         if ( f_tr_newseg ) {
-           c_tp->newsegment = TRUE;
-           f_tr_newseg = FALSE;
+       if ( set_c_ll( ud, attr ) ) {
+         ud->c_tp = vik_trackpoint_new ();
+         vik_coord_load_from_latlon ( &(ud->c_tp->coord), vik_trw_layer_get_coord_mode ( vtl ), &ud->c_ll );
+         if ( ud->f_tr_newseg ) {
+           ud->c_tp->newsegment = TRUE;
+           ud->f_tr_newseg = FALSE;
          }
-         c_tr->trackpoints = g_list_prepend ( c_tr->trackpoints, c_tp );
+         ud->c_tr->trackpoints = g_list_prepend ( ud->c_tr->trackpoints, ud->c_tp );
        }
        break;
 
      case tt_wpt_link:
-       c_link = get_attr ( attr, "href" );
+       ud->c_link = get_attr ( attr, "href" );
        break;
      case tt_gpx_name:
      case tt_gpx_author:
@@ -325,26 +365,26 @@ static void gpx_start(UserDataT *ud, const char *el, const char **attr)
      case tt_trk_src:
      case tt_trk_type:
      case tt_trk_name:
-       g_string_erase ( c_cdata, 0, -1 ); /* clear the cdata buffer */
+       g_string_erase ( ud->c_cdata, 0, -1 ); /* clear the cdata buffer */
        break;
 
      case tt_waypoint:
-       c_wp = vik_waypoint_new ();
-       c_wp->visible = TRUE;
+       ud->c_wp = vik_waypoint_new ();
+       ud->c_wp->visible = TRUE;
        break;
 
      case tt_waypoint_coord:
-       if ( set_c_ll( attr ) )
-         vik_coord_load_from_latlon ( &(c_wp->coord), vik_trw_layer_get_coord_mode ( vtl ), &c_ll );
+       if ( set_c_ll( ud, attr ) )
+         vik_coord_load_from_latlon ( &(ud->c_wp->coord), vik_trw_layer_get_coord_mode ( vtl ), &ud->c_ll );
        break;
 
      case tt_waypoint_name:
        if ( ( tmp = get_attr(attr, "id") ) ) {
-         if ( c_wp_name )
-           g_free ( c_wp_name );
-         c_wp_name = g_strdup ( tmp );
+         if ( ud->c_wp_name )
+           g_free ( ud->c_wp_name );
+         ud->c_wp_name = g_strdup ( tmp );
        }
-       g_string_erase ( c_cdata, 0, -1 ); /* clear the cdata buffer for description */
+       g_string_erase ( ud->c_cdata, 0, -1 ); /* clear the cdata buffer for description */
        break;
         
      default: break;
@@ -382,17 +422,15 @@ static void track_tidy_processing ( VikTrwLayer *vtl )
 
 static void gpx_end(UserDataT *ud, const char *el)
 {
-  static GTimeVal tp_time;
-  static GTimeVal wp_time;
   VikTrwLayer *vtl = ud->vtl;
 
-  g_string_truncate ( xpath, xpath->len - strlen(el) - 1 );
+  g_ptr_array_set_size ( ud->tag_stack, ud->tag_stack->len-1 );
 
-  switch ( current_tag ) {
+  switch ( ud->current_tag ) {
 
      case tt_gpx:
-       vik_trw_layer_set_metadata ( vtl, c_md );
-       c_md = NULL;
+       vik_trw_layer_set_metadata ( vtl, ud->c_md );
+       ud->c_md = NULL;
 
        // Essentially the end for a TrackWaypoint layer,
        //  so any specific GPX post processing can occur here
@@ -401,234 +439,227 @@ static void gpx_end(UserDataT *ud, const char *el)
        break;
 
      case tt_gpx_name:
-       vik_layer_rename ( VIK_LAYER(vtl), c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_layer_rename ( VIK_LAYER(vtl), ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_gpx_author:
-       if ( c_md->author )
-         g_free ( c_md->author );
-       c_md->author = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_md->author )
+         g_free ( ud->c_md->author );
+       ud->c_md->author = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_gpx_desc:
-       if ( c_md->description )
-         g_free ( c_md->description );
-       c_md->description = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_md->description )
+         g_free ( ud->c_md->description );
+       ud->c_md->description = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_gpx_keywords:
-       if ( c_md->keywords )
-         g_free ( c_md->keywords );
-       c_md->keywords = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_md->keywords )
+         g_free ( ud->c_md->keywords );
+       ud->c_md->keywords = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_gpx_time:
-       if ( c_md->timestamp )
-         g_free ( c_md->timestamp );
-       c_md->timestamp = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_md->timestamp )
+         g_free ( ud->c_md->timestamp );
+       ud->c_md->timestamp = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_waypoint:
      case tt_wpt:
-       if ( ! c_wp_name )
-         c_wp_name = g_strdup_printf("VIKING_WP%04d", unnamed_waypoints++);
-       vik_trw_layer_filein_add_waypoint ( vtl, c_wp_name, c_wp );
-       g_free ( c_wp_name );
-       c_wp = NULL;
-       c_wp_name = NULL;
+       if ( ! ud->c_wp_name )
+         ud->c_wp_name = g_strdup_printf("VIKING_WP%04d", ud->unnamed_waypoints++);
+       vik_trw_layer_filein_add_waypoint ( vtl, ud->c_wp_name, ud->c_wp );
+       g_free ( ud->c_wp_name );
+       ud->c_wp = NULL;
+       ud->c_wp_name = NULL;
        break;
 
      case tt_trk:
-       if ( ! c_tr_name )
-         c_tr_name = g_strdup_printf("VIKING_TR%03d", unnamed_tracks++);
+       if ( ! ud->c_tr_name )
+         ud->c_tr_name = g_strdup_printf("VIKING_TR%03d", ud->unnamed_tracks++);
        // Delibrate fall through
      case tt_rte:
-       if ( ! c_tr_name )
-         c_tr_name = g_strdup_printf("VIKING_RT%03d", unnamed_routes++);
-       c_tr->trackpoints = g_list_reverse ( c_tr->trackpoints );
-       vik_trw_layer_filein_add_track ( vtl, c_tr_name, c_tr );
-       g_free ( c_tr_name );
-       c_tr = NULL;
-       c_tr_name = NULL;
+       if ( ! ud->c_tr_name )
+         ud->c_tr_name = g_strdup_printf("VIKING_RT%03d", ud->unnamed_routes++);
+       ud->c_tr->trackpoints = g_list_reverse ( ud->c_tr->trackpoints );
+       vik_trw_layer_filein_add_track ( vtl, ud->c_tr_name, ud->c_tr );
+       g_free ( ud->c_tr_name );
+       ud->c_tr = NULL;
+       ud->c_tr_name = NULL;
        break;
 
      case tt_wpt_name:
-       if ( c_wp_name )
-         g_free ( c_wp_name );
-       c_wp_name = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_wp_name )
+         g_free ( ud->c_wp_name );
+       ud->c_wp_name = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_name:
-       if ( c_tr_name )
-         g_free ( c_tr_name );
-       c_tr_name = g_strdup ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       if ( ud->c_tr_name )
+         g_free ( ud->c_tr_name );
+       ud->c_tr_name = g_strdup ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_ele:
-       c_wp->altitude = g_ascii_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_wp->altitude = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_ele:
-       c_tp->altitude = g_ascii_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->altitude = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_waypoint_name: /* .loc name is really description. */
      case tt_wpt_desc:
-       vik_waypoint_set_description ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_description ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_cmt:
-       vik_waypoint_set_comment ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_comment ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_src:
-       vik_waypoint_set_source ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_source ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_type:
-       vik_waypoint_set_type ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_type ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_url:
-       vik_waypoint_set_url ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_url ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_link:
-       if ( c_link ) {
+       if ( ud->c_link ) {
          // Correct <link href="uri"></link> format
-         if ( util_is_url(c_link) ) {
-           vik_waypoint_set_url ( c_wp, c_link );
+         if ( util_is_url(ud->c_link) ) {
+           vik_waypoint_set_url ( ud->c_wp, ud->c_link );
          }
          else {
-           vu_waypoint_set_image_uri ( c_wp, c_link, ud->dirpath );
+           vu_waypoint_set_image_uri ( ud->c_wp, ud->c_link, ud->dirpath );
          }
        }
        else {
          // Fallback for incorrect GPX <link> format (probably from previous versions of Viking!)
          //  of the form <link>file</link>
-         gchar *fn = util_make_absolute_filename ( c_cdata->str, ud->dirpath );
-         vik_waypoint_set_image ( c_wp, fn ? fn : c_cdata->str );
+         gchar *fn = util_make_absolute_filename ( ud->c_cdata->str, ud->dirpath );
+         vik_waypoint_set_image ( ud->c_wp, fn ? fn : ud->c_cdata->str );
          g_free ( fn );
        }
-       c_link = NULL;
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_link = NULL;
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_sym:
-       vik_waypoint_set_symbol ( c_wp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_waypoint_set_symbol ( ud->c_wp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_desc:
-       vik_track_set_description ( c_tr, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_track_set_description ( ud->c_tr, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_src:
-       vik_track_set_source ( c_tr, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_track_set_source ( ud->c_tr, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_type:
-       vik_track_set_type ( c_tr, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_track_set_type ( ud->c_tr, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_cmt:
-       vik_track_set_comment ( c_tr, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_track_set_comment ( ud->c_tr, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_wpt_time:
-       if ( g_time_val_from_iso8601(c_cdata->str, &wp_time) ) {
-	 gdouble d1 = wp_time.tv_sec;
-	 gdouble d2 = (gdouble)wp_time.tv_usec/G_USEC_PER_SEC;
-         c_wp->timestamp = (d1 < 0) ? d1 - d2 : d1 + d2;
-       }
-       g_string_erase ( c_cdata, 0, -1 );
+       util_iso8601_to_timestamp ( ud->c_cdata->str, &ud->c_wp->timestamp );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_name:
-       vik_trackpoint_set_name ( c_tp, c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       vik_trackpoint_set_name ( ud->c_tp, ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_time:
-       if ( g_time_val_from_iso8601(c_cdata->str, &tp_time) ) {
-	 gdouble d1 = tp_time.tv_sec;
-	 gdouble d2 = (gdouble)tp_time.tv_usec/G_USEC_PER_SEC;
-         c_tp->timestamp = (d1 < 0) ? d1 - d2 : d1 + d2;
-       }
-       g_string_erase ( c_cdata, 0, -1 );
+       util_iso8601_to_timestamp ( ud->c_cdata->str, &ud->c_tp->timestamp );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_course:
-       c_tp->course = g_ascii_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->course = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_speed:
-       c_tp->speed = g_ascii_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->speed = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_fix:
-       if (!strcmp("2d", c_cdata->str))
-         c_tp->fix_mode = VIK_GPS_MODE_2D;
-       else if (!strcmp("3d", c_cdata->str))
-         c_tp->fix_mode = VIK_GPS_MODE_3D;
-       else if (!strcmp("dgps", c_cdata->str))
-         c_tp->fix_mode = VIK_GPS_MODE_DGPS;
-       else if (!strcmp("pps", c_cdata->str))
-         c_tp->fix_mode = VIK_GPS_MODE_PPS;
+       if (!strcmp("2d", ud->c_cdata->str))
+         ud->c_tp->fix_mode = VIK_GPS_MODE_2D;
+       else if (!strcmp("3d", ud->c_cdata->str))
+         ud->c_tp->fix_mode = VIK_GPS_MODE_3D;
+       else if (!strcmp("dgps", ud->c_cdata->str))
+         ud->c_tp->fix_mode = VIK_GPS_MODE_DGPS;
+       else if (!strcmp("pps", ud->c_cdata->str))
+         ud->c_tp->fix_mode = VIK_GPS_MODE_PPS;
        else
-         c_tp->fix_mode = VIK_GPS_MODE_NOT_SEEN;
-       g_string_erase ( c_cdata, 0, -1 );
+         ud->c_tp->fix_mode = VIK_GPS_MODE_NOT_SEEN;
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_sat:
-       c_tp->nsats = atoi ( c_cdata->str );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->nsats = atoi ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_hdop:
-       c_tp->hdop = g_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->hdop = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_vdop:
-       c_tp->vdop = g_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->vdop = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      case tt_trk_trkseg_trkpt_pdop:
-       c_tp->pdop = g_strtod ( c_cdata->str, NULL );
-       g_string_erase ( c_cdata, 0, -1 );
+       ud->c_tp->pdop = util_ascii_strtod ( ud->c_cdata->str );
+       g_string_erase ( ud->c_cdata, 0, -1 );
        break;
 
      default: break;
   }
 
-  current_tag = get_tag ( xpath->str );
+  tag_node *parent = g_ptr_array_index ( ud->tag_stack, ud->tag_stack->len-1 );
+  ud->current_tag = parent ? parent->tag_type : tt_unknown;
 }
 
-static void gpx_cdata(void *dta, const XML_Char *s, int len)
+static void gpx_cdata(UserDataT *ud, const XML_Char *s, int len)
 {
-  switch ( current_tag ) {
+  switch ( ud->current_tag ) {
     case tt_gpx_name:
     case tt_gpx_author:
     case tt_gpx_desc:
@@ -660,7 +691,7 @@ static void gpx_cdata(void *dta, const XML_Char *s, int len)
     case tt_trk_trkseg_trkpt_vdop:
     case tt_trk_trkseg_trkpt_pdop:
     case tt_waypoint_name: /* .loc name is really description. */
-      g_string_append_len ( c_cdata, s, len );
+      g_string_append_len ( ud->c_cdata, s, len );
       break;
 
     default: break;  /* ignore cdata from other things */
@@ -670,12 +701,67 @@ static void gpx_cdata(void *dta, const XML_Char *s, int len)
 // make like a "stack" of tag names
 // like gpspoint's separated like /gpx/wpt/whatever
 
+/* Amount of the file given to the parser at once */
+#define GPX_READ_SIZE (256*1024)
+
+#if GLIB_CHECK_VERSION(2,32,0)
+/*
+ * Parse the rest of a regular file straight from memory, without copying it through buffers.
+ * Returns FALSE if the file can not be mapped (and so nothing has been parsed)
+ */
+static gboolean gpx_parse_mapped ( XML_Parser parser, FILE *f, enum XML_Status *status, VikReadProgressFunc progress, gpointer user_data )
+{
+  GStatBuf st;
+  int fd = fileno ( f );
+  if ( fd < 0 || fstat ( fd, &st ) != 0 || !S_ISREG(st.st_mode) )
+    return FALSE;
+  long offset = ftell ( f );
+  if ( offset < 0 || offset > st.st_size )
+    return FALSE;
+
+  GMappedFile *mf = g_mapped_file_new_from_fd ( fd, FALSE, NULL );
+  if ( !mf )
+    return FALSE;
+
+  const gchar *contents = g_mapped_file_get_contents ( mf );
+  gsize length = g_mapped_file_get_length ( mf );
+  gsize pos = offset;
+  do {
+    // The parser takes an int length so large files still go in pieces
+    gsize len = MIN ( length - pos, 64*GPX_READ_SIZE );
+    *status = XML_Parse ( parser, contents + pos, len, pos + len >= length );
+    pos += len;
+    if ( progress && *status != XML_STATUS_ERROR && !progress ( pos - offset, user_data ) )
+      *status = XML_STATUS_ERROR;
+  } while ( pos < length && *status != XML_STATUS_ERROR );
+  g_mapped_file_unref ( mf );
+
+  // Leave the file as if it had been read through
+  fseek ( f, 0, SEEK_END );
+  return TRUE;
+}
+#endif
+
 gboolean a_gpx_read_file( VikTrwLayer *vtl, FILE *f, const gchar* dirpath ) {
+  return a_gpx_read_file_progress ( vtl, f, dirpath, NULL, NULL );
+}
+
+/**
+ * a_gpx_read_file_progress:
+ * @progress: Optional function told how much of the file has been read,
+ *            which can stop the reading (then FALSE is returned)
+ *
+ * As a_gpx_read_file()
+ */
+gboolean a_gpx_read_file_progress ( VikTrwLayer *vtl, FILE *f, const gchar* dirpath, VikReadProgressFunc progress, gpointer user_data )
+{
+  static GOnce tag_tree_once = G_ONCE_INIT;
   XML_Parser parser = XML_ParserCreate(NULL);
   int done=0, len;
+  gsize bytes_read = 0;
   enum XML_Status status = XML_STATUS_ERROR;
 
-  UserDataT *ud = g_malloc (sizeof(UserDataT));
+  UserDataT *ud = g_malloc0 (sizeof(UserDataT));
   ud->vtl     = vtl;
   ud->dirpath = dirpath;
 
@@ -683,27 +769,55 @@ gboolean a_gpx_read_file( VikTrwLayer *vtl, FILE *f, const gchar* dirpath ) {
   XML_SetUserData(parser, ud);
   XML_SetCharacterDataHandler(parser, (XML_CharacterDataHandler) gpx_cdata);
 
-  gchar buf[4096];
-
   g_assert ( f != NULL && vtl != NULL );
 
-  xpath = g_string_new ( "" );
-  c_cdata = g_string_new ( "" );
+  tag_node *tag_tree = g_once ( &tag_tree_once, tag_tree_build, NULL );
+  ud->current_tag = tt_unknown;
+  ud->tag_stack = g_ptr_array_new ();
+  g_ptr_array_add ( ud->tag_stack, tag_tree );
+  ud->c_cdata = g_string_new ( "" );
 
-  unnamed_waypoints = 1;
-  unnamed_tracks = 1;
-  unnamed_routes = 1;
+  ud->unnamed_waypoints = 1;
+  ud->unnamed_tracks = 1;
+  ud->unnamed_routes = 1;
 
+#if GLIB_CHECK_VERSION(2,32,0)
+  if ( !gpx_parse_mapped ( parser, f, &status, progress, user_data ) )
+#endif
   while (!done) {
-    len = fread(buf, 1, sizeof(buf)-7, f);
+    // Read directly into the parser's own buffer
+    void *buf = XML_GetBuffer ( parser, GPX_READ_SIZE );
+    if ( !buf ) {
+      status = XML_STATUS_ERROR;
+      break;
+    }
+    len = fread(buf, 1, GPX_READ_SIZE, f);
     done = feof(f) || !len;
-    status = XML_Parse(parser, buf, len, done);
+    status = XML_ParseBuffer(parser, len, done);
+    if ( status == XML_STATUS_ERROR )
+      break;
+    bytes_read += len;
+    if ( progress && !progress ( bytes_read, user_data ) ) {
+      status = XML_STATUS_ERROR;
+      break;
+    }
   }
 
   XML_ParserFree (parser);
+
+  // Anything left incomplete by a malformed file
+  if ( ud->c_tr )
+    vik_track_free ( ud->c_tr );
+  if ( ud->c_wp )
+    vik_waypoint_free ( ud->c_wp );
+  if ( ud->c_md )
+    vik_trw_metadata_free ( ud->c_md );
+  g_free ( ud->c_wp_name );
+  g_free ( ud->c_tr_name );
+
+  g_ptr_array_free ( ud->tag_stack, TRUE );
+  g_string_free ( ud->c_cdata, TRUE );
   g_free ( ud );
-  g_string_free ( xpath, TRUE );
-  g_string_free ( c_cdata, TRUE );
 
   return status != XML_STATUS_ERROR;
 }
@@ -877,6 +991,230 @@ entitize(const char * str)
 
 /* export GPX */
 
+/*
+ * Output is gathered in a large buffer and written out in big pieces,
+ *  rather than going through many small stdio calls
+ */
+#define GPX_WRITE_BUFFER_SIZE (64*1024)
+
+struct _GpxWriter {
+	FILE *file;
+	gsize len;
+	gint64 day;               /* of date_prefix */
+	gchar date_prefix[12];    /* "YYYY-MM-DDT" */
+	gchar buffer[GPX_WRITE_BUFFER_SIZE];
+};
+
+static GpxWriter *gpx_writer_new ( FILE *f )
+{
+  GpxWriter *gw = g_malloc ( sizeof(GpxWriter) );
+  gw->file = f;
+  gw->len = 0;
+  gw->day = -1;
+  return gw;
+}
+
+static void gpx_writer_flush ( GpxWriter *gw )
+{
+  if ( gw->len ) {
+    fwrite ( gw->buffer, 1, gw->len, gw->file );
+    gw->len = 0;
+  }
+}
+
+static void gpx_writer_free ( GpxWriter *gw )
+{
+  gpx_writer_flush ( gw );
+  g_free ( gw );
+}
+
+/*
+ * Get space for @len more characters
+ */
+static inline gchar *gpx_writer_reserve ( GpxWriter *gw, gsize len )
+{
+  if ( gw->len + len > GPX_WRITE_BUFFER_SIZE )
+    gpx_writer_flush ( gw );
+  return gw->buffer + gw->len;
+}
+
+static void gpx_writer_append ( GpxWriter *gw, const gchar *str, gsize len )
+{
+  if ( len > GPX_WRITE_BUFFER_SIZE ) {
+    gpx_writer_flush ( gw );
+    fwrite ( str, 1, len, gw->file );
+    return;
+  }
+  memcpy ( gpx_writer_reserve ( gw, len ), str, len );
+  gw->len += len;
+}
+
+static inline void gpx_writer_puts ( GpxWriter *gw, const gchar *str )
+{
+  gpx_writer_append ( gw, str, strlen(str) );
+}
+
+/*
+ * As a_coords_dtostr_buffer()
+ * NB Forcing decimal output for very large values gives more than the nominal 24 characters,
+ *  so there is room for a sign, 17 digits and 308 zeroes
+ */
+static void gpx_writer_double ( GpxWriter *gw, gdouble d )
+{
+  gchar *out = gpx_writer_reserve ( gw, 328 );
+  int str_len = fpconv_dtoa ( d, out, 1 );
+  gw->len += MIN ( str_len, COORDS_STR_BUFFER_SIZE-1 );
+}
+
+static void gpx_writer_uint ( GpxWriter *gw, guint value )
+{
+  gchar digits[12];
+  gint nn = sizeof(digits);
+  do {
+    digits[--nn] = '0' + value % 10;
+    value /= 10;
+  } while ( value );
+  gpx_writer_append ( gw, digits + nn, sizeof(digits) - nn );
+}
+
+/*
+ * The same text as entitize() gives, written straight out
+ */
+static void gpx_writer_entitized ( GpxWriter *gw, const gchar *str )
+{
+  static const gchar hex[] = "0123456789abcdef";
+  const gchar *plain = str;
+  const gchar *cp;
+  for ( cp = str; *cp; cp++ ) {
+    const gchar *entity;
+    switch ( *cp ) {
+      case '&': entity = "&amp;"; break;
+      case '\'': entity = "&apos;"; break;
+      case '<': entity = "&lt;"; break;
+      case '>': entity = "&gt;"; break;
+      case '"': entity = "&quot;"; break;
+      default: entity = NULL; break;
+    }
+    if ( !entity && !(*cp & 0x80) )
+      continue;
+
+    gpx_writer_append ( gw, plain, cp - plain );
+    if ( entity )
+      gpx_writer_puts ( gw, entity );
+    else {
+      // Any character outside of U+0000 to U+007F as '&#x...;'
+      int bytes = 0;
+      int value = 0;
+      utf8_to_int ( cp, &bytes, &value );
+      cp += bytes-1;
+      gchar *out = gpx_writer_reserve ( gw, 12 );
+      gint nn = 0;
+      out[nn++] = '&';
+      out[nn++] = '#';
+      out[nn++] = 'x';
+      gint shift = 28;
+      while ( shift > 0 && !((guint)value >> shift) )
+        shift -= 4;
+      for ( ; shift >= 0; shift -= 4 )
+        out[nn++] = hex[((guint)value >> shift) & 0xf];
+      out[nn++] = ';';
+      gw->len += nn;
+    }
+    plain = cp + 1;
+  }
+  gpx_writer_append ( gw, plain, cp - plain );
+}
+
+static inline void gpx_writer_two_digits ( gchar *out, guint value )
+{
+  out[0] = '0' + value / 10;
+  out[1] = '0' + value % 10;
+}
+
+/*
+ * Write an element of the time as g_time_val_to_iso8601() gives it,
+ *  with the date only worked out again when it changes
+ */
+static void gpx_writer_time_element ( GpxWriter *gw, const gchar *indent_and_tag, GTimeVal *tv, const gchar *end_tag )
+{
+  // Only from 1970 up to the end of 9999, otherwise glib versions differ
+  if ( tv->tv_sec < 0 || tv->tv_sec > G_GINT64_CONSTANT(253402300799) || tv->tv_usec < 0 || tv->tv_usec >= G_USEC_PER_SEC ) {
+    gchar *time_iso8601 = g_time_val_to_iso8601 ( tv );
+    if ( time_iso8601 ) {
+      gpx_writer_puts ( gw, indent_and_tag );
+      gpx_writer_puts ( gw, time_iso8601 );
+      gpx_writer_puts ( gw, end_tag );
+    }
+    g_free ( time_iso8601 );
+    return;
+  }
+
+  gint64 day = tv->tv_sec / 86400;
+  guint secs = tv->tv_sec % 86400;
+  if ( day != gw->day ) {
+    // Civil date from the days since the epoch
+    gint64 zz = day + 719468;
+    guint era = zz / 146097;
+    guint doe = zz - era * 146097;
+    guint yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    guint doy = doe - (365*yoe + yoe/4 - yoe/100);
+    guint mp = (5*doy + 2) / 153;
+    guint mday = doy - (153*mp + 2)/5 + 1;
+    guint month = mp < 10 ? mp + 3 : mp - 9;
+    guint year = yoe + era * 400 + (month <= 2);
+
+    gpx_writer_two_digits ( gw->date_prefix, year / 100 );
+    gpx_writer_two_digits ( gw->date_prefix + 2, year % 100 );
+    gw->date_prefix[4] = '-';
+    gpx_writer_two_digits ( gw->date_prefix + 5, month );
+    gw->date_prefix[7] = '-';
+    gpx_writer_two_digits ( gw->date_prefix + 8, mday );
+    gw->date_prefix[10] = 'T';
+    gw->day = day;
+  }
+
+  gpx_writer_puts ( gw, indent_and_tag );
+  gchar *out = gpx_writer_reserve ( gw, 28 );
+  memcpy ( out, gw->date_prefix, 11 );
+  gpx_writer_two_digits ( out + 11, secs / 3600 );
+  out[13] = ':';
+  gpx_writer_two_digits ( out + 14, (secs / 60) % 60 );
+  out[16] = ':';
+  gpx_writer_two_digits ( out + 17, secs % 60 );
+  gint nn = 19;
+  if ( tv->tv_usec != 0 ) {
+    out[nn++] = '.';
+    glong usec = tv->tv_usec;
+    for ( gint ii = 5; ii >= 0; ii-- ) {
+      out[nn+ii] = '0' + usec % 10;
+      usec /= 10;
+    }
+    nn += 6;
+  }
+  out[nn++] = 'Z';
+  gw->len += nn;
+  gpx_writer_puts ( gw, end_tag );
+}
+
+/*
+ * Write an element with entitized text on a line of its own
+ */
+static void gpx_writer_element ( GpxWriter *gw, const gchar *indent_and_tag, const gchar *text, const gchar *end_tag )
+{
+  gpx_writer_puts ( gw, indent_and_tag );
+  gpx_writer_entitized ( gw, text );
+  gpx_writer_puts ( gw, end_tag );
+}
+
+/*
+ * Seconds and microseconds of a timestamp as written
+ */
+static void timestamp_to_timeval ( gdouble ts, GTimeVal *timestamp )
+{
+  timestamp->tv_sec = ts;
+  timestamp->tv_usec = abs((ts-(gint64)ts)*G_USEC_PER_SEC);
+}
+
 /**
  * Note that elements are written in the schema specification order
  */
@@ -886,70 +1224,42 @@ static void gpx_write_waypoint ( VikWaypoint *wp, GpxWritingContext *context )
   if (context->options && !context->options->hidden && !wp->visible)
     return;
 
-  FILE *f = context->file;
+  GpxWriter *gw = context->writer;
   struct LatLon ll;
-  gchar s_lat[COORDS_STR_BUFFER_SIZE];
-  gchar s_lon[COORDS_STR_BUFFER_SIZE];
   gchar *tmp;
   vik_coord_to_latlon ( &(wp->coord), &ll );
-  a_coords_dtostr_buffer ( ll.lat, s_lat );
-  a_coords_dtostr_buffer ( ll.lon, s_lon );
   // NB 'hidden' is not part of any GPX standard - this appears to be a made up Viking 'extension'
   //  luckily most other GPX processing software ignores things they don't understand
-  fprintf ( f, "<wpt lat=\"%s\" lon=\"%s\"%s>\n",
-               s_lat, s_lon, wp->visible ? "" : " hidden=\"hidden\"" );
+  gpx_writer_puts ( gw, "<wpt lat=\"" );
+  gpx_writer_double ( gw, ll.lat );
+  gpx_writer_puts ( gw, "\" lon=\"" );
+  gpx_writer_double ( gw, ll.lon );
+  gpx_writer_puts ( gw, wp->visible ? "\">\n" : "\" hidden=\"hidden\">\n" );
 
   if ( !isnan(wp->altitude) )
   {
-    gchar s_alt[COORDS_STR_BUFFER_SIZE];
-    a_coords_dtostr_buffer ( wp->altitude, s_alt );
-    fprintf ( f, "  <ele>%s</ele>\n", s_alt );
+    gpx_writer_puts ( gw, "  <ele>" );
+    gpx_writer_double ( gw, wp->altitude );
+    gpx_writer_puts ( gw, "</ele>\n" );
   }
 
   if ( !isnan(wp->timestamp) ) {
     GTimeVal timestamp;
-    timestamp.tv_sec = wp->timestamp;
-    timestamp.tv_usec = abs((wp->timestamp-(gint64)wp->timestamp)*G_USEC_PER_SEC);
-
-    gchar *time_iso8601 = g_time_val_to_iso8601 ( &timestamp );
-    if ( time_iso8601 != NULL )
-      fprintf ( f, "  <time>%s</time>\n", time_iso8601 );
-    g_free ( time_iso8601 );
+    timestamp_to_timeval ( wp->timestamp, &timestamp );
+    gpx_writer_time_element ( gw, "  <time>", &timestamp, "</time>\n" );
   }
 
   // Sanity clause
-  if ( wp->name )
-    tmp = entitize ( wp->name );
-  else
-    tmp = g_strdup ("waypoint");
-
-  fprintf ( f, "  <name>%s</name>\n", tmp );
-  g_free ( tmp);
+  gpx_writer_element ( gw, "  <name>", wp->name ? wp->name : "waypoint", "</name>\n" );
 
   if ( wp->comment )
-  {
-    tmp = entitize(wp->comment);
-    fprintf ( f, "  <cmt>%s</cmt>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <cmt>", wp->comment, "</cmt>\n" );
   if ( wp->description )
-  {
-    tmp = entitize(wp->description);
-    fprintf ( f, "  <desc>%s</desc>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <desc>", wp->description, "</desc>\n" );
   if ( wp->source )
-  {
-    tmp = entitize(wp->source);
-    fprintf ( f, "  <src>%s</src>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <src>", wp->source, "</src>\n" );
   if ( wp->url )
-  {
-    tmp = entitize(wp->url);
-    fprintf ( f, "  <url>%s</url>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <url>", wp->url, "</url>\n" );
   if ( wp->image )
   {
     gchar *tmp = NULL;
@@ -963,30 +1273,30 @@ static void gpx_write_waypoint ( VikWaypoint *wp, GpxWritingContext *context )
     }
     if ( !tmp )
       tmp = gtk_html_filename_to_uri ( wp->image );
-    fprintf ( f, "  <link href=\"%s\"></link>\n", tmp );
+    gpx_writer_puts ( gw, "  <link href=\"" );
+    gpx_writer_puts ( gw, tmp );
+    gpx_writer_puts ( gw, "\"></link>\n" );
     g_free ( tmp );
   }
   if ( wp->symbol ) 
   {
-    tmp = entitize(wp->symbol);
     if ( a_vik_gpx_export_wpt_sym_name ( ) ) {
        // Lowercase the symbol name
+       tmp = entitize(wp->symbol);
        gchar *tmp2 = g_utf8_strdown ( tmp, -1 );
-       fprintf ( f, "  <sym>%s</sym>\n",  tmp2 );
+       gpx_writer_puts ( gw, "  <sym>" );
+       gpx_writer_puts ( gw, tmp2 );
+       gpx_writer_puts ( gw, "</sym>\n" );
        g_free ( tmp2 );
+       g_free ( tmp );
     }
     else
-      fprintf ( f, "  <sym>%s</sym>\n", tmp);
-    g_free ( tmp );
+      gpx_writer_element ( gw, "  <sym>", wp->symbol, "</sym>\n" );
   }
   if ( wp->type )
-  {
-    tmp = entitize(wp->type);
-    fprintf ( f, "  <type>%s</type>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <type>", wp->type, "</type>\n" );
 
-  fprintf ( f, "</wpt>\n" );
+  gpx_writer_puts ( gw, "</wpt>\n" );
 }
 
 /**
@@ -994,97 +1304,90 @@ static void gpx_write_waypoint ( VikWaypoint *wp, GpxWritingContext *context )
  */
 static void gpx_write_trackpoint ( VikTrackpoint *tp, GpxWritingContext *context )
 {
-  FILE *f = context->file;
+  GpxWriter *gw = context->writer;
   struct LatLon ll;
-  gchar s_lat[COORDS_STR_BUFFER_SIZE];
-  gchar s_lon[COORDS_STR_BUFFER_SIZE];
-  gchar s_alt[COORDS_STR_BUFFER_SIZE];
-  gchar s_dop[COORDS_STR_BUFFER_SIZE];
-  gchar *time_iso8601;
   vik_coord_to_latlon ( &(tp->coord), &ll );
 
   // No such thing as a rteseg! So make sure we don't put them in
   if ( context->options && !context->options->is_route && tp->newsegment )
-    fprintf ( f, "  </trkseg>\n  <trkseg>\n" );
+    gpx_writer_puts ( gw, "  </trkseg>\n  <trkseg>\n" );
 
-  a_coords_dtostr_buffer ( ll.lat, s_lat );
-  a_coords_dtostr_buffer ( ll.lon, s_lon );
-  fprintf ( f, "  <%spt lat=\"%s\" lon=\"%s\">\n", (context->options && context->options->is_route) ? "rte" : "trk", s_lat, s_lon );
+  gpx_writer_puts ( gw, (context->options && context->options->is_route) ? "  <rtept lat=\"" : "  <trkpt lat=\"" );
+  gpx_writer_double ( gw, ll.lat );
+  gpx_writer_puts ( gw, "\" lon=\"" );
+  gpx_writer_double ( gw, ll.lon );
+  gpx_writer_puts ( gw, "\">\n" );
 
   if ( !isnan(tp->altitude) )
   {
-    a_coords_dtostr_buffer ( tp->altitude, s_alt );
-    fprintf ( f, "    <ele>%s</ele>\n", s_alt );
+    gpx_writer_puts ( gw, "    <ele>" );
+    gpx_writer_double ( gw, tp->altitude );
+    gpx_writer_puts ( gw, "</ele>\n" );
   }
   else if ( context->options != NULL && context->options->force_ele )
   {
-    fprintf ( f, "    <ele>0</ele>\n" );
+    gpx_writer_puts ( gw, "    <ele>0</ele>\n" );
   }
   
-  time_iso8601 = NULL;
   if ( !isnan(tp->timestamp) ) {
     GTimeVal timestamp;
-    timestamp.tv_sec = tp->timestamp;
-    timestamp.tv_usec = abs((tp->timestamp-(gint64)tp->timestamp)*G_USEC_PER_SEC);
-  
-    time_iso8601 = g_time_val_to_iso8601 ( &timestamp );
+    timestamp_to_timeval ( tp->timestamp, &timestamp );
+    gpx_writer_time_element ( gw, "    <time>", &timestamp, "</time>\n" );
   }
   else if ( context->options != NULL && context->options->force_time )
   {
     GTimeVal current;
     g_get_current_time ( &current );
-  
-    time_iso8601 = g_time_val_to_iso8601 ( &current );
+    gpx_writer_time_element ( gw, "    <time>", &current, "</time>\n" );
   }
-  if ( time_iso8601 != NULL )
-    fprintf ( f, "    <time>%s</time>\n", time_iso8601 );
-  g_free(time_iso8601);
-  time_iso8601 = NULL;
   
   if (!isnan(tp->course)) {
-    gchar s_course[COORDS_STR_BUFFER_SIZE];
-    a_coords_dtostr_buffer ( tp->course, s_course );
-    fprintf ( f, "    <course>%s</course>\n", s_course );
+    gpx_writer_puts ( gw, "    <course>" );
+    gpx_writer_double ( gw, tp->course );
+    gpx_writer_puts ( gw, "</course>\n" );
   }
   if (!isnan(tp->speed)) {
-    gchar s_speed[COORDS_STR_BUFFER_SIZE];
-    a_coords_dtostr_buffer ( tp->speed, s_speed );
-    fprintf ( f, "    <speed>%s</speed>\n", s_speed );
+    gpx_writer_puts ( gw, "    <speed>" );
+    gpx_writer_double ( gw, tp->speed );
+    gpx_writer_puts ( gw, "</speed>\n" );
   }
 
-  if (tp->name) {
-    gchar *s_name = entitize(tp->name);
-    fprintf ( f, "    <name>%s</name>\n", s_name );
-    g_free(s_name);
-  }
+  if (tp->name)
+    gpx_writer_element ( gw, "    <name>", tp->name, "</name>\n" );
 
   if (tp->fix_mode == VIK_GPS_MODE_2D)
-    fprintf ( f, "    <fix>2d</fix>\n");
+    gpx_writer_puts ( gw, "    <fix>2d</fix>\n");
   if (tp->fix_mode == VIK_GPS_MODE_3D)
-    fprintf ( f, "    <fix>3d</fix>\n");
+    gpx_writer_puts ( gw, "    <fix>3d</fix>\n");
   if (tp->fix_mode == VIK_GPS_MODE_DGPS)
-    fprintf ( f, "    <fix>dgps</fix>\n");
+    gpx_writer_puts ( gw, "    <fix>dgps</fix>\n");
   if (tp->fix_mode == VIK_GPS_MODE_PPS)
-    fprintf ( f, "    <fix>pps</fix>\n");
-  if (tp->nsats > 0)
-    fprintf ( f, "    <sat>%d</sat>\n", tp->nsats );
+    gpx_writer_puts ( gw, "    <fix>pps</fix>\n");
+  if (tp->nsats > 0) {
+    gpx_writer_puts ( gw, "    <sat>" );
+    gpx_writer_uint ( gw, tp->nsats );
+    gpx_writer_puts ( gw, "</sat>\n" );
+  }
 
   if ( !isnan(tp->hdop) ) {
-    a_coords_dtostr_buffer ( tp->hdop, s_dop );
-    fprintf ( f, "    <hdop>%s</hdop>\n", s_dop );
+    gpx_writer_puts ( gw, "    <hdop>" );
+    gpx_writer_double ( gw, tp->hdop );
+    gpx_writer_puts ( gw, "</hdop>\n" );
   }
 
   if ( !isnan(tp->vdop) ) {
-    a_coords_dtostr_buffer ( tp->vdop, s_dop );
-    fprintf ( f, "    <vdop>%s</vdop>\n", s_dop );
+    gpx_writer_puts ( gw, "    <vdop>" );
+    gpx_writer_double ( gw, tp->vdop );
+    gpx_writer_puts ( gw, "</vdop>\n" );
   }
 
   if ( !isnan(tp->pdop) ) {
-    a_coords_dtostr_buffer ( tp->pdop, s_dop );
-    fprintf ( f, "    <pdop>%s</pdop>\n", s_dop );
+    gpx_writer_puts ( gw, "    <pdop>" );
+    gpx_writer_double ( gw, tp->pdop );
+    gpx_writer_puts ( gw, "</pdop>\n" );
   }
 
-  fprintf ( f, "  </%spt>\n", (context->options && context->options->is_route) ? "rte" : "trk" );
+  gpx_writer_puts ( gw, (context->options && context->options->is_route) ? "  </rtept>\n" : "  </trkpt>\n" );
 }
 
 
@@ -1094,55 +1397,31 @@ static void gpx_write_track ( VikTrack *t, GpxWritingContext *context )
   if (context->options && !context->options->hidden && !t->visible)
     return;
 
-  FILE *f = context->file;
-  gchar *tmp;
+  GpxWriter *gw = context->writer;
   gboolean first_tp_is_newsegment = FALSE; /* must temporarily make it not so, but we want to restore state. not that it matters. */
 
-  // Sanity clause
-  if ( t->name )
-    tmp = entitize ( t->name );
-  else
-    tmp = g_strdup ("track");
-
   // NB 'hidden' is not part of any GPX standard - this appears to be a made up Viking 'extension'
   //  luckily most other GPX processing software ignores things they don't understand
-  fprintf ( f, "<%s%s>\n  <name>%s</name>\n",
-	    t->is_route ? "rte" : "trk",
-	    t->visible ? "" : " hidden=\"hidden\"",
-	    tmp );
-  g_free ( tmp );
+  gpx_writer_puts ( gw, t->is_route ? "<rte" : "<trk" );
+  gpx_writer_puts ( gw, t->visible ? ">\n" : " hidden=\"hidden\">\n" );
+  // Sanity clause
+  gpx_writer_element ( gw, "  <name>", t->name ? t->name : "track", "</name>\n" );
 
   if ( t->comment )
-  {
-    tmp = entitize ( t->comment );
-    fprintf ( f, "  <cmt>%s</cmt>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <cmt>", t->comment, "</cmt>\n" );
 
   if ( t->description )
-  {
-    tmp = entitize ( t->description );
-    fprintf ( f, "  <desc>%s</desc>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <desc>", t->description, "</desc>\n" );
 
   if ( t->source )
-  {
-    tmp = entitize ( t->source );
-    fprintf ( f, "  <src>%s</src>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <src>", t->source, "</src>\n" );
 
   if ( t->type )
-  {
-    tmp = entitize ( t->type );
-    fprintf ( f, "  <type>%s</type>\n", tmp );
-    g_free ( tmp );
-  }
+    gpx_writer_element ( gw, "  <type>", t->type, "</type>\n" );
 
   /* No such thing as a rteseg! */
   if ( !t->is_route )
-    fprintf ( f, "  <trkseg>\n" );
+    gpx_writer_puts ( gw, "  <trkseg>\n" );
 
   if ( t->trackpoints && t->trackpoints->data ) {
     first_tp_is_newsegment = VIK_TRACKPOINT(t->trackpoints->data)->newsegment;
@@ -1153,12 +1432,12 @@ static void gpx_write_track ( VikTrack *t, GpxWritingContext *context )
 
   /* NB apparently no such thing as a rteseg! */
   if (!t->is_route)
-    fprintf ( f, "  </trkseg>\n");
+    gpx_writer_puts ( gw, "  </trkseg>\n");
 
-  fprintf ( f, "</%s>\n", t->is_route ? "rte" : "trk" );
+  gpx_writer_puts ( gw, t->is_route ? "</rte>\n" : "</trk>\n" );
 }
 
-static void gpx_write_header( FILE *f )
+static void gpx_write_header( GpxWriter *gw )
 {
   // Allow overriding the creator value
   // E.g. if something actually cares about it, see for example:
@@ -1167,18 +1446,20 @@ static void gpx_write_header( FILE *f )
   if ( g_strcmp0(creator, "") == 0 )
     creator = g_strdup_printf("Viking %s -- %s", PACKAGE_VERSION, PACKAGE_URL);
 
-  fprintf(f, "<?xml version=\"1.0\"?>\n"
-             "<gpx version=\"1.0\"\n");
-  fprintf(f, "creator=\"%s\"\n", creator);
-  fprintf(f,"xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
-            "xmlns=\"http://www.topografix.com/GPX/1/0\"\n"
-            "xsi:schemaLocation=\"http://www.topografix.com/GPX/1/0 http://www.topografix.com/GPX/1/0/gpx.xsd\">\n");
+  gpx_writer_puts ( gw, "<?xml version=\"1.0\"?>\n"
+                        "<gpx version=\"1.0\"\n" );
+  gpx_writer_puts ( gw, "creator=\"" );
+  gpx_writer_puts ( gw, creator );
+  gpx_writer_puts ( gw, "\"\n" );
+  gpx_writer_puts ( gw, "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+                        "xmlns=\"http://www.topografix.com/GPX/1/0\"\n"
+                        "xsi:schemaLocation=\"http://www.topografix.com/GPX/1/0 http://www.topografix.com/GPX/1/0/gpx.xsd\">\n" );
   g_free(creator);
 }
 
-static void gpx_write_footer( FILE *f )
+static void gpx_write_footer( GpxWriter *gw )
 {
-  fprintf(f, "</gpx>\n");
+  gpx_writer_puts ( gw, "</gpx>\n" );
 }
 
 static int gpx_waypoint_compare(const void *x, const void *y)
@@ -1197,40 +1478,25 @@ static int gpx_track_compare_name(const void *x, const void *y)
 
 void a_gpx_write_file ( VikTrwLayer *vtl, FILE *f, GpxWritingOptions *options, const gchar* dirpath )
 {
-  GpxWritingContext context = { options, f, dirpath };
+  GpxWriter *gw = gpx_writer_new ( f );
+  GpxWritingContext context = { options, gw, dirpath };
 
-  gpx_write_header ( f );
+  gpx_write_header ( gw );
 
-  gchar *tmp;
   const gchar *name = vik_layer_get_name(VIK_LAYER(vtl));
-  if ( name ) {
-    tmp = entitize ( name );
-    fprintf ( f, "  <name>%s</name>\n", tmp );
-    g_free ( tmp );
-  }
+  if ( name )
+    gpx_writer_element ( gw, "  <name>", name, "</name>\n" );
 
   VikTRWMetadata *md = vik_trw_layer_get_metadata (vtl);
   if ( md ) {
-    if ( md->author && strlen(md->author) > 0 ) {
-      tmp = entitize ( md->author );
-      fprintf ( f, "  <author>%s</author>\n", tmp );
-      g_free ( tmp );
-    }
-    if ( md->description && strlen(md->description) > 0) {
-      tmp = entitize ( md->description );
-      fprintf ( f, "  <desc>%s</desc>\n", tmp );
-      g_free ( tmp );
-    }
-    if ( md->timestamp ) {
-      tmp = entitize ( md->timestamp );
-      fprintf ( f, "  <time>%s</time>\n", tmp );
-      g_free ( tmp );
-    }
-    if ( md->keywords && strlen(md->keywords) > 0) {
-      tmp = entitize ( md->keywords );
-      fprintf ( f, "  <keywords>%s</keywords>\n", tmp );
-      g_free ( tmp );
-    }
+    if ( md->author && strlen(md->author) > 0 )
+      gpx_writer_element ( gw, "  <author>", md->author, "</author>\n" );
+    if ( md->description && strlen(md->description) > 0)
+      gpx_writer_element ( gw, "  <desc>", md->description, "</desc>\n" );
+    if ( md->timestamp )
+      gpx_writer_element ( gw, "  <time>", md->timestamp, "</time>\n" );
+    if ( md->keywords && strlen(md->keywords) > 0)
+      gpx_writer_element ( gw, "  <keywords>", md->keywords, "</keywords>\n" );
   }
 
   if ( vik_trw_layer_get_waypoints_visibility(vtl) || (options && options->hidden) ) {
@@ -1294,15 +1560,18 @@ void a_gpx_write_file ( VikTrwLayer *vtl, FILE *f, GpxWritingOptions *options, c
   g_list_free ( gl );
   g_list_free ( glrte );
 
-  gpx_write_footer ( f );
+  gpx_write_footer ( gw );
+  gpx_writer_free ( gw );
 }
 
 void a_gpx_write_track_file ( VikTrack *trk, FILE *f, GpxWritingOptions *options )
 {
-  GpxWritingContext context = {options, f};
-  gpx_write_header ( f );
+  GpxWriter *gw = gpx_writer_new ( f );
+  GpxWritingContext context = { options, gw, NULL };
+  gpx_write_header ( gw );
   gpx_write_track ( trk, &context );
-  gpx_write_footer ( f );
+  gpx_write_footer ( gw );
+  gpx_writer_free ( gw );
 }
 
 /**
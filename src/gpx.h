@@ -38,6 +38,7 @@ typedef struct {
 } GpxWritingOptions;
 
 gboolean a_gpx_read_file ( VikTrwLayer *trw, FILE *f, const gchar* dirpath );
+gboolean a_gpx_read_file_progress ( VikTrwLayer *trw, FILE *f, const gchar* dirpath, VikReadProgressFunc progress, gpointer user_data );
 void a_gpx_write_file ( VikTrwLayer *trw, FILE *f, GpxWritingOptions *options, const gchar *dirpath );
 void a_gpx_write_track_file ( VikTrack *trk, FILE *f, GpxWritingOptions *options );
 
@@ -30,6 +30,9 @@
 #define MAP_ID_EXPEDIA 5
 
 #define MAP_ID_MAPNIK_RENDER 7
+
+// Not a map as such, but DEM layers cache their rendered tiles as well
+#define MAP_ID_DEM_RENDER 8
  
 // Mostly OSM related - except the Blue Marble value
 #define MAP_ID_OSM_MAPNIK 13
@@ -0,0 +1,400 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/*
+ * A plain (Guttman) R-tree with the quadratic split.
+ * Items can be inserted and removed at any time,
+ *  so the tree can be kept up to date as things are edited rather than being rebuilt.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "rtree.h"
+
+#define RTREE_MAX_ENTRIES 16
+#define RTREE_MIN_ENTRIES 6
+
+// Unlike BBOX_INTERSECT() this includes touching edges,
+//  as the boxes of single points have no size
+#define RTREE_OVERLAP(a,b) ((a).south <= (b).north && (a).north >= (b).south && (a).east >= (b).west && (a).west <= (b).east)
+
+typedef struct _RTreeNode RTreeNode;
+
+struct _RTreeNode {
+  RTreeNode *parent;
+  gboolean leaf;
+  guint count;
+  // With one spare entry to hold an overflow until the node is split
+  LatLonBBox bbox[RTREE_MAX_ENTRIES+1];
+  gpointer child[RTREE_MAX_ENTRIES+1]; // The items in a leaf, otherwise the child nodes
+};
+
+struct _VikRTree {
+  RTreeNode *root;
+  GHashTable *leaves; // Of the leaf node holding each item, to find it again for removal
+};
+
+static RTreeNode *node_new ( gboolean leaf )
+{
+  RTreeNode *node = g_new0 ( RTreeNode, 1 );
+  node->leaf = leaf;
+  return node;
+}
+
+static void node_free ( RTreeNode *node )
+{
+  if ( !node->leaf )
+    for ( guint ii = 0; ii < node->count; ii++ )
+      node_free ( node->child[ii] );
+  g_free ( node );
+}
+
+static gdouble bbox_area ( const LatLonBBox *bbox )
+{
+  return (bbox->north - bbox->south) * (bbox->east - bbox->west);
+}
+
+static void bbox_union ( LatLonBBox *dest, const LatLonBBox *bbox )
+{
+  if ( bbox->south < dest->south ) dest->south = bbox->south;
+  if ( bbox->north > dest->north ) dest->north = bbox->north;
+  if ( bbox->west < dest->west ) dest->west = bbox->west;
+  if ( bbox->east > dest->east ) dest->east = bbox->east;
+}
+
+static gdouble bbox_union_area ( const LatLonBBox *aa, const LatLonBBox *bb )
+{
+  LatLonBBox bbox = *aa;
+  bbox_union ( &bbox, bb );
+  return bbox_area ( &bbox );
+}
+
+/*
+ * The node must have at least one entry
+ */
+static LatLonBBox node_bbox ( const RTreeNode *node )
+{
+  LatLonBBox bbox = node->bbox[0];
+  for ( guint ii = 1; ii < node->count; ii++ )
+    bbox_union ( &bbox, &node->bbox[ii] );
+  return bbox;
+}
+
+static guint node_index ( const RTreeNode *node, gconstpointer child )
+{
+  guint ii;
+  for ( ii = 0; ii < node->count; ii++ )
+    if ( node->child[ii] == child )
+      break;
+  return ii;
+}
+
+static void node_add ( VikRTree *rt, RTreeNode *node, const LatLonBBox *bbox, gpointer child )
+{
+  node->bbox[node->count] = *bbox;
+  node->child[node->count] = child;
+  node->count++;
+  if ( node->leaf )
+    g_hash_table_insert ( rt->leaves, child, node );
+  else
+    ((RTreeNode*)child)->parent = node;
+}
+
+static void node_delete ( RTreeNode *node, guint ii )
+{
+  node->count--;
+  if ( ii != node->count ) {
+    node->bbox[ii] = node->bbox[node->count];
+    node->child[ii] = node->child[node->count];
+  }
+}
+
+/*
+ * Share the entries of an overfull node between it and a new sibling
+ */
+static RTreeNode *node_split ( VikRTree *rt, RTreeNode *node )
+{
+  LatLonBBox bbox[RTREE_MAX_ENTRIES+1];
+  gpointer child[RTREE_MAX_ENTRIES+1];
+  guint count = node->count;
+  memcpy ( bbox, node->bbox, count * sizeof(LatLonBBox) );
+  memcpy ( child, node->child, count * sizeof(gpointer) );
+
+  // Start with the two entries that would waste the most area by being together
+  guint seed1 = 0, seed2 = 1;
+  gdouble worst = -G_MAXDOUBLE;
+  for ( guint ii = 0; ii < count; ii++ ) {
+    for ( guint jj = ii+1; jj < count; jj++ ) {
+      gdouble waste = bbox_union_area ( &bbox[ii], &bbox[jj] ) - bbox_area ( &bbox[ii] ) - bbox_area ( &bbox[jj] );
+      if ( waste > worst ) {
+        worst = waste;
+        seed1 = ii;
+        seed2 = jj;
+      }
+    }
+  }
+
+  RTreeNode *sibling = node_new ( node->leaf );
+  node->count = 0;
+  node_add ( rt, node, &bbox[seed1], child[seed1] );
+  node_add ( rt, sibling, &bbox[seed2], child[seed2] );
+  LatLonBBox bbox1 = bbox[seed1];
+  LatLonBBox bbox2 = bbox[seed2];
+
+  // Then each of the rest goes where it enlarges the area least
+  guint remaining = count - 2;
+  for ( guint ii = 0; ii < count; ii++ ) {
+    if ( ii == seed1 || ii == seed2 )
+      continue;
+    gboolean first;
+    // Both nodes must end up with at least the minimum number of entries
+    if ( node->count + remaining <= RTREE_MIN_ENTRIES )
+      first = TRUE;
+    else if ( sibling->count + remaining <= RTREE_MIN_ENTRIES )
+      first = FALSE;
+    else {
+      gdouble area1 = bbox_area ( &bbox1 );
+      gdouble area2 = bbox_area ( &bbox2 );
+      gdouble grow1 = bbox_union_area ( &bbox1, &bbox[ii] ) - area1;
+      gdouble grow2 = bbox_union_area ( &bbox2, &bbox[ii] ) - area2;
+      if ( grow1 != grow2 )
+        first = grow1 < grow2;
+      else if ( area1 != area2 )
+        first = area1 < area2;
+      else
+        first = node->count <= sibling->count;
+    }
+    if ( first ) {
+      node_add ( rt, node, &bbox[ii], child[ii] );
+      bbox_union ( &bbox1, &bbox[ii] );
+    }
+    else {
+      node_add ( rt, sibling, &bbox[ii], child[ii] );
+      bbox_union ( &bbox2, &bbox[ii] );
+    }
+    remaining--;
+  }
+  return sibling;
+}
+
+static RTreeNode *tree_choose_leaf ( VikRTree *rt, const LatLonBBox *bbox )
+{
+  RTreeNode *node = rt->root;
+  while ( !node->leaf ) {
+    guint best = 0;
+    gdouble best_grow = G_MAXDOUBLE;
+    gdouble best_area = G_MAXDOUBLE;
+    for ( guint ii = 0; ii < node->count; ii++ ) {
+      gdouble area = bbox_area ( &node->bbox[ii] );
+      gdouble grow = bbox_union_area ( &node->bbox[ii], bbox ) - area;
+      if ( grow < best_grow || (grow == best_grow && area < best_area) ) {
+        best = ii;
+        best_grow = grow;
+        best_area = area;
+      }
+    }
+    node = node->child[best];
+  }
+  return node;
+}
+
+/*
+ * Update the boxes above a node that has changed,
+ *  splitting any overfull nodes on the way up
+ */
+static void tree_adjust ( VikRTree *rt, RTreeNode *node )
+{
+  while ( node ) {
+    RTreeNode *sibling = NULL;
+    if ( node->count > RTREE_MAX_ENTRIES )
+      sibling = node_split ( rt, node );
+
+    RTreeNode *parent = node->parent;
+    if ( !parent ) {
+      if ( sibling ) {
+        LatLonBBox bbox1 = node_bbox ( node );
+        LatLonBBox bbox2 = node_bbox ( sibling );
+        rt->root = node_new ( FALSE );
+        node_add ( rt, rt->root, &bbox1, node );
+        node_add ( rt, rt->root, &bbox2, sibling );
+      }
+      return;
+    }
+
+    parent->bbox[node_index ( parent, node )] = node_bbox ( node );
+    if ( sibling ) {
+      LatLonBBox bbox = node_bbox ( sibling );
+      node_add ( rt, parent, &bbox, sibling );
+    }
+    node = parent;
+  }
+}
+
+static void tree_insert ( VikRTree *rt, gpointer item, const LatLonBBox *bbox )
+{
+  RTreeNode *leaf = tree_choose_leaf ( rt, bbox );
+  node_add ( rt, leaf, bbox, item );
+  tree_adjust ( rt, leaf );
+}
+
+/*
+ * Put all the items below a node taken out of the tree back in again
+ */
+static void tree_reinsert ( VikRTree *rt, RTreeNode *node )
+{
+  for ( guint ii = 0; ii < node->count; ii++ ) {
+    if ( node->leaf )
+      tree_insert ( rt, node->child[ii], &node->bbox[ii] );
+    else
+      tree_reinsert ( rt, node->child[ii] );
+  }
+  g_free ( node );
+}
+
+VikRTree *vik_rtree_new ( void )
+{
+  VikRTree *rt = g_new0 ( VikRTree, 1 );
+  rt->root = node_new ( TRUE );
+  rt->leaves = g_hash_table_new ( g_direct_hash, g_direct_equal );
+  return rt;
+}
+
+void vik_rtree_free ( VikRTree *rt )
+{
+  if ( !rt )
+    return;
+  node_free ( rt->root );
+  g_hash_table_destroy ( rt->leaves );
+  g_free ( rt );
+}
+
+/**
+ * vik_rtree_clear:
+ *
+ * Remove all the items
+ */
+void vik_rtree_clear ( VikRTree *rt )
+{
+  node_free ( rt->root );
+  rt->root = node_new ( TRUE );
+  g_hash_table_remove_all ( rt->leaves );
+}
+
+guint vik_rtree_size ( VikRTree *rt )
+{
+  return g_hash_table_size ( rt->leaves );
+}
+
+/**
+ * vik_rtree_insert:
+ *
+ * Add an item covering the given area.
+ * If the item is already in the tree then it is moved to the new area.
+ */
+void vik_rtree_insert ( VikRTree *rt, gpointer item, const LatLonBBox *bbox )
+{
+  vik_rtree_remove ( rt, item );
+  tree_insert ( rt, item, bbox );
+}
+
+/**
+ * vik_rtree_remove:
+ *
+ * Returns: TRUE if the item was in the tree
+ */
+gboolean vik_rtree_remove ( VikRTree *rt, gpointer item )
+{
+  RTreeNode *node = g_hash_table_lookup ( rt->leaves, item );
+  if ( !node )
+    return FALSE;
+
+  g_hash_table_remove ( rt->leaves, item );
+  node_delete ( node, node_index ( node, item ) );
+
+  // Take out any nodes left with too few entries, to be reinserted afterwards
+  GSList *orphans = NULL;
+  while ( node->parent ) {
+    RTreeNode *parent = node->parent;
+    guint ii = node_index ( parent, node );
+    if ( node->count < RTREE_MIN_ENTRIES ) {
+      node_delete ( parent, ii );
+      orphans = g_slist_prepend ( orphans, node );
+    }
+    else
+      parent->bbox[ii] = node_bbox ( node );
+    node = parent;
+  }
+
+  // Don't keep a root with only one child
+  while ( !rt->root->leaf && rt->root->count == 1 ) {
+    RTreeNode *root = rt->root;
+    rt->root = root->child[0];
+    rt->root->parent = NULL;
+    g_free ( root );
+  }
+  if ( !rt->root->leaf && rt->root->count == 0 )
+    rt->root->leaf = TRUE;
+
+  for ( GSList *iter = orphans; iter; iter = iter->next )
+    tree_reinsert ( rt, iter->data );
+  g_slist_free ( orphans );
+
+  return TRUE;
+}
+
+/**
+ * vik_rtree_lookup:
+ * @bbox: Set to the area of the item when found, may be NULL
+ *
+ * Returns: TRUE if the item is in the tree
+ */
+gboolean vik_rtree_lookup ( VikRTree *rt, gpointer item, LatLonBBox *bbox )
+{
+  RTreeNode *node = g_hash_table_lookup ( rt->leaves, item );
+  if ( !node )
+    return FALSE;
+  if ( bbox )
+    *bbox = node->bbox[node_index ( node, item )];
+  return TRUE;
+}
+
+static void node_search ( const RTreeNode *node, const LatLonBBox *bbox, GFunc func, gpointer user_data )
+{
+  for ( guint ii = 0; ii < node->count; ii++ ) {
+    if ( RTREE_OVERLAP ( node->bbox[ii], *bbox ) ) {
+      if ( node->leaf )
+        func ( node->child[ii], user_data );
+      else
+        node_search ( node->child[ii], bbox, func, user_data );
+    }
+  }
+}
+
+/**
+ * vik_rtree_search:
+ *
+ * Call the function for each item whose area overlaps the given area, in no particular order.
+ * The tree must not be changed by the function.
+ */
+void vik_rtree_search ( VikRTree *rt, const LatLonBBox *bbox, GFunc func, gpointer user_data )
+{
+  node_search ( rt->root, bbox, func, user_data );
+}
@@ -0,0 +1,47 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __VIKING_RTREE_H
+#define __VIKING_RTREE_H
+
+#include <glib.h>
+
+#include "bbox.h"
+
+G_BEGIN_DECLS
+
+/**
+ * An R-tree of items (any pointer value) each with a bounding box,
+ *  for finding the items within an area without looking at all of them
+ */
+typedef struct _VikRTree VikRTree;
+
+VikRTree *vik_rtree_new ( void );
+void vik_rtree_free ( VikRTree *rt );
+void vik_rtree_clear ( VikRTree *rt );
+guint vik_rtree_size ( VikRTree *rt );
+
+void vik_rtree_insert ( VikRTree *rt, gpointer item, const LatLonBBox *bbox );
+gboolean vik_rtree_remove ( VikRTree *rt, gpointer item );
+gboolean vik_rtree_lookup ( VikRTree *rt, gpointer item, LatLonBBox *bbox );
+
+void vik_rtree_search ( VikRTree *rt, const LatLonBBox *bbox, GFunc func, gpointer user_data );
+
+G_END_DECLS
+
+#endif
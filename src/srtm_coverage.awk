@@ -0,0 +1,47 @@
+# Generate srtm_coverage.h from the SRTM tile listing in srtm_continent.c
+#
+# The result is a 180x360 grid (one character per 1 degree cell, indexed
+#  from the south west corner) giving the index of the continent directory
+#  on the server holding that tile, or a space when there is no tile.
+
+BEGIN {
+  ncont = 0
+}
+
+/^[ \t]*"/ {
+  line = $0
+  while ( match(line, /"[^"]*"/) ) {
+    name = substr(line, RSTART+1, RLENGTH-2)
+    line = substr(line, RSTART+RLENGTH)
+    if ( name !~ /^[NS][0-9][0-9][EW][0-9][0-9][0-9]$/ ) {
+      continents[ncont++] = name
+      continue
+    }
+    lat = substr(name, 2, 2) + 0
+    lon = substr(name, 5, 3) + 0
+    if ( substr(name, 1, 1) == "S" ) lat = -lat
+    if ( substr(name, 4, 1) == "W" ) lon = -lon
+    cell[lat+90, lon+180] = ncont - 1
+  }
+}
+
+END {
+  print "/* Generated file -- Do not edit */"
+  print "/* Generated from srtm_continent.c by srtm_coverage.awk */"
+  print ""
+  print "static const gchar *srtm_continents[] = {"
+  for ( i = 0; i < ncont; i++ )
+    printf "  \"%s\",\n", continents[i]
+  print "  NULL };"
+  print ""
+  print "#define SRTM_COVERAGE_NONE ' '"
+  print ""
+  print "static const gchar srtm_coverage[180][361] = {"
+  for ( lat = 0; lat < 180; lat++ ) {
+    row = ""
+    for ( lon = 0; lon < 360; lon++ )
+      row = row (((lat, lon) in cell) ? cell[lat, lon] : " ")
+    printf "  \"%s\",\n", row
+  }
+  print "};"
+}
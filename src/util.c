@@ -324,6 +324,171 @@ time_t util_timegm (struct tm *tm)
 #endif
 }
 
+/**
+ * util_ascii_strtod:
+ *
+ * Returns: The same value as g_ascii_strtod ( @str, NULL ),
+ *  but found much more quickly for the plain decimal numbers in data files.
+ * Only numbers that can be converted exactly are done the quick way,
+ *  anything else is left to g_ascii_strtod().
+ */
+gdouble util_ascii_strtod ( const gchar *str )
+{
+	// All exactly representable as doubles
+	static const gdouble powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const gchar *pp = str;
+	guint64 mantissa = 0;
+	gint digits = 0;
+	gint exponent = 0;
+	gboolean negative = FALSE;
+
+	while ( *pp == ' ' || *pp == '\t' || *pp == '\n' || *pp == '\r' )
+		pp++;
+	if ( *pp == '-' ) {
+		negative = TRUE;
+		pp++;
+	}
+	else if ( *pp == '+' )
+		pp++;
+
+	for ( ; g_ascii_isdigit(*pp); pp++, digits++ )
+		mantissa = mantissa * 10 + (*pp - '0');
+	if ( *pp == '.' ) {
+		for ( pp++; g_ascii_isdigit(*pp); pp++, digits++, exponent-- )
+			mantissa = mantissa * 10 + (*pp - '0');
+	}
+	// NB 19 digits always fit in a guint64
+	if ( digits == 0 || digits > 19 )
+		return g_ascii_strtod ( str, NULL );
+
+	if ( *pp == 'e' || *pp == 'E' ) {
+		gint sign = 1;
+		gint value = 0;
+		gint exp_digits = 0;
+		pp++;
+		if ( *pp == '-' ) {
+			sign = -1;
+			pp++;
+		}
+		else if ( *pp == '+' )
+			pp++;
+		for ( ; g_ascii_isdigit(*pp) && exp_digits < 4; pp++, exp_digits++ )
+			value = value * 10 + (*pp - '0');
+		if ( exp_digits == 0 )
+			return g_ascii_strtod ( str, NULL );
+		exponent += sign * value;
+	}
+
+	// Anything else following the number (e.g. hex or infinity) is left to the full conversion
+	if ( *pp != '\0' && !g_ascii_isspace(*pp) )
+		return g_ascii_strtod ( str, NULL );
+
+	// A single multiplication or division of exact values is correctly rounded, just as strtod() is
+	if ( mantissa > (G_GUINT64_CONSTANT(1) << 53) || exponent < -22 || exponent > 22 )
+		return g_ascii_strtod ( str, NULL );
+
+	gdouble value = (exponent < 0) ? (gdouble)mantissa / powers[-exponent] : (gdouble)mantissa * powers[exponent];
+	return negative ? -value : value;
+}
+
+/*
+ * Read a fixed number of digits
+ */
+static gboolean read_digits ( const gchar **pp, gint count, gint *value )
+{
+	*value = 0;
+	for ( gint ii = 0; ii < count; ii++ ) {
+		if ( !g_ascii_isdigit((*pp)[ii]) )
+			return FALSE;
+		*value = *value * 10 + ((*pp)[ii] - '0');
+	}
+	*pp += count;
+	return TRUE;
+}
+
+/*
+ * The usual UTC form of 'YYYY-MM-DDTHH:MM:SS[.sss](Z|+HH:MM|-HH:MM)'
+ *  between 1970 and 2099, where the seconds since the epoch can be simply worked out
+ */
+static gboolean iso8601_quick ( const gchar *str, GTimeVal *tv )
+{
+	static const gint days_before[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+	const gchar *pp = str;
+	gint year, mon, mday, hour, min, sec;
+	glong usec = 0;
+	glong offset = 0;
+
+	while ( g_ascii_isspace(*pp) )
+		pp++;
+
+	if ( !read_digits ( &pp, 4, &year ) || *pp++ != '-' ||
+	     !read_digits ( &pp, 2, &mon ) || *pp++ != '-' ||
+	     !read_digits ( &pp, 2, &mday ) || *pp++ != 'T' ||
+	     !read_digits ( &pp, 2, &hour ) || *pp++ != ':' ||
+	     !read_digits ( &pp, 2, &min ) || *pp++ != ':' ||
+	     !read_digits ( &pp, 2, &sec ) )
+		return FALSE;
+	if ( year < 1970 || year > 2099 || mon < 1 || mon > 12 || mday < 1 || mday > 31 ||
+	     hour > 23 || min > 59 || sec > 60 )
+		return FALSE;
+
+	// Fractions of a second are truncated to microseconds
+	if ( *pp == '.' || *pp == ',' ) {
+		glong mul = 100000;
+		for ( pp++; g_ascii_isdigit(*pp); pp++ ) {
+			usec += (*pp - '0') * mul;
+			mul /= 10;
+		}
+	}
+
+	if ( *pp == 'Z' )
+		pp++;
+	else if ( *pp == '+' || *pp == '-' ) {
+		gint sign = (*pp == '+') ? -1 : 1;
+		gint off_hour, off_min;
+		pp++;
+		if ( !read_digits ( &pp, 2, &off_hour ) || *pp++ != ':' || !read_digits ( &pp, 2, &off_min ) || off_min > 59 )
+			return FALSE;
+		offset = sign * 60 * (60 * off_hour + off_min);
+	}
+	else
+		// Local time
+		return FALSE;
+
+	if ( *pp != '\0' )
+		return FALSE;
+
+	// Days since the epoch - no need to worry about centuries not being leap years in this range
+	glong days = (year - 1970) * 365 + (year - 1968) / 4 + days_before[mon-1] + mday - 1;
+	if ( year % 4 == 0 && mon < 3 )
+		days--;
+	tv->tv_sec = ((days * 24 + hour) * 60 + min) * 60 + sec + offset;
+	tv->tv_usec = usec;
+	return tv->tv_sec >= 0;
+}
+
+/**
+ * util_iso8601_to_timestamp:
+ * @timestamp: Set to the seconds since the epoch, including any fraction
+ *
+ * Read an ISO 8601 time, the common forms quickly,
+ *  otherwise using g_time_val_from_iso8601().
+ *
+ * Returns: Whether the time was understood
+ */
+gboolean util_iso8601_to_timestamp ( const gchar *str, gdouble *timestamp )
+{
+	GTimeVal tv;
+	if ( !iso8601_quick ( str, &tv ) && !g_time_val_from_iso8601 ( str, &tv ) )
+		return FALSE;
+	gdouble d1 = tv.tv_sec;
+	gdouble d2 = (gdouble)tv.tv_usec/G_USEC_PER_SEC;
+	*timestamp = (d1 < 0) ? d1 - d2 : d1 + d2;
+	return TRUE;
+}
+
 /**
  * util_is_url:
  *
@@ -72,6 +72,10 @@ void util_make_absolute_filenames ( GList *filenames, const gchar *dirpath );
 
 time_t util_timegm (struct tm *tm);
 
+gdouble util_ascii_strtod ( const gchar *str );
+
+gboolean util_iso8601_to_timestamp ( const gchar *str, gdouble *timestamp );
+
 gchar* util_formatd ( const gchar *format, gdouble dd );
 
 gboolean util_is_url ( const gchar *str );
@@ -46,9 +46,12 @@
 #include "dems.h"
 #include "icons/icons.h"
 #include "bbox.h"
+#include "mapcache.h"
+#include "maputils.h"
+#include "map_ids.h"
+#include "srtm_coverage.h"
 
 #define MAPS_CACHE_DIR maps_layer_default_dir()
-#define SRTM_CACHE_TEMPLATE "%ssrtm3-%s%s%c%02d%c%03d.hgt.zip"
 
 #define SRTM_HTTP_BASE_URL "https://dds.cr.usgs.gov/srtm/version2_1/SRTM3"
 static gchar *base_url = NULL;
@@ -93,6 +96,8 @@ static gchar *params_source[] = {
 static gchar *params_type[] = {
 	N_("Absolute height"),
 	N_("Height gradient"),
+	N_("Hillshade"),
+	N_("Slope"),
 	NULL
 };
 
@@ -104,6 +109,8 @@ enum { DEM_SOURCE_SRTM,
 
 enum { DEM_TYPE_HEIGHT = 0,
        DEM_TYPE_GRADIENT,
+       DEM_TYPE_HILLSHADE,
+       DEM_TYPE_SLOPE,
        DEM_TYPE_NONE,
 };
 
@@ -186,6 +193,10 @@ static gchar *dem_gradient_colors[] = {
 
 static const guint DEM_N_GRADIENT_COLORS = sizeof(dem_gradient_colors)/sizeof(dem_gradient_colors[0]);
 
+/* The above colours as RGB values, for rendering directly into pixbufs */
+static guint8 dem_height_rgb[G_N_ELEMENTS(dem_height_colors)][3];
+static guint8 dem_gradient_rgb[G_N_ELEMENTS(dem_gradient_colors)][3];
+
 
 VikLayerInterface vik_dem_layer_interface = {
   "DEM",
@@ -265,8 +276,23 @@ struct _VikDEMLayer {
 };
 
 // NB Only performed once per program run
+static void dem_colors_to_rgb ( gchar **colors, guint8 rgb[][3], guint n_colors )
+{
+  GdkColor color;
+  guint i;
+  for ( i = 0; i < n_colors; i++ ) {
+    gdk_color_parse ( colors[i], &color );
+    rgb[i][0] = color.red >> 8;
+    rgb[i][1] = color.green >> 8;
+    rgb[i][2] = color.blue >> 8;
+  }
+}
+
 static void vik_dem_class_init ( VikDEMLayerClass *klass )
 {
+  dem_colors_to_rgb ( dem_height_colors, dem_height_rgb, DEM_N_HEIGHT_COLORS );
+  dem_colors_to_rgb ( dem_gradient_colors, dem_gradient_rgb, DEM_N_GRADIENT_COLORS );
+
   // Note if suppling your own base URL - the site must still follow the Continent directory layout
   if ( ! a_settings_get_string ( VIK_SETTINGS_SRTM_HTTP_BASE_URL, &base_url ) ) {
     // Otherwise use the default
@@ -531,6 +557,13 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
 {
   VikDEMColumn *column, *prevcolumn, *nextcolumn;
 
+  // Shading is only available when rendering tiles, so otherwise fall back to the nearest equivalent
+  guint type = vdl->type;
+  if ( type == DEM_TYPE_HILLSHADE )
+    type = DEM_TYPE_HEIGHT;
+  else if ( type == DEM_TYPE_SLOPE )
+    type = DEM_TYPE_GRADIENT;
+
   LatLonBBox vp_bbox = vik_viewport_get_bbox ( vp );
   LatLonBBox dem_bbox = vik_dem_get_bbox ( dem );
 
@@ -603,7 +636,7 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
 
     vik_dem_east_north_to_xy ( dem, start_lon_as, start_lat_as, &start_x, &start_y );
     guint gradient_skip_factor = 1;
-    if(vdl->type == DEM_TYPE_GRADIENT)
+    if(type == DEM_TYPE_GRADIENT)
 	    gradient_skip_factor = skip_factor;
 
     /* verify sane elev interval */
@@ -660,7 +693,7 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
 	    continue;
 
 	  gboolean below_minimum = FALSE;
-          if(vdl->type == DEM_TYPE_HEIGHT) {
+          if(type == DEM_TYPE_HEIGHT) {
             if ( elev != VIK_DEM_INVALID_ELEVATION && elev < vdl->min_elev ) {
               // Prevent 'elev - vdl->min_elev' from being negative so can safely use as array index
               elev = ceil ( vdl->min_elev );
@@ -671,7 +704,7 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
           }
 
           {
-            if(vdl->type == DEM_TYPE_GRADIENT) {
+            if(type == DEM_TYPE_GRADIENT) {
               if( elev == VIK_DEM_INVALID_ELEVATION ) {
                 /* don't draw it */
               } else {
@@ -710,7 +743,7 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
                 vik_viewport_draw_rectangle(vp, vdl->gcsgradient[(gint)floor(((change - vdl->min_elev)/(vdl->max_elev - vdl->min_elev))*(DEM_N_GRADIENT_COLORS-2))+1], TRUE, box_x, box_y, box_width, box_height);
               }
             } else {
-              if(vdl->type == DEM_TYPE_HEIGHT) {
+              if(type == DEM_TYPE_HEIGHT) {
                 if ( elev == VIK_DEM_INVALID_ELEVATION )
                   ; /* don't draw it */
                 else if ( elev <= 0 || below_minimum )
@@ -811,34 +844,354 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
   }
 }
 
-/* return the continent for the specified lat, lon */
-/* TODO */
-static const gchar *srtm_continent_dir ( gint lat, gint lon )
+/**************************************************************
+ **** TILED RENDERING
+ **************************************************************/
+
+/*
+ * When the viewport is at one of the standard tile zoom levels (in Mercator or Lat/Lon drawmodes),
+ *  latlon based DEMs are rendered into pixbuf tiles that are kept in the mapcache.
+ * Thus subsequent redraws (e.g. panning) only need to draw a few pixbufs.
+ * A suitable overview level of the DEM is used so the amount of work per tile is bounded.
+ */
+#define DEM_TILE_SIZE 256
+#define DEM_MAX_TILES 400
+
+/* Light source for hillshading - conventionally from the north west, 45 degrees up */
+#define DEM_HILLSHADE_AZIMUTH 315.0
+#define DEM_HILLSHADE_ALTITUDE 45.0
+
+typedef struct {
+  VikDEMLayer *vdl;
+  VikDEM *dem;
+  gint x, y;          /* Tile position */
+  gdouble tiles;      /* Number of tiles around the world at this zoom */
+  gboolean mercator;
+  guint size;         /* In pixels */
+  GdkPixbuf *pixbuf;  /* The result */
+} DEMTileJob;
+
+static inline gdouble dem_tile_x_to_lon ( gdouble x, gdouble tiles )
+{
+  return (x / tiles * 360.0) - 180.0;
+}
+
+static inline gdouble dem_tile_y_to_lat ( gdouble y, gdouble tiles, gboolean mercator )
+{
+  gdouble lat = 180.0 - (y / tiles * 360.0);
+  return mercator ? DEMERCLAT(lat) : lat;
+}
+
+static inline gdouble dem_lon_to_tile_x ( gdouble lon, gdouble tiles )
+{
+  return (lon + 180.0) / 360.0 * tiles;
+}
+
+static inline gdouble dem_lat_to_tile_y ( gdouble lat, gdouble tiles, gboolean mercator )
+{
+  return (180.0 - (mercator ? MERCLAT(lat) : lat)) / 360.0 * tiles;
+}
+
+/*
+ * Horn's method for the gradient over a row of the grid,
+ *  giving either the hillshade illumination (0 to 1) or the slope (as a tangent).
+ * Written as simple loops over contiguous floats so the compiler can vectorize them.
+ * Invalid values are NaN, which propagate into the results.
+ */
+static void dem_kernel_horn_row ( const gfloat *restrict north,
+                                  const gfloat *restrict mid,
+                                  const gfloat *restrict south,
+                                  gfloat *restrict out,
+                                  guint width,
+                                  gfloat inv_8dx,
+                                  gfloat inv_8dy,
+                                  gboolean hillshade )
+{
+  const gfloat sin_alt = sin ( DEG2RAD(DEM_HILLSHADE_ALTITUDE) );
+  const gfloat lx = cos ( DEG2RAD(DEM_HILLSHADE_ALTITUDE) ) * sin ( DEG2RAD(DEM_HILLSHADE_AZIMUTH) );
+  const gfloat ly = cos ( DEG2RAD(DEM_HILLSHADE_ALTITUDE) ) * cos ( DEG2RAD(DEM_HILLSHADE_AZIMUTH) );
+  guint i;
+
+  if ( hillshade ) {
+    for ( i = 1; i < width-1; i++ ) {
+      gfloat p = ((north[i+1] + 2*mid[i+1] + south[i+1]) - (north[i-1] + 2*mid[i-1] + south[i-1])) * inv_8dx;
+      gfloat q = ((north[i-1] + 2*north[i] + north[i+1]) - (south[i-1] + 2*south[i] + south[i+1])) * inv_8dy;
+      gfloat shade = (sin_alt - p*lx - q*ly) / sqrtf ( 1.0f + p*p + q*q );
+      out[i] = shade < 0.0f ? 0.0f : shade;
+    }
+  }
+  else {
+    for ( i = 1; i < width-1; i++ ) {
+      gfloat p = ((north[i+1] + 2*mid[i+1] + south[i+1]) - (north[i-1] + 2*mid[i-1] + south[i-1])) * inv_8dx;
+      gfloat q = ((north[i-1] + 2*north[i] + north[i+1]) - (south[i-1] + 2*south[i] + south[i+1])) * inv_8dy;
+      out[i] = sqrtf ( p*p + q*q );
+    }
+  }
+}
+
+/*
+ * The same measure as the non tiled 'Height gradient' drawing:
+ *  the sum of differences to the surrounding values (ignoring invalid ones)
+ */
+static void dem_kernel_gradient_row ( const gfloat *restrict north,
+                                      const gfloat *restrict mid,
+                                      const gfloat *restrict south,
+                                      gfloat *restrict out,
+                                      guint width,
+                                      gfloat scale )
 {
-  extern const char *_srtm_continent_data[];
-  static GHashTable *srtm_continent = NULL;
-  const gchar *continent;
-  gchar name[16];
-
-  if (!srtm_continent) {
-    const gchar **s;
-
-    srtm_continent = g_hash_table_new(g_str_hash, g_str_equal);
-    s = _srtm_continent_data;
-    while (*s != (gchar *)-1) {
-      continent = *s++;
-      while (*s) {
-        g_hash_table_insert(srtm_continent, (gpointer) *s, (gpointer) continent);
-        s++;
+  guint i;
+  for ( i = 1; i < width-1; i++ ) {
+    gfloat change = 0.0f;
+    const gfloat nb[8] = { north[i-1], north[i], north[i+1], mid[i-1], mid[i+1], south[i-1], south[i], south[i+1] };
+    guint j;
+    for ( j = 0; j < 8; j++ )
+      if ( !isnan(nb[j]) )
+        change += fabsf ( mid[i] - nb[j] );
+    out[i] = change * scale;
+  }
+}
+
+static inline void dem_set_pixel ( guchar *pixel, const guint8 rgb[3], gdouble shade )
+{
+  pixel[0] = rgb[0] * shade;
+  pixel[1] = rgb[1] * shade;
+  pixel[2] = rgb[2] * shade;
+  pixel[3] = 255;
+}
+
+static void dem_tile_render_worker ( DEMTileJob *job, gpointer user_data )
+{
+  VikDEMLayer *vdl = job->vdl;
+  VikDEM *dem = job->dem;
+  const guint size = job->size;
+  guint px, py;
+
+  // Pick the coarsest level that still has a sample per pixel
+  const gdouble pixel_deg = 360.0 / job->tiles / size;
+  guint level = 0;
+  while ( level+1 < vik_dem_get_n_levels(dem) &&
+          vik_dem_get_level_factor(dem, level+1) * dem->east_scale / 3600.0 <= pixel_deg )
+    level++;
+  const guint factor = vik_dem_get_level_factor ( dem, level );
+  const gdouble east_step = dem->east_scale * factor;
+  const gdouble north_step = dem->north_scale * factor;
+
+  // Level sample for each pixel column and row
+  gint *cols = g_malloc ( sizeof(gint) * size );
+  gint *rows = g_malloc ( sizeof(gint) * size );
+  gint cmin = G_MAXINT, cmax = -1, rmin = G_MAXINT, rmax = -1;
+  for ( px = 0; px < size; px++ ) {
+    gdouble east = dem_tile_x_to_lon ( job->x + (px + 0.5) / size, job->tiles ) * 3600;
+    cols[px] = ( east < dem->min_east || east > dem->max_east ) ? -1 : (gint) floor((east - dem->min_east) / east_step);
+    if ( cols[px] >= 0 ) { cmin = MIN(cmin, cols[px]); cmax = MAX(cmax, cols[px]); }
+  }
+  for ( py = 0; py < size; py++ ) {
+    gdouble north = dem_tile_y_to_lat ( job->y + (py + 0.5) / size, job->tiles, job->mercator ) * 3600;
+    rows[py] = ( north < dem->min_north || north > dem->max_north ) ? -1 : (gint) floor((north - dem->min_north) / north_step);
+    if ( rows[py] >= 0 ) { rmin = MIN(rmin, rows[py]); rmax = MAX(rmax, rows[py]); }
+  }
+
+  if ( cmax < 0 || rmax < 0 ) {
+    // DEM doesn't actually cover this tile
+    g_free ( cols );
+    g_free ( rows );
+    return;
+  }
+
+  // Copy the values needed into a grid, with a border for the neighbours
+  const gint c0 = cmin - 1, r0 = rmin - 1;
+  const guint width = cmax - cmin + 3, height = rmax - rmin + 3;
+  gfloat *elevs = g_malloc ( sizeof(gfloat) * width * height );
+  gfloat *values = NULL;
+  guint i, j;
+  for ( j = 0; j < height; j++ ) {
+    for ( i = 0; i < width; i++ ) {
+      gint16 elev = VIK_DEM_INVALID_ELEVATION;
+      if ( c0 + (gint)i >= 0 && r0 + (gint)j >= 0 )
+        elev = vik_dem_get_level_xy ( dem, level, c0 + i, r0 + j, TRUE );
+      elevs[j*width + i] = ( elev == VIK_DEM_INVALID_ELEVATION ) ? NAN : elev;
+    }
+  }
+
+  if ( vdl->type != DEM_TYPE_HEIGHT ) {
+    values = g_malloc0 ( sizeof(gfloat) * width * height );
+    const gdouble lat = dem_tile_y_to_lat ( job->y + 0.5, job->tiles, job->mercator );
+    const gfloat dx = east_step / 3600.0 * 111320.0 * cos ( DEG2RAD(lat) );
+    const gfloat dy = north_step / 3600.0 * 110574.0;
+    // As per the non tiled version
+    const gfloat scale = 1.0 / ((factor > 1) ? log(factor) : 0.55);
+    for ( j = 1; j < height-1; j++ ) {
+      const gfloat *north = elevs + (j+1)*width;
+      const gfloat *mid = elevs + j*width;
+      const gfloat *south = elevs + (j-1)*width;
+      if ( vdl->type == DEM_TYPE_GRADIENT )
+        dem_kernel_gradient_row ( north, mid, south, values + j*width, width, scale );
+      else
+        dem_kernel_horn_row ( north, mid, south, values + j*width, width, 1.0 / (8*dx), 1.0 / (8*dy), vdl->type == DEM_TYPE_HILLSHADE );
+    }
+  }
+
+  guint8 sea_rgb[3] = { vdl->color.red >> 8, vdl->color.green >> 8, vdl->color.blue >> 8 };
+  const gdouble range = vdl->max_elev - vdl->min_elev;
+
+  job->pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, size, size );
+  gdk_pixbuf_fill ( job->pixbuf, 0x00000000 );
+  const gint rowstride = gdk_pixbuf_get_rowstride ( job->pixbuf );
+  guchar *pixels = gdk_pixbuf_get_pixels ( job->pixbuf );
+
+  for ( py = 0; py < size; py++ ) {
+    if ( rows[py] < 0 )
+      continue;
+    guchar *pixel = pixels + py * rowstride;
+    const guint offset = (rows[py] - r0) * width;
+    for ( px = 0; px < size; px++, pixel += 4 ) {
+      if ( cols[px] < 0 )
+        continue;
+      const guint index = offset + (cols[px] - c0);
+      const gfloat elev = elevs[index];
+      if ( isnan(elev) )
+        continue;
+
+      if ( vdl->type == DEM_TYPE_GRADIENT || vdl->type == DEM_TYPE_SLOPE ) {
+        gdouble fraction;
+        if ( vdl->type == DEM_TYPE_SLOPE ) {
+          if ( isnan(values[index]) )
+            continue;
+          fraction = atan ( values[index] ) / (M_PI/2);
+        }
+        else
+          fraction = (CLAMP(values[index], vdl->min_elev, vdl->max_elev) - vdl->min_elev) / range;
+        dem_set_pixel ( pixel, dem_gradient_rgb[(gint)floor(fraction*(DEM_N_GRADIENT_COLORS-2))+1], 1.0 );
+      }
+      else {
+        // Height colouring, which is optionally shaded
+        gdouble shade = 1.0;
+        if ( vdl->type == DEM_TYPE_HILLSHADE && !isnan(values[index]) )
+          shade = 0.25 + 0.75 * values[index];
+        if ( elev <= 0 || elev < vdl->min_elev )
+          dem_set_pixel ( pixel, sea_rgb, shade );
+        else
+          dem_set_pixel ( pixel, dem_height_rgb[(gint)floor(((MIN(elev, vdl->max_elev) - vdl->min_elev)/range)*(DEM_N_HEIGHT_COLORS-2))+1], shade );
       }
-      s++;
     }
   }
-  g_snprintf(name, sizeof(name), "%c%02d%c%03d",
-                  (lat >= 0) ? 'N' : 'S', ABS(lat),
-		  (lon >= 0) ? 'E' : 'W', ABS(lon));
 
-  return(g_hash_table_lookup(srtm_continent, name));
+  g_free ( values );
+  g_free ( elevs );
+  g_free ( cols );
+  g_free ( rows );
+}
+
+/**
+ * Draw the DEM via tiles from the mapcache, rendering any that are missing.
+ *
+ * Returns: FALSE if the DEM or viewport is not suitable for drawing with tiles
+ */
+static gboolean dem_layer_draw_dem_tiles ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *dem, const gchar *filename )
+{
+  if ( dem->horiz_units != VIK_DEM_HORIZ_LL_ARCSECONDS )
+    return FALSE;
+
+  VikViewportDrawMode mode = vik_viewport_get_drawmode ( vp );
+  if ( mode != VIK_VIEWPORT_DRAWMODE_MERCATOR && mode != VIK_VIEWPORT_DRAWMODE_LATLON )
+    return FALSE;
+
+  gdouble mpp = vik_viewport_get_xmpp ( vp );
+  gint zoom = map_utils_mpp_to_scale ( mpp );
+  if ( mpp != vik_viewport_get_ympp(vp) || zoom == 255 )
+    return FALSE;
+
+  LatLonBBox vp_bbox = vik_viewport_get_bbox ( vp );
+  LatLonBBox dem_bbox = vik_dem_get_bbox ( dem );
+  if ( ! BBOX_INTERSECT(dem_bbox, vp_bbox) )
+    return TRUE; // Nothing to draw
+
+  const gboolean mercator = ( mode == VIK_VIEWPORT_DRAWMODE_MERCATOR );
+  const gdouble tiles = VIK_GZ(17) / mpp;
+  const guint size = DEM_TILE_SIZE * vik_viewport_get_scale ( vp );
+
+  // Only the tiles covering both the DEM and the viewport
+  gint xmin = floor ( dem_lon_to_tile_x ( MAX(vp_bbox.west, dem_bbox.west), tiles ) );
+  gint xmax = floor ( dem_lon_to_tile_x ( MIN(vp_bbox.east, dem_bbox.east), tiles ) );
+  gint ymin = floor ( dem_lat_to_tile_y ( MIN(vp_bbox.north, dem_bbox.north), tiles, mercator ) );
+  gint ymax = floor ( dem_lat_to_tile_y ( MAX(vp_bbox.south, dem_bbox.south), tiles, mercator ) );
+
+  if ( (xmax-xmin+1) * (ymax-ymin+1) > DEM_MAX_TILES )
+    return FALSE;
+
+  /* verify sane elev interval */
+  if ( vdl->max_elev <= vdl->min_elev )
+    vdl->max_elev = vdl->min_elev + 1;
+
+  // Everything that affects the rendering is part of the cache key
+  gchar *key = g_strdup_printf ( "%s:%d:%d:%d:%02x%02x%02x:%d", filename, vdl->type,
+                                 (gint)vdl->min_elev, (gint)vdl->max_elev,
+                                 vdl->color.red >> 8, vdl->color.green >> 8, vdl->color.blue >> 8, size );
+
+  const guint n_tiles = (xmax-xmin+1) * (ymax-ymin+1);
+  DEMTileJob *jobs = g_new0 ( DEMTileJob, n_tiles );
+  GThreadPool *pool = NULL;
+  gint x, y;
+  guint nn = 0;
+
+  for ( x = xmin; x <= xmax; x++ ) {
+    for ( y = ymin; y <= ymax; y++, nn++ ) {
+      DEMTileJob *job = &jobs[nn];
+      job->x = x;
+      job->y = y;
+      job->pixbuf = a_mapcache_get ( x, y, mode, MAP_ID_DEM_RENDER, zoom, 255, 0.0, 0.0, key );
+      if ( job->pixbuf )
+        continue;
+      // Render missing tiles in parallel
+      job->vdl = vdl;
+      job->dem = dem;
+      job->tiles = tiles;
+      job->mercator = mercator;
+      job->size = size;
+      if ( !pool )
+        pool = g_thread_pool_new ( (GFunc)dem_tile_render_worker, NULL, a_background_get_local_threads(), FALSE, NULL );
+      g_thread_pool_push ( pool, job, NULL );
+    }
+  }
+
+  // Wait for all renders to complete
+  if ( pool )
+    g_thread_pool_free ( pool, FALSE, TRUE );
+
+  // Position of the first tile, the others are simply offset from it
+  VikCoord coord;
+  struct LatLon ll;
+  gint xx, yy;
+  ll.lon = dem_tile_x_to_lon ( xmin, tiles );
+  ll.lat = dem_tile_y_to_lat ( ymin, tiles, mercator );
+  vik_coord_load_from_latlon ( &coord, vik_viewport_get_coord_mode(vp), &ll );
+  vik_viewport_coord_to_screen ( vp, &coord, &xx, &yy );
+
+  for ( nn = 0; nn < n_tiles; nn++ ) {
+    DEMTileJob *job = &jobs[nn];
+    if ( !job->pixbuf )
+      continue;
+    if ( job->dem )
+      a_mapcache_add ( job->pixbuf, (mapcache_extra_t) {0.0}, job->x, job->y, mode, MAP_ID_DEM_RENDER, zoom, 255, 0.0, 0.0, key );
+    vik_viewport_draw_pixbuf ( vp, job->pixbuf, 0, 0, xx + (job->x-xmin)*size, yy + (job->y-ymin)*size, size, size );
+    g_object_unref ( job->pixbuf );
+  }
+
+  g_free ( jobs );
+  g_free ( key );
+  return TRUE;
+}
+
+/* return the continent for the specified lat, lon */
+static const gchar *srtm_continent_dir ( gint lat, gint lon )
+{
+  if ( lat < -90 || lat >= 90 || lon < -180 || lon >= 180 )
+    return NULL;
+  gchar code = srtm_coverage[lat+90][lon+180];
+  if ( code == SRTM_COVERAGE_NONE )
+    return NULL;
+  return srtm_continents[code - '0'];
 }
 
 static void dem_layer_draw ( VikDEMLayer *vdl, VikViewport *vp )
@@ -859,7 +1212,8 @@ static void dem_layer_draw ( VikDEMLayer *vdl, VikViewport *vp )
   while ( dems_iter ) {
     dem = a_dems_get ( (const char *) (dems_iter->data) );
     if ( dem )
-      vik_dem_layer_draw_dem ( vdl, vp, dem );
+      if ( ! dem_layer_draw_dem_tiles ( vdl, vp, dem, (const gchar *) (dems_iter->data) ) )
+        vik_dem_layer_draw_dem ( vdl, vp, dem );
     dems_iter = dems_iter->next;
   }
 }
@@ -913,6 +1267,83 @@ typedef struct {
  *  SOURCE: SRTM                                  *
  **************************************************/
 
+/*
+ * Index of the SRTM files in the cache directory (a bit per degree cell),
+ *  so drawing their existence does not need to probe the filesystem for every cell.
+ * The directories are only rescanned when they have been modified.
+ */
+static guint8 srtm_index[180][360/8];
+static gchar *srtm_index_dir = NULL;
+static time_t srtm_index_mtimes[G_N_ELEMENTS(srtm_continents)];
+G_LOCK_DEFINE_STATIC(srtm_index);
+
+/* Must be called with the srtm_index lock held */
+static void srtm_index_set ( gint lat, gint lon )
+{
+  if ( lat < -90 || lat >= 90 || lon < -180 || lon >= 180 )
+    return;
+  srtm_index[lat+90][(lon+180)/8] |= 1 << ((lon+180)%8);
+}
+
+/* Must be called with the srtm_index lock held */
+static gboolean srtm_index_get ( gint lat, gint lon )
+{
+  if ( lat < -90 || lat >= 90 || lon < -180 || lon >= 180 )
+    return FALSE;
+  return srtm_index[lat+90][(lon+180)/8] & (1 << ((lon+180)%8));
+}
+
+static void srtm_index_add ( gint lat, gint lon )
+{
+  G_LOCK(srtm_index);
+  srtm_index_set ( lat, lon );
+  G_UNLOCK(srtm_index);
+}
+
+/* Must be called with the srtm_index lock held */
+static void srtm_index_refresh ()
+{
+  const gchar *cache_dir = MAPS_CACHE_DIR;
+  time_t mtimes[G_N_ELEMENTS(srtm_continents)] = { 0 };
+  gchar *dirs[G_N_ELEMENTS(srtm_continents)] = { NULL };
+  guint cc;
+
+  for ( cc = 0; srtm_continents[cc]; cc++ ) {
+    GStatBuf stat_buf;
+    dirs[cc] = g_strdup_printf ( "%ssrtm3-%s", cache_dir, srtm_continents[cc] );
+    if ( g_stat ( dirs[cc], &stat_buf ) == 0 )
+      mtimes[cc] = stat_buf.st_mtime;
+  }
+
+  if ( g_strcmp0 ( cache_dir, srtm_index_dir ) != 0 ||
+       memcmp ( mtimes, srtm_index_mtimes, sizeof(mtimes) ) != 0 ) {
+    g_debug ( "%s: rescanning %s", __FUNCTION__, cache_dir );
+    memset ( srtm_index, 0, sizeof(srtm_index) );
+    for ( cc = 0; srtm_continents[cc]; cc++ ) {
+      GDir *dir = mtimes[cc] ? g_dir_open ( dirs[cc], 0, NULL ) : NULL;
+      if ( !dir )
+        continue;
+      const gchar *name;
+      while ( (name = g_dir_read_name ( dir )) ) {
+        gchar ns, ew;
+        gint lat, lon;
+        if ( !g_str_has_suffix ( name, ".hgt.zip" ) ||
+             sscanf ( name, "%c%2d%c%3d", &ns, &lat, &ew, &lon ) != 4 ||
+             (ns != 'N' && ns != 'S') || (ew != 'E' && ew != 'W') )
+          continue;
+        srtm_index_set ( ns == 'S' ? -lat : lat, ew == 'W' ? -lon : lon );
+      }
+      g_dir_close ( dir );
+    }
+    g_free ( srtm_index_dir );
+    srtm_index_dir = g_strdup ( cache_dir );
+    memcpy ( srtm_index_mtimes, mtimes, sizeof(mtimes) );
+  }
+
+  for ( cc = 0; srtm_continents[cc]; cc++ )
+    g_free ( dirs[cc] );
+}
+
 static void srtm_dem_download_thread ( DEMDownloadParams *p, gpointer threaddata )
 {
   gint intlat, intlon;
@@ -958,6 +1389,8 @@ static void srtm_dem_download_thread ( DEMDownloadParams *p, gpointer threaddata
     }
     case DOWNLOAD_SUCCESS:
     case DOWNLOAD_NOT_REQUIRED:
+      srtm_index_add ( intlat, intlon );
+      break;
     default:
       break;
   }
@@ -990,25 +1423,16 @@ static gchar *srtm_lat_lon_to_dest_fn ( gdouble lat, gdouble lon )
 static void srtm_draw_existence ( VikViewport *vp )
 {
   gdouble max_lat, max_lon, min_lat, min_lon;  
-  gchar buf[strlen(MAPS_CACHE_DIR)+strlen(SRTM_CACHE_TEMPLATE)+30];
   gint i, j;
 
   vik_viewport_get_min_max_lat_lon ( vp, &min_lat, &max_lat, &min_lon, &max_lon );
 
-  for (i = floor(min_lat); i <= floor(max_lat); i++) {
-    for (j = floor(min_lon); j <= floor(max_lon); j++) {
-      const gchar *continent_dir;
-      if ((continent_dir = srtm_continent_dir(i, j)) == NULL)
-        continue;
-      g_snprintf(buf, sizeof(buf), SRTM_CACHE_TEMPLATE,
-                MAPS_CACHE_DIR,
-                continent_dir,
-                G_DIR_SEPARATOR_S,
-		(i >= 0) ? 'N' : 'S',
-		ABS(i),
-		(j >= 0) ? 'E' : 'W',
-		ABS(j) );
-      if ( g_file_test(buf, G_FILE_TEST_EXISTS ) == TRUE ) {
+  G_LOCK(srtm_index);
+  srtm_index_refresh ();
+
+  for (i = MAX(floor(min_lat), -90); i <= MIN(floor(max_lat), 89); i++) {
+    for (j = MAX(floor(min_lon), -180); j <= MIN(floor(max_lon), 179); j++) {
+      if ( srtm_index_get ( i, j ) ) {
         VikCoord ne, sw;
         gint x1, y1, x2, y2;
         sw.north_south = i;
@@ -1026,6 +1450,7 @@ static void srtm_draw_existence ( VikViewport *vp )
       }
     }
   }
+  G_UNLOCK(srtm_index);
 }
 
 
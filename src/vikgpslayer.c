@@ -1184,11 +1184,11 @@ static void gps_download_progress_func(BabelProgressCode c, gpointer data, GpsSe
 {
   gchar *line;
 
+  // Once cancelled, gps_comm_thread() finishes up when the transfer returns
   if ( !sess->ok ) {
-    //gps_session_delete(sess);
-    sess->thread_complete = TRUE;
-    g_debug ("THREAD EXIT INTERUPPT");
-    g_thread_exit ( NULL );
+    if ( c == BABEL_QUERY_CANCEL )
+      *(gboolean*)data = TRUE;
+    return;
   }
 
   switch(c) {
@@ -1258,9 +1258,9 @@ static void gps_upload_progress_func(BabelProgressCode c, gpointer data, GpsSess
   static int cnt = 0;
 
   if ( !sess->ok ) {
-    //gps_session_delete(sess);
-    sess->thread_complete = TRUE;
-    g_thread_exit ( NULL );
+    if ( c == BABEL_QUERY_CANCEL )
+      *(gboolean*)data = TRUE;
+    return;
   }
 
   switch(c) {
@@ -1672,7 +1672,6 @@ static void realtime_tracking_draw(VikGpsLayer *vgl, VikViewport *vp)
 static VikTrackpoint* create_realtime_trackpoint(VikGpsLayer *vgl, gboolean forced)
 {
     struct LatLon ll;
-    GList *last_tp;
 
     gdouble cur_timestamp = vgl->realtime_fix.fix.time;
     gdouble last_timestamp = vgl->last_fix.fix.time;
@@ -1687,12 +1686,11 @@ static VikTrackpoint* create_realtime_trackpoint(VikGpsLayer *vgl, gboolean forc
       int last_heading = isnan(vgl->last_fix.fix.track) ? 0 : (int)floor(vgl->last_fix.fix.track);
       int alt = isnan(vgl->realtime_fix.fix.altitude) ? 0 : (int)floor(vgl->realtime_fix.fix.altitude);
       int last_alt = isnan(vgl->last_fix.fix.altitude) ? 0 : (int)floor(vgl->last_fix.fix.altitude);
-      if (((last_tp = g_list_last(vgl->realtime_track->trackpoints)) != NULL) &&
+      if ((vgl->realtime_track->trackpoints != NULL) &&
           (vgl->realtime_fix.fix.mode > MODE_2D) &&
           (vgl->last_fix.fix.mode <= MODE_2D) &&
           ((cur_timestamp - last_timestamp) < 2)) {
-        g_free(last_tp->data);
-        vgl->realtime_track->trackpoints = g_list_delete_link(vgl->realtime_track->trackpoints, last_tp);
+        vik_track_remove_last_trackpoint ( vgl->realtime_track );
         replace = TRUE;
       }
       if (replace ||
@@ -175,24 +175,20 @@ static void calendar_mark_layer_in_month ( VikLayersPanel *vlp, VikTrwLayer *vtl
   guint year, month, day;
   gtk_calendar_get_date ( GTK_CALENDAR(vlp->calendar), &year, &month, &day );
   GDate *gd = g_date_new();
-  GHashTable *trks = vik_trw_layer_get_tracks ( vtl ); 
-  GHashTableIter iter;
-  gpointer key, value;
+  // Doesn't need the layer's tracks to be loaded
+  GArray *times = vik_trw_layer_get_track_times ( vtl );
+  guint ii;
   // Foreach Track
-  g_hash_table_iter_init ( &iter, trks );
-  while ( g_hash_table_iter_next ( &iter, &key, &value ) ) {
-    VikTrack *trk = VIK_TRACK(value);
-    // First trackpoint
-    if ( trk->trackpoints && !isnan(VIK_TRACKPOINT(trk->trackpoints->data)->timestamp) ) {
-      // Not worried about subsecond resolution here!
-      g_date_set_time_t ( gd, (time_t)VIK_TRACKPOINT(trk->trackpoints->data)->timestamp );
-      // Is in selected month?
-      if ( g_date_get_year(gd) == year && (g_date_get_month(gd) == (month+1)) ) {
-	gtk_calendar_mark_day ( GTK_CALENDAR(vlp->calendar), g_date_get_day(gd) );
-	break;
-      }
+  for ( ii = 0; ii < times->len; ii++ ) {
+    // Not worried about subsecond resolution here!
+    g_date_set_time_t ( gd, (time_t)g_array_index ( times, gdouble, ii ) );
+    // Is in selected month?
+    if ( g_date_get_year(gd) == year && (g_date_get_month(gd) == (month+1)) ) {
+      gtk_calendar_mark_day ( GTK_CALENDAR(vlp->calendar), g_date_get_day(gd) );
+      break;
     }
   }
+  g_array_free ( times, TRUE );
   g_date_free ( gd );
 }
 
@@ -389,26 +385,22 @@ static gchar *calendar_detail ( GtkCalendar *calendar,
   while ( layers ) {
     vtl = VIK_TRW_LAYER(layers->data);
 
-    GHashTable *trks = vik_trw_layer_get_tracks ( vtl ); 
-    GHashTableIter iter;
-    gpointer key, value;
+    // Doesn't need the layer's tracks to be loaded
+    GArray *times = vik_trw_layer_get_track_times ( vtl );
+    guint ii;
     // Foreach Track
-    g_hash_table_iter_init ( &iter, trks );
-    while ( g_hash_table_iter_next ( &iter, &key, &value ) ) {
-      VikTrack *trk = VIK_TRACK(value);
-      // First trackpoint
-      if ( trk->trackpoints && !isnan(VIK_TRACKPOINT(trk->trackpoints->data)->timestamp) ) {
-        // Not worried about subsecond resolution here!
-        g_date_set_time_t ( gd, (time_t)VIK_TRACKPOINT(trk->trackpoints->data)->timestamp );
-        // Is of this day?
-        if ( g_date_get_year(gd) == year &&
-             g_date_get_month(gd) == (month+1) &&
-             g_date_get_day(gd) == day ) {
-          need_to_break = TRUE;
-	  break;
-	}
+    for ( ii = 0; ii < times->len; ii++ ) {
+      // Not worried about subsecond resolution here!
+      g_date_set_time_t ( gd, (time_t)g_array_index ( times, gdouble, ii ) );
+      // Is of this day?
+      if ( g_date_get_year(gd) == year &&
+           g_date_get_month(gd) == (month+1) &&
+           g_date_get_day(gd) == day ) {
+        need_to_break = TRUE;
+        break;
       }
     }
+    g_array_free ( times, TRUE );
     // Fully exit
     if ( need_to_break )
       break;
@@ -38,11 +38,21 @@
 #include "globals.h"
 #include "dems.h"
 #include "settings.h"
+#include "background.h"
+
+// Source of the track revisions, so no two tracks (even one freed and another since created) share one
+static gint track_revision = 0;
+
+static void track_revise ( VikTrack *tr )
+{
+  tr->revision = (guint)g_atomic_int_add ( &track_revision, 1 );
+}
 
 VikTrack *vik_track_new()
 {
   VikTrack *tr = g_malloc0 ( sizeof ( VikTrack ) );
   tr->ref_count = 1;
+  track_revise ( tr );
   return tr;
 }
 
@@ -115,13 +125,15 @@ void vik_track_set_source(VikTrack *tr, const gchar *source)
     tr->source = NULL;
 }
 
+/**
+ * vik_track_set_type:
+ *
+ * Types are generally shared by many tracks, so only one copy of each is kept
+ */
 void vik_track_set_type(VikTrack *tr, const gchar *type)
 {
-  if ( tr->type )
-    g_free ( tr->type );
-
   if ( type && type[0] != '\0' )
-    tr->type = g_strdup(type);
+    tr->type = g_intern_string(type);
   else
     tr->type = NULL;
 }
@@ -155,10 +167,9 @@ void vik_track_free(VikTrack *tr)
     g_free ( tr->description );
   if ( tr->source )
     g_free ( tr->source );
-  if ( tr->type )
-    g_free ( tr->type );
   g_list_foreach ( tr->trackpoints, (GFunc) vik_trackpoint_free, NULL );
   g_list_free( tr->trackpoints );
+  vik_track_invalidate ( tr );
   if (tr->property_dialog)
     if ( GTK_IS_WIDGET(tr->property_dialog) )
       gtk_widget_destroy ( GTK_WIDGET(tr->property_dialog) );
@@ -207,7 +218,9 @@ VikTrack *vik_track_copy ( const VikTrack *tr, gboolean copy_points )
 
 VikTrackpoint *vik_trackpoint_new()
 {
-  VikTrackpoint *tp = g_malloc0(sizeof(VikTrackpoint));
+  // Trackpoints are created and freed in very large numbers,
+  //  so use the slice allocator rather than the general heap
+  VikTrackpoint *tp = g_slice_new0(VikTrackpoint);
   tp->timestamp = NAN;
   tp->speed = NAN;
   tp->course = NAN;
@@ -221,7 +234,7 @@ VikTrackpoint *vik_trackpoint_new()
 void vik_trackpoint_free(VikTrackpoint *tp)
 {
   g_free(tp->name);
-  g_free(tp);
+  g_slice_free(VikTrackpoint, tp);
 }
 
 void vik_trackpoint_set_name(VikTrackpoint *tp, const gchar *name)
@@ -247,20 +260,499 @@ VikTrackpoint *vik_trackpoint_copy(VikTrackpoint *tp)
   return new_tp;
 }
 
+/**************************************************************
+ **** COLUMNAR DATA
+ **************************************************************/
+
+/*
+ * Returns: The columnar form of the @n_points trackpoints
+ */
+static VikTrackData *track_data_new ( const VikTrack *tr, guint n_points )
+{
+  VikTrackData *data = g_malloc0 ( sizeof(VikTrackData) );
+  guint capacity = MAX ( 1, n_points );
+  data->tps = g_new ( VikTrackpoint*, capacity );
+  data->coords = g_new ( VikCoord, capacity );
+  data->timestamps = g_new ( gdouble, capacity );
+  data->altitudes = g_new ( gdouble, capacity );
+  data->diffs = g_new ( gdouble, capacity );
+  data->newsegments = g_new ( gboolean, capacity );
+  // Can't have more segments than points
+  data->segments = g_new ( guint, capacity );
+  data->distances = g_new ( gdouble, capacity );
+
+  GList *iter;
+  for ( iter = tr->trackpoints; iter; iter = iter->next ) {
+    VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
+    guint ii = data->n_points++;
+    data->tps[ii] = tp;
+    data->coords[ii] = tp->coord;
+    data->timestamps[ii] = tp->timestamp;
+    data->altitudes[ii] = tp->altitude;
+    data->diffs[ii] = ii ? vik_coord_diff ( &(tp->coord), &(data->coords[ii-1]) ) : 0.0;
+    data->distances[ii] = ii ? data->distances[ii-1] + data->diffs[ii] : 0.0;
+    data->newsegments[ii] = tp->newsegment;
+    if ( ii == 0 || tp->newsegment )
+      data->segments[data->n_segments++] = ii;
+  }
+  return data;
+}
+
+static void track_data_free ( VikTrackData *data )
+{
+  if ( !data )
+    return;
+  g_free ( data->tps );
+  g_free ( data->coords );
+  g_free ( data->timestamps );
+  g_free ( data->altitudes );
+  g_free ( data->diffs );
+  g_free ( data->newsegments );
+  g_free ( data->segments );
+  g_free ( data->distances );
+  g_free ( data );
+}
+
+/**
+ * vik_track_get_coords:
+ * @n_points: Returns the number of trackpoints
+ *
+ * Returns: A newly allocated array of the positions of the trackpoints, to be freed with g_free()
+ */
+VikCoord *vik_track_get_coords ( const VikTrack *tr, guint *n_points )
+{
+  VikCoord *coords = g_new ( VikCoord, MAX(1, vik_track_get_tp_count(tr)) );
+  guint ii = 0;
+  GList *iter;
+  for ( iter = tr->trackpoints; iter; iter = iter->next )
+    coords[ii++] = VIK_TRACKPOINT(iter->data)->coord;
+  *n_points = ii;
+  return coords;
+}
+
+/**************************************************************
+ **** DERIVED VALUES
+ **************************************************************/
+
+/*
+ * Values derived from the trackpoints, kept between operations while the track's revision is unchanged.
+ * Since tracks may be read from several threads at once (e.g. those loading files in the background),
+ *  the caches of all tracks are only made, extended or replaced while holding the track_caches lock.
+ * What is returned from them stays valid until the track is next changed, which like any change to the
+ *  list of trackpoints itself must not happen while another thread is reading the track.
+ * The statistics are small and are kept for any track asked about,
+ *  whereas the columns, the lookup arrays and the profiles are only made for tracks that are
+ *  simplified, searched or graphed.
+ */
+struct _VikTrackCache {
+  guint revision;
+  guint n_points;
+  GList *tail;           /* Last link of the trackpoints list */
+  VikTrackStats stats;
+  VikTrackData *data;    /* Only created when first needed */
+  /* Lookup arrays, so positions along the track can be found by binary search; only created when first needed */
+  gdouble *lengths;      /* Distance from the start (ignoring segment gaps) */
+  gdouble *max_times;    /* Latest timestamp up to this point; NAN until the first valid timestamp */
+  GHashTable *indices;   /* Trackpoint -> index+1, only created when first needed */
+  /* Profiles made at one size by vik_track_prepare_profiles() */
+  guint16 profiles_chunks;
+  guint profiles_made;   /* Bitmask of those made (even if the result was NULL) */
+  gdouble *profiles[VIK_TRACK_PROFILE_N];
+};
+
+static void track_cache_free_profiles ( VikTrackCache *cache )
+{
+  guint pp;
+  for ( pp = 0; pp < VIK_TRACK_PROFILE_N; pp++ ) {
+    g_free ( cache->profiles[pp] );
+    cache->profiles[pp] = NULL;
+  }
+  cache->profiles_made = 0;
+}
+
+/*
+ * Free the values that depend on every point, keeping the statistics
+ */
+static void track_cache_clear ( VikTrackCache *cache )
+{
+  track_data_free ( cache->data );
+  g_free ( cache->lengths );
+  g_free ( cache->max_times );
+  cache->data = NULL;
+  cache->lengths = NULL;
+  cache->max_times = NULL;
+  if ( cache->indices )
+    g_hash_table_destroy ( cache->indices );
+  cache->indices = NULL;
+  track_cache_free_profiles ( cache );
+}
+
+G_LOCK_DEFINE_STATIC(track_caches);
+
+static void track_cache_free ( VikTrackCache *cache )
+{
+  if ( !cache )
+    return;
+  track_cache_clear ( cache );
+  g_free ( cache );
+}
+
+static void track_stats_init ( VikTrackStats *stats )
+{
+  memset ( stats, 0, sizeof(VikTrackStats) );
+  stats->min_alt = 25000.0;
+  stats->max_alt = -5000.0;
+}
+
+/*
+ * Include the altitude of the point in the extremes
+ */
+static void track_stats_point ( VikTrackStats *stats, VikTrackpoint *tp )
+{
+  if ( tp->altitude > stats->max_alt ) {
+    stats->max_alt = tp->altitude;
+    stats->max_alt_tp = tp;
+  }
+  if ( tp->altitude < stats->min_alt ) {
+    stats->min_alt = tp->altitude;
+    stats->min_alt_tp = tp;
+  }
+}
+
+/*
+ * Add (sign +1) or remove (sign -1) the contribution of the step from @prev to @tp
+ */
+static void track_stats_step ( VikTrackStats *stats, const VikTrackpoint *prev, VikTrackpoint *tp, gdouble sign )
+{
+  gdouble diff = vik_coord_diff ( &(tp->coord), &(prev->coord) );
+  stats->length_including_gaps += sign * diff;
+  if ( !tp->newsegment )
+    stats->length += sign * diff;
+
+  if ( !isnan(tp->timestamp) && !isnan(prev->timestamp) && !tp->newsegment ) {
+    gdouble dt = ABS(tp->timestamp - prev->timestamp);
+    stats->timed_length += sign * diff;
+    stats->timed_duration += sign * dt;
+    if ( sign > 0 ) {
+      gdouble speed = diff / dt;
+      if ( speed > stats->max_speed ) {
+        stats->max_speed = speed;
+        stats->max_speed_tp = tp;
+      }
+    }
+  }
+
+  if ( !isnan(tp->altitude) && !isnan(prev->altitude) ) {
+    gdouble diff = tp->altitude - prev->altitude;
+    if ( diff > 0 )
+      stats->elev_up += sign * diff;
+    else
+      stats->elev_down -= sign * diff;
+  }
+}
+
+/*
+ * Returns: The cache if it's for the current revision of the track, otherwise NULL
+ * The track_caches lock must be held
+ */
+static VikTrackCache *track_cache_current ( const VikTrack *tr )
+{
+  if ( tr->cache && tr->cache->revision == tr->revision )
+    return tr->cache;
+  return NULL;
+}
+
+/*
+ * Returns: The cache for the current revision of the track, (re)making its statistics if necessary
+ * The track_caches lock must be held
+ */
+static VikTrackCache *track_cache_make ( const VikTrack *tr )
+{
+  VikTrackCache *cache = track_cache_current ( tr );
+  if ( cache )
+    return cache;
+
+  cache = tr->cache;
+  if ( cache )
+    track_cache_clear ( cache );
+  else {
+    cache = g_malloc0 ( sizeof(VikTrackCache) );
+    ((VikTrack*)tr)->cache = cache;
+  }
+  cache->revision = tr->revision;
+  cache->n_points = 0;
+  cache->tail = NULL;
+  track_stats_init ( &(cache->stats) );
+
+  GList *iter;
+  for ( iter = tr->trackpoints; iter; iter = iter->next ) {
+    VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
+    if ( cache->tail )
+      track_stats_step ( &(cache->stats), VIK_TRACKPOINT(cache->tail->data), tp, 1.0 );
+    track_stats_point ( &(cache->stats), tp );
+    cache->tail = iter;
+    cache->n_points++;
+  }
+  return cache;
+}
+
+/*
+ * Returns: The cache with its columns, making them if necessary
+ * The track_caches lock must be held
+ */
+static VikTrackCache *track_data_make ( const VikTrack *tr )
+{
+  VikTrackCache *cache = track_cache_make ( tr );
+  if ( !cache->data )
+    cache->data = track_data_new ( tr, cache->n_points );
+  return cache;
+}
+
+/*
+ * Returns: The cache for the current revision of the track, with its statistics
+ */
+static VikTrackCache *track_cache ( const VikTrack *tr )
+{
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_cache_make ( tr );
+  G_UNLOCK(track_caches);
+  return cache;
+}
+
+/*
+ * Returns: The cache for the current revision of the track, with its columns
+ */
+static VikTrackCache *track_data ( const VikTrack *tr )
+{
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_data_make ( tr );
+  G_UNLOCK(track_caches);
+  return cache;
+}
+
+/**
+ * vik_track_get_data:
+ *
+ * Returns: The columnar form of the trackpoints.
+ *  It belongs to the track and is only valid until the track is next changed.
+ */
+const VikTrackData *vik_track_get_data ( const VikTrack *tr )
+{
+  return track_data(tr)->data;
+}
+
+/*
+ * Returns: The cache with its columns and lookup arrays, making them if necessary
+ * The track_caches lock must be held
+ */
+static VikTrackCache *track_lookup_make ( const VikTrack *tr )
+{
+  VikTrackCache *cache = track_data_make ( tr );
+  if ( cache->lengths )
+    return cache;
+
+  const VikTrackData *data = cache->data;
+  guint capacity = MAX ( 1, data->n_points );
+  cache->lengths = g_new ( gdouble, capacity );
+  cache->max_times = g_new ( gdouble, capacity );
+
+  guint ii;
+  for ( ii = 0; ii < data->n_points; ii++ ) {
+    if ( ii ) {
+      cache->lengths[ii] = cache->lengths[ii-1] + (data->newsegments[ii] ? 0.0 : data->diffs[ii]);
+      // NB fmax() ignores a NAN argument
+      cache->max_times[ii] = fmax ( cache->max_times[ii-1], data->timestamps[ii] );
+    }
+    else {
+      cache->lengths[0] = 0.0;
+      cache->max_times[0] = data->timestamps[0];
+    }
+  }
+  return cache;
+}
+
+/*
+ * Returns: The cache for the current revision of the track, with its columns and lookup arrays
+ */
+static VikTrackCache *track_lookup ( const VikTrack *tr )
+{
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_lookup_make ( tr );
+  G_UNLOCK(track_caches);
+  return cache;
+}
+
+/**
+ * vik_track_invalidate:
+ *
+ * Discard any information derived from the trackpoints.
+ * This must be called whenever a track's trackpoints are changed
+ *  (which vik_track_calculate_bounds() does).
+ */
+void vik_track_invalidate ( VikTrack *tr )
+{
+  G_LOCK(track_caches);
+  track_revise ( tr );
+  track_cache_free ( tr->cache );
+  tr->cache = NULL;
+  G_UNLOCK(track_caches);
+}
+
+/*
+ * Find the index of the trackpoint in the track
+ * Returns: The cache with its lookup arrays, or NULL if not found
+ */
+static VikTrackCache *track_lookup_index ( const VikTrack *tr, const VikTrackpoint *tp, guint *index )
+{
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_lookup_make ( tr );
+  if ( !cache->indices ) {
+    cache->indices = g_hash_table_new ( g_direct_hash, g_direct_equal );
+    guint ii;
+    for ( ii = 0; ii < cache->data->n_points; ii++ )
+      g_hash_table_insert ( cache->indices, cache->data->tps[ii], GUINT_TO_POINTER(ii+1) );
+  }
+  guint value = GPOINTER_TO_UINT ( g_hash_table_lookup ( cache->indices, tp ) );
+  G_UNLOCK(track_caches);
+  if ( !value )
+    return NULL;
+  *index = value - 1;
+  return cache;
+}
+
+/*
+ * Returns: The first index in the range [start, end) with a value not less than the one given,
+ *  or end if there is none.
+ * The values must be non decreasing (NAN entries are allowed at the beginning)
+ */
+static guint track_data_lower_bound ( const gdouble *values, guint start, guint end, gdouble value )
+{
+  while ( start < end ) {
+    guint mid = start + (end - start) / 2;
+    if ( values[mid] >= value )
+      end = mid;
+    else
+      start = mid + 1;
+  }
+  return start;
+}
+
+// Near enough for the purposes of simplification
+#define TRACK_METRES_PER_DEGREE 111319.5
+
+typedef struct {
+  guint start;
+  guint end;
+  gdouble limit;
+} SimplifyRange;
+
+/*
+ * Douglas-Peucker simplification of each segment, recording for every point
+ *  the largest tolerance (in metres) at which it would still be kept.
+ * The ends of segments are always kept.
+ */
+static gdouble *track_data_make_significance ( const VikTrackData *data )
+{
+  const guint n = data->n_points;
+  gdouble *sig = g_malloc0 ( sizeof(gdouble) * MAX(1,n) );
+  gdouble *xs = g_malloc ( sizeof(gdouble) * MAX(1,n) );
+  gdouble *ys = g_malloc ( sizeof(gdouble) * MAX(1,n) );
+  guint ii, seg;
+
+  // Flatten into metres; in the small areas between points the distortion doesn't matter
+  for ( ii = 0; ii < n; ii++ ) {
+    const VikCoord *coord = &(data->coords[ii]);
+    if ( coord->mode == VIK_COORD_LATLON ) {
+      ys[ii] = coord->north_south * TRACK_METRES_PER_DEGREE;
+      xs[ii] = coord->east_west * TRACK_METRES_PER_DEGREE * cos ( DEG2RAD(coord->north_south) );
+    }
+    else {
+      ys[ii] = coord->north_south;
+      xs[ii] = coord->east_west;
+    }
+  }
+
+  // Ranges still to be simplified; an explicit stack as recursion could be very deep
+  GArray *stack = g_array_new ( FALSE, FALSE, sizeof(SimplifyRange) );
+
+  for ( seg = 0; seg < data->n_segments; seg++ ) {
+    SimplifyRange range;
+    range.start = data->segments[seg];
+    range.end = ( seg+1 < data->n_segments ) ? data->segments[seg+1]-1 : n-1;
+    range.limit = G_MAXDOUBLE;
+    sig[range.start] = sig[range.end] = G_MAXDOUBLE;
+    g_array_append_val ( stack, range );
+
+    while ( stack->len ) {
+      SimplifyRange rr = g_array_index ( stack, SimplifyRange, stack->len-1 );
+      g_array_set_size ( stack, stack->len-1 );
+      if ( rr.end - rr.start < 2 )
+        continue;
+
+      // Find the point furthest from the line between the ends
+      gdouble dx = xs[rr.end] - xs[rr.start];
+      gdouble dy = ys[rr.end] - ys[rr.start];
+      gdouble len = sqrt ( dx*dx + dy*dy );
+      gdouble max_dist = -1.0;
+      guint kk = rr.start + 1;
+      for ( ii = rr.start+1; ii < rr.end; ii++ ) {
+        gdouble px = xs[ii] - xs[rr.start];
+        gdouble py = ys[ii] - ys[rr.start];
+        gdouble dist = ( len > 0 ) ? fabs ( px*dy - py*dx ) / len : sqrt ( px*px + py*py );
+        if ( dist > max_dist ) {
+          max_dist = dist;
+          kk = ii;
+        }
+      }
+
+      // A point can't be more significant than the one that split its range
+      SimplifyRange left, right;
+      sig[kk] = MIN ( max_dist, rr.limit );
+      left.start = rr.start;
+      left.end = kk;
+      left.limit = sig[kk];
+      right.start = kk;
+      right.end = rr.end;
+      right.limit = sig[kk];
+      g_array_append_val ( stack, left );
+      g_array_append_val ( stack, right );
+    }
+  }
+
+  g_array_free ( stack, TRUE );
+  g_free ( xs );
+  g_free ( ys );
+  return sig;
+}
+
+/**
+ * vik_track_make_significance:
+ *
+ * Allows drawing a simplified version of a track, by skipping points
+ *  with a significance less than the size of a pixel.
+ *
+ * Returns: For each point, the largest distance in metres that the track
+ *  could be simplified by with the point still being kept.
+ *  Free with g_free(); it is only valid until the track is next changed (as given by its revision).
+ */
+gdouble *vik_track_make_significance ( const VikTrack *tr )
+{
+  return track_data_make_significance ( vik_track_get_data ( tr ) );
+}
+
 /**
  * track_recalculate_bounds_last_tp:
  * @trk:   The track to consider the recalculation on
+ * @tp:    The last trackpoint of the track
  *
  * A faster bounds check, since it only considers the last track point
  */
-static void track_recalculate_bounds_last_tp ( VikTrack *trk )
+static void track_recalculate_bounds_last_tp ( VikTrack *trk, VikTrackpoint *tp )
 {
-  GList *tpl = g_list_last ( trk->trackpoints );
-
-  if ( tpl ) {
+  if ( tp ) {
     struct LatLon ll;
     // See if this trackpoint increases the track bounds and update if so
-    vik_coord_to_latlon ( &(VIK_TRACKPOINT(tpl->data)->coord), &ll );
+    vik_coord_to_latlon ( &(tp->coord), &ll );
     if ( ll.lat > trk->bbox.north )
       trk->bbox.north = ll.lat;
     if ( ll.lon < trk->bbox.west )
@@ -286,93 +778,116 @@ void vik_track_add_trackpoint ( VikTrack *tr, VikTrackpoint *tp, gboolean recalc
 {
   // When it's the first trackpoint need to ensure the bounding box is initialized correctly
   gboolean adding_first_point = tr->trackpoints ? FALSE : TRUE;
-  tr->trackpoints = g_list_append ( tr->trackpoints, tp );
-  if ( adding_first_point )
+  if ( adding_first_point ) {
+    tr->trackpoints = g_list_append ( tr->trackpoints, tp );
     vik_track_calculate_bounds ( tr );
-  else if ( recalculate )
-    track_recalculate_bounds_last_tp ( tr );
+  }
+  else {
+    // Extend rather than discard any existing statistics
+    G_LOCK(track_caches);
+    VikTrackCache *cache = track_cache_current ( tr );
+    if ( cache ) {
+      // Append via the known last link, rather than walking the whole list
+      VikTrackpoint *prev = VIK_TRACKPOINT(cache->tail->data);
+      cache->tail = g_list_append ( cache->tail, tp )->next;
+      cache->n_points++;
+      track_stats_step ( &(cache->stats), prev, tp, 1.0 );
+      track_stats_point ( &(cache->stats), tp );
+      track_cache_clear ( cache );
+    }
+    else
+      tr->trackpoints = g_list_append ( tr->trackpoints, tp );
+    track_revise ( tr );
+    if ( cache )
+      cache->revision = tr->revision;
+    G_UNLOCK(track_caches);
+    if ( recalculate )
+      track_recalculate_bounds_last_tp ( tr, tp );
+  }
 }
 
 /**
- * vik_track_get_length_to_trackpoint:
+ * vik_track_remove_last_trackpoint:
  *
+ * Remove and free the last trackpoint,
+ *  keeping the track statistics where possible rather than recalculating them all.
+ * NB The bounds are not reduced.
  */
-gdouble vik_track_get_length_to_trackpoint (const VikTrack *tr, const VikTrackpoint *tp)
+void vik_track_remove_last_trackpoint ( VikTrack *tr )
 {
-  gdouble len = 0.0;
-  if ( tr->trackpoints )
-  {
-    // Is it the very first track point?
-    if ( VIK_TRACKPOINT(tr->trackpoints->data) == tp )
-      return len;
-
-    GList *iter = tr->trackpoints->next;
-    while (iter)
-    {
-      VikTrackpoint *tp1 = VIK_TRACKPOINT(iter->data);
-      if ( ! tp1->newsegment )
-        len += vik_coord_diff ( &(tp1->coord),
-                                &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-
-      // Exit when we reach the desired point
-      if ( tp1 == tp )
-        break;
+  if ( !tr->trackpoints )
+    return;
 
-      iter = iter->next;
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_cache_current ( tr );
+  GList *last = cache ? cache->tail : g_list_last ( tr->trackpoints );
+  VikTrackpoint *tp = VIK_TRACKPOINT(last->data);
+  if ( cache ) {
+    VikTrackStats *stats = &(cache->stats);
+    // Extremes can't be wound back
+    if ( !last->prev || tp == stats->max_speed_tp || tp == stats->min_alt_tp || tp == stats->max_alt_tp ) {
+      track_cache_free ( cache );
+      tr->cache = cache = NULL;
+    }
+    else {
+      track_stats_step ( stats, VIK_TRACKPOINT(last->prev->data), tp, -1.0 );
+      cache->tail = last->prev;
+      cache->n_points--;
+      track_cache_clear ( cache );
     }
   }
-  return len;
+
+  vik_trackpoint_free ( tp );
+  tr->trackpoints = g_list_delete_link ( tr->trackpoints, last );
+  track_revise ( tr );
+  if ( cache )
+    cache->revision = tr->revision;
+  G_UNLOCK(track_caches);
+}
+
+/**
+ * vik_track_get_length_to_trackpoint:
+ *
+ */
+gdouble vik_track_get_length_to_trackpoint (const VikTrack *tr, const VikTrackpoint *tp)
+{
+  guint index;
+  const VikTrackCache *cache = track_lookup_index ( tr, tp, &index );
+  // If not found, as before give the whole length
+  if ( !cache )
+    return vik_track_get_length ( tr );
+  return cache->lengths[index];
 }
 
 gdouble vik_track_get_length(const VikTrack *tr)
 {
-  gdouble len = 0.0;
-  if ( tr->trackpoints )
-  {
-    GList *iter = tr->trackpoints->next;
-    while (iter)
-    {
-      if ( ! VIK_TRACKPOINT(iter->data)->newsegment )
-        len += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-                                &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-      iter = iter->next;
-    }
-  }
-  return len;
+  return track_cache(tr)->stats.length;
 }
 
 gdouble vik_track_get_length_including_gaps(const VikTrack *tr)
 {
-  gdouble len = 0.0;
-  if ( tr->trackpoints )
-  {
-    GList *iter = tr->trackpoints->next;
-    while (iter)
-    {
-      len += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-                              &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-      iter = iter->next;
-    }
-  }
-  return len;
+  return track_cache(tr)->stats.length_including_gaps;
 }
 
 gulong vik_track_get_tp_count(const VikTrack *tr)
 {
+  G_LOCK(track_caches);
+  const VikTrackCache *cache = track_cache_current ( tr );
+  gulong count = cache ? cache->n_points : 0;
+  G_UNLOCK(track_caches);
+  if ( cache )
+    return count;
   return g_list_length(tr->trackpoints);
 }
 
 gulong vik_track_get_dup_point_count ( const VikTrack *tr )
 {
+  const VikTrackData *data = vik_track_get_data ( tr );
   gulong num = 0;
-  GList *iter = tr->trackpoints;
-  while ( iter )
-  {
-    if ( iter->next && vik_coord_equals ( &(VIK_TRACKPOINT(iter->data)->coord),
-                       &(VIK_TRACKPOINT(iter->next->data)->coord) ) )
+  guint ii;
+  for ( ii = 1; ii < data->n_points; ii++ )
+    if ( vik_coord_equals ( &(data->coords[ii-1]), &(data->coords[ii]) ) )
       num++;
-    iter = iter->next;
-  }
   return num;
 }
 
@@ -413,17 +928,13 @@ gulong vik_track_remove_dup_points ( VikTrack *tr )
  */
 gulong vik_track_get_same_time_point_count ( const VikTrack *tr )
 {
+  const VikTrackData *data = vik_track_get_data ( tr );
   gulong num = 0;
-  GList *iter = tr->trackpoints;
-  while ( iter ) {
-    if ( iter->next &&
-	 ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-           !isnan(VIK_TRACKPOINT(iter->next->data)->timestamp) ) &&
-         ( VIK_TRACKPOINT(iter->data)->timestamp ==
-           VIK_TRACKPOINT(iter->next->data)->timestamp) )
+  guint ii;
+  for ( ii = 1; ii < data->n_points; ii++ )
+    // NB Comparison is always false when either is NAN
+    if ( data->timestamps[ii-1] == data->timestamps[ii] )
       num++;
-    iter = iter->next;
-  }
   return num;
 }
 
@@ -499,6 +1010,8 @@ gboolean vik_track_remove_dodgy_first_point ( VikTrack *vt, guint speed, gboolea
             vt->trackpoints = g_list_delete_link ( vt->trackpoints, iter );
             if ( recalc_bounds )
               vik_track_calculate_bounds ( vt );
+            else
+              vik_track_invalidate ( vt );
 	  }
 	}
       }
@@ -530,6 +1043,7 @@ void vik_track_to_routepoints ( VikTrack *tr )
 
     iter = iter->next;
   }
+  vik_track_invalidate ( tr );
 }
 
 guint vik_track_get_segment_count(const VikTrack *tr)
@@ -605,6 +1119,7 @@ guint vik_track_merge_segments(VikTrack *tr)
       num++;
     }
   }
+  vik_track_invalidate ( tr );
   return num;
 }
 
@@ -630,6 +1145,7 @@ void vik_track_reverse ( VikTrack *tr )
     }
     iter = iter->prev;
   }
+  vik_track_invalidate ( tr );
 }
 
 /**
@@ -643,57 +1159,26 @@ void vik_track_reverse ( VikTrack *tr )
 gdouble vik_track_get_duration(const VikTrack *trk, gboolean segment_gaps)
 {
   gdouble duration = 0;
-  if ( trk->trackpoints ) {
-    // Ensure times are available
-    if ( !isnan(vik_track_get_tp_first(trk)->timestamp) ) {
-      // Get trkpt only once - as using vik_track_get_tp_last() iterates whole track each time
-      if (segment_gaps) {
-        // Simple duration
-        VikTrackpoint *trkpt_last = vik_track_get_tp_last(trk);
-        if ( !isnan(trkpt_last->timestamp) ) {
-          gdouble t1 = vik_track_get_tp_first(trk)->timestamp;
-          gdouble t2 = trkpt_last->timestamp;
-          duration = t2 - t1;
-        }
-      }
-      else {
-        // Total within segments
-        GList *iter = trk->trackpoints->next;
-        while (iter) {
-          if ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-               !isnan(VIK_TRACKPOINT(iter->prev->data)->timestamp) &&
-              (!VIK_TRACKPOINT(iter->data)->newsegment) ) {
-            duration += ABS(VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp);
-          }
-          iter = iter->next;
-        }
-      }
+  // Ensure times are available
+  if ( trk->trackpoints && !isnan(VIK_TRACKPOINT(trk->trackpoints->data)->timestamp) ) {
+    if (segment_gaps) {
+      // Simple duration
+      gdouble t1 = VIK_TRACKPOINT(trk->trackpoints->data)->timestamp;
+      gdouble t2 = vik_track_get_tp_last(trk)->timestamp;
+      if ( !isnan(t2) )
+        duration = t2 - t1;
     }
+    else
+      // Total within segments
+      duration = track_cache(trk)->stats.timed_duration;
   }
   return duration;
 }
 
 gdouble vik_track_get_average_speed(const VikTrack *tr)
 {
-  gdouble len = 0.0;
-  gdouble time = 0;
-  if ( tr->trackpoints )
-  {
-    GList *iter = tr->trackpoints->next;
-    while (iter)
-    {
-      if ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-           !isnan(VIK_TRACKPOINT(iter->prev->data)->timestamp) &&
-          (! VIK_TRACKPOINT(iter->data)->newsegment) )
-      {
-        len += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-                                &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-        time += ABS(VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp);
-      }
-      iter = iter->next;
-    }
-  }
-  return (time == 0) ? 0 : ABS(len/time);
+  const VikTrackStats *stats = &(track_cache(tr)->stats);
+  return (stats->timed_duration == 0) ? 0 : ABS(stats->timed_length/stats->timed_duration);
 }
 
 /**
@@ -708,25 +1193,19 @@ gdouble vik_track_get_average_speed(const VikTrack *tr)
  */
 gdouble vik_track_get_average_speed_moving (const VikTrack *tr, int stop_length_seconds)
 {
+  const VikTrackData *data = vik_track_get_data ( tr );
+  const gdouble *ts = data->timestamps;
   gdouble len = 0.0;
   gdouble time = 0;
-  if ( tr->trackpoints )
+  guint ii;
+  for ( ii = 1; ii < data->n_points; ii++ )
   {
-    GList *iter = tr->trackpoints->next;
-    while (iter)
+    if ( !isnan(ts[ii]) && !isnan(ts[ii-1]) && !data->newsegments[ii] )
     {
-      if ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-           !isnan(VIK_TRACKPOINT(iter->prev->data)->timestamp) &&
-          (! VIK_TRACKPOINT(iter->data)->newsegment) )
-      {
-	if ( ( VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp ) < stop_length_seconds ) {
-	  len += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-				  &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-	
-	  time += ABS(VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp);
-	}
+      if ( ( ts[ii] - ts[ii-1] ) < stop_length_seconds ) {
+        len += data->diffs[ii];
+        time += ABS(ts[ii] - ts[ii-1]);
       }
-      iter = iter->next;
     }
   }
   return (time == 0) ? 0 : ABS(len/time);
@@ -734,25 +1213,7 @@ gdouble vik_track_get_average_speed_moving (const VikTrack *tr, int stop_length_
 
 gdouble vik_track_get_max_speed(const VikTrack *tr)
 {
-  gdouble maxspeed = 0.0, speed = 0.0;
-  if ( tr->trackpoints )
-  {
-    GList *iter = tr->trackpoints->next;
-    while (iter)
-    {
-      if ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-           !isnan(VIK_TRACKPOINT(iter->prev->data)->timestamp) &&
-          (! VIK_TRACKPOINT(iter->data)->newsegment) )
-      {
-        speed =  vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord), &(VIK_TRACKPOINT(iter->prev->data)->coord) )
-                 / ABS(VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp);
-        if ( speed > maxspeed )
-          maxspeed = speed;
-      }
-      iter = iter->next;
-    }
-  }
-  return maxspeed;
+  return track_cache(tr)->stats.max_speed;
 }
 
 void vik_track_convert ( VikTrack *tr, VikCoordMode dest_mode )
@@ -763,11 +1224,12 @@ void vik_track_convert ( VikTrack *tr, VikCoordMode dest_mode )
     vik_coord_convert ( &(VIK_TRACKPOINT(iter->data)->coord), dest_mode );
     iter = iter->next;
   }
+  vik_track_invalidate ( tr );
 }
 
 /* I understood this when I wrote it ... maybe ... Basically it eats up the
  * proper amounts of length on the track and averages elevation over that. */
-gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
+static gdouble *track_data_make_elevation ( const VikTrackData *data, guint16 num_chunks )
 {
   gdouble *pts;
   gdouble total_length, chunk_length, current_dist, current_area_under_curve, current_seg_length, dist_along_seg = 0.0;
@@ -775,36 +1237,36 @@ gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
   guint16 current_chunk;
   gboolean ignore_it = FALSE;
 
-  GList *iter = tr->trackpoints;
+  const gdouble *alts = data->altitudes;
+  const guint n = data->n_points;
+  guint ii;
 
-  if (!iter || !iter->next) /* zero- or one-point track */
+  if ( n < 2 ) /* zero- or one-point track */
 	  return NULL;
 
   { /* test if there's anything worth calculating */
     gboolean okay = FALSE;
-    while ( iter )
+    for ( ii = 0; ii < n; ii++ )
     {
       // Sometimes a GPS device (or indeed any random file) can have stupid numbers for elevations
       // Since when is 9.9999e+24 a valid elevation!!
       // This can happen when a track (with no elevations) is uploaded to a GPS device and then redownloaded (e.g. using a Garmin Legend EtrexHCx)
       // Some protection against trying to work with crazily massive numbers (otherwise get SIGFPE, Arithmetic exception)
-      if ( !isnan(VIK_TRACKPOINT(iter->data)->altitude) &&
-	   VIK_TRACKPOINT(iter->data)->altitude < 1E9 ) {
+      if ( !isnan(alts[ii]) && alts[ii] < 1E9 ) {
         okay = TRUE; break;
       }
-      iter = iter->next;
     }
     if ( ! okay )
       return NULL;
   }
 
-  iter = tr->trackpoints;
+  ii = 0;
 
   g_assert ( num_chunks < 16000 );
 
   pts = g_malloc ( sizeof(gdouble) * num_chunks );
 
-  total_length = vik_track_get_length_including_gaps ( tr );
+  total_length = data->distances[data->n_points-1];
   chunk_length = total_length / num_chunks;
 
   /* Zero chunk_length (eg, track of 2 tp with the same loc) will cause crash */
@@ -818,10 +1280,9 @@ gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
   current_chunk = 0;
   current_seg_length = 0;
 
-  current_seg_length = vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-      &(VIK_TRACKPOINT(iter->next->data)->coord) );
-  altitude1 = VIK_TRACKPOINT(iter->data)->altitude;
-  altitude2 = VIK_TRACKPOINT(iter->next->data)->altitude;
+  current_seg_length = data->diffs[1];
+  altitude1 = alts[0];
+  altitude2 = alts[1];
   dist_along_seg = 0;
 
   while ( current_chunk < num_chunks ) {
@@ -855,18 +1316,17 @@ gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
       } else { current_dist = current_area_under_curve = 0; } /* should only happen if first current_seg_length == 0 */
 
       /* get intervening segs */
-      iter = iter->next;
-      while ( iter && iter->next ) {
-        current_seg_length = vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-            &(VIK_TRACKPOINT(iter->next->data)->coord) );
-        altitude1 = VIK_TRACKPOINT(iter->data)->altitude;
-        altitude2 = VIK_TRACKPOINT(iter->next->data)->altitude;
-        ignore_it = VIK_TRACKPOINT(iter->next->data)->newsegment;
+      ii++;
+      while ( ii+1 < n ) {
+        current_seg_length = data->diffs[ii+1];
+        altitude1 = alts[ii];
+        altitude2 = alts[ii+1];
+        ignore_it = data->newsegments[ii+1];
 
         if ( chunk_length - current_dist >= current_seg_length ) {
           current_dist += current_seg_length;
           current_area_under_curve += current_seg_length * (altitude1+altitude2) * 0.5;
-          iter = iter->next;
+          ii++;
         } else {
           break;
         }
@@ -874,9 +1334,9 @@ gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
 
       /* final seg */
       dist_along_seg = chunk_length - current_dist;
-      if ( ignore_it || ( iter && !iter->next ) ) {
+      if ( ignore_it || ii+1 >= n ) {
         pts[current_chunk] = current_area_under_curve / current_dist;
-        if (!iter->next) {
+        if ( ii+1 >= n ) {
           int i;
           for (i = current_chunk + 1; i < num_chunks; i++)
             pts[i] = pts[current_chunk];
@@ -904,37 +1364,30 @@ gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
  */
 void vik_track_get_total_elevation_gain(const VikTrack *tr, gdouble *up, gdouble *down)
 {
-  gdouble diff;
-  *up = *down = 0;
   if ( tr->trackpoints ) {
-    GList *iter = tr->trackpoints->next;
-    while (iter) {
-      VikTrackpoint *tp1 = VIK_TRACKPOINT(iter->data);
-      VikTrackpoint *tp2 = VIK_TRACKPOINT(iter->prev->data);
-      if ( !isnan(tp1->altitude) && !isnan(tp2->altitude) ) {
-        diff = tp1->altitude - tp2->altitude;
-        if ( diff > 0 )
-          *up += diff;
-        else
-          *down -= diff;
-      }
-      iter = iter->next;
-    }
+    const VikTrackStats *stats = &(track_cache(tr)->stats);
+    *up = stats->elev_up;
+    *down = stats->elev_down;
   } else
     *up = *down = NAN;
 }
 
-gdouble *vik_track_make_gradient_map ( const VikTrack *tr, guint16 num_chunks )
+/*
+ * Gradients from the (same sized) elevation map
+ */
+static gdouble *track_data_make_gradient ( const VikTrackData *data, guint16 num_chunks, const gdouble *altitudes )
 {
   gdouble *pts;
-  gdouble *altitudes;
   gdouble total_length, chunk_length, current_gradient;
   gdouble altitude1, altitude2;
   guint16 current_chunk;
 
   g_assert ( num_chunks < 16000 );
 
-  total_length = vik_track_get_length_including_gaps ( tr );
+  if ( !data->n_points || altitudes == NULL )
+    return NULL;
+
+  total_length = data->distances[data->n_points-1];
   chunk_length = total_length / num_chunks;
 
   /* Zero chunk_length (eg, track of 2 tp with the same loc) will cause crash */
@@ -942,11 +1395,6 @@ gdouble *vik_track_make_gradient_map ( const VikTrack *tr, guint16 num_chunks )
     return NULL;
   }
 
-  altitudes = vik_track_make_elevation_map (tr, num_chunks);
-  if (altitudes == NULL) {
-    return NULL;
-  }
-
   current_gradient = 0.0;
   pts = g_malloc ( sizeof(gdouble) * num_chunks );
   for (current_chunk = 0; current_chunk < (num_chunks - 1); current_chunk++) {
@@ -959,26 +1407,25 @@ gdouble *vik_track_make_gradient_map ( const VikTrack *tr, guint16 num_chunks )
 
   pts[current_chunk] = current_gradient;
 
-  g_free ( altitudes );
-
   return pts;
 }
 
 /* by Alex Foobarian */
-gdouble *vik_track_make_speed_map ( const VikTrack *tr, guint16 num_chunks )
+static gdouble *track_data_make_speed ( const VikTrackData *data, guint16 num_chunks )
 {
-  gdouble *v, *s, *t;
+  gdouble *v;
+  const gdouble *s;
+  const gdouble *t;
   gdouble duration, chunk_dur;
-  int i, pt_count, numpts, index;
-  GList *iter;
+  int i, index;
 
-  if ( ! tr->trackpoints )
+  if ( ! data->n_points )
     return NULL;
 
   g_assert ( num_chunks < 16000 );
 
-  gdouble t1 = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  gdouble t2 = VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->timestamp;
+  gdouble t1 = data->timestamps[0];
+  gdouble t2 = data->timestamps[data->n_points-1];
   duration = t2 - t1;
 
   if ( isnan(t1) || isnan(t2) || !duration )
@@ -988,25 +1435,12 @@ gdouble *vik_track_make_speed_map ( const VikTrack *tr, guint16 num_chunks )
     g_warning("negative duration: unsorted trackpoint timestamps?");
     return NULL;
   }
-  pt_count = vik_track_get_tp_count(tr);
 
   v = g_malloc ( sizeof(gdouble) * num_chunks );
   chunk_dur = duration / num_chunks;
 
-  s = g_malloc(sizeof(double) * pt_count);
-  t = g_malloc(sizeof(double) * pt_count);
-
-  iter = tr->trackpoints->next;
-  numpts = 0;
-  s[0] = 0;
-  t[0] = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  numpts++;
-  while (iter) {
-    s[numpts] = s[numpts-1] + vik_coord_diff ( &(VIK_TRACKPOINT(iter->prev->data)->coord), &(VIK_TRACKPOINT(iter->data)->coord) );
-    t[numpts] = VIK_TRACKPOINT(iter->data)->timestamp;
-    numpts++;
-    iter = iter->next;
-  }
+  s = data->distances;
+  t = data->timestamps;
 
   /* In the following computation, we iterate through periods of time of duration chunk_dur.
    * The first period begins at the beginning of the track.  The last period ends at the end of the track.
@@ -1032,26 +1466,25 @@ gdouble *vik_track_make_speed_map ( const VikTrack *tr, guint16 num_chunks )
       v[i] = 0;
     }
   }
-  g_free(s);
-  g_free(t);
   return v;
 }
 
 /**
  * Make a distance/time map, heavily based on the vik_track_make_speed_map method
  */
-gdouble *vik_track_make_distance_map ( const VikTrack *tr, guint16 num_chunks )
+static gdouble *track_data_make_distance ( const VikTrackData *data, guint16 num_chunks )
 {
-  gdouble *v, *s, *t;
+  gdouble *v;
+  const gdouble *s;
+  const gdouble *t;
   gdouble duration, chunk_dur;
-  int i, pt_count, numpts, index;
-  GList *iter;
+  int i, index;
 
-  if ( ! tr->trackpoints )
+  if ( ! data->n_points )
     return NULL;
 
-  gdouble t1 = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  gdouble t2 = VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->timestamp;
+  gdouble t1 = data->timestamps[0];
+  gdouble t2 = data->timestamps[data->n_points-1];
   duration = t2 - t1;
 
   if ( isnan(t1) || isnan(t2) || !duration )
@@ -1061,25 +1494,12 @@ gdouble *vik_track_make_distance_map ( const VikTrack *tr, guint16 num_chunks )
     g_warning("negative duration: unsorted trackpoint timestamps?");
     return NULL;
   }
-  pt_count = vik_track_get_tp_count(tr);
 
   v = g_malloc ( sizeof(gdouble) * num_chunks );
   chunk_dur = duration / num_chunks;
 
-  s = g_malloc(sizeof(double) * pt_count);
-  t = g_malloc(sizeof(double) * pt_count);
-
-  iter = tr->trackpoints->next;
-  numpts = 0;
-  s[0] = 0;
-  t[0] = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  numpts++;
-  while (iter) {
-    s[numpts] = s[numpts-1] + vik_coord_diff ( &(VIK_TRACKPOINT(iter->prev->data)->coord), &(VIK_TRACKPOINT(iter->data)->coord) );
-    t[numpts] = VIK_TRACKPOINT(iter->data)->timestamp;
-    numpts++;
-    iter = iter->next;
-  }
+  s = data->distances;
+  t = data->timestamps;
 
   /* In the following computation, we iterate through periods of time of duration chunk_dur.
    * The first period begins at the beginning of the track.  The last period ends at the end of the track.
@@ -1105,8 +1525,6 @@ gdouble *vik_track_make_distance_map ( const VikTrack *tr, guint16 num_chunks )
       v[i] = 0;
     }
   }
-  g_free(s);
-  g_free(t);
   return v;
 }
 
@@ -1116,28 +1534,27 @@ gdouble *vik_track_make_distance_map ( const VikTrack *tr, guint16 num_chunks )
  * NB Somehow the elevation/distance applies some kind of smoothing algorithm,
  *   but I don't think any one understands it any more (I certainly don't ATM)
  */
-gdouble *vik_track_make_elevation_time_map ( const VikTrack *tr, guint16 num_chunks )
+static gdouble *track_data_make_elevation_time ( const VikTrackData *data, guint16 num_chunks )
 {
   gdouble duration, chunk_dur;
-  GList *iter = tr->trackpoints;
+  guint ii;
 
-  if (!iter || !iter->next) /* zero- or one-point track */
+  if ( data->n_points < 2 ) /* zero- or one-point track */
     return NULL;
 
   /* test if there's anything worth calculating */
   gboolean okay = FALSE;
-  while ( iter ) {
-    if ( !isnan(VIK_TRACKPOINT(iter->data)->altitude) ) {
+  for ( ii = 0; ii < data->n_points; ii++ ) {
+    if ( !isnan(data->altitudes[ii]) ) {
       okay = TRUE;
       break;
     }
-    iter = iter->next;
   }
   if ( ! okay )
     return NULL;
 
-  gdouble t1 = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  gdouble t2 = VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->timestamp;
+  gdouble t1 = data->timestamps[0];
+  gdouble t2 = data->timestamps[data->n_points-1];
   duration = t2 - t1;
 
   if ( isnan(t1) || isnan(t2) || !duration )
@@ -1147,28 +1564,13 @@ gdouble *vik_track_make_elevation_time_map ( const VikTrack *tr, guint16 num_chu
     g_warning("negative duration: unsorted trackpoint timestamps?");
     return NULL;
   }
-  gint pt_count = vik_track_get_tp_count(tr);
-
-  // Reset iterator back to the beginning
-  iter = tr->trackpoints;
 
   gdouble *pts = g_malloc ( sizeof(gdouble) * num_chunks ); // The return altitude values
-  gdouble *s = g_malloc(sizeof(double) * pt_count); // calculation altitudes
-  gdouble *t = g_malloc(sizeof(double) * pt_count); // calculation times
+  const gdouble *s = data->altitudes; // calculation altitudes
+  const gdouble *t = data->timestamps; // calculation times
 
   chunk_dur = duration / num_chunks;
 
-  s[0] = VIK_TRACKPOINT(iter->data)->altitude;
-  t[0] = VIK_TRACKPOINT(iter->data)->timestamp;
-  iter = tr->trackpoints->next;
-  gint numpts = 1;
-  while (iter) {
-    s[numpts] = VIK_TRACKPOINT(iter->data)->altitude;
-    t[numpts] = VIK_TRACKPOINT(iter->data)->timestamp;
-    numpts++;
-    iter = iter->next;
-  }
-
  /* In the following computation, we iterate through periods of time of duration chunk_dur.
    * The first period begins at the beginning of the track.  The last period ends at the end of the track.
    */
@@ -1193,8 +1595,6 @@ gdouble *vik_track_make_elevation_time_map ( const VikTrack *tr, guint16 num_chu
       pts[i] = 0;
     }
   }
-  g_free(s);
-  g_free(t);
 
   return pts;
 }
@@ -1202,18 +1602,19 @@ gdouble *vik_track_make_elevation_time_map ( const VikTrack *tr, guint16 num_chu
 /**
  * Make a speed/distance map
  */
-gdouble *vik_track_make_speed_dist_map ( const VikTrack *tr, guint16 num_chunks )
+static gdouble *track_data_make_speed_dist ( const VikTrackData *data, guint16 num_chunks )
 {
-  gdouble *v, *s, *t;
-  gint i, pt_count, numpts, index;
-  GList *iter;
+  gdouble *v;
+  const gdouble *s;
+  const gdouble *t;
+  gint i, index;
   gdouble duration, total_length, chunk_length;
 
-  if ( ! tr->trackpoints )
+  if ( ! data->n_points )
     return NULL;
 
-  gdouble t1 = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  gdouble t2 = VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->timestamp;
+  gdouble t1 = data->timestamps[0];
+  gdouble t2 = data->timestamps[data->n_points-1];
   duration = t2 - t1;
 
   if ( isnan(t1) || isnan(t2) || !duration )
@@ -1224,30 +1625,18 @@ gdouble *vik_track_make_speed_dist_map ( const VikTrack *tr, guint16 num_chunks
     return NULL;
   }
 
-  total_length = vik_track_get_length_including_gaps ( tr );
+  total_length = data->distances[data->n_points-1];
   chunk_length = total_length / num_chunks;
-  pt_count = vik_track_get_tp_count(tr);
 
   if (chunk_length <= 0) {
     return NULL;
   }
 
   v = g_malloc ( sizeof(gdouble) * num_chunks );
-  s = g_malloc ( sizeof(double) * pt_count );
-  t = g_malloc ( sizeof(double) * pt_count );
 
   // No special handling of segments ATM...
-  iter = tr->trackpoints->next;
-  numpts = 0;
-  s[0] = 0;
-  t[0] = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  numpts++;
-  while (iter) {
-    s[numpts] = s[numpts-1] + vik_coord_diff ( &(VIK_TRACKPOINT(iter->prev->data)->coord), &(VIK_TRACKPOINT(iter->data)->coord) );
-    t[numpts] = VIK_TRACKPOINT(iter->data)->timestamp;
-    numpts++;
-    iter = iter->next;
-  }
+  s = data->distances;
+  t = data->timestamps;
 
   // Iterate through a portion of the track to get an average speed for that part
   // This will essentially interpolate between segments, which I think is right given the usage of 'get_length_including_gaps'
@@ -1270,11 +1659,179 @@ gdouble *vik_track_make_speed_dist_map ( const VikTrack *tr, guint16 num_chunks
       v[i] = 0;
     }
   }
-  g_free(s);
-  g_free(t);
   return v;
 }
 
+/*
+ * Profile series calculation, in the order of #VikTrackProfile
+ * NB Gradients are derived from the elevations, so are made along with them
+ */
+typedef gdouble *(*TrackProfileFunc) ( const VikTrackData *data, guint16 num_chunks );
+
+static const TrackProfileFunc track_profile_funcs[VIK_TRACK_PROFILE_N] = {
+  track_data_make_elevation,
+  NULL,
+  track_data_make_speed,
+  track_data_make_distance,
+  track_data_make_elevation_time,
+  track_data_make_speed_dist,
+};
+
+// Below this size it's not worth the overhead of using other threads
+#define PROFILE_THREADED_POINTS 20000
+
+typedef struct {
+  const VikTrackData *data;
+  guint16 num_chunks;
+  VikTrackProfile profile;
+  gboolean with_gradient;
+  gdouble *results[VIK_TRACK_PROFILE_N];
+} ProfileJob;
+
+static void track_profile_job ( ProfileJob *job, gpointer user_data )
+{
+  job->results[job->profile] = track_profile_funcs[job->profile] ( job->data, job->num_chunks );
+  if ( job->with_gradient )
+    job->results[VIK_TRACK_PROFILE_GRADIENT] =
+      track_data_make_gradient ( job->data, job->num_chunks, job->results[VIK_TRACK_PROFILE_ELEVATION] );
+}
+
+/*
+ * Keep the values (which may be NULL) unless it's already been made
+ */
+static void track_cache_store_profile ( VikTrackCache *cache, VikTrackProfile profile, gdouble *values )
+{
+  if ( cache->profiles_made & VIK_TRACK_PROFILE_MASK(profile) )
+    g_free ( values );
+  else {
+    cache->profiles[profile] = values;
+    cache->profiles_made |= VIK_TRACK_PROFILE_MASK(profile);
+  }
+}
+
+/**
+ * vik_track_prepare_profiles:
+ * @profiles:   Bitmask of the wanted #VikTrackProfile series
+ * @num_chunks: The number of values in each series
+ *
+ * Calculate all the wanted profile series together,
+ *  sharing one columnar copy of the trackpoints and using multiple threads for large tracks.
+ * The results are kept until the track is changed or a different size is requested,
+ *  so subsequent vik_track_make_*_map() calls of the same size just copy them.
+ */
+void vik_track_prepare_profiles ( const VikTrack *tr, guint profiles, guint16 num_chunks )
+{
+  ProfileJob jobs[VIK_TRACK_PROFILE_N];
+  guint pp, n_jobs = 0;
+
+  G_LOCK(track_caches);
+  VikTrackCache *cache = track_cache_make ( tr );
+  if ( cache->profiles_chunks != num_chunks ) {
+    track_cache_free_profiles ( cache );
+    cache->profiles_chunks = num_chunks;
+  }
+  guint needed = profiles & ~cache->profiles_made;
+  G_UNLOCK(track_caches);
+
+  if ( needed & VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_GRADIENT) )
+    needed |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_ELEVATION);
+
+  for ( pp = 0; pp < VIK_TRACK_PROFILE_N; pp++ ) {
+    if ( !(needed & VIK_TRACK_PROFILE_MASK(pp)) || !track_profile_funcs[pp] )
+      continue;
+    memset ( &jobs[n_jobs], 0, sizeof(ProfileJob) );
+    jobs[n_jobs].num_chunks = num_chunks;
+    jobs[n_jobs].profile = pp;
+    jobs[n_jobs].with_gradient = ( pp == VIK_TRACK_PROFILE_ELEVATION ) &&
+                                 ( needed & VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_GRADIENT) );
+    n_jobs++;
+  }
+  if ( !n_jobs )
+    return;
+
+  // The calculations themselves are made without holding the lock
+  const VikTrackData *data = vik_track_get_data ( tr );
+  for ( pp = 0; pp < n_jobs; pp++ )
+    jobs[pp].data = data;
+
+  guint threads = MIN ( a_background_get_local_threads(), n_jobs );
+  if ( threads > 1 && data->n_points >= PROFILE_THREADED_POINTS ) {
+    GThreadPool *pool = g_thread_pool_new ( (GFunc) track_profile_job, NULL, threads, FALSE, NULL );
+    for ( pp = 0; pp < n_jobs; pp++ )
+      g_thread_pool_push ( pool, &jobs[pp], NULL );
+    // Wait for them all to finish
+    g_thread_pool_free ( pool, FALSE, TRUE );
+  }
+  else {
+    for ( pp = 0; pp < n_jobs; pp++ )
+      track_profile_job ( &jobs[pp], NULL );
+  }
+
+  G_LOCK(track_caches);
+  // Meanwhile another size may have been asked for
+  gboolean keep = cache->profiles_chunks == num_chunks;
+  for ( pp = 0; pp < n_jobs; pp++ ) {
+    if ( keep )
+      track_cache_store_profile ( cache, jobs[pp].profile, jobs[pp].results[jobs[pp].profile] );
+    else
+      g_free ( jobs[pp].results[jobs[pp].profile] );
+    if ( jobs[pp].with_gradient ) {
+      if ( keep )
+        track_cache_store_profile ( cache, VIK_TRACK_PROFILE_GRADIENT, jobs[pp].results[VIK_TRACK_PROFILE_GRADIENT] );
+      else
+        g_free ( jobs[pp].results[VIK_TRACK_PROFILE_GRADIENT] );
+    }
+  }
+  G_UNLOCK(track_caches);
+}
+
+/*
+ * Returns: A copy of the profile series (or NULL if it can't be made for this track)
+ */
+static gdouble *track_make_profile ( const VikTrack *tr, VikTrackProfile profile, guint16 num_chunks )
+{
+  gdouble *values = NULL;
+  vik_track_prepare_profiles ( tr, VIK_TRACK_PROFILE_MASK(profile), num_chunks );
+  G_LOCK(track_caches);
+  const VikTrackCache *cache = track_cache_current ( tr );
+  if ( cache && cache->profiles_chunks == num_chunks && cache->profiles[profile] ) {
+    values = g_malloc ( sizeof(gdouble) * num_chunks );
+    memcpy ( values, cache->profiles[profile], sizeof(gdouble) * num_chunks );
+  }
+  G_UNLOCK(track_caches);
+  return values;
+}
+
+gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_ELEVATION, num_chunks );
+}
+
+gdouble *vik_track_make_gradient_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_GRADIENT, num_chunks );
+}
+
+gdouble *vik_track_make_speed_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_SPEED, num_chunks );
+}
+
+gdouble *vik_track_make_distance_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_DISTANCE, num_chunks );
+}
+
+gdouble *vik_track_make_elevation_time_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_ELEVATION_TIME, num_chunks );
+}
+
+gdouble *vik_track_make_speed_dist_map ( const VikTrack *tr, guint16 num_chunks )
+{
+  return track_make_profile ( tr, VIK_TRACK_PROFILE_SPEED_DIST, num_chunks );
+}
+
 /**
  * vik_track_get_tp_by_dist:
  * @trk:                  The Track on which to find a Trackpoint
@@ -1288,201 +1845,105 @@ gdouble *vik_track_make_speed_dist_map ( const VikTrack *tr, guint16 num_chunks
  */
 VikTrackpoint *vik_track_get_tp_by_dist ( VikTrack *trk, gdouble meters_from_start, gboolean get_next_point, gdouble *tp_metres_from_start )
 {
-  gdouble current_dist = 0.0;
-  gdouble current_inc = 0.0;
+  const VikTrackData *data = track_lookup(trk)->data;
   if ( tp_metres_from_start )
     *tp_metres_from_start = 0.0;
 
-  if ( trk->trackpoints ) {
-    GList *iter = g_list_next ( g_list_first ( trk->trackpoints ) );
-    while (iter) {
-      current_inc = vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-                                     &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-      current_dist += current_inc;
-      if ( current_dist >= meters_from_start )
-        break;
-      iter = g_list_next ( iter );
-    }
-    // passed the end of the track
-    if ( !iter )
-      return NULL;
+  if ( !data->n_points )
+    return NULL;
 
-    if ( tp_metres_from_start )
-      *tp_metres_from_start = current_dist;
+  guint ii = track_data_lower_bound ( data->distances, 1, data->n_points, meters_from_start );
+  // passed the end of the track
+  if ( ii >= data->n_points )
+    return NULL;
 
-    // we've gone past the distance already, is the previous trackpoint wanted?
-    if ( !get_next_point ) {
-      if ( iter->prev ) {
-        if ( tp_metres_from_start )
-          *tp_metres_from_start = current_dist-current_inc;
-        return VIK_TRACKPOINT(iter->prev->data);
-      }
-    }
-    return VIK_TRACKPOINT(iter->data);
-  }
+  // we've gone past the distance already, is the previous trackpoint wanted?
+  if ( !get_next_point )
+    ii--;
 
-  return NULL;
+  if ( tp_metres_from_start )
+    *tp_metres_from_start = data->distances[ii];
+  return data->tps[ii];
 }
 
 /* by Alex Foobarian */
 VikTrackpoint *vik_track_get_closest_tp_by_percentage_dist ( VikTrack *tr, gdouble reldist, gdouble *meters_from_start )
 {
-  gdouble dist = vik_track_get_length_including_gaps(tr) * reldist;
-  gdouble current_dist = 0.0;
-  gdouble current_inc = 0.0;
-  if ( tr->trackpoints )
-  {
-    GList *iter = tr->trackpoints->next;
-    GList *last_iter = NULL;
-    gdouble last_dist = 0.0;
-    while (iter)
-    {
-      current_inc = vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-                                     &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-      last_dist = current_dist;
-      current_dist += current_inc;
-      if ( current_dist >= dist )
-        break;
-      last_iter = iter;
-      iter = iter->next;
-    }
-    if (!iter) { /* passing the end the track */
-      if (last_iter) {
-        if (meters_from_start)
-          *meters_from_start = last_dist;
-        return(VIK_TRACKPOINT(last_iter->data));
-      }
-      else
-        return NULL;
-    }
-    /* we've gone past the dist already, was prev trackpoint closer? */
-    /* should do a vik_coord_average_weighted() thingy. */
-    if ( iter->prev && fabs(current_dist-current_inc-dist) < fabs(current_dist-dist) ) {
+  const VikTrackData *data = track_lookup(tr)->data;
+
+  if ( !data->n_points )
+    return NULL;
+
+  gdouble dist = data->distances[data->n_points-1] * reldist;
+  guint ii = track_data_lower_bound ( data->distances, 1, data->n_points, dist );
+
+  if ( ii >= data->n_points ) { /* passing the end the track */
+    if ( data->n_points > 1 ) {
       if (meters_from_start)
-        *meters_from_start = last_dist;
-      iter = iter->prev;
+        *meters_from_start = data->distances[data->n_points-2];
+      return data->tps[data->n_points-1];
     }
     else
-      if (meters_from_start)
-        *meters_from_start = current_dist;
-
-    return VIK_TRACKPOINT(iter->data);
-
+      return NULL;
   }
-  return NULL;
+  /* we've gone past the dist already, was prev trackpoint closer? */
+  /* should do a vik_coord_average_weighted() thingy. */
+  if ( fabs(data->distances[ii-1]-dist) < fabs(data->distances[ii]-dist) )
+    ii--;
+  if (meters_from_start)
+    *meters_from_start = data->distances[ii];
+
+  return data->tps[ii];
 }
 
 VikTrackpoint *vik_track_get_closest_tp_by_percentage_time ( VikTrack *tr, gdouble reltime, gdouble *seconds_from_start )
 {
-  if ( !tr->trackpoints )
+  const VikTrackCache *cache = track_lookup ( tr );
+  const VikTrackData *data = cache->data;
+  VikTrackpoint * const *tps = data->tps;
+  if ( !data->n_points )
     return NULL;
 
   gdouble t_pos, t_start, t_end, t_total;
-  t_start = VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  t_end = VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->timestamp;
+  t_start = tps[0]->timestamp;
+  t_end = tps[data->n_points-1]->timestamp;
   t_total = t_end - t_start;
 
   t_pos = t_start + t_total * reltime;
 
-  GList *iter = tr->trackpoints;
-
-  while (iter) {
-    if (VIK_TRACKPOINT(iter->data)->timestamp == t_pos)
-      break;
-    if (VIK_TRACKPOINT(iter->data)->timestamp > t_pos) {
-      if (iter->prev == NULL)  /* first trackpoint */
-        break;
-      gdouble t_before = t_pos - VIK_TRACKPOINT(iter->prev->data)->timestamp;
-      gdouble t_after = VIK_TRACKPOINT(iter->data)->timestamp - t_pos;
+  // The first point at or beyond the time is also the first one where the latest time so far reaches it
+  guint ii = track_data_lower_bound ( cache->max_times, 0, data->n_points, t_pos );
+  if ( ii < data->n_points ) {
+    if ( tps[ii]->timestamp > t_pos && ii > 0 ) {
+      gdouble t_before = t_pos - tps[ii-1]->timestamp;
+      gdouble t_after = tps[ii]->timestamp - t_pos;
       if (t_before <= t_after)
-        iter = iter->prev;
-      break;
+        ii--;
     }
-    else if ((iter->next == NULL) && (t_pos < (VIK_TRACKPOINT(iter->data)->timestamp + 3))) /* last trackpoint: accommodate for round-off */
-      break;
-    iter = iter->next;
   }
-
-  if (!iter)
-    return NULL;
+  else {
+    ii = data->n_points-1;
+    if ( !(t_pos < (tps[ii]->timestamp + 3)) ) /* last trackpoint: accommodate for round-off */
+      return NULL;
+  }
   if (seconds_from_start)
-    *seconds_from_start = VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(tr->trackpoints->data)->timestamp;
-  return VIK_TRACKPOINT(iter->data);
+    *seconds_from_start = tps[ii]->timestamp - t_start;
+  return tps[ii];
 }
 
 VikTrackpoint* vik_track_get_tp_by_max_speed ( const VikTrack *tr )
 {
-  gdouble maxspeed = 0.0, speed = 0.0;
-
-  if ( !tr->trackpoints )
-    return NULL;
-
-  GList *iter = tr->trackpoints;
-  VikTrackpoint *max_speed_tp = NULL;
-
-  while (iter) {
-    if (iter->prev) {
-      if ( !isnan(VIK_TRACKPOINT(iter->data)->timestamp) &&
-           !isnan(VIK_TRACKPOINT(iter->prev->data)->timestamp) &&
-	   (! VIK_TRACKPOINT(iter->data)->newsegment) ) {
-	speed =  vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord), &(VIK_TRACKPOINT(iter->prev->data)->coord) )
-	  / ABS(VIK_TRACKPOINT(iter->data)->timestamp - VIK_TRACKPOINT(iter->prev->data)->timestamp);
-	if ( speed > maxspeed ) {
-	  maxspeed = speed;
-	  max_speed_tp = VIK_TRACKPOINT(iter->data);
-	}
-      }
-    }
-    iter = iter->next;
-  }
-  
-  return max_speed_tp;
+  return track_cache(tr)->stats.max_speed_tp;
 }
 
 VikTrackpoint* vik_track_get_tp_by_max_alt ( const VikTrack *tr )
 {
-  gdouble maxalt = -5000.0;
-  if ( !tr->trackpoints )
-    return NULL;
-
-  GList *iter = tr->trackpoints;
-  VikTrackpoint *max_alt_tp = NULL;
-
-  while (iter) {
-    if ( VIK_TRACKPOINT(iter->data)->altitude > maxalt ) {
-      maxalt = VIK_TRACKPOINT(iter->data)->altitude;
-      max_alt_tp = VIK_TRACKPOINT(iter->data);
-    }
-    iter = iter->next;
-  }
-
-  if (!max_alt_tp)
-    return NULL;
-
-  return max_alt_tp;
+  return track_cache(tr)->stats.max_alt_tp;
 }
 
 VikTrackpoint* vik_track_get_tp_by_min_alt ( const VikTrack *tr )
 {
-  gdouble minalt = 25000.0;
-  if ( !tr->trackpoints )
-    return NULL;
-
-  GList *iter = tr->trackpoints;
-  VikTrackpoint *min_alt_tp = NULL;
-
-  while (iter) {
-    if ( VIK_TRACKPOINT(iter->data)->altitude < minalt ) {
-      minalt = VIK_TRACKPOINT(iter->data)->altitude;
-      min_alt_tp = VIK_TRACKPOINT(iter->data);
-    }
-    iter = iter->next;
-  }
-
-  if (!min_alt_tp)
-    return NULL;
-
-  return min_alt_tp;
+  return track_cache(tr)->stats.min_alt_tp;
 }
 
 VikTrackpoint *vik_track_get_tp_first( const VikTrack *tr )
@@ -1498,28 +1959,26 @@ VikTrackpoint *vik_track_get_tp_last ( const VikTrack *tr )
   if ( !tr->trackpoints )
     return NULL;
 
-  return (VikTrackpoint*)g_list_last(tr->trackpoints)->data;
+  // The last link is known while the statistics are current,
+  //  but isn't worth making them for (e.g. when a track is being drawn point by point)
+  G_LOCK(track_caches);
+  const VikTrackCache *cache = track_cache_current ( tr );
+  GList *last = cache ? cache->tail : NULL;
+  G_UNLOCK(track_caches);
+  if ( !last )
+    last = g_list_last ( tr->trackpoints );
+  return VIK_TRACKPOINT(last->data);
 }
 
 VikTrackpoint *vik_track_get_tp_prev ( const VikTrack *tr, VikTrackpoint *tp )
 {
-  if ( !tr->trackpoints )
-    return NULL;
+  guint index;
+  const VikTrackCache *cache = track_lookup_index ( tr, tp, &index );
 
-  GList *iter = tr->trackpoints;
-  VikTrackpoint *tp_prev = NULL;
-
-  while (iter) {
-    if (iter->prev) {
-      if ( VIK_TRACKPOINT(iter->data) == tp ) {
-        tp_prev = VIK_TRACKPOINT(iter->prev->data);
-        break;
-      }
-    }
-    iter = iter->next;
-  }
+  if ( !cache || index == 0 )
+    return NULL;
 
-  return tp_prev;
+  return cache->data->tps[index-1];
 }
 
 /**
@@ -1534,19 +1993,9 @@ gboolean vik_track_get_minmax_alt ( const VikTrack *tr, gdouble *min_alt, gdoubl
   *min_alt = 25000;
   *max_alt = -5000;
   if ( tr && tr->trackpoints ) {
-    GList *iter = tr->trackpoints;
-    gdouble tmp_alt;
-    while (iter) {
-      VikTrackpoint *tp = VIK_TRACKPOINT(iter->data);
-      if ( !isnan(tp->altitude) ) {
-	tmp_alt = tp->altitude;
-	if ( tmp_alt > *max_alt )
-	  *max_alt = tmp_alt;
-	if ( tmp_alt < *min_alt )
-	  *min_alt = tmp_alt;
-      }
-      iter = iter->next;
-    }
+    const VikTrackStats *stats = &(track_cache(tr)->stats);
+    *min_alt = stats->min_alt;
+    *max_alt = stats->max_alt;
     return (*min_alt != 25000);
   }
   return FALSE;
@@ -1655,6 +2104,8 @@ void vik_track_calculate_bounds ( VikTrack *trk )
 {
   GList *tp_iter;
   tp_iter = trk->trackpoints;
+
+  vik_track_invalidate ( trk );
   
   struct LatLon topleft, bottomright, ll;
   
@@ -1717,6 +2168,7 @@ void vik_track_anonymize_times ( VikTrack *tr )
     }
     tp_iter = tp_iter->next;
   }
+  vik_track_invalidate ( tr );
 }
 
 /**
@@ -1761,6 +2213,7 @@ void vik_track_interpolate_times ( VikTrack *tr )
 
           tp->timestamp = (cur_dist / tr_dist) * tsdiff + tsfirst;
         }
+        vik_track_invalidate ( tr );
         // Some points may now have the same time so remove them.
         vik_track_remove_same_time_points ( tr );
       }
@@ -1795,6 +2248,7 @@ gulong vik_track_apply_dem_data ( VikTrack *tr, gboolean skip_existing )
     }
     tp_iter = tp_iter->next;
   }
+  vik_track_invalidate ( tr );
   return num;
 }
 
@@ -1808,8 +2262,10 @@ void vik_track_apply_dem_data_last_trackpoint ( VikTrack *tr )
   if ( tr->trackpoints ) {
     /* As in vik_track_apply_dem_data above - use 'best' interpolation method */
     elev = a_dems_get_elev_by_coord ( &(VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->coord), VIK_DEM_INTERPOL_BEST );
-    if ( elev != VIK_DEM_INVALID_ELEVATION )
+    if ( elev != VIK_DEM_INVALID_ELEVATION ) {
       VIK_TRACKPOINT(g_list_last(tr->trackpoints)->data)->altitude = elev;
+      vik_track_invalidate ( tr );
+    }
   }
 }
 
@@ -1905,6 +2361,7 @@ gulong vik_track_smooth_missing_elevation_data ( VikTrack *tr, gboolean flat )
     tp_iter = tp_iter->next;
   }
 
+  vik_track_invalidate ( tr );
   return num;
 }
 
@@ -1920,6 +2377,7 @@ void vik_track_steal_and_append_trackpoints ( VikTrack *t1, VikTrack *t2 )
   } else
     t1->trackpoints = t2->trackpoints;
   t2->trackpoints = NULL;
+  vik_track_invalidate ( t2 );
 
   // Trackpoints updated - so update the bounds
   vik_track_calculate_bounds ( t1 );
@@ -1943,6 +2401,7 @@ VikCoord *vik_track_cut_back_to_double_point ( VikTrack *tr )
   while ( iter->next )
     iter = iter->next;
 
+  vik_track_invalidate ( tr );
 
   while ( iter->prev ) {
     VikCoord *cur_coord = &((VikTrackpoint*)iter->data)->coord;
@@ -1955,7 +2414,7 @@ VikCoord *vik_track_cut_back_to_double_point ( VikTrack *tr )
 
       /* truncate trackpoint list */
       iter->prev = NULL; /* pretend it's the end */
-      g_list_foreach ( iter, (GFunc) g_free, NULL );
+      g_list_foreach ( iter, (GFunc) vik_trackpoint_free, NULL );
       g_list_free( iter );
 
       prev->next = NULL;
@@ -1968,7 +2427,7 @@ VikCoord *vik_track_cut_back_to_double_point ( VikTrack *tr )
   /* no double point found! */
   rv = g_malloc(sizeof(VikCoord));
   *rv = ((VikTrackpoint*) tr->trackpoints->data)->coord;
-  g_list_foreach ( tr->trackpoints, (GFunc) g_free, NULL );
+  g_list_foreach ( tr->trackpoints, (GFunc) vik_trackpoint_free, NULL );
   g_list_free( tr->trackpoints );
   tr->trackpoints = NULL;
   return rv;
@@ -67,6 +67,66 @@ typedef enum {
   NUM_TRACK_DRAWNAMES
 } VikTrackDrawnameType;
 
+/**
+ * VikTrackStats:
+ *
+ * Whole track statistics, kept up to date as points are appended
+ */
+typedef struct {
+  gdouble length;         /* Distance within segments */
+  gdouble length_including_gaps;
+  gdouble timed_length;   /* Distance within segments between points that have timestamps */
+  gdouble timed_duration; /* Time taken for the above */
+  gdouble max_speed;
+  VikTrackpoint *max_speed_tp; /* The point reached at the maximum speed; NULL if none */
+  gdouble min_alt;        /* 25000 if no altitudes */
+  gdouble max_alt;        /* -5000 if no altitudes */
+  VikTrackpoint *min_alt_tp;   /* NULL if no altitudes */
+  VikTrackpoint *max_alt_tp;   /* NULL if no altitudes */
+  gdouble elev_up;
+  gdouble elev_down;
+} VikTrackStats;
+
+/**
+ * VikTrackProfile:
+ *
+ * The series of values along a track that can be made for graphs
+ */
+typedef enum {
+  VIK_TRACK_PROFILE_ELEVATION,      /* By distance */
+  VIK_TRACK_PROFILE_GRADIENT,       /* By distance */
+  VIK_TRACK_PROFILE_SPEED,          /* By time */
+  VIK_TRACK_PROFILE_DISTANCE,       /* By time */
+  VIK_TRACK_PROFILE_ELEVATION_TIME, /* By time */
+  VIK_TRACK_PROFILE_SPEED_DIST,     /* By distance */
+  VIK_TRACK_PROFILE_N
+} VikTrackProfile;
+
+#define VIK_TRACK_PROFILE_MASK(p) (1 << (p))
+
+/**
+ * VikTrackData:
+ *
+ * A contiguous columnar copy of a track's trackpoints,
+ *  so operations over the whole track are linear scans of arrays rather than list walks.
+ * Made when first needed by vik_track_get_data() and then kept with the track until it is changed.
+ */
+typedef struct _VikTrackData VikTrackData;
+struct _VikTrackData {
+  guint n_points;
+  VikTrackpoint **tps; /* The trackpoints themselves */
+  VikCoord *coords;
+  gdouble *timestamps;
+  gdouble *altitudes;
+  gdouble *diffs;      /* Distance from the previous point (including over segment gaps); 0 for the first point */
+  gboolean *newsegments;
+  guint n_segments;
+  guint *segments;     /* Index of the first point of each segment */
+  gdouble *distances;  /* Distance from the start (including over segment gaps) */
+};
+
+typedef struct _VikTrackCache VikTrackCache;
+
 // Instead of having a separate VikRoute type, routes are considered tracks
 //  Thus all track operations must cope with a 'route' version
 //  [track functions handle having no timestamps anyway - so there is no practical difference in most cases]
@@ -83,13 +143,15 @@ struct _VikTrack {
   gchar *comment;
   gchar *description;
   gchar *source;
-  gchar *type;
+  const gchar *type; // Interned string - do not free
   guint8 ref_count;
   gchar *name;
   GtkWidget *property_dialog;
   gboolean has_color;
   GdkColor color;
   LatLonBBox bbox;
+  guint revision; /* Changes whenever the trackpoints are changed */
+  VikTrackCache *cache; /* Values derived from the trackpoints at the current revision, may be NULL */
 };
 
 VikTrack *vik_track_new();
@@ -109,6 +171,13 @@ VikTrackpoint *vik_trackpoint_copy(VikTrackpoint *tp);
 void vik_trackpoint_set_name(VikTrackpoint *tp, const gchar *name);
 
 void vik_track_add_trackpoint(VikTrack *tr, VikTrackpoint *tp, gboolean recalculate);
+void vik_track_remove_last_trackpoint ( VikTrack *tr );
+
+const VikTrackData *vik_track_get_data ( const VikTrack *tr );
+void vik_track_invalidate ( VikTrack *tr );
+gdouble *vik_track_make_significance ( const VikTrack *tr );
+VikCoord *vik_track_get_coords ( const VikTrack *tr, guint *n_points );
+
 gdouble vik_track_get_length_to_trackpoint (const VikTrack *tr, const VikTrackpoint *tp);
 gdouble vik_track_get_length(const VikTrack *tr);
 gdouble vik_track_get_length_including_gaps(const VikTrack *tr);
@@ -133,6 +202,7 @@ gdouble vik_track_get_average_speed(const VikTrack *tr);
 gdouble vik_track_get_average_speed_moving ( const VikTrack *tr, int stop_length_seconds );
 
 void vik_track_convert ( VikTrack *tr, VikCoordMode dest_mode );
+void vik_track_prepare_profiles ( const VikTrack *tr, guint profiles, guint16 num_chunks );
 gdouble *vik_track_make_elevation_map ( const VikTrack *tr, guint16 num_chunks );
 void vik_track_get_total_elevation_gain(const VikTrack *tr, gdouble *up, gdouble *down);
 VikTrackpoint *vik_track_get_tp_by_dist ( VikTrack *trk, gdouble meters_from_start, gboolean get_next_point, gdouble *tp_metres_from_start );
@@ -48,7 +48,6 @@
 #include "thumbnails.h"
 #include "background.h"
 #include "gpx.h"
-#include "geojson.h"
 #include "babel.h"
 #include "dem.h"
 #include "dems.h"
@@ -63,6 +62,7 @@
 #include "vikexttool_datasources.h"
 #include "ui_util.h"
 #include "vikrouting.h"
+#include "rtree.h"
 
 #include "icons/icons.h"
 
@@ -107,6 +107,8 @@
 
 #define MIN_STOP_LENGTH 15
 #define MAX_STOP_LENGTH 86400
+#define TRACK_LOD_PIXELS 0.5 /* simplify tracks for drawing by up to this amount */
+#define WP_LABEL_CACHE_MIN 1000 /* waypoint labels kept laid out, or one per waypoint of the layer if more */
 #define DRAW_ELEVATION_FACTOR 30 /* height of elevation plotting, sort of relative to zoom level ("mpp" that isn't mpp necessarily) */
                                  /* this is multiplied by user-inputted value from 1-100. */
 
@@ -131,6 +133,93 @@ typedef enum {
   VIK_EXTERNAL_TYPE_LAST
 } trw_external_type_t;
 
+/*
+ * Things that are slow to make for drawing, kept by name for reuse on later draws.
+ * Once full the least recently used is dropped to make room.
+ */
+typedef struct {
+  GHashTable *table; // Of DrawCacheEntry
+  GQueue *order; // Of the keys, most recently used first
+  guint max_size;
+  GDestroyNotify value_free;
+} DrawCache;
+
+typedef struct {
+  gpointer value;
+  GList *link; // Of the key in the order
+  GDestroyNotify value_free;
+} DrawCacheEntry;
+
+static void draw_cache_entry_free ( DrawCacheEntry *entry )
+{
+  entry->value_free ( entry->value );
+  g_free ( entry );
+}
+
+static DrawCache *draw_cache_new ( guint max_size, GDestroyNotify value_free )
+{
+  DrawCache *dc = g_new0 ( DrawCache, 1 );
+  dc->table = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, (GDestroyNotify) draw_cache_entry_free );
+  dc->order = g_queue_new ();
+  dc->max_size = max_size;
+  dc->value_free = value_free;
+  return dc;
+}
+
+static void draw_cache_clear ( DrawCache *dc )
+{
+  g_queue_clear ( dc->order );
+  g_hash_table_remove_all ( dc->table );
+}
+
+static void draw_cache_free ( DrawCache *dc )
+{
+  g_queue_free ( dc->order );
+  g_hash_table_destroy ( dc->table );
+  g_free ( dc );
+}
+
+static void draw_cache_set_max_size ( DrawCache *dc, guint max_size )
+{
+  dc->max_size = max_size;
+  while ( g_queue_get_length ( dc->order ) > dc->max_size )
+    g_hash_table_remove ( dc->table, g_queue_pop_tail ( dc->order ) );
+}
+
+static gpointer draw_cache_lookup ( DrawCache *dc, const gchar *key )
+{
+  DrawCacheEntry *entry = g_hash_table_lookup ( dc->table, key );
+  if ( !entry )
+    return NULL;
+  // Now the most recently used
+  g_queue_unlink ( dc->order, entry->link );
+  g_queue_push_head_link ( dc->order, entry->link );
+  return entry->value;
+}
+
+static void draw_cache_insert ( DrawCache *dc, const gchar *key, gpointer value )
+{
+  if ( dc->max_size == 0 ) {
+    dc->value_free ( value );
+    return;
+  }
+  DrawCacheEntry *entry = g_hash_table_lookup ( dc->table, key );
+  if ( entry ) {
+    g_queue_delete_link ( dc->order, entry->link );
+    g_hash_table_remove ( dc->table, key );
+  }
+  while ( g_queue_get_length ( dc->order ) >= dc->max_size )
+    g_hash_table_remove ( dc->table, g_queue_pop_tail ( dc->order ) );
+
+  gchar *new_key = g_strdup ( key );
+  entry = g_new ( DrawCacheEntry, 1 );
+  entry->value = value;
+  entry->value_free = dc->value_free;
+  g_queue_push_head ( dc->order, new_key );
+  entry->link = g_queue_peek_head_link ( dc->order );
+  g_hash_table_insert ( dc->table, new_key, entry );
+}
+
 struct _VikTrwLayer {
   VikLayer vl;
   GHashTable *tracks;
@@ -143,6 +232,13 @@ struct _VikTrwLayer {
   gboolean tracks_visible, routes_visible, waypoints_visible;
   LatLonBBox waypoints_bbox;
 
+  // Spatial indices, to find what is near a position without looking at everything
+  VikRTree *track_index; // Of TrackIndexChunk for both tracks and routes
+  GHashTable *track_index_entries; // Of TrackIndexEntry for each VikTrack
+  VikRTree *waypoint_index; // Of the waypoint ids
+
+  GHashTable *track_geometry; // Of TrackGeometry for each VikTrack, as last drawn
+
   gboolean track_draw_labels;
   guint8 drawmode;
   guint8 drawpoints;
@@ -176,7 +272,7 @@ struct _VikTrwLayer {
 
   gdouble track_draw_speed_factor;
   GArray *track_gc;
-  GdkGC *track_1color_gc;
+  GHashTable *track_color_gcs; // Of GdkGC for each track colour in DRAWMODE_BY_TRACK
   GdkColor track_color;
   GdkGC *current_track_gc;
   // Separate GC for a track's potential new point as drawn via separate method
@@ -218,12 +314,14 @@ struct _VikTrwLayer {
   gboolean drawlabels;
   gboolean drawimages;
   guint8 image_alpha;
-  GHashTable *image_cache;
+  DrawCache *image_cache; // Of GdkPixbuf for each image file
   guint8 image_size;
   guint16 image_cache_size;
+  gint image_max_size; // Largest image drawn so far, for finding clicks on images
 
   /* for waypoint text */
   PangoLayout *wplabellayout;
+  DrawCache *wp_label_cache; // Of WaypointLabel for each waypoint name
 
   gboolean has_verified_thumbnails;
 
@@ -242,6 +340,12 @@ struct _VikTrwLayer {
   gchar *external_file;
   gboolean external_loaded;
   gchar *external_dirpath;
+
+  // Data read from a .vik file but not yet made into tracks and waypoints
+  GString *deferred_data;
+  gchar *deferred_dirpath;
+  GpspointSummary deferred_summary; // What is known of the deferred data without loading it
+  GtkTreeIter deferred_iter; // Placeholder in the treeview until loaded
 };
 
 struct DrawingParams {
@@ -257,10 +361,19 @@ struct DrawingParams {
   gdouble ce1, ce2, cn1, cn2;
   LatLonBBox bbox;
   gboolean highlight;
+  VikViewportProjection proj;
+  GPtrArray *waypoints; // Those to be drawn, gathered so their positions can be converted together
 };
 
 static gboolean trw_layer_delete_waypoint ( VikTrwLayer *vtl, VikWaypoint *wp );
 
+static void trw_layer_index_new ( VikTrwLayer *vtl );
+static void trw_layer_index_free ( VikTrwLayer *vtl );
+static void trw_layer_index_waypoint ( gpointer id, VikWaypoint *wp, VikTrwLayer *vtl );
+static void trw_layer_unindex_track ( VikTrwLayer *vtl, VikTrack *trk );
+static void track_geometry_free ( gpointer data );
+static void trw_layer_unindex_track_cb ( gpointer id, VikTrack *trk, VikTrwLayer *vtl );
+
 typedef enum {
   MA_VTL = 0,
   MA_VLP,
@@ -800,6 +913,7 @@ static gboolean trw_read_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath
 static void trw_write_file_external ( VikTrwLayer *trw, FILE *f, const gchar *dirpath );
 static gboolean trw_read_file_external ( VikTrwLayer *trw, FILE *f, const gchar *dirpath );
 static gboolean trw_load_external_layer ( VikTrwLayer *trw );
+static void trw_layer_load_deferred ( VikTrwLayer *vtl );
 static void trw_update_layer_icon ( VikTrwLayer *trw );
 
 /* End Layer Interface function definitions */
@@ -870,8 +984,6 @@ static gboolean have_diary_program = FALSE;
 static gchar *diary_program = NULL;
 #define VIK_SETTINGS_EXTERNAL_DIARY_PROGRAM "external_diary_program"
 
-static gboolean have_geojson_export = FALSE;
-
 static gboolean have_astro_program = FALSE;
 static gchar *astro_program = NULL;
 #define VIK_SETTINGS_EXTERNAL_ASTRO_PROGRAM "external_astro_program"
@@ -933,10 +1045,6 @@ static void vik_trwlayer_class_init ( VikTrwLayerClass *klass )
     g_free ( cmd );
   }
 
-  if ( g_find_program_in_path ( a_geojson_program_export() ) ) {
-    have_geojson_export = TRUE;
-  }
-
   // Astronomy Domain
   if ( ! a_settings_get_string ( VIK_SETTINGS_EXTERNAL_ASTRO_PROGRAM, &astro_program ) ) {
 #ifdef WINDOWS
@@ -1067,6 +1175,7 @@ static gboolean trw_layer_find_date_waypoint ( const gpointer id, const VikWaypo
  */
 gboolean vik_trw_layer_find_date ( VikTrwLayer *vtl, const gchar *date_str, VikCoord *position, VikViewport *vvp, gboolean do_tracks, gboolean select )
 {
+  trw_layer_load_deferred ( vtl );
   date_finder_type df;
   df.found = FALSE;
   df.date_str = date_str;
@@ -1355,19 +1464,18 @@ static gboolean trw_layer_set_param ( VikTrwLayer *vtl, VikLayerSetParam *vlsp )
     case PARAM_IS:
       if ( vlsp->data.u != vtl->image_size ) {
         vtl->image_size = vlsp->data.u;
-        g_hash_table_remove_all ( vtl->image_cache );
+        draw_cache_clear ( vtl->image_cache );
       }
       break;
     case PARAM_IA:
       if ( vlsp->data.u != vtl->image_alpha ) {
         vtl->image_alpha = vlsp->data.u;
-        g_hash_table_remove_all ( vtl->image_cache );
+        draw_cache_clear ( vtl->image_cache );
       }
       break;
     case PARAM_ICS:
-      // If cache size is made smaller, then reset cache
-      if ( vlsp->data.u < vtl->image_cache_size )
-        g_hash_table_remove_all ( vtl->image_cache );
+      // If cache size is made smaller, the least recently used images are dropped
+      draw_cache_set_max_size ( vtl->image_cache, vlsp->data.u );
       vtl->image_cache_size = vlsp->data.u;
       break;
     case PARAM_WPC:
@@ -1406,6 +1514,7 @@ static gboolean trw_layer_set_param ( VikTrwLayer *vtl, VikLayerSetParam *vlsp )
           case FS_XX_LARGE: vtl->wp_fsize_str = g_strdup ( "xx-large" ); break;
           default: vtl->wp_fsize_str = g_strdup ( "medium" ); break;
         }
+        draw_cache_clear ( vtl->wp_label_cache );
       }
       break;
     case PARAM_WPSO: if ( vlsp->data.u < VL_SO_LAST ) vtl->wp_sort_order = vlsp->data.u; break;
@@ -1584,6 +1693,8 @@ static void trw_layer_marshall( VikTrwLayer *vtl, guint8 **data, guint *len )
   guint8 *pd;
   guint pl;
 
+  trw_layer_load_deferred ( vtl );
+
   *data = NULL;
 
   // Use byte arrays to store sublayer data
@@ -1745,6 +1856,20 @@ static void pixbuf_free ( GdkPixbuf *pixbuf )
   g_object_unref ( G_OBJECT(pixbuf) );
 }
 
+/*
+ * A waypoint label laid out ready to draw
+ */
+typedef struct {
+  PangoLayout *layout;
+  gint width, height;
+} WaypointLabel;
+
+static void waypoint_label_free ( WaypointLabel *label )
+{
+  g_object_unref ( G_OBJECT(label->layout) );
+  g_free ( label );
+}
+
 // Stick a 1 at the end of the function name to make it more unique
 //  thus more easily searchable in a simple text editor
 static VikTrwLayer* trw_layer_new1 ( VikViewport *vvp )
@@ -1771,7 +1896,12 @@ static VikTrwLayer* trw_layer_new1 ( VikViewport *vvp )
   rv->routes = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) vik_track_free );
   rv->routes_iters = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, g_free );
 
-  rv->image_cache = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify) pixbuf_free ); // Must be performed before set_params via set_defaults
+  trw_layer_index_new ( rv );
+  rv->track_geometry = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, track_geometry_free );
+
+  // Must be performed before set_params via set_defaults
+  rv->image_cache = draw_cache_new ( 0, (GDestroyNotify) pixbuf_free );
+  rv->wp_label_cache = draw_cache_new ( WP_LABEL_CACHE_MIN, (GDestroyNotify) waypoint_label_free );
 
   vik_layer_set_defaults ( VIK_LAYER(rv), vvp );
 
@@ -1798,6 +1928,8 @@ static void trw_layer_free ( VikTrwLayer *trwlayer )
   g_hash_table_destroy(trwlayer->tracks_iters);
   g_hash_table_destroy(trwlayer->routes);
   g_hash_table_destroy(trwlayer->routes_iters);
+  trw_layer_index_free ( trwlayer );
+  g_hash_table_destroy ( trwlayer->track_geometry );
 
   /* ODC: replace with GArray */
   trw_layer_free_track_gcs ( trwlayer );
@@ -1832,11 +1964,18 @@ static void trw_layer_free ( VikTrwLayer *trwlayer )
   if ( trwlayer->tracks_analysis_dialog != NULL )
     gtk_widget_destroy ( GTK_WIDGET(trwlayer->tracks_analysis_dialog) );
 
-  g_hash_table_destroy ( trwlayer->image_cache );
+  draw_cache_free ( trwlayer->image_cache );
+  draw_cache_free ( trwlayer->wp_label_cache );
 
   g_free ( trwlayer->external_file );
   g_free ( trwlayer->external_dirpath );
 
+  if ( trwlayer->deferred_data ) {
+    g_string_free ( trwlayer->deferred_data, TRUE );
+    g_array_free ( trwlayer->deferred_summary.track_times, TRUE );
+  }
+  g_free ( trwlayer->deferred_dirpath );
+
   if ( trwlayer->crosshair_cursor )
   {
     gdk_cursor_unref ( trwlayer->crosshair_cursor );
@@ -1885,6 +2024,7 @@ static void init_drawing_params ( struct DrawingParams *dp, VikTrwLayer *vtl, Vi
   }
 
   dp->bbox = vik_viewport_get_bbox ( vp );
+  vik_viewport_get_projection ( vp, &dp->proj );
 }
 
 /*
@@ -2223,6 +2363,132 @@ static void trw_layer_draw_point_names ( struct DrawingParams *dp, VikTrack *trk
   g_free ( bgcolour );
 }
 
+/*
+ * Values for drawing a track that are kept between draws:
+ *  the significance of each point, for simplifying the track when zoomed out,
+ *  and the positions of the trackpoints in the world pixels of the viewport (see vik_viewport_projection_to_world()),
+ *  so that panning only has to move them rather than convert every coordinate again.
+ * They are remade when the track is changed (as given by its revision),
+ *  and the positions also when the viewport is zoomed or reprojected.
+ */
+typedef struct {
+  guint revision;
+  guint n_points;
+  gdouble *significance; /* Only made when first needed */
+  VikViewportProjection proj;
+  GdkPoint *world;       /* Only made when first needed */
+} TrackGeometry;
+
+static void track_geometry_free ( gpointer data )
+{
+  TrackGeometry *geom = data;
+  g_free ( geom->significance );
+  g_free ( geom->world );
+  g_free ( geom );
+}
+
+/*
+ * Returns: The drawing values of the track, discarding any made before the track was last changed
+ */
+static TrackGeometry *trw_layer_track_geometry ( VikTrwLayer *vtl, VikTrack *trk )
+{
+  guint n_points = vik_track_get_tp_count ( trk );
+  TrackGeometry *geom = g_hash_table_lookup ( vtl->track_geometry, trk );
+  if ( !geom ) {
+    geom = g_new0 ( TrackGeometry, 1 );
+    g_hash_table_insert ( vtl->track_geometry, trk, geom );
+  }
+  else if ( geom->revision == trk->revision && geom->n_points == n_points )
+    return geom;
+  else {
+    g_free ( geom->significance );
+    g_free ( geom->world );
+    geom->significance = NULL;
+    geom->world = NULL;
+  }
+  geom->revision = trk->revision;
+  geom->n_points = n_points;
+  return geom;
+}
+
+/*
+ * Set @points to the screen positions of all the trackpoints
+ */
+static void trw_layer_track_to_screen ( struct DrawingParams *dp, VikTrack *trk, TrackGeometry *geom, GdkPoint *points )
+{
+  guint n_points;
+  if ( !vik_viewport_projection_has_world ( &dp->proj ) ) {
+    VikCoord *coords = vik_track_get_coords ( trk, &n_points );
+    vik_viewport_projection_to_screen ( &dp->proj, coords, n_points, points );
+    g_free ( coords );
+    return;
+  }
+
+  if ( !geom->world || !vik_viewport_projection_same_world ( &geom->proj, &dp->proj ) ) {
+    VikCoord *coords = vik_track_get_coords ( trk, &n_points );
+    geom->proj = dp->proj;
+    geom->world = g_renew ( GdkPoint, geom->world, n_points );
+    vik_viewport_projection_to_world ( &dp->proj, coords, n_points, geom->world );
+    g_free ( coords );
+  }
+  vik_viewport_projection_world_to_screen ( &dp->proj, geom->world, geom->n_points, points );
+}
+
+/*
+ * The GC for drawing tracks of this colour, which is kept until the track GCs are next remade
+ */
+static GdkGC *trw_layer_track_color_gc ( VikTrwLayer *vtl, VikViewport *vp, GdkColor *color )
+{
+  if ( !vtl->track_color_gcs )
+    vtl->track_color_gcs = g_hash_table_new_full ( g_int64_hash, g_int64_equal, g_free, g_object_unref );
+
+  gint64 key = ((gint64)color->red << 32) | ((gint64)color->green << 16) | color->blue;
+  GdkGC *gc = g_hash_table_lookup ( vtl->track_color_gcs, &key );
+  if ( !gc ) {
+    gint64 *new_key = g_new ( gint64, 1 );
+    *new_key = key;
+    gc = vik_viewport_new_gc_from_color ( vp, color, vtl->line_thickness );
+    g_hash_table_insert ( vtl->track_color_gcs, new_key, gc );
+  }
+  return gc;
+}
+
+/*
+ * Consecutive segments of the same colour are gathered up to be drawn together,
+ *  which is much quicker than drawing each one by itself
+ */
+typedef struct {
+  VikViewport *vp;
+  GdkGC *gc;
+  GArray *points;
+} TrackLines;
+
+static void track_lines_flush ( TrackLines *lines )
+{
+  if ( lines->points->len > 1 )
+    vik_viewport_draw_lines ( lines->vp, lines->gc, (GdkPoint*)lines->points->data, lines->points->len );
+  g_array_set_size ( lines->points, 0 );
+}
+
+static void track_lines_add ( TrackLines *lines, GdkGC *gc, gint x1, gint y1, gint x2, gint y2 )
+{
+  GdkPoint pt;
+  if ( lines->points->len > 0 ) {
+    GdkPoint *last = &g_array_index ( lines->points, GdkPoint, lines->points->len-1 );
+    if ( gc != lines->gc || last->x != x1 || last->y != y1 )
+      track_lines_flush ( lines );
+  }
+  if ( lines->points->len == 0 ) {
+    lines->gc = gc;
+    pt.x = x1;
+    pt.y = y1;
+    g_array_append_val ( lines->points, pt );
+  }
+  pt.x = x2;
+  pt.y = y2;
+  g_array_append_val ( lines->points, pt );
+}
+
 static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct DrawingParams *dp, gboolean draw_track_outline )
 {
   if ( ! track->visible )
@@ -2273,10 +2539,7 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
       // Still need to figure out the gc according to the drawing mode:
       switch ( dp->vtl->drawmode ) {
       case DRAWMODE_BY_TRACK:
-        if ( dp->vtl->track_1color_gc )
-          g_object_unref ( dp->vtl->track_1color_gc );
-        dp->vtl->track_1color_gc = vik_viewport_new_gc_from_color ( dp->vp, &track->color, dp->vtl->line_thickness );
-        main_gc = dp->vtl->track_1color_gc;
+        main_gc = trw_layer_track_color_gc ( dp->vtl, dp->vp, &track->color );
 	break;
       default:
         // Mostly for DRAWMODE_ALL_SAME_COLOR
@@ -2287,13 +2550,42 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
     }
   }
 
+  // When zoomed out, skip points that make no visible difference to the line
+  //  but keep full detail when the points themselves are shown or the track is being worked on
+  TrackGeometry *geom = list ? trw_layer_track_geometry ( dp->vtl, track ) : NULL;
+  const gdouble *significance = NULL;
+  guint significance_count = 0;
+  gdouble lod_metres = 0.0;
+  if ( list && !drawpoints && track != dp->vtl->current_track && track != dp->vtl->current_tp_track ) {
+    lod_metres = dp->xmpp * TRACK_LOD_PIXELS;
+    if ( dp->lat_lon )
+      lod_metres *= cos ( DEG2RAD(dp->center->north_south) );
+    if ( !geom->significance )
+      geom->significance = vik_track_make_significance ( track );
+    significance = geom->significance;
+    significance_count = geom->n_points;
+  }
+
   if (list) {
     int x, y, oldx, oldy;
     VikTrackpoint *tp = VIK_TRACKPOINT(list->data);
+    VikTrackpoint *tp_prev = tp;
+    guint index = 0;
+    guint index_prev = 0;
+
+    // Convert all the trackpoints to screen positions in one go
+    GdkPoint *points = g_new ( GdkPoint, geom->n_points );
+    trw_layer_track_to_screen ( dp, track, geom, points );
+
+    TrackLines lines;
+    lines.vp = dp->vp;
+    lines.gc = NULL;
+    lines.points = g_array_new ( FALSE, FALSE, sizeof(GdkPoint) );
   
     tp_size = (list == dp->vtl->current_tpl) ? tp_size_cur : tp_size_reg;
 
-    vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+    x = points[0].x;
+    y = points[0].y;
 
     // Draw the first point as something a bit different from the normal points
     // ATM it's slightly bigger and a triangle
@@ -2318,10 +2610,17 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 
     while ((list = g_list_next(list)))
     {
+      index++;
       tp = VIK_TRACKPOINT(list->data);
+      if ( index < significance_count && significance[index] < lod_metres && list != dp->vtl->current_tpl )
+        continue;
       tp_size = (list == dp->vtl->current_tpl) ? tp_size_cur : tp_size_reg;
 
-      VikTrackpoint *tp2 = VIK_TRACKPOINT(list->prev->data);
+      // Previous point drawn (which may not be the previous point in the track)
+      VikTrackpoint *tp2 = tp_prev;
+      guint index2 = index_prev;
+      tp_prev = tp;
+      index_prev = index;
       // See if in a different lat/lon 'quadrant' so don't draw massively long lines (presumably wrong way around the Earth)
       //  Mainly to prevent wrong lines drawn when a track crosses the 180 degrees East-West longitude boundary
       //  (since vik_viewport_draw_line() only copes with pixel value and has no concept of the globe)
@@ -2337,7 +2636,8 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
              tp->coord.east_west < dp->ce2 && tp->coord.east_west > dp->ce1 &&  /* both UTM and lat lon */
              tp->coord.north_south > dp->cn1 && tp->coord.north_south < dp->cn2 ) )
       {
-        vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+        x = points[index].x;
+        y = points[index].y;
 
 	/*
 	 * If points are the same in display coordinates, don't draw.
@@ -2390,18 +2690,22 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
           if ( drawpoints && dp->vtl->coord_mode == VIK_COORD_UTM && tp->coord.utm_zone != dp->center->utm_zone )
             draw_utm_skip_insignia (  dp->vp, main_gc, x, y);
 
-          if (!useoldvals)
-            vik_viewport_coord_to_screen ( dp->vp, &(tp2->coord), &oldx, &oldy );
+          if (!useoldvals) {
+            oldx = points[index2].x;
+            oldy = points[index2].y;
+          }
 
           if ( draw_track_outline ) {
-            vik_viewport_draw_line ( dp->vp, dp->vtl->track_bg_gc, oldx, oldy, x, y);
+            track_lines_add ( &lines, dp->vtl->track_bg_gc, oldx, oldy, x, y );
           }
           else {
 
-            vik_viewport_draw_line ( dp->vp, main_gc, oldx, oldy, x, y);
+            track_lines_add ( &lines, main_gc, oldx, oldy, x, y );
 
             if ( dp->vtl->drawelevation && list->next && !isnan(VIK_TRACKPOINT(list->next->data)->altitude) ) {
               GdkPoint tmp[4];
+              // Keep the order of drawing for the elevation
+              track_lines_flush ( &lines );
               #define FIXALTITUDE(what) ((VIK_TRACKPOINT((what))->altitude-min_alt)/alt_diff*DRAW_ELEVATION_FACTOR*dp->vtl->elevation_factor/dp->xmpp)
 
 	      tmp[0].x = oldx;
@@ -2451,7 +2755,8 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
         {
           if ( dp->vtl->coord_mode != VIK_COORD_UTM || tp->coord.utm_zone == dp->center->utm_zone )
           {
-            vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+            x = points[index].x;
+            y = points[index].y;
 
             if ( !drawing_highlight && (dp->vtl->drawmode == DRAWMODE_BY_SPEED) ) {
               main_gc = g_array_index(dp->vtl->track_gc, GdkGC *, track_section_colour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed ));
@@ -2463,9 +2768,9 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 	    if ( x != oldx || y != oldy )
 	      {
 		if ( draw_track_outline )
-		  vik_viewport_draw_line ( dp->vp, dp->vtl->track_bg_gc, oldx, oldy, x, y);
+		  track_lines_add ( &lines, dp->vtl->track_bg_gc, oldx, oldy, x, y );
 		else
-		  vik_viewport_draw_line ( dp->vp, main_gc, oldx, oldy, x, y);
+		  track_lines_add ( &lines, main_gc, oldx, oldy, x, y );
 	      }
           }
           else 
@@ -2475,7 +2780,8 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 	     */
 	    if ( x != oldx || y != oldy )
 	      {
-		vik_viewport_coord_to_screen ( dp->vp, &(tp2->coord), &x, &y );
+		x = points[index2].x;
+		y = points[index2].y;
 		draw_utm_skip_insignia ( dp->vp, main_gc, x, y );
 	      }
           }
@@ -2483,6 +2789,9 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
         useoldvals = FALSE;
       }
     }
+    track_lines_flush ( &lines );
+    g_array_free ( lines.points, TRUE );
+    g_free ( points );
 
     // Labels drawn after the trackpoints, so the labels are on top
     if ( dp->vtl->track_draw_labels ) {
@@ -2505,140 +2814,156 @@ static void trw_layer_draw_track_cb ( const gpointer id, VikTrack *track, struct
   }
 }
 
-static void trw_layer_draw_waypoint ( const gpointer id, VikWaypoint *wp, struct DrawingParams *dp )
+static gboolean trw_layer_waypoint_on_screen ( VikWaypoint *wp, struct DrawingParams *dp )
 {
-  if ( wp->visible )
-  if ( (!dp->one_zone && !dp->lat_lon) || ( ( dp->lat_lon || wp->coord.utm_zone == dp->center->utm_zone ) && 
+  return wp->visible &&
+    ( (!dp->one_zone && !dp->lat_lon) || ( ( dp->lat_lon || wp->coord.utm_zone == dp->center->utm_zone ) && 
              wp->coord.east_west < dp->ce2 && wp->coord.east_west > dp->ce1 && 
-             wp->coord.north_south > dp->cn1 && wp->coord.north_south < dp->cn2 ) )
-  {
-    gint x, y;
-    vik_viewport_coord_to_screen ( dp->vp, &(wp->coord), &x, &y );
+             wp->coord.north_south > dp->cn1 && wp->coord.north_south < dp->cn2 ) );
+}
 
-    /* if in shrunken_cache, get that. If not, get and add to shrunken_cache */
+static void trw_layer_draw_waypoint_at ( VikWaypoint *wp, struct DrawingParams *dp, gint x, gint y )
+{
+  /* if in shrunken_cache, get that. If not, get and add to shrunken_cache */
 
-    if ( wp->image && dp->vtl->drawimages )
-    {
-      if ( dp->vtl->image_alpha == 0)
-        return;
+  if ( wp->image && dp->vtl->drawimages )
+  {
+    if ( dp->vtl->image_alpha == 0)
+      return;
 
-      GdkPixbuf *pixbuf = g_hash_table_lookup ( dp->vtl->image_cache, wp->image );
-      if ( !pixbuf )
+    GdkPixbuf *pixbuf = draw_cache_lookup ( dp->vtl->image_cache, wp->image );
+    if ( pixbuf )
+      g_object_ref ( pixbuf );
+    else
+    {
+      GdkPixbuf *regularthumb = a_thumbnails_get ( wp->image );
+      gboolean have_thumb = ( regularthumb != NULL );
+      if ( ! regularthumb )
+        regularthumb = a_thumbnails_get_default ();
+      if ( regularthumb )
       {
-        gchar *image = wp->image;
-        GdkPixbuf *regularthumb = a_thumbnails_get ( wp->image );
-        if ( ! regularthumb )
+        if ( dp->vtl->image_size == 128 )
+          pixbuf = regularthumb;
+        else
         {
-          regularthumb = a_thumbnails_get_default (); /* cache one 'not yet loaded' for all thumbs not loaded */
-          image = "\x12\x00"; /* this shouldn't occur naturally. */
+          pixbuf = a_thumbnails_scale_pixbuf(regularthumb, dp->vtl->image_size, dp->vtl->image_size);
+          g_object_unref ( G_OBJECT(regularthumb) );
         }
-        if ( regularthumb )
-        {
-          if ( dp->vtl->image_size == 128 )
-            pixbuf = regularthumb;
-          else
-          {
-            pixbuf = a_thumbnails_scale_pixbuf(regularthumb, dp->vtl->image_size, dp->vtl->image_size);
-            g_object_unref ( G_OBJECT(regularthumb) );
-          }
 
-          // Apply alpha setting to the image before the pixbuf gets stored in the cache
-          if ( dp->vtl->image_alpha != 255 )
-            pixbuf = ui_pixbuf_set_alpha ( pixbuf, dp->vtl->image_alpha );
+        // Apply alpha setting to the image before the pixbuf gets stored in the cache
+        if ( dp->vtl->image_alpha != 255 )
+          pixbuf = ui_pixbuf_set_alpha ( pixbuf, dp->vtl->image_alpha );
 
-          /* needed so 'click picture' tool knows how big the pic is; we don't
-           * store it in the cache because they may have been freed already. */
-          wp->image_width = gdk_pixbuf_get_width ( pixbuf );
-          wp->image_height = gdk_pixbuf_get_height ( pixbuf );
+        /* needed so 'click picture' tool knows how big the pic is; we don't
+         * store it in the cache because they may have been freed already. */
+        wp->image_width = gdk_pixbuf_get_width ( pixbuf );
+        wp->image_height = gdk_pixbuf_get_height ( pixbuf );
+        dp->vtl->image_max_size = MAX ( dp->vtl->image_max_size, MAX ( wp->image_width, wp->image_height ) );
 
-          if ( g_hash_table_size(dp->vtl->image_cache) < dp->vtl->image_cache_size )
-            g_hash_table_insert ( dp->vtl->image_cache, image, pixbuf );
-        }
-        else
-        {
-          pixbuf = a_thumbnails_get_default (); /* thumbnail not yet loaded */
-        }
+        // Images without a thumbnail yet are looked for again on the next draw
+        if ( have_thumb )
+          draw_cache_insert ( dp->vtl->image_cache, wp->image, g_object_ref ( pixbuf ) );
       }
-      if ( pixbuf )
-      {
-        gint w, h;
-        w = gdk_pixbuf_get_width ( pixbuf );
-        h = gdk_pixbuf_get_height ( pixbuf );
-
-        if ( x+(w/2) > 0 && y+(h/2) > 0 && x-(w/2) < dp->width && y-(h/2) < dp->height ) /* always draw within boundaries */
-        {
-          if ( dp->highlight ) {
-            // Highlighted - so draw a little border around the chosen one
-            // single line seems a little weak so draw 2 of them
-            vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
-                                         x - (w/2) - 1, y - (h/2) - 1, w + 2, h + 2 );
-            vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
-                                         x - (w/2) - 2, y - (h/2) - 2, w + 4, h + 4 );
-          }
+    }
+    if ( pixbuf )
+    {
+      gint w, h;
+      w = gdk_pixbuf_get_width ( pixbuf );
+      h = gdk_pixbuf_get_height ( pixbuf );
 
-          vik_viewport_draw_pixbuf ( dp->vp, pixbuf, 0, 0, x - (w/2), y - (h/2), w, h );
+      if ( x+(w/2) > 0 && y+(h/2) > 0 && x-(w/2) < dp->width && y-(h/2) < dp->height ) /* always draw within boundaries */
+      {
+        if ( dp->highlight ) {
+          // Highlighted - so draw a little border around the chosen one
+          // single line seems a little weak so draw 2 of them
+          vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
+                                       x - (w/2) - 1, y - (h/2) - 1, w + 2, h + 2 );
+          vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
+                                       x - (w/2) - 2, y - (h/2) - 2, w + 4, h + 4 );
         }
-        return; /* if failed to draw picture, default to drawing regular waypoint (below) */
+
+        vik_viewport_draw_pixbuf ( dp->vp, pixbuf, 0, 0, x - (w/2), y - (h/2), w, h );
       }
+      g_object_unref ( G_OBJECT(pixbuf) );
+      return; /* if failed to draw picture, default to drawing regular waypoint (below) */
     }
+  }
 
-    // Draw appropriate symbol - either symbol image or simple types
-    if ( dp->vtl->wp_draw_symbols && wp->symbol && wp->symbol_pixbuf ) {
-      vik_viewport_draw_pixbuf ( dp->vp, wp->symbol_pixbuf, 0, 0, x - gdk_pixbuf_get_width(wp->symbol_pixbuf)/2, y - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2, -1, -1 );
-    } 
-    else if ( wp == dp->vtl->current_wp ) {
-      switch ( dp->vtl->wp_symbol ) {
-        case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2 ); break;
-        case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2 ); break;
-        case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size, y - dp->vtl->wp_size, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64 ); break;
-        case WP_SYMBOL_X: vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size*2, y - dp->vtl->wp_size*2, x + dp->vtl->wp_size*2, y + dp->vtl->wp_size*2 );
-                          vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size*2, y + dp->vtl->wp_size*2, x + dp->vtl->wp_size*2, y - dp->vtl->wp_size*2 );
-        default: break;
-      }
+  // Draw appropriate symbol - either symbol image or simple types
+  if ( dp->vtl->wp_draw_symbols && wp->symbol && wp->symbol_pixbuf ) {
+    vik_viewport_draw_pixbuf ( dp->vp, wp->symbol_pixbuf, 0, 0, x - gdk_pixbuf_get_width(wp->symbol_pixbuf)/2, y - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2, -1, -1 );
+  } 
+  else if ( wp == dp->vtl->current_wp ) {
+    switch ( dp->vtl->wp_symbol ) {
+      case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2 ); break;
+      case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2 ); break;
+      case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size, y - dp->vtl->wp_size, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64 ); break;
+      case WP_SYMBOL_X: vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size*2, y - dp->vtl->wp_size*2, x + dp->vtl->wp_size*2, y + dp->vtl->wp_size*2 );
+                        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size*2, y + dp->vtl->wp_size*2, x + dp->vtl->wp_size*2, y - dp->vtl->wp_size*2 );
+      default: break;
     }
-    else {
-      switch ( dp->vtl->wp_symbol ) {
-        case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size ); break;
-        case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size ); break;
-        case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64 ); break;
-        case WP_SYMBOL_X: vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size, y-dp->vtl->wp_size, x+dp->vtl->wp_size, y+dp->vtl->wp_size );
-                          vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size, y+dp->vtl->wp_size, x+dp->vtl->wp_size, y-dp->vtl->wp_size ); break;
-        default: break;
-      }
+  }
+  else {
+    switch ( dp->vtl->wp_symbol ) {
+      case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size ); break;
+      case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size ); break;
+      case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64 ); break;
+      case WP_SYMBOL_X: vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size, y-dp->vtl->wp_size, x+dp->vtl->wp_size, y+dp->vtl->wp_size );
+                        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size, y+dp->vtl->wp_size, x+dp->vtl->wp_size, y-dp->vtl->wp_size ); break;
+      default: break;
     }
+  }
 
-    if ( dp->vtl->drawlabels )
-    {
-      /* thanks to the GPSDrive people (Fritz Ganter et al.) for hints on this part ... yah, I'm too lazy to study documentation */
-      gint label_x, label_y;
-      gint width, height;
-      // Hopefully name won't break the markup (may need to sanitize - g_markup_escape_text())
+  if ( dp->vtl->drawlabels )
+  {
+    /* thanks to the GPSDrive people (Fritz Ganter et al.) for hints on this part ... yah, I'm too lazy to study documentation */
+    gint label_x, label_y;
+    gint width, height;
+    const gchar *name = wp->name ? wp->name : "";
+
+    // Laying out the text is slow, so labels are kept for the next time they are drawn
+    WaypointLabel *label = draw_cache_lookup ( dp->vtl->wp_label_cache, name );
+    if ( !label ) {
+      label = g_new0 ( WaypointLabel, 1 );
+      label->layout = pango_layout_copy ( dp->vtl->wplabellayout );
 
-      // Could this stored in the waypoint rather than recreating each pass?
-      gchar *wp_label_markup = g_strdup_printf ( "<span size=\"%s\">%s</span>", dp->vtl->wp_fsize_str, wp->name );
+      // Hopefully name won't break the markup (may need to sanitize - g_markup_escape_text())
+      gchar *wp_label_markup = g_strdup_printf ( "<span size=\"%s\">%s</span>", dp->vtl->wp_fsize_str, name );
 
       if ( pango_parse_markup ( wp_label_markup, -1, 0, NULL, NULL, NULL, NULL ) )
-        pango_layout_set_markup ( dp->vtl->wplabellayout, wp_label_markup, -1 );
+        pango_layout_set_markup ( label->layout, wp_label_markup, -1 );
       else
         // Fallback if parse failure
-        pango_layout_set_text ( dp->vtl->wplabellayout, wp->name, -1 );
+        pango_layout_set_text ( label->layout, name, -1 );
 
       g_free ( wp_label_markup );
 
-      pango_layout_get_pixel_size ( dp->vtl->wplabellayout, &width, &height );
-      label_x = x - width/2;
-      if ( wp->symbol_pixbuf )
-        label_y = y - height - 2 - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2;
-      else
-        label_y = y - dp->vtl->wp_size - height - 2;
-
-      /* if highlight mode on, then draw background text in highlight colour */
-      if ( dp->highlight )
-        vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, label_x - 1, label_y-1,width+2,height+2);
-      else
-        vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, label_x - 1, label_y-1,width+2,height+2);
-      vik_viewport_draw_layout ( dp->vp, dp->vtl->waypoint_text_gc, label_x, label_y, dp->vtl->wplabellayout );
+      pango_layout_get_pixel_size ( label->layout, &label->width, &label->height );
+      draw_cache_insert ( dp->vtl->wp_label_cache, name, label );
     }
+    width = label->width;
+    height = label->height;
+    label_x = x - width/2;
+    if ( wp->symbol_pixbuf )
+      label_y = y - height - 2 - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2;
+    else
+      label_y = y - dp->vtl->wp_size - height - 2;
+
+    /* if highlight mode on, then draw background text in highlight colour */
+    if ( dp->highlight )
+      vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, label_x - 1, label_y-1,width+2,height+2);
+    else
+      vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, label_x - 1, label_y-1,width+2,height+2);
+    vik_viewport_draw_layout ( dp->vp, dp->vtl->waypoint_text_gc, label_x, label_y, label->layout );
+  }
+}
+
+static void trw_layer_draw_waypoint ( const gpointer id, VikWaypoint *wp, struct DrawingParams *dp )
+{
+  if ( trw_layer_waypoint_on_screen ( wp, dp ) ) {
+    gint x, y;
+    vik_viewport_coord_to_screen ( dp->vp, &(wp->coord), &x, &y );
+    trw_layer_draw_waypoint_at ( wp, dp, x, y );
   }
 }
 
@@ -2649,6 +2974,40 @@ static void trw_layer_draw_waypoint_cb ( gpointer id, VikWaypoint *wp, struct Dr
   }
 }
 
+static void trw_layer_gather_waypoint_cb ( gpointer id, struct DrawingParams *dp )
+{
+  VikWaypoint *wp = g_hash_table_lookup ( dp->vtl->waypoints, id );
+  if ( wp && trw_layer_waypoint_on_screen ( wp, dp ) )
+    g_ptr_array_add ( dp->waypoints, wp );
+}
+
+/*
+ * Draw the waypoints in view, converting all their positions in one go
+ */
+static void trw_layer_draw_waypoints ( struct DrawingParams *dp )
+{
+  // Room for every label, so a full redraw doesn't evict the ones it is about to use
+  draw_cache_set_max_size ( dp->vtl->wp_label_cache, MAX ( WP_LABEL_CACHE_MIN, g_hash_table_size ( dp->vtl->waypoints ) ) );
+
+  dp->waypoints = g_ptr_array_new ();
+  vik_rtree_search ( dp->vtl->waypoint_index, &dp->bbox, (GFunc) trw_layer_gather_waypoint_cb, dp );
+
+  guint n = dp->waypoints->len;
+  VikCoord *coords = g_new ( VikCoord, n );
+  GdkPoint *points = g_new ( GdkPoint, n );
+  for ( guint ii = 0; ii < n; ii++ )
+    coords[ii] = VIK_WAYPOINT(g_ptr_array_index ( dp->waypoints, ii ))->coord;
+  vik_viewport_projection_to_screen ( &dp->proj, coords, n, points );
+
+  for ( guint ii = 0; ii < n; ii++ )
+    trw_layer_draw_waypoint_at ( g_ptr_array_index ( dp->waypoints, ii ), dp, points[ii].x, points[ii].y );
+
+  g_free ( points );
+  g_free ( coords );
+  g_ptr_array_free ( dp->waypoints, TRUE );
+  dp->waypoints = NULL;
+}
+
 static void trw_layer_draw_with_highlight ( VikTrwLayer *l, gpointer data, gboolean highlight )
 {
   static struct DrawingParams dp;
@@ -2662,12 +3021,18 @@ static void trw_layer_draw_with_highlight ( VikTrwLayer *l, gpointer data, gbool
   if ( l->routes_visible )
     g_hash_table_foreach ( l->routes, (GHFunc) trw_layer_draw_track_cb, &dp );
 
-  if (l->waypoints_visible)
-    g_hash_table_foreach ( l->waypoints, (GHFunc) trw_layer_draw_waypoint_cb, &dp );
+  if ( l->waypoints_visible && BBOX_INTERSECT ( l->waypoints_bbox, dp.bbox ) )
+    trw_layer_draw_waypoints ( &dp );
 }
 
 static void trw_layer_draw ( VikTrwLayer *l, gpointer data )
 {
+  // Only make the tracks and waypoints once some of them could be seen
+  if ( l->deferred_data ) {
+    LatLonBBox bbox = vik_viewport_get_bbox ( VIK_VIEWPORT(data) );
+    if ( !BBOX_INTERSECT ( l->deferred_summary.bbox, bbox ) )
+      return;
+  }
   trw_ensure_layer_loaded ( l );
   // If this layer is to be highlighted - then don't draw now - as it will be drawn later on in the specific highlight draw stage
   // This may seem slightly inefficient to test each time for every layer
@@ -2746,10 +3111,10 @@ static void trw_layer_free_track_gcs ( VikTrwLayer *vtl )
     g_object_unref ( vtl->track_bg_gc );
     vtl->track_bg_gc = NULL;
   }
-  if ( vtl->track_1color_gc )
+  if ( vtl->track_color_gcs )
   {
-    g_object_unref ( vtl->track_1color_gc );
-    vtl->track_1color_gc = NULL;
+    g_hash_table_destroy ( vtl->track_color_gcs );
+    vtl->track_color_gcs = NULL;
   }
   if ( vtl->current_track_gc ) 
   {
@@ -2850,7 +3215,7 @@ static VikTrwLayer* trw_layer_create ( VikViewport *vp )
 /*
  * Can accept a null symbol, and may return null value
  */
-GdkPixbuf* get_wp_sym_small ( gchar *symbol )
+GdkPixbuf* get_wp_sym_small ( const gchar *symbol )
 {
   GdkPixbuf* wp_icon = a_get_wp_sym (symbol);
   // ATM a_get_wp_sym returns a cached icon, with the size dependent on the preferences.
@@ -2935,6 +3300,12 @@ static void trw_layer_realize ( VikTrwLayer *vtl, VikTreeview *vt, GtkTreeIter *
   GtkTreeIter iter2;
   gpointer pass_along[5] = { &(vtl->tracks_iter), &iter2, vtl, vt, GINT_TO_POINTER(VIK_TRW_LAYER_SUBLAYER_TRACK) };
 
+  if ( vtl->deferred_data ) {
+    vik_treeview_add_sublayer ( vt, layer_iter, &(vtl->deferred_iter), _("Not loaded yet"), vtl, NULL, VIK_TRW_LAYER_SUBLAYER_NOT_LOADED, NULL, FALSE, 0 );
+    trw_update_layer_icon ( vtl );
+    return;
+  }
+
   if ( g_hash_table_size (vtl->tracks) > 0 ) {
     trw_layer_add_sublayer_tracks ( vtl, vt , layer_iter );
 
@@ -3041,7 +3412,6 @@ static void trw_layer_tracks_tooltip ( const gpointer id, VikTrack *tr, tooltip_
 
   // Ensure times are available
   if ( tr->trackpoints && !isnan(vik_track_get_tp_first(tr)->timestamp) ) {
-    // Get trkpt only once - as using vik_track_get_tp_last() iterates whole track each time
     VikTrackpoint *trkpt_last = vik_track_get_tp_last(tr);
     if ( !isnan(trkpt_last->timestamp) ) {
       // Seconds precision is good enough for the tooltip
@@ -3091,6 +3461,14 @@ static const gchar* trw_layer_layer_tooltip ( VikTrwLayer *vtl )
 
   // For compact date format I'm using '%x'     [The preferred date representation for the current locale without the time.]
 
+  // Until loaded only the numbers of items are known
+  if ( vtl->deferred_data ) {
+    g_snprintf (tmp_buf, sizeof(tmp_buf),
+                _("Tracks: %d - Waypoints: %d - Routes: %d"),
+                vtl->deferred_summary.n_tracks, vtl->deferred_summary.n_waypoints, vtl->deferred_summary.n_routes);
+    return tmp_buf;
+  }
+
   // Safety check - I think these should always be valid
   if ( vtl->tracks && vtl->waypoints ) {
     tooltip_tracks tt = { 0.0, 0, 0, 0 };
@@ -3439,16 +3817,19 @@ static gboolean trw_layer_selected ( VikTrwLayer *l, gint subtype, gpointer subl
 
 GHashTable *vik_trw_layer_get_tracks ( VikTrwLayer *l )
 {
+  trw_layer_load_deferred ( l );
   return l->tracks;
 }
 
 GHashTable *vik_trw_layer_get_routes ( VikTrwLayer *l )
 {
+  trw_layer_load_deferred ( l );
   return l->routes;
 }
 
 GHashTable *vik_trw_layer_get_waypoints ( VikTrwLayer *l )
 {
+  trw_layer_load_deferred ( l );
   return l->waypoints;
 }
 
@@ -3469,6 +3850,7 @@ GHashTable *vik_trw_layer_get_waypoints_iters ( VikTrwLayer *vtl )
 
 gboolean vik_trw_layer_is_empty ( VikTrwLayer *vtl )
 {
+  trw_layer_load_deferred ( vtl );
   return ! ( g_hash_table_size ( vtl->tracks ) ||
              g_hash_table_size ( vtl->routes ) ||
              g_hash_table_size ( vtl->waypoints ) );
@@ -3507,6 +3889,7 @@ static gboolean trw_layer_waypoint_find ( const gpointer id, const VikWaypoint *
  */
 VikWaypoint *vik_trw_layer_get_waypoint ( VikTrwLayer *vtl, const gchar *name )
 {
+  trw_layer_load_deferred ( vtl );
   return g_hash_table_find ( vtl->waypoints, (GHRFunc) trw_layer_waypoint_find, (gpointer) name );
 }
 
@@ -3528,6 +3911,7 @@ static gboolean trw_layer_track_find ( const gpointer id, const VikTrack *trk, c
  */
 VikTrack *vik_trw_layer_get_track ( VikTrwLayer *vtl, const gchar *name )
 {
+  trw_layer_load_deferred ( vtl );
   return g_hash_table_find ( vtl->tracks, (GHRFunc) trw_layer_track_find, (gpointer) name );
 }
 
@@ -3554,6 +3938,7 @@ static void trw_layer_find_maxmin_tracks ( const gpointer id, const VikTrack *tr
 
 static void trw_layer_find_maxmin (VikTrwLayer *vtl, struct LatLon maxmin[2])
 {
+  trw_layer_load_deferred ( vtl );
   // Continually reuse maxmin to find the latest maximum and minimum values
   // First set to waypoints bounds
   maxmin[0].lat = vtl->waypoints_bbox.north;
@@ -4256,6 +4641,8 @@ static GtkMenu* create_external_submenu ( GtkMenu *menu )
 static void trw_layer_add_menu_items ( VikTrwLayer *vtl, GtkMenu *menu, gpointer vlp )
 {
   static menu_array_layer data;
+  // Most of the layer operations work on all the tracks and waypoints
+  trw_layer_load_deferred ( vtl );
   data[MA_VTL] = vtl;
   data[MA_VLP] = vlp;
 
@@ -4292,8 +4679,7 @@ static void trw_layer_add_menu_items ( VikTrwLayer *vtl, GtkMenu *menu, gpointer
   if ( a_babel_available () )
     (void)vu_menu_add_item ( export_submenu, _("Export as _KML..."), NULL, G_CALLBACK(trw_layer_export_kml), data );
 
-  if ( have_geojson_export )
-    (void)vu_menu_add_item ( export_submenu, _("Export as GEO_JSON..."), NULL, G_CALLBACK(trw_layer_export_geojson), data );
+  (void)vu_menu_add_item ( export_submenu, _("Export as GEO_JSON..."), NULL, G_CALLBACK(trw_layer_export_geojson), data );
 
   if ( a_babel_available () )
     (void)vu_menu_add_item ( export_submenu, _("Export via GPSbabel..."), NULL, G_CALLBACK(trw_layer_export_babel), data );
@@ -4423,12 +4809,24 @@ static void trw_layer_add_menu_items ( VikTrwLayer *vtl, GtkMenu *menu, gpointer
   vik_ext_tools_add_menu_items_to_menu ( VIK_WINDOW(VIK_GTK_WINDOW_FROM_LAYER(vtl)), external_submenu, NULL );
 }
 
+// Layers may be filled in by files being read in other threads
+G_LOCK_DEFINE_STATIC(uuids);
+
+static guint next_uuid ( guint *counter )
+{
+  G_LOCK(uuids);
+  guint uuid = ++(*counter);
+  G_UNLOCK(uuids);
+  return uuid;
+}
+
 // Fake Waypoint UUIDs vi simple increasing integer
-static guint wp_uuid = 0;
+static guint wp_uuid_counter = 0;
 
 void vik_trw_layer_add_waypoint ( VikTrwLayer *vtl, gchar *name, VikWaypoint *wp )
 {
-  wp_uuid++;
+  trw_layer_load_deferred ( vtl );
+  guint wp_uuid = next_uuid ( &wp_uuid_counter );
 
   vik_waypoint_set_name (wp, name);
 
@@ -4459,15 +4857,17 @@ void vik_trw_layer_add_waypoint ( VikTrwLayer *vtl, gchar *name, VikWaypoint *wp
 
   highest_wp_number_add_wp(vtl, name);
   g_hash_table_insert ( vtl->waypoints, GUINT_TO_POINTER(wp_uuid), wp );
+  trw_layer_index_waypoint ( GUINT_TO_POINTER(wp_uuid), wp, vtl );
  
 }
 
 // Fake Track UUIDs vi simple increasing integer
-static guint tr_uuid = 0;
+static guint tr_uuid_counter = 0;
 
 void vik_trw_layer_add_track ( VikTrwLayer *vtl, gchar *name, VikTrack *t )
 {
-  tr_uuid++;
+  trw_layer_load_deferred ( vtl );
+  guint tr_uuid = next_uuid ( &tr_uuid_counter );
 
   vik_track_set_name (t, name);
 
@@ -4503,11 +4903,12 @@ void vik_trw_layer_add_track ( VikTrwLayer *vtl, gchar *name, VikTrack *t )
 }
 
 // Fake Route UUIDs vi simple increasing integer
-static guint rt_uuid = 0;
+static guint rt_uuid_counter = 0;
 
 void vik_trw_layer_add_route ( VikTrwLayer *vtl, gchar *name, VikTrack *t )
 {
-  rt_uuid++;
+  trw_layer_load_deferred ( vtl );
+  guint rt_uuid = next_uuid ( &rt_uuid_counter );
 
   vik_track_set_name (t, name);
 
@@ -4556,9 +4957,7 @@ void vik_trw_layer_reset_waypoints ( VikTrwLayer *vtl )
     VikWaypoint *wp = VIK_WAYPOINT(value);
     if ( wp->symbol ) {
       // Reapply symbol setting to update the pixbuf
-      gchar *tmp_symbol = g_strdup ( wp->symbol );
-      vik_waypoint_set_symbol ( wp, tmp_symbol );
-      g_free ( tmp_symbol );
+      vik_waypoint_set_symbol ( wp, wp->symbol );
     }
   }
 }
@@ -4810,6 +5209,7 @@ gboolean vik_trw_layer_delete_track ( VikTrwLayer *vtl, VikTrack *trk )
       if ( it ) {
         vik_treeview_item_delete ( VIK_LAYER(vtl)->vt, it );
         g_hash_table_remove ( vtl->tracks_iters, udata.uuid );
+        trw_layer_unindex_track ( vtl, trk );
         g_hash_table_remove ( vtl->tracks, udata.uuid );
 
 	// If last sublayer, then remove sublayer container
@@ -4858,6 +5258,7 @@ gboolean vik_trw_layer_delete_route ( VikTrwLayer *vtl, VikTrack *trk )
       if ( it ) {
         vik_treeview_item_delete ( VIK_LAYER(vtl)->vt, it );
         g_hash_table_remove ( vtl->routes_iters, udata.uuid );
+        trw_layer_unindex_track ( vtl, trk );
         g_hash_table_remove ( vtl->routes, udata.uuid );
 
         // If last sublayer, then remove sublayer container
@@ -4878,6 +5279,7 @@ static void delete_waypoint_low_level ( VikTrwLayer *vtl, VikWaypoint *wp, gpoin
   g_hash_table_remove ( vtl->waypoints_iters, uuid );
 
   highest_wp_number_remove_wp ( vtl, wp->name );
+  vik_rtree_remove ( vtl->waypoint_index, uuid );
   g_hash_table_remove ( vtl->waypoints, uuid ); // last because this frees the name
 }
 
@@ -5023,6 +5425,7 @@ void vik_trw_layer_delete_all_routes ( VikTrwLayer *vtl )
 
   if ( g_hash_table_size (vtl->routes) > 0 )
     vik_treeview_item_delete ( VIK_LAYER(vtl)->vt, &(vtl->routes_iter) );
+  g_hash_table_foreach ( vtl->routes, (GHFunc) trw_layer_unindex_track_cb, vtl );
   g_hash_table_remove_all(vtl->routes);
 
   vik_layer_emit_update ( VIK_LAYER(vtl) );
@@ -5041,6 +5444,7 @@ void vik_trw_layer_delete_all_tracks ( VikTrwLayer *vtl )
 
   if ( g_hash_table_size (vtl->tracks) > 0 )
     vik_treeview_item_delete ( VIK_LAYER(vtl)->vt, &(vtl->tracks_iter) );
+  g_hash_table_foreach ( vtl->tracks, (GHFunc) trw_layer_unindex_track_cb, vtl );
   g_hash_table_remove_all(vtl->tracks);
 
   vik_layer_emit_update ( VIK_LAYER(vtl) );
@@ -5059,6 +5463,7 @@ void vik_trw_layer_delete_all_waypoints ( VikTrwLayer *vtl )
 
   if ( g_hash_table_size (vtl->waypoints) > 0 )
     vik_treeview_item_delete ( VIK_LAYER(vtl)->vt, &(vtl->waypoints_iter) );
+  vik_rtree_clear ( vtl->waypoint_index );
   g_hash_table_remove_all(vtl->waypoints);
 
   vik_layer_emit_update ( VIK_LAYER(vtl) );
@@ -6116,6 +6521,7 @@ static void trw_layer_merge_with_other ( menu_array_sublayer values )
         else
           vik_trw_layer_delete_track (vtl, merge_track);
         track->trackpoints = g_list_sort(track->trackpoints, trackpoint_compare);
+        vik_track_invalidate ( track );
       }
     }
     for (l = merge_list; l != NULL; l = g_list_next(l))
@@ -6409,6 +6815,7 @@ static void trw_layer_merge_by_timestamp ( menu_array_sublayer values )
     }
 
     orig_trk->trackpoints = g_list_sort(orig_trk->trackpoints, trackpoint_compare);
+    vik_track_invalidate ( orig_trk );
   }
 
   g_list_free(nearby_tracks);
@@ -6710,6 +7117,7 @@ static void trw_layer_trackpoint_selected_delete ( VikTrwLayer *vtl, VikTrack *t
     // Delete current trackpoint
     vik_trackpoint_free ( vtl->current_tpl->data );
     trk->trackpoints = g_list_delete_link ( trk->trackpoints, vtl->current_tpl );
+    vik_track_invalidate ( trk );
 
     // Set to current to the available adjacent trackpoint
     vtl->current_tpl = new_tpl;
@@ -6722,6 +7130,7 @@ static void trw_layer_trackpoint_selected_delete ( VikTrwLayer *vtl, VikTrack *t
     // Delete current trackpoint
     vik_trackpoint_free ( vtl->current_tpl->data );
     trk->trackpoints = g_list_delete_link ( trk->trackpoints, vtl->current_tpl );
+    vik_track_invalidate ( trk );
     trw_layer_cancel_current_tp ( vtl, FALSE );
   }
 }
@@ -8573,6 +8982,7 @@ static void trw_layer_insert_tp_beside_current_tp ( VikTrwLayer *vtl, gboolean b
         index = index + 1;
       // NB no recalculation of bounds since it is inserted between points
       trk->trackpoints = g_list_insert ( trk->trackpoints, tp_new, index );
+      vik_track_invalidate ( trk );
     }
   }
 
@@ -8662,8 +9072,12 @@ static void trw_layer_tpwin_response ( VikTrwLayer *vtl, gint response )
       trw_layer_insert_tp_beside_current_tp ( vtl, FALSE, vtl->current_tp_track->is_route );
     }
   }
-  else if ( response == VIK_TRW_LAYER_TPWIN_DATA_CHANGED )
+  else if ( response == VIK_TRW_LAYER_TPWIN_DATA_CHANGED ) {
+    // The trackpoint has been edited
+    if ( vtl->current_tp_track )
+      vik_track_calculate_bounds ( vtl->current_tp_track );
     vik_layer_emit_update(VIK_LAYER(vtl));
+  }
 }
 
 /**
@@ -8785,6 +9199,157 @@ static void trw_layer_tpwin_init ( VikTrwLayer *vtl )
   /* set layer name and TP data */
 }
 
+/***************************************************************************
+ ** Spatial index
+ ***************************************************************************/
+
+/*
+ * Tracks and routes are indexed in chunks of consecutive trackpoints,
+ *  so finding what is near a position only needs to look at the few chunks there.
+ * A track is (re)indexed when next needed after any change to it (as given by its revision),
+ *  whereas waypoints are kept up to date as they are added, moved or deleted.
+ */
+#define TRACK_INDEX_CHUNK_SIZE 64
+
+typedef struct {
+  VikTrack *trk;
+  gpointer id;
+  guint revision;
+  GPtrArray *chunks;
+} TrackIndexEntry;
+
+typedef struct {
+  TrackIndexEntry *entry;
+  GList *first;
+  guint start; // Index of the first trackpoint
+  guint count;
+} TrackIndexChunk;
+
+static void track_index_entry_free ( TrackIndexEntry *entry )
+{
+  g_ptr_array_free ( entry->chunks, TRUE );
+  g_free ( entry );
+}
+
+static void trw_layer_index_new ( VikTrwLayer *vtl )
+{
+  vtl->track_index = vik_rtree_new ();
+  vtl->track_index_entries = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) track_index_entry_free );
+  vtl->waypoint_index = vik_rtree_new ();
+}
+
+static void trw_layer_index_free ( VikTrwLayer *vtl )
+{
+  vik_rtree_free ( vtl->track_index );
+  g_hash_table_destroy ( vtl->track_index_entries );
+  vik_rtree_free ( vtl->waypoint_index );
+}
+
+/*
+ * Must be called before a track is removed from the layer
+ */
+static void trw_layer_unindex_track ( VikTrwLayer *vtl, VikTrack *trk )
+{
+  // Nor is it drawn any more
+  g_hash_table_remove ( vtl->track_geometry, trk );
+
+  TrackIndexEntry *entry = g_hash_table_lookup ( vtl->track_index_entries, trk );
+  if ( !entry )
+    return;
+  for ( guint ii = 0; ii < entry->chunks->len; ii++ )
+    vik_rtree_remove ( vtl->track_index, g_ptr_array_index ( entry->chunks, ii ) );
+  g_hash_table_remove ( vtl->track_index_entries, trk );
+}
+
+static void trw_layer_unindex_track_cb ( gpointer id, VikTrack *trk, VikTrwLayer *vtl )
+{
+  trw_layer_unindex_track ( vtl, trk );
+}
+
+static void trw_layer_index_track ( gpointer id, VikTrack *trk, VikTrwLayer *vtl )
+{
+  TrackIndexEntry *entry = g_hash_table_lookup ( vtl->track_index_entries, trk );
+  if ( entry && entry->revision == trk->revision && entry->id == id )
+    return;
+  trw_layer_unindex_track ( vtl, trk );
+
+  entry = g_new0 ( TrackIndexEntry, 1 );
+  entry->trk = trk;
+  entry->id = id;
+  entry->revision = trk->revision;
+  entry->chunks = g_ptr_array_new_with_free_func ( g_free );
+  g_hash_table_insert ( vtl->track_index_entries, trk, entry );
+
+  TrackIndexChunk *chunk = NULL;
+  LatLonBBox bbox = { 0.0, 0.0, 0.0, 0.0 };
+  guint index = 0;
+  for ( GList *iter = trk->trackpoints; iter; iter = iter->next, index++ ) {
+    struct LatLon ll;
+    vik_coord_to_latlon ( &(VIK_TRACKPOINT(iter->data)->coord), &ll );
+    if ( !chunk ) {
+      chunk = g_new0 ( TrackIndexChunk, 1 );
+      chunk->entry = entry;
+      chunk->first = iter;
+      chunk->start = index;
+      bbox.north = bbox.south = ll.lat;
+      bbox.east = bbox.west = ll.lon;
+    }
+    else {
+      if ( ll.lat > bbox.north ) bbox.north = ll.lat;
+      if ( ll.lat < bbox.south ) bbox.south = ll.lat;
+      if ( ll.lon > bbox.east ) bbox.east = ll.lon;
+      if ( ll.lon < bbox.west ) bbox.west = ll.lon;
+    }
+    chunk->count++;
+    if ( chunk->count == TRACK_INDEX_CHUNK_SIZE || !iter->next ) {
+      vik_rtree_insert ( vtl->track_index, chunk, &bbox );
+      g_ptr_array_add ( entry->chunks, chunk );
+      chunk = NULL;
+    }
+  }
+}
+
+/*
+ * Bring the index up to date with any of the tracks added or changed since it was last used
+ */
+static void trw_layer_index_tracks ( VikTrwLayer *vtl, GHashTable *tracks )
+{
+  g_hash_table_foreach ( tracks, (GHFunc) trw_layer_index_track, vtl );
+}
+
+static void trw_layer_index_waypoint ( gpointer id, VikWaypoint *wp, VikTrwLayer *vtl )
+{
+  struct LatLon ll;
+  LatLonBBox bbox;
+  vik_coord_to_latlon ( &(wp->coord), &ll );
+  // Only need to update it if it has moved
+  if ( vik_rtree_lookup ( vtl->waypoint_index, id, &bbox ) && bbox.north == ll.lat && bbox.east == ll.lon )
+    return;
+  bbox.north = bbox.south = ll.lat;
+  bbox.east = bbox.west = ll.lon;
+  vik_rtree_insert ( vtl->waypoint_index, id, &bbox );
+}
+
+/*
+ * The area within (just over) the number of pixels of a screen position
+ */
+static LatLonBBox trw_layer_screen_area ( VikViewport *vvp, gint x, gint y, gint pixels )
+{
+  LatLonBBox bbox = { 90.0, -90.0, -180.0, 180.0 };
+  pixels++;
+  for ( guint corner = 0; corner < 4; corner++ ) {
+    VikCoord coord;
+    struct LatLon ll;
+    vik_viewport_screen_to_coord ( vvp, (corner & 1) ? x+pixels : x-pixels, (corner & 2) ? y+pixels : y-pixels, &coord );
+    vik_coord_to_latlon ( &coord, &ll );
+    if ( ll.lat > bbox.north ) bbox.north = ll.lat;
+    if ( ll.lat < bbox.south ) bbox.south = ll.lat;
+    if ( ll.lon > bbox.east ) bbox.east = ll.lon;
+    if ( ll.lon < bbox.west ) bbox.west = ll.lon;
+  }
+  return bbox;
+}
+
 /***************************************************************************
  ** Tool code
  ***************************************************************************/
@@ -8798,6 +9363,7 @@ typedef struct {
   gpointer closest_wp_id;
   VikWaypoint *closest_wp;
   VikViewport *vvp;
+  VikTrwLayer *vtl;
 } WPSearchParams;
 
 typedef struct {
@@ -8807,7 +9373,7 @@ typedef struct {
   VikTrackpoint *closest_tp;
   VikViewport *vvp;
   GList *closest_tpl;
-  LatLonBBox bbox;
+  gboolean search_routes;
 } TPSearchParams;
 
 static void waypoint_search_closest_tp ( gpointer id, VikWaypoint *wp, WPSearchParams *params )
@@ -8843,29 +9409,33 @@ static void waypoint_search_closest_tp ( gpointer id, VikWaypoint *wp, WPSearchP
     }
 }
 
-static void track_search_closest_tp ( gpointer id, VikTrack *t, TPSearchParams *params )
+static void track_chunk_search_closest_tp ( TrackIndexChunk *chunk, TPSearchParams *params )
 {
-  GList *tpl = t->trackpoints;
+  VikTrack *t = chunk->entry->trk;
+  GList *tpl = chunk->first;
   VikTrackpoint *tp;
+  VikCoord coords[TRACK_INDEX_CHUNK_SIZE];
+  GdkPoint points[TRACK_INDEX_CHUNK_SIZE];
 
-  if ( !t->visible )
+  if ( !t->visible || t->is_route != params->search_routes )
     return;
 
-  if ( ! BBOX_INTERSECT ( t->bbox, params->bbox ) )
-    return;
+  for ( guint ii = 0; ii < chunk->count; ii++, tpl = tpl->next )
+    coords[ii] = VIK_TRACKPOINT(tpl->data)->coord;
+  tpl = chunk->first;
+  vik_viewport_coords_to_screen ( params->vvp, coords, chunk->count, points );
 
-  while (tpl)
+  for ( guint ii = 0; ii < chunk->count; ii++ )
   {
-    gint x, y;
+    gint x = points[ii].x;
+    gint y = points[ii].y;
     tp = VIK_TRACKPOINT(tpl->data);
-
-    vik_viewport_coord_to_screen ( params->vvp, &(tp->coord), &x, &y );
  
     if ( abs (x - params->x) <= TRACKPOINT_SIZE_APPROX && abs (y - params->y) <= TRACKPOINT_SIZE_APPROX &&
         ((!params->closest_tp) ||        /* was the old trackpoint we already found closer than this one? */
           abs(x - params->x)+abs(y - params->y) < abs(x - params->closest_x)+abs(y - params->closest_y)))
     {
-      params->closest_track_id = id;
+      params->closest_track_id = chunk->entry->id;
       params->closest_tp = tp;
       params->closest_tpl = tpl;
       params->closest_x = x;
@@ -8875,6 +9445,37 @@ static void track_search_closest_tp ( gpointer id, VikTrack *t, TPSearchParams *
   }
 }
 
+/*
+ * Find the closest trackpoint of the tracks (or routes) near the position in the params
+ */
+static void trw_layer_search_closest_tp ( VikTrwLayer *vtl, GHashTable *tracks, TPSearchParams *params )
+{
+  trw_layer_index_tracks ( vtl, tracks );
+  params->search_routes = ( tracks == vtl->routes );
+  LatLonBBox area = trw_layer_screen_area ( params->vvp, params->x, params->y, TRACKPOINT_SIZE_APPROX );
+  vik_rtree_search ( vtl->track_index, &area, (GFunc) track_chunk_search_closest_tp, params );
+}
+
+static void waypoint_index_search_closest ( gpointer id, WPSearchParams *params )
+{
+  VikWaypoint *wp = g_hash_table_lookup ( params->vtl->waypoints, id );
+  if ( wp )
+    waypoint_search_closest_tp ( id, wp, params );
+}
+
+/*
+ * Find the closest waypoint near the position in the params
+ */
+static void trw_layer_search_closest_wp ( VikTrwLayer *vtl, WPSearchParams *params )
+{
+  gint pixels = WAYPOINT_SIZE_APPROX;
+  if ( params->draw_images )
+    pixels = MAX ( pixels, (vtl->image_max_size+1) / 2 );
+  params->vtl = vtl;
+  LatLonBBox area = trw_layer_screen_area ( params->vvp, params->x, params->y, pixels );
+  vik_rtree_search ( vtl->waypoint_index, &area, (GFunc) waypoint_index_search_closest, params );
+}
+
 // ATM: Leave this as 'Track' only.
 //  Not overly bothered about having a snap to route trackpoint capability
 static VikTrackpoint *closest_tp_in_five_pixel_interval ( VikTrwLayer *vtl, VikViewport *vvp, gint x, gint y )
@@ -8885,8 +9486,7 @@ static VikTrackpoint *closest_tp_in_five_pixel_interval ( VikTrwLayer *vtl, VikV
   params.vvp = vvp;
   params.closest_track_id = NULL;
   params.closest_tp = NULL;
-  params.bbox = vik_viewport_get_bbox ( params.vvp );
-  g_hash_table_foreach ( vtl->tracks, (GHFunc) track_search_closest_tp, &params);
+  trw_layer_search_closest_tp ( vtl, vtl->tracks, &params );
   return params.closest_tp;
 }
 
@@ -8899,7 +9499,7 @@ static VikWaypoint *closest_wp_in_five_pixel_interval ( VikTrwLayer *vtl, VikVie
   params.draw_images = vtl->drawimages;
   params.closest_wp = NULL;
   params.closest_wp_id = NULL;
-  g_hash_table_foreach ( vtl->waypoints, (GHFunc) waypoint_search_closest_tp, &params);
+  trw_layer_search_closest_wp ( vtl, &params );
   return params.closest_wp;
 }
 
@@ -9034,7 +9634,7 @@ static gboolean trw_layer_select_click ( VikTrwLayer *vtl, GdkEventButton *event
     wp_params.closest_wp_id = NULL;
     wp_params.closest_wp = NULL;
 
-    g_hash_table_foreach ( vtl->waypoints, (GHFunc) waypoint_search_closest_tp, &wp_params);
+    trw_layer_search_closest_wp ( vtl, &wp_params );
 
     if ( wp_params.closest_wp )  {
 
@@ -9079,10 +9679,9 @@ static gboolean trw_layer_select_click ( VikTrwLayer *vtl, GdkEventButton *event
   tp_params.closest_track_id = NULL;
   tp_params.closest_tp = NULL;
   tp_params.closest_tpl = NULL;
-  tp_params.bbox = bbox;
 
   if (vtl->tracks_visible) {
-    g_hash_table_foreach ( vtl->tracks, (GHFunc) track_search_closest_tp, &tp_params);
+    trw_layer_search_closest_tp ( vtl, vtl->tracks, &tp_params );
 
     if ( tp_params.closest_tp )  {
 
@@ -9117,7 +9716,7 @@ static gboolean trw_layer_select_click ( VikTrwLayer *vtl, GdkEventButton *event
 
   // Try again for routes
   if (vtl->routes_visible) {
-    g_hash_table_foreach ( vtl->routes, (GHFunc) track_search_closest_tp, &tp_params);
+    trw_layer_search_closest_tp ( vtl, vtl->routes, &tp_params );
 
     if ( tp_params.closest_tp )  {
 
@@ -9351,7 +9950,7 @@ static gboolean tool_edit_waypoint_click ( VikTrwLayer *vtl, GdkEventButton *eve
   params.draw_images = vtl->drawimages;
   params.closest_wp_id = NULL;
   params.closest_wp = NULL;
-  g_hash_table_foreach ( vtl->waypoints, (GHFunc) waypoint_search_closest_tp, &params);
+  trw_layer_search_closest_wp ( vtl, &params );
   if ( vtl->current_wp && (vtl->current_wp == params.closest_wp) )
   {
     if ( event->button == 3 )
@@ -9601,7 +10200,7 @@ static void update_statusbar ( VikTrwLayer *vtl )
 static gboolean tool_select_tp ( VikTrwLayer *vtl, TPSearchParams *params, gboolean search_tracks, gboolean search_routes )
 {
   if ( vtl->tracks_visible && search_tracks )
-    g_hash_table_foreach ( vtl->tracks, (GHFunc) track_search_closest_tp, params);
+    trw_layer_search_closest_tp ( vtl, vtl->tracks, params );
 
   if ( params->closest_tp )
   {
@@ -9615,7 +10214,7 @@ static gboolean tool_select_tp ( VikTrwLayer *vtl, TPSearchParams *params, gbool
   }
 
   if ( vtl->routes_visible && search_routes )
-    g_hash_table_foreach ( vtl->routes, (GHFunc) track_search_closest_tp, params);
+    trw_layer_search_closest_tp ( vtl, vtl->routes, params );
 
   if ( params->closest_tp )
   {
@@ -9831,11 +10430,9 @@ static void undo_trackpoint_add ( VikTrwLayer *vtl )
 {
   // 'undo'
   if ( vtl->current_track->trackpoints ) {
-    // TODO rework this...
-    //vik_trackpoint_free ( vik_track_get_tp_last (vtl->current_track) );
     GList *last = g_list_last(vtl->current_track->trackpoints);
-    g_free ( last->data );
-    vtl->current_track->trackpoints = g_list_remove_link ( vtl->current_track->trackpoints, last );
+    vik_trackpoint_free ( last->data );
+    vtl->current_track->trackpoints = g_list_delete_link ( vtl->current_track->trackpoints, last );
 
     vik_track_calculate_bounds ( vtl->current_track );
   }
@@ -10034,6 +10631,7 @@ static gboolean tool_edit_track_or_route_join ( VikTrwLayer *vtl, TPSearchParams
     trw_layer_split_at_selected_trackpoint ( vtl, is_route ? VIK_TRW_LAYER_SUBLAYER_ROUTE : VIK_TRW_LAYER_SUBLAYER_TRACK );
     vik_track_steal_and_append_trackpoints ( origin_track, vtl->current_tp_track );
     VIK_TRACKPOINT(vtl->current_tpl->data)->newsegment = FALSE;
+    vik_track_invalidate ( origin_track );
 
     if ( is_route )
       vik_trw_layer_delete_route ( vtl, vtl->current_tp_track );
@@ -10096,7 +10694,6 @@ static gboolean tool_edit_track_or_route_click_dispatch ( VikTrwLayer *vtl, GdkE
   params.closest_track_id = NULL;
   params.closest_tp = NULL;
   params.closest_tpl = NULL;
-  params.bbox = vik_viewport_get_bbox ( vvp );
 
   // if we're not already editing a track/route
   // (is_track == is_route means we want a track, but have a route, or vice versa)
@@ -10202,7 +10799,6 @@ static gboolean tool_edit_trackpoint_click ( VikTrwLayer *vtl, GdkEventButton *e
   params.closest_track_id = NULL;
   params.closest_tp = NULL;
   params.closest_tpl = NULL;
-  params.bbox = vik_viewport_get_bbox ( vvp );
 
   if ( event->button != 1 ) 
     return FALSE;
@@ -10368,7 +10964,6 @@ static gboolean tool_extended_route_finder_click ( VikTrwLayer *vtl, GdkEventBut
       params.closest_track_id = NULL;
       params.closest_tp = NULL;
       params.closest_tpl = NULL;
-      params.bbox = vik_viewport_get_bbox ( vvp );
 
       tool_edit_track_or_route_join ( vtl, &params, TRUE );
     }
@@ -10655,6 +11250,9 @@ void trw_layer_calculate_bounds_waypoints ( VikTrwLayer *vtl )
   vtl->waypoints_bbox.east = bottomright.lon;
   vtl->waypoints_bbox.south = bottomright.lat;
   vtl->waypoints_bbox.west = topleft.lon;
+
+  // Move any waypoints that have moved in the index too
+  g_hash_table_foreach ( vtl->waypoints, (GHFunc) trw_layer_index_waypoint, vtl );
 }
 
 static void trw_layer_calculate_bounds_track ( gpointer id, VikTrack *trk )
@@ -10735,6 +11333,7 @@ static gdouble trw_layer_get_timestamp_waypoints ( VikTrwLayer *vtl )
  */
 static gdouble trw_layer_get_timestamp ( VikTrwLayer *vtl )
 {
+  trw_layer_load_deferred ( vtl );
   gdouble timestamp_tracks = trw_layer_get_timestamp_tracks ( vtl );
   gdouble timestamp_waypoints = trw_layer_get_timestamp_waypoints ( vtl );
   // NB routes don't have timestamps - hence they are not considered
@@ -10755,6 +11354,10 @@ static gdouble trw_layer_get_timestamp ( VikTrwLayer *vtl )
 
 static void trw_layer_post_read ( VikTrwLayer *vtl, VikViewport *vvp, gboolean from_file )
 {
+  // Done once the data is loaded
+  if ( vtl->deferred_data )
+    return;
+
   if ( VIK_LAYER(vtl)->realized )
     trw_layer_verify_thumbnails ( vtl );
   trw_layer_track_alloc_colors ( vtl );
@@ -10820,6 +11423,14 @@ VikCoordMode vik_trw_layer_get_coord_mode ( VikTrwLayer *vtl )
   return vtl->coord_mode;
 }
 
+/**
+ * Whether the layer data is kept in an external file, rather than in the Viking file
+ */
+gboolean vik_trw_layer_is_external ( VikTrwLayer *vtl )
+{
+  return vtl->external_layer != VIK_TRW_LAYER_INTERNAL;
+}
+
 /**
  * Uniquify the whole layer
  * Also requires the layers panel as the names shown there need updating too
@@ -11193,7 +11804,14 @@ static void trw_write_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath )
   if ( trw->external_layer == VIK_TRW_LAYER_EXTERNAL ) {
     trw_write_file_external ( trw, f, dirpath );
   } else if ( trw->external_layer != VIK_TRW_LAYER_EXTERNAL_NO_WRITE ) {
-    a_gpspoint_write_file( trw, f, dirpath );
+    // Data never loaded can be written back as it was read,
+    //  unless relative filenames in it would then be wrong
+    if ( trw->deferred_data && g_strcmp0 ( dirpath, trw->deferred_dirpath ) == 0 )
+      fwrite ( trw->deferred_data->str, 1, trw->deferred_data->len, f );
+    else {
+      trw_layer_load_deferred ( trw );
+      a_gpspoint_write_file( trw, f, dirpath );
+    }
   }
 }
 
@@ -11201,6 +11819,12 @@ gboolean trw_read_file ( VikTrwLayer *trw, FILE *f, const gchar *dirpath )
 {
   if ( trw->external_layer != VIK_TRW_LAYER_INTERNAL ) {
     return trw_read_file_external ( trw, f, dirpath );
+  } else if ( !trw->deferred_data && vik_trw_layer_is_empty ( trw ) ) {
+    // Leave making the tracks and waypoints until they are wanted (see trw_layer_load_deferred)
+    trw->deferred_data = a_gpspoint_read_unparsed ( f, &(trw->deferred_summary) );
+    g_free ( trw->deferred_dirpath );
+    trw->deferred_dirpath = g_strdup ( dirpath );
+    return trw->deferred_data != NULL;
   } else {
     return a_gpspoint_read_file( trw, f, dirpath );
   }
@@ -11275,8 +11899,72 @@ static gboolean trw_load_external_layer ( VikTrwLayer *trw )
   return ! failed;
 }
 
+/*
+ * Make the tracks and waypoints from data read in by trw_read_file()
+ */
+static void trw_layer_load_deferred ( VikTrwLayer *vtl )
+{
+  if ( !vtl->deferred_data )
+    return;
+
+  // Cleared first as adding the tracks and waypoints comes back here
+  GString *data = vtl->deferred_data;
+  vtl->deferred_data = NULL;
+
+  // Rather than inserting each item into the treeview, which would sort each time,
+  //  add them all at once afterwards
+  VikLayer *vl = VIK_LAYER(vtl);
+  gboolean realized = vl->realized;
+  if ( realized ) {
+    vik_treeview_item_delete ( vl->vt, &(vtl->deferred_iter) );
+    vl->realized = FALSE;
+  }
+
+  if ( !a_gpspoint_read_text ( vtl, data->str, data->len, vtl->deferred_dirpath ) )
+    g_warning ( "%s: Could not read the data of layer %s", __FUNCTION__, vl->name );
+
+  if ( realized ) {
+    vl->realized = TRUE;
+    trw_layer_realize ( vtl, vl->vt, &(vl->iter) );
+  }
+  trw_layer_post_read ( vtl, NULL, TRUE );
+
+  g_string_free ( data, TRUE );
+  g_array_free ( vtl->deferred_summary.track_times, TRUE );
+  vtl->deferred_summary.track_times = NULL;
+  g_free ( vtl->deferred_dirpath );
+  vtl->deferred_dirpath = NULL;
+}
+
+/**
+ * vik_trw_layer_get_track_times:
+ *
+ * Unlike vik_trw_layer_get_tracks(), this doesn't need the data of the layer to have been loaded.
+ *
+ * Returns: A new array of the times (as gdouble) of the first trackpoint of each track that has one
+ */
+GArray *vik_trw_layer_get_track_times ( VikTrwLayer *vtl )
+{
+  GArray *times = g_array_new ( FALSE, FALSE, sizeof(gdouble) );
+  if ( vtl->deferred_data ) {
+    g_array_append_vals ( times, vtl->deferred_summary.track_times->data, vtl->deferred_summary.track_times->len );
+    return times;
+  }
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init ( &iter, vtl->tracks );
+  while ( g_hash_table_iter_next ( &iter, &key, &value ) ) {
+    VikTrack *trk = VIK_TRACK(value);
+    if ( trk->trackpoints && !isnan(VIK_TRACKPOINT(trk->trackpoints->data)->timestamp) )
+      g_array_append_val ( times, VIK_TRACKPOINT(trk->trackpoints->data)->timestamp );
+  }
+  return times;
+}
+
 void trw_ensure_layer_loaded ( VikTrwLayer *trw )
 {
+  trw_layer_load_deferred ( trw );
   if ( trw->external_layer != VIK_TRW_LAYER_INTERNAL && ! trw->external_loaded ) {
     // set to true for now else the load will trigger redraws that will
     // trigger reloads...
@@ -11332,7 +12020,6 @@ static gboolean tool_splitter_click ( VikTrwLayer *vtl, GdkEventButton *event, V
   params.closest_track_id = NULL;
   params.closest_tp = NULL;
   params.closest_tpl = NULL;
-  params.bbox = vik_viewport_get_bbox ( vvp );
 
   if ( tool_select_tp ( vtl, &params, TRUE, TRUE ) )
   {
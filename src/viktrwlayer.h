@@ -43,7 +43,8 @@ enum {
   VIK_TRW_LAYER_SUBLAYER_TRACK,
   VIK_TRW_LAYER_SUBLAYER_WAYPOINT,
   VIK_TRW_LAYER_SUBLAYER_ROUTES,
-  VIK_TRW_LAYER_SUBLAYER_ROUTE
+  VIK_TRW_LAYER_SUBLAYER_ROUTE,
+  VIK_TRW_LAYER_SUBLAYER_NOT_LOADED
 };
 
 typedef struct _VikTrwLayerClass VikTrwLayerClass;
@@ -77,6 +78,16 @@ gboolean vik_trw_layer_find_date ( VikTrwLayer *vtl, const gchar *date_str, VikC
 void vik_trw_layer_filein_add_waypoint ( VikTrwLayer *vtl, gchar *name, VikWaypoint *wp );
 void vik_trw_layer_filein_add_track ( VikTrwLayer *vtl, gchar *name, VikTrack *tr );
 
+/**
+ * VikReadProgressFunc:
+ * @bytes_read: How much of the file has been read so far
+ *
+ * Called now and again by file readers, which may be in a background thread
+ *
+ * Returns: FALSE to stop reading the file
+ */
+typedef gboolean (*VikReadProgressFunc) ( gsize bytes_read, gpointer user_data );
+
 void vik_trw_layer_tidy_tracks ( VikTrwLayer *vtl, guint speed, gboolean recalc_bounds );
 
 gint vik_trw_layer_get_property_tracks_line_thickness ( VikTrwLayer *vtl );
@@ -96,6 +107,7 @@ gboolean vik_trw_layer_delete_route ( VikTrwLayer *vtl, VikTrack *trk );
 gboolean vik_trw_layer_auto_set_view ( VikTrwLayer *vtl, VikViewport *vvp );
 gboolean vik_trw_layer_find_center ( VikTrwLayer *vtl, VikCoord *dest );
 GHashTable *vik_trw_layer_get_tracks ( VikTrwLayer *l );
+GArray *vik_trw_layer_get_track_times ( VikTrwLayer *vtl );
 GHashTable *vik_trw_layer_get_routes ( VikTrwLayer *l );
 GHashTable *vik_trw_layer_get_waypoints ( VikTrwLayer *l );
 gboolean vik_trw_layer_is_empty ( VikTrwLayer *vtl );
@@ -103,6 +115,7 @@ gboolean vik_trw_layer_is_empty ( VikTrwLayer *vtl );
 gboolean vik_trw_layer_new_waypoint ( VikTrwLayer *vtl, GtkWindow *w, const VikCoord *def_coord );
 
 VikCoordMode vik_trw_layer_get_coord_mode ( VikTrwLayer *vtl );
+gboolean vik_trw_layer_is_external ( VikTrwLayer *vtl );
 
 gboolean vik_trw_layer_uniquify ( VikTrwLayer *vtl, VikLayersPanel *vlp );
 
@@ -140,7 +153,7 @@ typedef struct {
 typedef GList* (*VikTrwlayerGetWaypointsAndLayersFunc) (VikLayer*, gpointer);
 GList *vik_trw_layer_build_waypoint_list_t ( VikTrwLayer *vtl, GList *waypoints );
 
-GdkPixbuf* get_wp_sym_small ( gchar *symbol );
+GdkPixbuf* get_wp_sym_small ( const gchar *symbol );
 
 /* Exposed Layer Interface function definitions */
 // Intended only for use by other trw_layer subwindows
@@ -1269,7 +1269,8 @@ static void draw_dem_alt_speed_dist(VikTrack *tr,
 				    gboolean do_dem,
 				    gboolean do_speed)
 {
-  GList *iter;
+  const VikTrackData *data = vik_track_get_data ( tr );
+  guint ii;
   gdouble max_speed = 0;
   gdouble total_length = vik_track_get_length_including_gaps(tr);
 
@@ -1277,17 +1278,14 @@ static void draw_dem_alt_speed_dist(VikTrack *tr,
   if (do_speed)
     max_speed = max_speed_in * 110 / 100;
 
-  gdouble dist = 0;
   gint h2 = height + MARGIN_Y; // Adjust height for x axis labelling offset
   gint achunk = chunksa[cia]*LINES;
 
-  for (iter = tr->trackpoints->next; iter; iter = iter->next) {
+  for (ii = 1; ii < data->n_points; ii++) {
     int x;
-    dist += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-			     &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-    x = (width * dist)/total_length + margin;
+    x = (width * data->distances[ii])/total_length + margin;
     if (do_dem) {
-      gint16 elev = a_dems_get_elev_by_coord(&(VIK_TRACKPOINT(iter->data)->coord), VIK_DEM_INTERPOL_BEST);
+      gint16 elev = a_dems_get_elev_by_coord(&(data->coords[ii]), VIK_DEM_INTERPOL_BEST);
       if ( elev != VIK_DEM_INVALID_ELEVATION ) {
 	// Convert into height units
 	if (a_vik_get_units_height () == VIK_UNITS_HEIGHT_FEET)
@@ -1304,8 +1302,8 @@ static void draw_dem_alt_speed_dist(VikTrack *tr,
     }
     if (do_speed) {
       // This is just a speed indicator - no actual values can be inferred by user
-      if (!isnan(VIK_TRACKPOINT(iter->data)->speed)) {
-        int y_speed = h2 - (height * VIK_TRACKPOINT(iter->data)->speed)/max_speed;
+      if (!isnan(data->tps[ii]->speed)) {
+        int y_speed = h2 - (height * data->tps[ii]->speed)/max_speed;
         gdk_draw_rectangle(GDK_DRAWABLE(pix), speed_gc, TRUE, x-2, y_speed-2, 4, 4);
       }
     }
@@ -1625,7 +1623,8 @@ static void draw_speed_dist(VikTrack *tr,
 				    gint margin,
 				    gboolean do_speed)
 {
-  GList *iter;
+  const VikTrackData *data = vik_track_get_data ( tr );
+  guint ii;
   gdouble max_speed = 0;
   gdouble total_length = vik_track_get_length_including_gaps(tr);
 
@@ -1633,16 +1632,13 @@ static void draw_speed_dist(VikTrack *tr,
   if (do_speed)
     max_speed = max_speed_in * 110 / 100;
 
-  gdouble dist = 0;
-  for (iter = tr->trackpoints->next; iter; iter = iter->next) {
+  for (ii = 1; ii < data->n_points; ii++) {
     int x;
-    dist += vik_coord_diff ( &(VIK_TRACKPOINT(iter->data)->coord),
-			     &(VIK_TRACKPOINT(iter->prev->data)->coord) );
-    x = (width * dist)/total_length + MARGIN_X;
+    x = (width * data->distances[ii])/total_length + MARGIN_X;
     if (do_speed) {
       // This is just a speed indicator - no actual values can be inferred by user
-      if (!isnan(VIK_TRACKPOINT(iter->data)->speed)) {
-	int y_speed = height - (height * VIK_TRACKPOINT(iter->data)->speed)/max_speed;
+      if (!isnan(data->tps[ii]->speed)) {
+	int y_speed = height - (height * data->tps[ii]->speed)/max_speed;
 	gdk_draw_rectangle(GDK_DRAWABLE(pix), speed_gc, TRUE, x-2, y_speed-2, 4, 4);
       }
     }
@@ -2372,6 +2368,22 @@ static void draw_all_graphs ( GtkWidget *widget, PropWidgets *widgets, gboolean
   gdouble pc = NAN;
   gdouble pc_blob = NAN;
 
+  // Calculate the values for all the graphs in one go
+  guint profiles = 0;
+  if ( widgets->elev_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_ELEVATION);
+  if ( widgets->gradient_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_GRADIENT);
+  if ( widgets->speed_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_SPEED);
+  if ( widgets->dist_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_DISTANCE);
+  if ( widgets->elev_time_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_ELEVATION_TIME);
+  if ( widgets->speed_dist_box )
+    profiles |= VIK_TRACK_PROFILE_MASK(VIK_TRACK_PROFILE_SPEED_DIST);
+  vik_track_prepare_profiles ( widgets->tr, profiles, widgets->profile_width );
+
   // Draw elevations
   if (widgets->elev_box != NULL) {
 
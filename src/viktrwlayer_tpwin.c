@@ -141,6 +141,7 @@ static void tpwin_sync_alt_to_tp ( VikTrwLayerTpwin *tpwin )
       tpwin->cur_tp->altitude = gtk_spin_button_get_value ( tpwin->alt );
       g_critical("Houston, we've had a problem. height=%d", height_units);
     }
+    gtk_dialog_response ( GTK_DIALOG(tpwin), VIK_TRW_LAYER_TPWIN_DATA_CHANGED );
   }
 }
 
@@ -153,6 +154,7 @@ static void tpwin_sync_ts_to_tp ( VikTrwLayerTpwin *tpwin )
     tpwin->cur_tp->timestamp = gtk_spin_button_get_value ( tpwin->ts );
 
     tpwin_update_times ( tpwin, tpwin->cur_tp );
+    gtk_dialog_response ( GTK_DIALOG(tpwin), VIK_TRW_LAYER_TPWIN_DATA_CHANGED );
   }
 }
 
@@ -206,6 +208,7 @@ static void tpwin_sync_time_to_tp ( GtkWidget* widget, GdkEventButton *event, Vi
     gtk_button_set_image ( GTK_BUTTON(tpwin->time), NULL );
 
   tpwin_update_times ( tpwin, tpwin->cur_tp );
+  gtk_dialog_response ( GTK_DIALOG(tpwin), VIK_TRW_LAYER_TPWIN_DATA_CHANGED );
 }
 
 static gboolean tpwin_set_name ( VikTrwLayerTpwin *tpwin )
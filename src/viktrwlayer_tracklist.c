@@ -444,8 +444,8 @@ static void trw_layer_track_list_add ( vik_trw_track_list_t *vtdl,
 	guint trk_len_time = 0; // In minutes
 	if ( trk->trackpoints ) {
 		time_t t1, t2;
-		t1 = VIK_TRACKPOINT(g_list_first(trk->trackpoints)->data)->timestamp;
-		t2 = VIK_TRACKPOINT(g_list_last(trk->trackpoints)->data)->timestamp;
+		t1 = vik_track_get_tp_first(trk)->timestamp;
+		t2 = vik_track_get_tp_last(trk)->timestamp;
 		trk_len_time = (int)round(labs(t2-t1)/60.0);
 	}
 
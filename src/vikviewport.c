@@ -1307,6 +1307,256 @@ void vik_viewport_coord_to_screen ( VikViewport *vvp, const VikCoord *coord, int
   }
 }
 
+/**
+ * vik_viewport_get_projection:
+ *
+ * Get the current conversion from coordinates to the screen, for vik_viewport_projection_to_screen().
+ * It is only valid until the viewport is next moved, zoomed or resized.
+ */
+void vik_viewport_get_projection ( VikViewport *vvp, VikViewportProjection *proj )
+{
+  proj->coord_mode = vvp->coord_mode;
+  proj->drawmode = vvp->drawmode;
+  proj->center = vvp->center;
+  proj->center_merclat = MERCLAT ( vvp->center.north_south );
+  proj->xmpp = vvp->xmpp;
+  proj->ympp = vvp->ympp;
+  proj->xmfactor = vvp->xmfactor;
+  proj->ymfactor = vvp->ymfactor;
+  proj->width_2 = vvp->width_2;
+  proj->height_2 = vvp->height_2;
+  proj->utm_zone_width = vvp->utm_zone_width;
+  proj->one_utm_zone = vvp->one_utm_zone;
+}
+
+/*
+ * A single coordinate, including any not in the mode of the projection
+ */
+static void projection_coord_to_screen ( const VikViewportProjection *proj, const VikCoord *coord, GdkPoint *point )
+{
+  VikCoord tmp;
+  if ( coord->mode != proj->coord_mode ) {
+    g_warning ( "Have to convert in vik_viewport_projection_to_screen! This should never happen!");
+    vik_coord_copy_convert ( coord, proj->coord_mode, &tmp );
+    coord = &tmp;
+  }
+
+  if ( proj->coord_mode == VIK_COORD_UTM ) {
+    if ( proj->center.utm_zone != coord->utm_zone && proj->one_utm_zone ) {
+      point->x = point->y = VIK_VIEWPORT_UTM_WRONG_ZONE;
+      return;
+    }
+    point->x = ( (coord->east_west - proj->center.east_west) / proj->xmpp ) + (proj->width_2) -
+      (proj->center.utm_zone - coord->utm_zone ) * proj->utm_zone_width / proj->xmpp;
+    point->y = (proj->height_2) - ( (coord->north_south - proj->center.north_south) / proj->ympp );
+  } else if ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_LATLON ) {
+    point->x = proj->width_2 + ( proj->xmfactor * (coord->east_west - proj->center.east_west) );
+    point->y = proj->height_2 + ( proj->ymfactor * (proj->center.north_south - coord->north_south) );
+  } else if ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_EXPEDIA ) {
+    double xx, yy;
+    calcxy ( &xx, &yy, proj->center.east_west, proj->center.north_south, coord->east_west, coord->north_south,
+             proj->xmpp * ALTI_TO_MPP, proj->ympp * ALTI_TO_MPP, proj->width_2, proj->height_2 );
+    point->x = xx; point->y = yy;
+  } else if ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) {
+    point->x = proj->width_2 + ( proj->xmfactor * (coord->east_west - proj->center.east_west) );
+    point->y = proj->height_2 + ( proj->ymfactor * ( proj->center_merclat - MERCLAT(coord->north_south) ) );
+  }
+}
+
+/**
+ * vik_viewport_projection_to_screen:
+ * @points: Set to the screen positions, the same as vik_viewport_coord_to_screen() would give
+ *
+ * Convert an array of coordinates to the screen.
+ * The choice of how to convert is made once for all of them,
+ *  leaving simple loops for the common modes.
+ */
+void vik_viewport_projection_to_screen ( const VikViewportProjection *proj, const VikCoord *coords, guint n, GdkPoint *points )
+{
+  const gdouble ce = proj->center.east_west;
+  const gdouble cn = proj->center.north_south;
+  guint ii;
+
+  if ( proj->coord_mode == VIK_COORD_UTM ) {
+    for ( ii = 0; ii < n; ii++ ) {
+      if ( G_UNLIKELY(coords[ii].mode != VIK_COORD_UTM) ) {
+        projection_coord_to_screen ( proj, &coords[ii], &points[ii] );
+        continue;
+      }
+      if ( proj->one_utm_zone && coords[ii].utm_zone != proj->center.utm_zone ) {
+        points[ii].x = points[ii].y = VIK_VIEWPORT_UTM_WRONG_ZONE;
+        continue;
+      }
+      points[ii].x = ( (coords[ii].east_west - ce) / proj->xmpp ) + (proj->width_2) -
+        (proj->center.utm_zone - coords[ii].utm_zone ) * proj->utm_zone_width / proj->xmpp;
+      points[ii].y = (proj->height_2) - ( (coords[ii].north_south - cn) / proj->ympp );
+    }
+  }
+  else if ( proj->coord_mode == VIK_COORD_LATLON && proj->drawmode == VIK_VIEWPORT_DRAWMODE_LATLON ) {
+    for ( ii = 0; ii < n; ii++ ) {
+      if ( G_UNLIKELY(coords[ii].mode != VIK_COORD_LATLON) ) {
+        projection_coord_to_screen ( proj, &coords[ii], &points[ii] );
+        continue;
+      }
+      points[ii].x = proj->width_2 + ( proj->xmfactor * (coords[ii].east_west - ce) );
+      points[ii].y = proj->height_2 + ( proj->ymfactor * (cn - coords[ii].north_south) );
+    }
+  }
+  else if ( proj->coord_mode == VIK_COORD_LATLON && proj->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) {
+    for ( ii = 0; ii < n; ii++ ) {
+      if ( G_UNLIKELY(coords[ii].mode != VIK_COORD_LATLON) ) {
+        projection_coord_to_screen ( proj, &coords[ii], &points[ii] );
+        continue;
+      }
+      points[ii].x = proj->width_2 + ( proj->xmfactor * (coords[ii].east_west - ce) );
+      points[ii].y = proj->height_2 + ( proj->ymfactor * ( proj->center_merclat - MERCLAT(coords[ii].north_south) ) );
+    }
+  }
+  else {
+    // Only the Expedia projection remains, which is not worth a loop of its own
+    for ( ii = 0; ii < n; ii++ )
+      projection_coord_to_screen ( proj, &coords[ii], &points[ii] );
+  }
+}
+
+/**
+ * vik_viewport_coords_to_screen:
+ *
+ * Convert an array of coordinates to the screen, see vik_viewport_projection_to_screen()
+ */
+void vik_viewport_coords_to_screen ( VikViewport *vvp, const VikCoord *coords, guint n, GdkPoint *points )
+{
+  VikViewportProjection proj;
+  g_return_if_fail ( vvp != NULL );
+  vik_viewport_get_projection ( vvp, &proj );
+  vik_viewport_projection_to_screen ( &proj, coords, n, points );
+}
+
+/**
+ * vik_viewport_projection_has_world:
+ *
+ * Returns: Whether vik_viewport_projection_to_world() can be used.
+ *  The Expedia projection is not a simple scaling, so it can't.
+ */
+gboolean vik_viewport_projection_has_world ( const VikViewportProjection *proj )
+{
+  return proj->coord_mode == VIK_COORD_UTM ||
+    ( proj->coord_mode == VIK_COORD_LATLON &&
+      ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_LATLON || proj->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) );
+}
+
+/**
+ * vik_viewport_projection_same_world:
+ *
+ * Returns: Whether world positions made for @proj1 can be used with @proj2,
+ *  i.e. the projections differ by no more than a pan.
+ */
+gboolean vik_viewport_projection_same_world ( const VikViewportProjection *proj1, const VikViewportProjection *proj2 )
+{
+  if ( proj1->coord_mode != proj2->coord_mode || proj1->drawmode != proj2->drawmode ||
+       proj1->xmpp != proj2->xmpp || proj1->ympp != proj2->ympp ||
+       proj1->xmfactor != proj2->xmfactor || proj1->ymfactor != proj2->ymfactor )
+    return FALSE;
+  if ( proj1->coord_mode == VIK_COORD_UTM ) {
+    // Other zones are placed relative to the zone in the centre
+    if ( proj1->center.utm_zone != proj2->center.utm_zone || proj1->one_utm_zone != proj2->one_utm_zone )
+      return FALSE;
+    // NB The zone width follows the centre, but only matters when more than one zone is shown
+    if ( !proj1->one_utm_zone && proj1->utm_zone_width != proj2->utm_zone_width )
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * The world position of the centre of the projection
+ */
+static void projection_world_center ( const VikViewportProjection *proj, gint *x, gint *y )
+{
+  if ( proj->coord_mode == VIK_COORD_UTM ) {
+    *x = floor ( proj->center.east_west / proj->xmpp );
+    *y = floor ( -proj->center.north_south / proj->ympp );
+  } else if ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) {
+    *x = floor ( proj->xmfactor * proj->center.east_west );
+    *y = floor ( -proj->ymfactor * proj->center_merclat );
+  } else {
+    *x = floor ( proj->xmfactor * proj->center.east_west );
+    *y = floor ( -proj->ymfactor * proj->center.north_south );
+  }
+}
+
+/**
+ * vik_viewport_projection_to_world:
+ * @world: Set to the positions in pixels from a fixed origin, which don't depend on the centre
+ *
+ * Convert an array of coordinates to world positions,
+ *  which vik_viewport_projection_world_to_screen() then moves onto the screen of any projection
+ *  that vik_viewport_projection_same_world() accepts.
+ * Positions may be up to a pixel different to those from vik_viewport_projection_to_screen().
+ *
+ * Only for projections where vik_viewport_projection_has_world() is true.
+ */
+void vik_viewport_projection_to_world ( const VikViewportProjection *proj, const VikCoord *coords, guint n, GdkPoint *world )
+{
+  guint ii;
+  g_return_if_fail ( vik_viewport_projection_has_world ( proj ) );
+
+  for ( ii = 0; ii < n; ii++ ) {
+    VikCoord tmp;
+    const VikCoord *coord = &coords[ii];
+    if ( G_UNLIKELY(coord->mode != proj->coord_mode) ) {
+      vik_coord_copy_convert ( coord, proj->coord_mode, &tmp );
+      coord = &tmp;
+    }
+    if ( proj->coord_mode == VIK_COORD_UTM ) {
+      if ( proj->one_utm_zone && coord->utm_zone != proj->center.utm_zone ) {
+        world[ii].x = world[ii].y = VIK_VIEWPORT_UTM_WRONG_ZONE;
+        continue;
+      }
+      world[ii].x = floor ( ( coord->east_west - (proj->center.utm_zone - coord->utm_zone) * proj->utm_zone_width ) / proj->xmpp );
+      world[ii].y = floor ( -coord->north_south / proj->ympp );
+    } else if ( proj->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) {
+      world[ii].x = floor ( proj->xmfactor * coord->east_west );
+      world[ii].y = floor ( -proj->ymfactor * MERCLAT(coord->north_south) );
+    } else {
+      world[ii].x = floor ( proj->xmfactor * coord->east_west );
+      world[ii].y = floor ( -proj->ymfactor * coord->north_south );
+    }
+  }
+}
+
+/**
+ * vik_viewport_projection_world_to_screen:
+ *
+ * Move world positions from vik_viewport_projection_to_world() onto the screen,
+ *  which is only an offset in whole pixels.
+ */
+void vik_viewport_projection_world_to_screen ( const VikViewportProjection *proj, const GdkPoint *world, guint n, GdkPoint *points )
+{
+  gint cx, cy, dx, dy;
+  guint ii;
+  projection_world_center ( proj, &cx, &cy );
+  dx = proj->width_2 - cx;
+  dy = proj->height_2 - cy;
+
+  if ( proj->coord_mode == VIK_COORD_UTM && proj->one_utm_zone ) {
+    for ( ii = 0; ii < n; ii++ ) {
+      if ( world[ii].x == VIK_VIEWPORT_UTM_WRONG_ZONE ) {
+        points[ii] = world[ii];
+        continue;
+      }
+      points[ii].x = world[ii].x + dx;
+      points[ii].y = world[ii].y + dy;
+    }
+  }
+  else {
+    for ( ii = 0; ii < n; ii++ ) {
+      points[ii].x = world[ii].x + dx;
+      points[ii].y = world[ii].y + dy;
+    }
+  }
+}
+
 /**
  * a_viewport_clip_line:
  * @x1: screen coord
@@ -1393,6 +1643,57 @@ void vik_viewport_draw_line ( VikViewport *vvp, GdkGC *gc, gint x1, gint y1, gin
   }
 }
 
+#define DRAW_LINES_RUN 256
+
+/**
+ * vik_viewport_draw_lines:
+ *
+ * Draw a line through all the points, the same as drawing each segment with vik_viewport_draw_line()
+ *  but with far fewer calls to GDK.
+ * Segments off the screen are left out and the remainder clipped,
+ *  with the rest drawn as runs of consecutive segments.
+ */
+void vik_viewport_draw_lines ( VikViewport *vvp, GdkGC *gc, const GdkPoint *points, gint npoints )
+{
+  GdkPoint run[DRAW_LINES_RUN];
+  gint nn = 0;
+  gint ii;
+
+  for ( ii = 1; ii < npoints; ii++ ) {
+    gint x1 = points[ii-1].x, y1 = points[ii-1].y;
+    gint x2 = points[ii].x, y2 = points[ii].y;
+    if ( ( x1 < 0 && x2 < 0 ) || ( y1 < 0 && y2 < 0 ) ||
+         ( x1 > vvp->width && x2 > vvp->width ) || ( y1 > vvp->height && y2 > vvp->height ) ) {
+      if ( nn > 1 )
+        gdk_draw_lines ( vvp->scr_buffer, gc, run, nn );
+      nn = 0;
+      continue;
+    }
+    a_viewport_clip_line ( &x1, &y1, &x2, &y2 );
+    // A clipped start doesn't join on to the run so far
+    if ( nn > 0 && ( run[nn-1].x != x1 || run[nn-1].y != y1 ) ) {
+      if ( nn > 1 )
+        gdk_draw_lines ( vvp->scr_buffer, gc, run, nn );
+      nn = 0;
+    }
+    if ( nn == 0 ) {
+      run[0].x = x1;
+      run[0].y = y1;
+      nn = 1;
+    }
+    run[nn].x = x2;
+    run[nn].y = y2;
+    nn++;
+    if ( nn == DRAW_LINES_RUN ) {
+      gdk_draw_lines ( vvp->scr_buffer, gc, run, nn );
+      run[0] = run[nn-1];
+      nn = 1;
+    }
+  }
+  if ( nn > 1 )
+    gdk_draw_lines ( vvp->scr_buffer, gc, run, nn );
+}
+
 void vik_viewport_draw_rectangle ( VikViewport *vvp, GdkGC *gc, gboolean filled, gint x1, gint y1, gint x2, gint y2 )
 {
   // Using 32 as half the default waypoint image size, so this draws ensures the highlight gets done
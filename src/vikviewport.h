@@ -116,6 +116,29 @@ void vik_viewport_set_drawmode ( VikViewport *vvp, VikViewportDrawMode drawmode
 VikViewportDrawMode vik_viewport_get_drawmode ( VikViewport *vvp );
    /* Do not forget to update vik_viewport_get_drawmode_name() if you modify VikViewportDrawMode */
 
+/* Converting many coordinates at once */
+typedef struct {
+  VikCoordMode coord_mode;
+  VikViewportDrawMode drawmode;
+  VikCoord center;
+  gdouble center_merclat; /* The center latitude in the Mercator projection */
+  gdouble xmpp, ympp;
+  gdouble xmfactor, ymfactor;
+  gint width_2, height_2;
+  gdouble utm_zone_width;
+  gboolean one_utm_zone;
+} VikViewportProjection;
+
+void vik_viewport_get_projection ( VikViewport *vvp, VikViewportProjection *proj );
+void vik_viewport_projection_to_screen ( const VikViewportProjection *proj, const VikCoord *coords, guint n, GdkPoint *points );
+void vik_viewport_coords_to_screen ( VikViewport *vvp, const VikCoord *coords, guint n, GdkPoint *points );
+
+/* Positions that stay the same when the viewport is panned, only changing when it is zoomed or reprojected */
+gboolean vik_viewport_projection_has_world ( const VikViewportProjection *proj );
+gboolean vik_viewport_projection_same_world ( const VikViewportProjection *proj1, const VikViewportProjection *proj2 );
+void vik_viewport_projection_to_world ( const VikViewportProjection *proj, const VikCoord *coords, guint n, GdkPoint *world );
+void vik_viewport_projection_world_to_screen ( const VikViewportProjection *proj, const GdkPoint *world, guint n, GdkPoint *points );
+
 
 /* Triggers */
 void vik_viewport_set_trigger ( VikViewport *vp, gpointer trigger );
@@ -178,6 +201,7 @@ void vik_viewport_set_highlight_thickness ( VikViewport *vvp, gint thickness );
 /* Drawing primitives */
 void a_viewport_clip_line ( gint *x1, gint *y1, gint *x2, gint *y2 ); /* run this before drawing a line. vik_viewport_draw_line runs it for you */
 void vik_viewport_draw_line ( VikViewport *vvp, GdkGC *gc, gint x1, gint y1, gint x2, gint y2 );
+void vik_viewport_draw_lines ( VikViewport *vvp, GdkGC *gc, const GdkPoint *points, gint npoints );
 void vik_viewport_draw_rectangle ( VikViewport *vvp, GdkGC *gc, gboolean filled, gint x1, gint y1, gint x2, gint y2 );
 void vik_viewport_draw_string ( VikViewport *vvp, GdkFont *font, GdkGC *gc, gint x1, gint y1, const gchar *string );
 void vik_viewport_draw_arc ( VikViewport *vvp, GdkGC *gc, gboolean filled, gint x, gint y, gint width, gint height, gint angle1, gint angle2 );
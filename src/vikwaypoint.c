@@ -32,7 +32,7 @@
 
 VikWaypoint *vik_waypoint_new()
 {
-  VikWaypoint *wp = g_malloc0 ( sizeof ( VikWaypoint ) );
+  VikWaypoint *wp = g_slice_new0 ( VikWaypoint );
   wp->altitude = NAN;
   wp->name = g_strdup(_("Waypoint"));
   wp->image_direction = NAN;
@@ -89,13 +89,15 @@ void vik_waypoint_set_source(VikWaypoint *wp, const gchar *source)
     wp->source = NULL;
 }
 
+/**
+ * vik_waypoint_set_type:
+ *
+ * Types are generally shared by many waypoints, so only one copy of each is kept
+ */
 void vik_waypoint_set_type(VikWaypoint *wp, const gchar *type)
 {
-  if ( wp->type )
-    g_free ( wp->type );
-
   if ( type && type[0] != '\0' )
-    wp->type = g_strdup(type);
+    wp->type = g_intern_string(type);
   else
     wp->type = NULL;
 }
@@ -136,16 +138,14 @@ void vik_waypoint_set_symbol(VikWaypoint *wp, const gchar *symname)
 {
   const gchar *hashed_symname;
 
-  if ( wp->symbol )
-    g_free ( wp->symbol );
-
+  // NB As with the type, the symbol name is interned rather than copied
   // NB symbol_pixbuf is just a reference, so no need to free it
 
   if ( symname && symname[0] != '\0' ) {
     hashed_symname = a_get_hashed_sym ( symname );
     if ( hashed_symname )
       symname = hashed_symname;
-    wp->symbol = g_strdup ( symname );
+    wp->symbol = g_intern_string ( symname );
     wp->symbol_pixbuf = a_get_wp_sym ( wp->symbol );
   }
   else {
@@ -164,15 +164,11 @@ void vik_waypoint_free(VikWaypoint *wp)
     g_free ( wp->description );
   if ( wp->source )
     g_free ( wp->source );
-  if ( wp->type )
-    g_free ( wp->type );
   if ( wp->url )
     g_free ( wp->url );
   if ( wp->image )
     g_free ( wp->image );
-  if ( wp->symbol )
-    g_free ( wp->symbol );
-  g_free ( wp );
+  g_slice_free ( VikWaypoint, wp );
 }
 
 VikWaypoint *vik_waypoint_copy(const VikWaypoint *wp)
@@ -257,6 +253,7 @@ void vik_waypoint_marshall ( VikWaypoint *wp, guint8 **data, guint *datalen)
 VikWaypoint *vik_waypoint_unmarshall (const guint8 *data_in, guint datalen)
 {
   guint len;
+  gchar *str;
   VikWaypoint *new_wp = vik_waypoint_new();
   guint8 *data = (guint8*)data_in;
   // This copies the fixed sized elements (i.e. visibility, altitude, image_width, etc...)
@@ -278,13 +275,16 @@ VikWaypoint *vik_waypoint_unmarshall (const guint8 *data_in, guint datalen)
   vwu_get(new_wp->comment);
   vwu_get(new_wp->description);
   vwu_get(new_wp->source);
-  vwu_get(new_wp->type);
+  vwu_get(str);
+  vik_waypoint_set_type(new_wp, str);
+  g_free(str);
   vwu_get(new_wp->url);
   vwu_get(new_wp->image); 
-  vwu_get(new_wp->symbol);
+  vwu_get(str);
   // Different Viking instances need their seperate versions
   //  copying to itself will get the same reference
-  new_wp->symbol_pixbuf = a_get_wp_sym(new_wp->symbol);
+  vik_waypoint_set_symbol(new_wp, str);
+  g_free(str);
 
   return new_wp;
 #undef vwu_get
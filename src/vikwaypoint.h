@@ -46,7 +46,7 @@ struct _VikWaypoint {
   gchar *comment;
   gchar *description;
   gchar *source;
-  gchar *type;
+  const gchar *type; // Interned string - do not free
   gchar *url;
   gchar *image;
   // NB Only really applicable if geotagging(exif info) is being used
@@ -57,7 +57,7 @@ struct _VikWaypoint {
    * dimensions of the original image. */
   guint8 image_width;
   guint8 image_height;
-  gchar *symbol;
+  const gchar *symbol; // Interned string - do not free
   // Only for GUI display
   GdkPixbuf *symbol_pixbuf;
 };
@@ -29,7 +29,6 @@
 #include "background.h"
 #include "acquire.h"
 #include "datasources.h"
-#include "geojson.h"
 #include "vikgoto.h"
 #include "dems.h"
 #include "mapcache.h"
@@ -214,6 +213,8 @@ struct _VikWindow {
   gchar *filename;
   gboolean modified;
   VikLoadType_t loaded_type;
+  guint loads_pending; // Files still being read in the background
+  GPtrArray *loads; // Layers read in the background in the order they were asked for, waiting for the rest
 
   gboolean only_updating_coord_mode_ui; /* hack for a bug in GTK */
   GtkUIManager *uim;
@@ -618,6 +619,13 @@ static void window_finalize ( GObject *gob )
 
   window_list = g_slist_remove ( window_list, vw );
 
+  if ( vw->loads ) {
+    for ( guint ii = 0; ii < vw->loads->len; ii++ )
+      if ( g_ptr_array_index ( vw->loads, ii ) )
+        g_object_unref ( g_ptr_array_index ( vw->loads, ii ) );
+    g_ptr_array_free ( vw->loads, TRUE );
+  }
+
   gdk_cursor_unref ( vw->busy_cursor );
   int tt;
   for (tt = 0; tt < vw->vt->n_tools; tt++ )
@@ -3541,13 +3549,119 @@ void calendar_update ( VikWindow *vw )
 }
 #endif
 
+static void show_load_failure ( VikWindow *vw, VikLoadType_t load_type, const gchar *filename )
+{
+  switch ( load_type )
+  {
+    case LOAD_TYPE_READ_FAILURE:
+      a_dialog_error_msg ( GTK_WINDOW(vw), _("The file you requested could not be opened.") );
+      break;
+    case LOAD_TYPE_GPSBABEL_FAILURE:
+      a_dialog_error_msg ( GTK_WINDOW(vw), _("GPSBabel is required to load files of this type or GPSBabel encountered problems.") );
+      break;
+    case LOAD_TYPE_GPX_FAILURE:
+      a_dialog_error_msg_extra ( GTK_WINDOW(vw), _("Unable to load malformed GPX file %s"), filename );
+      break;
+    case LOAD_TYPE_UNSUPPORTED_FAILURE:
+      a_dialog_error_msg_extra ( GTK_WINDOW(vw), _("Unsupported file type for %s"), filename );
+      break;
+    default:
+      break;
+  }
+}
+
+typedef struct {
+  VikWindow *vw;
+  guint slot; // Where the layer goes in the window's loads
+} background_load_t;
+
+/**
+ * Keep the layer from a file read in the background,
+ *  then once the last of the files is in add all the layers, in the order the files were asked for, and draw just once
+ */
+static void file_loaded_in_background ( VikTrwLayer *vtl, const gchar *filename, VikLoadType_t load_type, background_load_t *bl )
+{
+  VikWindow *vw = bl->vw;
+  guint slot = bl->slot;
+  g_free ( bl );
+
+  // The window may have been closed while the file was being read
+  if ( ! g_slist_find ( window_list, vw ) ) {
+    if ( vtl )
+      g_object_unref ( vtl );
+    return;
+  }
+
+  if ( vtl ) {
+    g_ptr_array_index ( vw->loads, slot ) = vtl;
+    update_recently_used_document ( vw, filename );
+  }
+  else
+    show_load_failure ( vw, load_type, filename );
+
+  if ( vw->loads_pending )
+    vw->loads_pending--;
+  if ( vw->loads_pending )
+    return;
+
+  for ( guint ii = 0; ii < vw->loads->len; ii++ ) {
+    vtl = g_ptr_array_index ( vw->loads, ii );
+    if ( ! vtl )
+      continue;
+    vik_layer_post_read ( VIK_LAYER(vtl), vw->viking_vvp, TRUE );
+    vik_aggregate_layer_add_layer ( vik_layers_panel_get_top_layer(vw->viking_vlp), VIK_LAYER(vtl), FALSE );
+    vik_trw_layer_auto_set_view ( vtl, vw->viking_vvp );
+  }
+  g_ptr_array_set_size ( vw->loads, 0 );
+
+  draw_update ( vw );
+  vik_layers_panel_calendar_update ( vw->viking_vlp );
+}
+
+#define VIK_SETTINGS_WIN_BACKGROUND_LOAD_SIZE "window_background_load_size"
+
+/*
+ * A file on its own is only worth reading in the background when it is big enough to take a while
+ */
+static gboolean open_file_is_large ( const gchar *filename )
+{
+  gint size = 4*1024*1024;
+  gint setting;
+  if ( a_settings_get_integer ( VIK_SETTINGS_WIN_BACKGROUND_LOAD_SIZE, &setting ) )
+    size = setting;
+
+  if ( strncmp ( filename, "file://", 7 ) == 0 )
+    filename = filename + 7;
+  GStatBuf stat_buf;
+  return g_stat ( filename, &stat_buf ) == 0 && stat_buf.st_size >= size;
+}
+
 /**
  * @first: Indicates the first file in a possible list of files to be loaded
  * @last:  Indicates the last file in a possible list of files to be loaded
  *        Hence a draw operation can be performed
+ *
+ * When part of a list, or when large, files that just hold tracks, routes and waypoints are read in the background,
+ *  all at the same time, each into their own new layer.
  */
 void vik_window_open_file ( VikWindow *vw, const gchar *filename, gboolean change_filename, gboolean first, gboolean last, gboolean new_layer, gboolean external )
 {
+  if ( new_layer && ! a_vik_get_open_files_in_selected_layer() &&
+       a_file_load_in_background_possible ( filename ) &&
+       ( ! ( first && last ) || open_file_is_large ( filename ) ) ) {
+    // Something is being loaded, so no need to look for a location
+    vw->loaded_type = LOAD_TYPE_OTHER_SUCCESS;
+    if ( ! vw->loads )
+      vw->loads = g_ptr_array_new ();
+    background_load_t *bl = g_malloc ( sizeof(background_load_t) );
+    bl->vw = vw;
+    bl->slot = vw->loads->len;
+    g_ptr_array_add ( vw->loads, NULL );
+    vw->loads_pending++;
+    a_file_load_in_background ( vw->viking_vvp, filename, external, (VikFileLoadedFunc)file_loaded_in_background, bl );
+    return;
+  }
+
   if ( first )
     vik_window_set_busy_cursor ( vw );
 
@@ -3580,16 +3694,10 @@ void vik_window_open_file ( VikWindow *vw, const gchar *filename, gboolean chang
   switch ( vw->loaded_type )
   {
     case LOAD_TYPE_READ_FAILURE:
-      a_dialog_error_msg ( GTK_WINDOW(vw), _("The file you requested could not be opened.") );
-      break;
     case LOAD_TYPE_GPSBABEL_FAILURE:
-      a_dialog_error_msg ( GTK_WINDOW(vw), _("GPSBabel is required to load files of this type or GPSBabel encountered problems.") );
-      break;
     case LOAD_TYPE_GPX_FAILURE:
-      a_dialog_error_msg_extra ( GTK_WINDOW(vw), _("Unable to load malformed GPX file %s"), filename );
-      break;
     case LOAD_TYPE_UNSUPPORTED_FAILURE:
-      a_dialog_error_msg_extra ( GTK_WINDOW(vw), _("Unsupported file type for %s"), filename );
+      show_load_failure ( vw, vw->loaded_type, filename );
       break;
     case LOAD_TYPE_VIK_FAILURE_NON_FATAL:
     {
@@ -3857,7 +3965,8 @@ static gboolean window_save ( VikWindow *vw )
   vik_window_set_busy_cursor ( vw );
   gboolean success = TRUE;
 
-  if ( a_file_save ( vik_layers_panel_get_top_layer ( vw->viking_vlp ), vw->viking_vvp, vw->filename ) )
+  if ( a_file_save ( vik_layers_panel_get_top_layer ( vw->viking_vlp ), vw->viking_vvp, vw->filename,
+                     a_vik_get_file_save_format() == VIK_FILE_SAVE_FORMAT_BINARY ) )
   {
     update_recently_used_document ( vw, vw->filename );
   }
@@ -5212,12 +5321,10 @@ static void window_create_ui( VikWindow *window )
   }
 
   // GeoJSON import capability
-  if ( g_find_program_in_path ( a_geojson_program_import() ) ) {
-    if ( gtk_ui_manager_add_ui_from_string ( uim,
-         "<ui><menubar name='MainMenu'><menu action='File'><menu action='Acquire'><menuitem action='AcquireGeoJSON'/></menu></menu></menubar></ui>",
-         -1, &error ) )
-      gtk_action_group_add_actions ( action_group, entries_geojson, G_N_ELEMENTS (entries_geojson), window );
-  }
+  if ( gtk_ui_manager_add_ui_from_string ( uim,
+       "<ui><menubar name='MainMenu'><menu action='File'><menu action='Acquire'><menuitem action='AcquireGeoJSON'/></menu></menu></menubar></ui>",
+       -1, &error ) )
+    gtk_action_group_add_actions ( action_group, entries_geojson, G_N_ELEMENTS (entries_geojson), window );
 
   icon_factory = gtk_icon_factory_new ();
   gtk_icon_factory_add_default (icon_factory); 
@@ -0,0 +1,133 @@
+// Copyright: CC0
+// Measure how quickly the track and waypoint data of .vik files is read,
+//  both from a file and from text already in memory (as for layers loaded on first use)
+// run like:
+//  ./benchmark_gpspoint [file]
+// Without a file one with a long track is made up
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+#include "gpspoint.h"
+#include "viklayer.h"
+#include "viklayer_defaults.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+#define N_POINTS 1000000
+#define N_READS 3
+
+static gchar *write_example ( void )
+{
+  gchar *filename = NULL;
+  gint fd = g_file_open_tmp ( "benchmark_gpspoint_XXXXXX.txt", &filename, NULL );
+  if ( fd < 0 )
+    return NULL;
+  FILE *f = fdopen ( fd, "w" );
+
+  fprintf ( f, "type=\"track\" name=\"Walk\"\n" );
+  // Around Stonehenge, one point a second, written as Viking does
+  GRand *rand = g_rand_new_with_seed ( 1 );
+  gdouble lat = 51.1789, lon = -1.8262, ele = 100.0;
+  gchar slat[G_ASCII_DTOSTR_BUF_SIZE], slon[G_ASCII_DTOSTR_BUF_SIZE], sele[G_ASCII_DTOSTR_BUF_SIZE];
+  for ( guint ii = 0; ii < N_POINTS; ii++ ) {
+    lat += g_rand_double_range ( rand, -0.0002, 0.0002 );
+    lon += g_rand_double_range ( rand, -0.0003, 0.0003 );
+    ele += g_rand_double_range ( rand, -1.0, 1.0 );
+    fprintf ( f, "type=\"trackpoint\" latitude=\"%s\" longitude=\"%s\" altitude=\"%s\" unixtime=\"%d\"\n",
+              g_ascii_formatd ( slat, sizeof(slat), "%.6f", lat ),
+              g_ascii_formatd ( slon, sizeof(slon), "%.6f", lon ),
+              g_ascii_formatd ( sele, sizeof(sele), "%.1f", ele ),
+              1400000000 + ii );
+  }
+  g_rand_free ( rand );
+
+  fprintf ( f, "type=\"trackend\"\n" );
+  fclose ( f );
+  return filename;
+}
+
+static gulong count_trackpoints ( VikTrwLayer *vtl )
+{
+  gulong count = 0;
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init ( &iter, vik_trw_layer_get_tracks ( vtl ) );
+  while ( g_hash_table_iter_next ( &iter, NULL, &value ) )
+    count += vik_track_get_tp_count ( VIK_TRACK(value) );
+  return count;
+}
+
+static void report ( const gchar *name, gdouble elapsed, gsize size, gulong points )
+{
+  g_printf ( "%s %8.3fs  %8.1f MB/s  %10.0f points/s\n", name, elapsed, size / elapsed / (1024*1024), points / elapsed );
+}
+
+int main ( int argc, char *argv[] )
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+  g_type_init();
+#endif
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+
+  gchar *example = NULL;
+  const gchar *filename = argv[1];
+  if ( !filename ) {
+    example = write_example ();
+    filename = example;
+  }
+  gchar *text = NULL;
+  gsize size = 0;
+  if ( !filename || !g_file_get_contents ( filename, &text, &size, NULL ) ) {
+    g_printerr ( "Can not read %s\n", filename ? filename : "example file" );
+    return 1;
+  }
+
+  GTimer *timer = g_timer_new ();
+  for ( guint nn = 0; nn < N_READS; nn++ ) {
+    VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, NULL, FALSE );
+    FILE *f = g_fopen ( filename, "rb" );
+    g_timer_start ( timer );
+    gboolean ok = a_gpspoint_read_file ( VIK_TRW_LAYER(vl), f, NULL );
+    gdouble elapsed = g_timer_elapsed ( timer, NULL );
+    fclose ( f );
+    gulong points = count_trackpoints ( VIK_TRW_LAYER(vl) );
+    g_object_unref ( vl );
+    if ( !ok || (example && points != N_POINTS) ) {
+      g_printerr ( "Failed to read %s\n", filename );
+      return 1;
+    }
+    report ( "file:  ", elapsed, size, points );
+  }
+
+  for ( guint nn = 0; nn < N_READS; nn++ ) {
+    VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, NULL, FALSE );
+    g_timer_start ( timer );
+    gboolean ok = a_gpspoint_read_text ( VIK_TRW_LAYER(vl), text, size, NULL );
+    gdouble elapsed = g_timer_elapsed ( timer, NULL );
+    gulong points = count_trackpoints ( VIK_TRW_LAYER(vl) );
+    g_object_unref ( vl );
+    if ( !ok || (example && points != N_POINTS) ) {
+      g_printerr ( "Failed to read %s from memory\n", filename );
+      return 1;
+    }
+    report ( "memory:", elapsed, size, points );
+  }
+  g_timer_destroy ( timer );
+  g_free ( text );
+
+  if ( example ) {
+    g_remove ( example );
+    g_free ( example );
+  }
+
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright: CC0
+// Measure how quickly GPX files are read and written
+// run like:
+//  ./benchmark_gpx [file.gpx]
+// Without a file one with a long track is made up
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gprintf.h>
+#include "gpx.h"
+#include "viklayer.h"
+#include "viklayer_defaults.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+#define N_POINTS 500000
+#define N_READS 3
+#define N_WRITES 3
+
+static gchar *write_example ( void )
+{
+  gchar *filename = NULL;
+  gint fd = g_file_open_tmp ( "benchmark_gpx_XXXXXX.gpx", &filename, NULL );
+  if ( fd < 0 )
+    return NULL;
+  FILE *f = fdopen ( fd, "w" );
+
+  fprintf ( f, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n"
+               "<gpx version=\"1.1\" creator=\"benchmark_gpx\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+               "<trk>\n  <name>Walk</name>\n<trkseg>\n" );
+  // Around Stonehenge, one point a second
+  GRand *rand = g_rand_new_with_seed ( 1 );
+  gdouble lat = 51.1789, lon = -1.8262, ele = 100.0;
+  gchar slat[G_ASCII_DTOSTR_BUF_SIZE], slon[G_ASCII_DTOSTR_BUF_SIZE], sele[G_ASCII_DTOSTR_BUF_SIZE];
+  for ( guint ii = 0; ii < N_POINTS; ii++ ) {
+    lat += g_rand_double_range ( rand, -0.0002, 0.0002 );
+    lon += g_rand_double_range ( rand, -0.0003, 0.0003 );
+    ele += g_rand_double_range ( rand, -1.0, 1.0 );
+    guint secs = 1400000000 + ii;
+    fprintf ( f, "  <trkpt lat=\"%s\" lon=\"%s\">\n    <ele>%s</ele>\n    <time>2014-05-13T%02d:%02d:%02dZ</time>\n  </trkpt>\n",
+              g_ascii_formatd ( slat, sizeof(slat), "%.6f", lat ),
+              g_ascii_formatd ( slon, sizeof(slon), "%.6f", lon ),
+              g_ascii_formatd ( sele, sizeof(sele), "%.1f", ele ),
+              (secs / 3600) % 24, (secs / 60) % 60, secs % 60 );
+  }
+  g_rand_free ( rand );
+
+  fprintf ( f, "</trkseg>\n</trk>\n</gpx>\n" );
+  fclose ( f );
+  return filename;
+}
+
+int main ( int argc, char *argv[] )
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+  g_type_init();
+#endif
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+
+  gchar *example = NULL;
+  const gchar *filename = argv[1];
+  if ( !filename ) {
+    example = write_example ();
+    filename = example;
+  }
+  GStatBuf st;
+  if ( !filename || g_stat ( filename, &st ) != 0 ) {
+    g_printerr ( "Can not read %s\n", filename ? filename : "example file" );
+    return 1;
+  }
+
+  GTimer *timer = g_timer_new ();
+  for ( guint nn = 0; nn < N_READS; nn++ ) {
+    VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, NULL, FALSE );
+    FILE *f = g_fopen ( filename, "rb" );
+    g_timer_start ( timer );
+    gboolean ok = a_gpx_read_file ( VIK_TRW_LAYER(vl), f, NULL );
+    gdouble elapsed = g_timer_elapsed ( timer, NULL );
+    fclose ( f );
+    g_object_unref ( vl );
+    if ( !ok ) {
+      g_printerr ( "Failed to read %s\n", filename );
+      return 1;
+    }
+    g_printf ( "read: %8.3fs  %8.1f MB/s\n", elapsed, st.st_size / elapsed / (1024*1024) );
+  }
+
+  VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, NULL, FALSE );
+  FILE *f = g_fopen ( filename, "rb" );
+  a_gpx_read_file ( VIK_TRW_LAYER(vl), f, NULL );
+  fclose ( f );
+  for ( guint nn = 0; nn < N_WRITES; nn++ ) {
+    gchar *out = NULL;
+    gint fd = g_file_open_tmp ( "benchmark_gpx_XXXXXX.gpx", &out, NULL );
+    if ( fd < 0 )
+      return 1;
+    f = fdopen ( fd, "w" );
+    g_timer_start ( timer );
+    a_gpx_write_file ( VIK_TRW_LAYER(vl), f, NULL, NULL );
+    fflush ( f );
+    gdouble elapsed = g_timer_elapsed ( timer, NULL );
+    glong size = ftell ( f );
+    fclose ( f );
+    g_remove ( out );
+    g_free ( out );
+    g_printf ( "write: %7.3fs  %8.1f MB/s\n", elapsed, size / elapsed / (1024*1024) );
+  }
+  g_object_unref ( vl );
+  g_timer_destroy ( timer );
+
+  if ( example ) {
+    g_remove ( example );
+    g_free ( example );
+  }
+
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  return 0;
+}
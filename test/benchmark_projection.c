@@ -0,0 +1,97 @@
+// Copyright: CC0
+// Measure how many coordinates per second are converted to screen positions,
+//  one at a time, in batches and by panning positions already in world pixels,
+//  for each of the common viewport modes
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <math.h>
+#include "vikviewport.h"
+#include "globals.h"
+
+#define N_POINTS 100000
+#define N_ROUNDS 20
+
+static void benchmark ( const gchar *name, const VikViewportProjection *proj, const VikCoord *coords )
+{
+  GdkPoint *points = g_new ( GdkPoint, N_POINTS );
+  GTimer *timer = g_timer_new ();
+
+  g_timer_start ( timer );
+  for ( guint rr = 0; rr < N_ROUNDS; rr++ )
+    for ( guint ii = 0; ii < N_POINTS; ii++ )
+      vik_viewport_projection_to_screen ( proj, &coords[ii], 1, &points[ii] );
+  gdouble single = g_timer_elapsed ( timer, NULL );
+
+  g_timer_start ( timer );
+  for ( guint rr = 0; rr < N_ROUNDS; rr++ )
+    vik_viewport_projection_to_screen ( proj, coords, N_POINTS, points );
+  gdouble batch = g_timer_elapsed ( timer, NULL );
+
+  GdkPoint *world = g_new ( GdkPoint, N_POINTS );
+  vik_viewport_projection_to_world ( proj, coords, N_POINTS, world );
+  g_timer_start ( timer );
+  for ( guint rr = 0; rr < N_ROUNDS; rr++ )
+    vik_viewport_projection_world_to_screen ( proj, world, N_POINTS, points );
+  gdouble pan = g_timer_elapsed ( timer, NULL );
+
+  g_printf ( "%-10s single: %12.0f points/s  batch: %12.0f points/s  pan: %12.0f points/s\n", name,
+             N_POINTS * N_ROUNDS / single, N_POINTS * N_ROUNDS / batch, N_POINTS * N_ROUNDS / pan );
+
+  g_timer_destroy ( timer );
+  g_free ( world );
+  g_free ( points );
+}
+
+int main ( int argc, char *argv[] )
+{
+  VikCoord *coords = g_new0 ( VikCoord, N_POINTS );
+  GRand *rand = g_rand_new_with_seed ( 1 );
+
+  VikViewportProjection proj;
+  proj.xmpp = proj.ympp = 4.0;
+  proj.width_2 = 512;
+  proj.height_2 = 384;
+  proj.utm_zone_width = 0.0;
+  proj.one_utm_zone = TRUE;
+
+  // Around Stonehenge
+  proj.coord_mode = VIK_COORD_LATLON;
+  proj.center.mode = VIK_COORD_LATLON;
+  proj.center.north_south = 51.1789;
+  proj.center.east_west = -1.8262;
+  proj.xmfactor = 65536.0 * 256.0 / 360.0 / proj.xmpp;
+  proj.ymfactor = 65536.0 * 256.0 / 360.0 / proj.ympp;
+  for ( guint ii = 0; ii < N_POINTS; ii++ ) {
+    coords[ii].mode = VIK_COORD_LATLON;
+    coords[ii].north_south = proj.center.north_south + g_rand_double_range ( rand, -0.05, 0.05 );
+    coords[ii].east_west = proj.center.east_west + g_rand_double_range ( rand, -0.05, 0.05 );
+  }
+
+  proj.drawmode = VIK_VIEWPORT_DRAWMODE_LATLON;
+  proj.center_merclat = 0.0;
+  benchmark ( "LatLon", &proj, coords );
+
+  proj.drawmode = VIK_VIEWPORT_DRAWMODE_MERCATOR;
+  proj.center_merclat = MERCLAT ( proj.center.north_south );
+  benchmark ( "Mercator", &proj, coords );
+
+  proj.coord_mode = VIK_COORD_UTM;
+  proj.drawmode = VIK_VIEWPORT_DRAWMODE_UTM;
+  proj.center.mode = VIK_COORD_UTM;
+  proj.center.north_south = 5670000.0;
+  proj.center.east_west = 582000.0;
+  proj.center.utm_zone = 30;
+  proj.center.utm_letter = 'U';
+  for ( guint ii = 0; ii < N_POINTS; ii++ ) {
+    coords[ii].mode = VIK_COORD_UTM;
+    coords[ii].north_south = proj.center.north_south + g_rand_double_range ( rand, -5000.0, 5000.0 );
+    coords[ii].east_west = proj.center.east_west + g_rand_double_range ( rand, -5000.0, 5000.0 );
+    coords[ii].utm_zone = 30;
+    coords[ii].utm_letter = 'U';
+  }
+  benchmark ( "UTM", &proj, coords );
+
+  g_rand_free ( rand );
+  g_free ( coords );
+  return 0;
+}
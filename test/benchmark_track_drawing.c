@@ -0,0 +1,121 @@
+// Copyright: CC0
+// Measure drawing a million track segments onto a viewport:
+//  one line at a time against polylines, then a layer holding such a track
+// Needs a display to draw on
+#include <gtk/gtk.h>
+#include <glib/gprintf.h>
+#include "vikviewport.h"
+#include "viktrwlayer.h"
+#include "viklayer_defaults.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+#define N_SEGMENTS 1000000
+#define N_DRAWS 5
+#define WIDTH 1024
+#define HEIGHT 768
+
+static void benchmark_lines ( VikViewport *vvp, GRand *rand )
+{
+  GdkGC *gc = vik_viewport_new_gc ( vvp, "#000000", 2 );
+
+  // A random walk, mostly on the screen
+  GdkPoint *points = g_new ( GdkPoint, N_SEGMENTS+1 );
+  gint x = WIDTH/2, y = HEIGHT/2;
+  for ( guint ii = 0; ii <= N_SEGMENTS; ii++ ) {
+    x = CLAMP ( x + g_rand_int_range ( rand, -8, 9 ), -WIDTH/4, WIDTH + WIDTH/4 );
+    y = CLAMP ( y + g_rand_int_range ( rand, -8, 9 ), -HEIGHT/4, HEIGHT + HEIGHT/4 );
+    points[ii].x = x;
+    points[ii].y = y;
+  }
+
+  GTimer *timer = g_timer_new ();
+
+  g_timer_start ( timer );
+  for ( guint ii = 0; ii < N_SEGMENTS; ii++ )
+    vik_viewport_draw_line ( vvp, gc, points[ii].x, points[ii].y, points[ii+1].x, points[ii+1].y );
+  gdk_flush ();
+  gdouble single = g_timer_elapsed ( timer, NULL );
+
+  g_timer_start ( timer );
+  vik_viewport_draw_lines ( vvp, gc, points, N_SEGMENTS+1 );
+  gdk_flush ();
+  gdouble polyline = g_timer_elapsed ( timer, NULL );
+
+  g_printf ( "lines:      %8.3fs  polylines: %8.3fs\n", single, polyline );
+
+  g_timer_destroy ( timer );
+  g_free ( points );
+  g_object_unref ( gc );
+}
+
+static void benchmark_layer ( VikViewport *vvp, GRand *rand )
+{
+  VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, vvp, FALSE );
+  VikTrwLayer *vtl = VIK_TRW_LAYER(vl);
+
+  // Around Stonehenge
+  struct LatLon ll = { 51.1789, -1.8262 };
+  vik_viewport_set_center_latlon ( vvp, &ll, FALSE );
+  vik_viewport_set_zoom ( vvp, 4.0 );
+
+  VikTrack *trk = vik_track_new ();
+  GList *tpl = NULL;
+  for ( guint ii = 0; ii <= N_SEGMENTS; ii++ ) {
+    VikTrackpoint *tp = vik_trackpoint_new ();
+    ll.lat = CLAMP ( ll.lat + g_rand_double_range ( rand, -0.0002, 0.0002 ), 51.15, 51.21 );
+    ll.lon = CLAMP ( ll.lon + g_rand_double_range ( rand, -0.0003, 0.0003 ), -1.87, -1.78 );
+    vik_coord_load_from_latlon ( &tp->coord, vik_viewport_get_coord_mode ( vvp ), &ll );
+    tpl = g_list_prepend ( tpl, tp );
+  }
+  trk->trackpoints = g_list_reverse ( tpl );
+  vik_track_calculate_bounds ( trk );
+  vik_trw_layer_add_track ( vtl, g_strdup ( "Walk" ), trk );
+
+  GTimer *timer = g_timer_new ();
+  for ( guint nn = 0; nn < N_DRAWS; nn++ ) {
+    g_timer_start ( timer );
+    vik_layer_draw ( vl, vvp );
+    gdk_flush ();
+    g_printf ( "layer draw: %8.3fs\n", g_timer_elapsed ( timer, NULL ) );
+    // Then pan a little
+    vik_viewport_set_center_screen ( vvp, WIDTH/2 + 10, HEIGHT/2 + 10 );
+  }
+  g_timer_destroy ( timer );
+
+  g_object_unref ( vl );
+}
+
+int main ( int argc, char *argv[] )
+{
+  if ( !gtk_init_check ( &argc, &argv ) ) {
+    g_printf ( "No display available\n" );
+    return 0;
+  }
+
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+
+  GtkWidget *window = gtk_window_new ( GTK_WINDOW_TOPLEVEL );
+  VikViewport *vvp = vik_viewport_new ();
+  gtk_container_add ( GTK_CONTAINER(window), GTK_WIDGET(vvp) );
+  gtk_widget_realize ( GTK_WIDGET(vvp) );
+  vik_viewport_configure_manually ( vvp, WIDTH, HEIGHT );
+
+  g_printf ( "For %d segments\n", N_SEGMENTS );
+  GRand *rand = g_rand_new_with_seed ( 1 );
+  benchmark_lines ( vvp, rand );
+  benchmark_layer ( vvp, rand );
+  g_rand_free ( rand );
+
+  gtk_widget_destroy ( window );
+
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+
+# Enable running in test directory or via make distcheck when $srcdir is defined
+if [ -z "$srcdir" ]; then
+  srcdir=.
+fi
+
+# Saving in the binary form then loading it back must not lose anything
+#  (waypoints and tracks may come out in a different order, but not the points within a track)
+# So each trackpoint is joined onto the line of the track it's in before sorting
+by_item ()
+{
+  awk '/^type="(track|route)point"/ { item = item "\t" $0; next }
+       { if ( NR > 1 ) print item; item = $0 }
+       END { print item }' "$1" | sort
+}
+
+for file in $srcdir/WaypointSymbols.vik $srcdir/Stonehenge.gpx $srcdir/RobRoute.gpx; do
+  ./test_binary_file "$file" binary_expected.vik binary_file.vik binary_result.vik
+  rv=$?
+  if [ $rv -ne 0 ]; then
+    echo "binary file failure for $file"
+    exit $rv
+  fi
+  by_item binary_expected.vik > binary_expected_sorted.vik
+  by_item binary_result.vik > binary_result_sorted.vik
+  if ! cmp -s binary_expected_sorted.vik binary_result_sorted.vik; then
+    echo "binary file difference for $file"
+    diff binary_expected_sorted.vik binary_result_sorted.vik | head
+    exit 1
+  fi
+done
+rm -f binary_expected.vik binary_file.vik binary_result.vik binary_expected_sorted.vik binary_result_sorted.vik
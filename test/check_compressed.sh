@@ -0,0 +1,45 @@
+#!/bin/sh
+
+# Enable running in test directory or via make distcheck when $srcdir is defined
+if [ -z "$srcdir" ]; then
+  srcdir=.
+fi
+
+# A compressed file must load just the same as the file itself
+#  (apart from the name of the layer, which comes from the file name)
+./test_binary_file $srcdir/Stonehenge.gpx compressed_expected.vik compressed_binary.vik compressed_result.vik
+rv=$?
+if [ $rv -ne 0 ]; then
+  exit $rv
+fi
+grep -v "^name=" compressed_expected.vik | sort > compressed_expected_sorted.vik
+
+# Including compressed data within compressed data, which is not a file of its own
+for tool in gzip:gz bzip2:bz2 gzip,bzip2:gz.bz2; do
+  ext=${tool#*:}
+  tool=$(echo ${tool%:*} | tr , ' ')
+  cp $srcdir/Stonehenge.gpx compressed.data
+  for each in $tool; do
+    if ! command -v $each > /dev/null; then
+      continue 2
+    fi
+    $each -c compressed.data > compressed.tmp
+    mv compressed.tmp compressed.data
+  done
+  mv compressed.data compressed.gpx.$ext
+  ./test_binary_file compressed.gpx.$ext compressed_text.vik compressed_binary.vik compressed_result.vik
+  rv=$?
+  if [ $rv -ne 0 ]; then
+    echo "$tool file failure"
+    exit $rv
+  fi
+  grep -v "^name=" compressed_text.vik | sort > compressed_text_sorted.vik
+  if ! cmp -s compressed_expected_sorted.vik compressed_text_sorted.vik; then
+    echo "$tool file difference"
+    diff compressed_expected_sorted.vik compressed_text_sorted.vik | head
+    exit 1
+  fi
+  rm -f compressed.gpx.$ext
+done
+rm -f compressed.data
+rm -f compressed_expected.vik compressed_binary.vik compressed_result.vik compressed_text.vik compressed_expected_sorted.vik compressed_text_sorted.vik
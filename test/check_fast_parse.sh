@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# Quick number and time parsing must give the same values as glib
+./test_fast_parse
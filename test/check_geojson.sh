@@ -0,0 +1,38 @@
+#!/bin/sh
+
+# Enable running in test directory or via make distcheck when $srcdir is defined
+if [ -z "$srcdir" ]; then
+  srcdir=.
+fi
+
+# GeoJSON written by Viking must read back the same
+for file in $srcdir/Stonehenge.gpx $srcdir/RobRoute.gpx $srcdir/Features.geojson; do
+  if ! ./test_geojson "$file" geojson_first.geojson || ! ./test_geojson geojson_first.geojson geojson_second.geojson; then
+    echo "geojson failure for $file"
+    exit 1
+  fi
+  if ! cmp -s geojson_first.geojson geojson_second.geojson; then
+    echo "geojson difference for $file"
+    diff geojson_first.geojson geojson_second.geojson | head
+    exit 1
+  fi
+done
+
+# Points and MultiPoints are waypoints, LineStrings and MultiLineStrings are tracks, others are ignored
+./test_geojson $srcdir/Features.geojson geojson_first.geojson
+if [ $(grep -c '"type":"Point"' geojson_first.geojson) -ne 3 ] ||
+   [ $(grep -c '"type":"LineString"' geojson_first.geojson) -ne 1 ] ||
+   [ $(grep -c '"type":"MultiLineString"' geojson_first.geojson) -ne 1 ] ||
+   grep -q Ignored geojson_first.geojson; then
+  echo "geojson features wrongly read"
+  exit 1
+fi
+for expected in '"name":"Stonehenge \"Heel\" Stone"' '"desc":"Line one\nLine two"' '"time":"2014-05-13T18:19:20Z"' \
+                '"coordTimes":["2014-05-13T18:00:00Z","2014-05-13T18:00:01.500000Z","2014-05-13T18:00:03Z"]' \
+                '"name":"Cursus é😀"' '"name":"Barrows"'; do
+  if ! grep -qF "$expected" geojson_first.geojson; then
+    echo "geojson features missing $expected"
+    exit 1
+  fi
+done
+rm -f geojson_first.geojson geojson_second.geojson
@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# R-tree searches must find exactly the same items as a search of every item
+./test_rtree
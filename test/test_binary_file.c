@@ -0,0 +1,54 @@
+// Copyright: CC0
+// Save a file in the binary form, load it back and save that as text:
+//  the text must hold the same as the text saved from the original
+// Usage: test_binary_file <input file> <expected text output> <binary output> <result text output>
+// Needs a display for the viewport
+#include <gtk/gtk.h>
+#include <glib/gprintf.h>
+#include "file.h"
+#include "viklayer_defaults.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+int main ( int argc, char *argv[] )
+{
+  if ( !gtk_init_check ( &argc, &argv ) ) {
+    g_printf ( "No display available\n" );
+    // Skipped
+    return 77;
+  }
+  if ( argc != 5 ) {
+    g_printerr ( "Usage: %s <input file> <expected text output> <binary output> <result text output>\n", argv[0] );
+    return 1;
+  }
+
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+
+  VikViewport *vvp = vik_viewport_new ();
+  g_object_ref_sink ( vvp );
+  VikAggregateLayer *top = VIK_AGGREGATE_LAYER(vik_layer_create ( VIK_LAYER_AGGREGATE, vvp, FALSE ));
+  VikAggregateLayer *reread = VIK_AGGREGATE_LAYER(vik_layer_create ( VIK_LAYER_AGGREGATE, vvp, FALSE ));
+
+  int rv = 1;
+  // Binary first, as the text of layers not yet used is written back as it was read
+  if ( a_file_load ( top, vvp, NULL, argv[1], TRUE, FALSE, NULL ) >= LOAD_TYPE_VIK_SUCCESS &&
+       a_file_save ( top, vvp, argv[3], TRUE ) &&
+       a_file_save ( top, vvp, argv[2], FALSE ) &&
+       a_file_load ( reread, vvp, NULL, argv[3], TRUE, FALSE, NULL ) == LOAD_TYPE_VIK_SUCCESS &&
+       a_file_save ( reread, vvp, argv[4], FALSE ) )
+    rv = 0;
+
+  g_object_unref ( reread );
+  g_object_unref ( top );
+  g_object_unref ( vvp );
+
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  return rv;
+}
@@ -0,0 +1,89 @@
+// Copyright: CC0
+// Check the quick number and time parsing used when reading GPX files
+//  gives exactly the same values as the general glib functions
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <string.h>
+#include "util.h"
+
+#define N_VALUES 200000
+
+static gboolean check_number ( const gchar *str )
+{
+  gdouble expected = g_ascii_strtod ( str, NULL );
+  gdouble result = util_ascii_strtod ( str );
+  if ( memcmp ( &result, &expected, sizeof(gdouble) ) ) {
+    g_printerr ( "%s gave %.17g, expected %.17g\n", str, result, expected );
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean check_time ( const gchar *str )
+{
+  GTimeVal tv;
+  gboolean expected_ok = g_time_val_from_iso8601 ( str, &tv );
+  gdouble expected = 0.0;
+  if ( expected_ok ) {
+    gdouble d1 = tv.tv_sec;
+    gdouble d2 = (gdouble)tv.tv_usec/G_USEC_PER_SEC;
+    expected = (d1 < 0) ? d1 - d2 : d1 + d2;
+  }
+  gdouble result = 0.0;
+  gboolean ok = util_iso8601_to_timestamp ( str, &result );
+  if ( ok != expected_ok || result != expected ) {
+    g_printerr ( "%s gave %d %.6f, expected %d %.6f\n", str, ok, result, expected_ok, expected );
+    return FALSE;
+  }
+  return TRUE;
+}
+
+int main ( int argc, char *argv[] )
+{
+  static const gchar *numbers[] = {
+    "0", "-0", "0.0", "1", "-1", "51.1789", "-1.8262", "123.45", "1e5", "1.5E-3", "+7.25",
+    "9007199254740993", "9007199254740992.5", "1234567890123456789012", "0.1e23", "1e-23",
+    "4.9e-324", "1.7976931348623157e308", "1e309", "nan", "inf", "", "abc", " 12.5", "12.5 ",
+    "12,5", "12.5abc", ".5", "5.", "-.5e1", "0x10", "00012.000", NULL };
+  static const gchar *times[] = {
+    "2015-03-19T10:11:12Z", "2015-03-19T10:11:12.345Z", "2015-03-19T10:11:12,5Z",
+    "2015-03-19T10:11:12.1234567Z", "2015-03-19T10:11:12+01:00", "2015-03-19T10:11:12-05:30",
+    "2015-03-19T10:11:12", "1970-01-01T00:00:00Z", "1969-12-31T23:59:59Z", "2100-02-28T12:00:00Z",
+    "2016-02-29T23:59:60Z", "20150319T101112Z", "2015-03-19 10:11:12Z", "2015-3-19T10:11:12Z",
+    "2015-03-19T10:11:12Zjunk", "", "garbage", NULL };
+
+  for ( const gchar **str = numbers; *str; str++ )
+    if ( !check_number ( *str ) )
+      return 1;
+  for ( const gchar **str = times; *str; str++ )
+    if ( !check_time ( *str ) )
+      return 1;
+
+  GRand *rand = g_rand_new_with_seed ( 7 );
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  for ( guint ii = 0; ii < N_VALUES; ii++ ) {
+    // Coordinates and altitudes as usually written, and some with every digit
+    gdouble value = g_rand_double_range ( rand, -10000.0, 10000.0 );
+    g_ascii_formatd ( buf, sizeof(buf), "%.6f", value );
+    if ( !check_number ( buf ) )
+      return 1;
+    g_ascii_formatd ( buf, sizeof(buf), "%.17g", value );
+    if ( !check_number ( buf ) )
+      return 1;
+    g_ascii_formatd ( buf, sizeof(buf), "%.3e", value * g_rand_double ( rand ) );
+    if ( !check_number ( buf ) )
+      return 1;
+
+    gchar *str = g_strdup_printf ( "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                                   g_rand_int_range ( rand, 1960, 2110 ), g_rand_int_range ( rand, 1, 13 ),
+                                   g_rand_int_range ( rand, 1, 32 ), g_rand_int_range ( rand, 0, 24 ),
+                                   g_rand_int_range ( rand, 0, 60 ), g_rand_int_range ( rand, 0, 60 ),
+                                   g_rand_int_range ( rand, 0, 1000 ) );
+    gboolean ok = check_time ( str );
+    g_free ( str );
+    if ( !ok )
+      return 1;
+  }
+  g_rand_free ( rand );
+  return 0;
+}
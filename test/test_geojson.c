@@ -0,0 +1,63 @@
+// Copyright: CC0
+// Read GPX or GeoJSON (by the file extension) and write it out as GeoJSON
+// run like:
+//  ./test_geojson input.gpx output.geojson
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gpx.h"
+#include "geojson.h"
+#include "viklayer.h"
+#include "viklayer_defaults.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+int main ( int argc, char *argv[] )
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+  g_type_init();
+#endif
+  if ( argc != 3 ) {
+    g_printerr ( "Usage: %s input output.geojson\n", argv[0] );
+    return 1;
+  }
+
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+
+  VikLayer *vl = vik_layer_create ( VIK_LAYER_TRW, NULL, FALSE );
+  VikTrwLayer *vtl = VIK_TRW_LAYER(vl);
+
+  int ans = 0;
+  FILE *f = g_fopen ( argv[1], "r" );
+  if ( !f ) {
+    g_printerr ( "Can not open %s\n", argv[1] );
+    ans = 1;
+  }
+  else {
+    gboolean ok;
+    if ( g_str_has_suffix ( argv[1], ".gpx" ) )
+      ok = a_gpx_read_file ( vtl, f, NULL );
+    else
+      ok = a_geojson_read_file ( vtl, f );
+    fclose ( f );
+
+    FILE *ff = g_fopen ( argv[2], "w" );
+    if ( !ok || !ff || !a_geojson_write_file ( vtl, ff ) ) {
+      g_printerr ( "Failed to convert %s\n", argv[1] );
+      ans = 1;
+    }
+    if ( ff )
+      fclose ( ff );
+  }
+  g_object_unref ( vl );
+
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  return ans;
+}
@@ -0,0 +1,116 @@
+// Copyright: CC0
+// Check R-tree searches find the same items as looking at every item
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <string.h>
+#include "rtree.h"
+
+#define N_ITEMS 5000
+
+static LatLonBBox boxes[N_ITEMS];
+static gboolean present[N_ITEMS];
+
+static void count_found ( gpointer item, gpointer user_data )
+{
+  guint *found = user_data;
+  found[GPOINTER_TO_UINT(item)-1]++;
+}
+
+static gboolean overlaps ( const LatLonBBox *aa, const LatLonBBox *bb )
+{
+  return aa->south <= bb->north && aa->north >= bb->south && aa->east >= bb->west && aa->west <= bb->east;
+}
+
+static LatLonBBox random_bbox ( GRand *rand, gdouble max_size )
+{
+  LatLonBBox bbox;
+  bbox.south = g_rand_double_range ( rand, -80.0, 80.0 );
+  bbox.west = g_rand_double_range ( rand, -170.0, 170.0 );
+  // Includes boxes of single points
+  if ( g_rand_boolean ( rand ) ) {
+    bbox.north = bbox.south;
+    bbox.east = bbox.west;
+  }
+  else {
+    bbox.north = bbox.south + g_rand_double_range ( rand, 0.0, max_size );
+    bbox.east = bbox.west + g_rand_double_range ( rand, 0.0, max_size );
+  }
+  return bbox;
+}
+
+static gboolean check ( VikRTree *rt, GRand *rand )
+{
+  static guint found[N_ITEMS];
+  guint expected = 0;
+  for ( guint ii = 0; ii < N_ITEMS; ii++ )
+    if ( present[ii] )
+      expected++;
+  if ( vik_rtree_size ( rt ) != expected ) {
+    g_printerr ( "Size %d, expected %d\n", vik_rtree_size ( rt ), expected );
+    return FALSE;
+  }
+
+  for ( guint nn = 0; nn < 200; nn++ ) {
+    LatLonBBox area = random_bbox ( rand, 40.0 );
+    memset ( found, 0, sizeof(found) );
+    vik_rtree_search ( rt, &area, count_found, found );
+    for ( guint ii = 0; ii < N_ITEMS; ii++ ) {
+      guint want = present[ii] && overlaps ( &boxes[ii], &area ) ? 1 : 0;
+      if ( found[ii] != want ) {
+        g_printerr ( "Item %d found %d times, expected %d\n", ii, found[ii], want );
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+int main ( int argc, char *argv[] )
+{
+  GRand *rand = g_rand_new_with_seed ( 42 );
+  VikRTree *rt = vik_rtree_new ();
+
+  for ( guint ii = 0; ii < N_ITEMS; ii++ ) {
+    boxes[ii] = random_bbox ( rand, 2.0 );
+    vik_rtree_insert ( rt, GUINT_TO_POINTER(ii+1), &boxes[ii] );
+    present[ii] = TRUE;
+  }
+  if ( !check ( rt, rand ) )
+    return 1;
+
+  // Move some and remove others
+  for ( guint ii = 0; ii < N_ITEMS; ii++ ) {
+    switch ( g_rand_int_range ( rand, 0, 3 ) ) {
+    case 0:
+      boxes[ii] = random_bbox ( rand, 2.0 );
+      vik_rtree_insert ( rt, GUINT_TO_POINTER(ii+1), &boxes[ii] );
+      break;
+    case 1:
+      if ( !vik_rtree_remove ( rt, GUINT_TO_POINTER(ii+1) ) )
+        return 1;
+      present[ii] = FALSE;
+      break;
+    default:
+      break;
+    }
+  }
+  if ( !check ( rt, rand ) )
+    return 1;
+
+  for ( guint ii = 0; ii < N_ITEMS; ii++ ) {
+    LatLonBBox bbox;
+    if ( vik_rtree_lookup ( rt, GUINT_TO_POINTER(ii+1), &bbox ) != present[ii] )
+      return 1;
+    if ( present[ii] && memcmp ( &bbox, &boxes[ii], sizeof(bbox) ) )
+      return 1;
+    if ( present[ii] && !vik_rtree_remove ( rt, GUINT_TO_POINTER(ii+1) ) )
+      return 1;
+    present[ii] = FALSE;
+  }
+  if ( !check ( rt, rand ) )
+    return 1;
+
+  vik_rtree_free ( rt );
+  g_rand_free ( rand );
+  return 0;
+}